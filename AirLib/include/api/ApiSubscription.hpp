@@ -0,0 +1,146 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef air_ApiSubscription_hpp
+#define air_ApiSubscription_hpp
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "common/Common.hpp"
+#include "common/common_utils/ScheduledExecutor.hpp"
+
+namespace msr { namespace airlib {
+
+/*
+    Server side of data subscription. Sampler is called on its own thread at requested rate and each
+    sample with new time stamp is queued with increasing sequence number, samples with same time stamp
+    as previous one are dropped so subscriber gets every sample only once. Subscriber takes queued samples
+    with poll() which blocks until there is at least one sample, so from subscriber's point of view samples
+    are pushed as soon as they are available. If subscriber falls behind, oldest samples are dropped once
+    queue is full, subscriber can detect this by gaps in sequence numbers.
+
+    If nobody has polled for lease duration, the subscription expires and stops sampling. This cleans up
+    after clients that went away without unsubscribing.
+
+    TSample must have sequence and time_stamp fields.
+*/
+template <typename TSample>
+class ApiSubscription {
+public:
+    typedef std::function<TSample()> Sampler;
+
+    ApiSubscription(const Sampler& sampler, float rate_hz, unsigned int queue_size, float lease_sec = 10)
+        : sampler_(sampler), queue_size_(std::max(queue_size, 1u)),
+        lease_(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(lease_sec)))
+    {
+        if (rate_hz <= 0)
+            throw std::invalid_argument("Subscription rate must be positive");
+
+        last_poll_ = Clock::now();
+        executor_.initialize(std::bind(&ApiSubscription::sample, this, std::placeholders::_1),
+            static_cast<uint64_t>(1E9 / rate_hz));
+        executor_.start();
+    }
+
+    ~ApiSubscription()
+    {
+        stop();
+    }
+
+    //returns queued samples, waits up to timeout if there are none, returns empty if subscription is stopped
+    std::vector<TSample> poll(float timeout_sec)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        last_poll_ = Clock::now();
+
+        sample_cv_.wait_for(lock, std::chrono::duration<float>(timeout_sec), [this]() {
+            return !queue_.empty() || is_stopped_;
+        });
+
+        std::vector<TSample> samples(std::make_move_iterator(queue_.begin()), std::make_move_iterator(queue_.end()));
+        queue_.clear();
+        last_poll_ = Clock::now();
+        return samples;
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            is_stopped_ = true;
+        }
+        sample_cv_.notify_all();
+        executor_.stop();
+    }
+
+    bool isStopped() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return is_stopped_;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    bool sample(uint64_t)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (is_stopped_ || Clock::now() - last_poll_ > lease_) {
+                is_stopped_ = true;
+                sample_cv_.notify_all();
+                return false;
+            }
+        }
+
+        //sampling can take long, e.g., rendering images, so don't block pollers meanwhile
+        TSample sample;
+        try {
+            sample = sampler_();
+        }
+        catch (const std::exception& ex) {
+            Utils::log(Utils::stringf("Subscription sampling failed: %s", ex.what()), Utils::kLogLevelError);
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (has_sample_ && sample.time_stamp == last_time_stamp_)
+            return true;
+
+        has_sample_ = true;
+        last_time_stamp_ = sample.time_stamp;
+        sample.sequence = ++sequence_;
+
+        if (queue_.size() >= queue_size_)
+            queue_.pop_front();
+        queue_.push_back(std::move(sample));
+        sample_cv_.notify_all();
+
+        return true;
+    }
+
+private:
+    Sampler sampler_;
+    unsigned int queue_size_;
+    Clock::duration lease_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable sample_cv_;
+    std::deque<TSample> queue_;
+    Clock::time_point last_poll_;
+    bool is_stopped_ = false;
+
+    bool has_sample_ = false;
+    TTimePoint last_time_stamp_ = 0;
+    uint64_t sequence_ = 0;
+
+    //declared last so sampling thread stops before other members are destroyed
+    common_utils::ScheduledExecutor executor_;
+};
+
+}} //namespace
+#endif
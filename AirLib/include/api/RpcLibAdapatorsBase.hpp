@@ -11,11 +11,17 @@
 #include "common/ImageCaptureBase.hpp"
 #include "safety/SafetyEval.hpp"
 #include "api/WorldSimApiBase.hpp"
+#include "api/VehicleStateQuery.hpp"
+#include "common/common_utils/SharedMemoryRing.hpp"
 
 #include "common/common_utils/WindowsApisCommonPre.hpp"
 #include "rpc/msgpack.hpp"
 #include "common/common_utils/WindowsApisCommonPost.hpp"
 
+#ifndef RPCLIB_MSGPACK
+#define RPCLIB_MSGPACK clmdep_msgpack
+#endif // !RPCLIB_MSGPACK
+
 namespace msr { namespace airlib_rpclib {
 
 class RpcLibAdapatorsBase {
@@ -378,9 +384,20 @@ public:
         }         
     };
 
+    /*
+        Image pixels are the bulk of the traffic so this adaptor avoids copying them wherever it can:
+        - server moves buffers out of ImageCaptureBase::ImageResponse into the adaptor,
+        - buffers are shared with msgpack zone when rpclib converts return value to msgpack object
+          so uint8 pixels are serialized as bin straight from the buffer filled by renderer,
+        - client decodes received message directly into ImageCaptureBase::ImageResponse, optionally
+          reusing buffers of responses from previous call.
+        Wire format is same as MSGPACK_DEFINE_MAP would produce so other clients such as Python are unaffected.
+        Empty buffers are sent as is, decoding below doesn't have the empty vector problem of
+        https://github.com/rpclib/rpclib/issues/152 so no placeholder element is needed.
+    */
     struct ImageResponse {
-        std::vector<uint8_t> image_data_uint8;
-        std::vector<float> image_data_float;
+        std::shared_ptr<std::vector<uint8_t>> image_data_uint8;
+        std::shared_ptr<std::vector<float>> image_data_float;
 
         std::string camera_name;
         Vector3r camera_position;
@@ -392,25 +409,223 @@ public:
         int width, height;
         msr::airlib::ImageCaptureBase::ImageType image_type;
 
-        MSGPACK_DEFINE_MAP(image_data_uint8, image_data_float, camera_position, camera_name,
-            camera_orientation, time_stamp, message, pixels_as_float, compress, width, height, image_type);
-
         ImageResponse()
+            : image_data_uint8(std::make_shared<std::vector<uint8_t>>()), image_data_float(std::make_shared<std::vector<float>>())
         {}
 
         ImageResponse(const msr::airlib::ImageCaptureBase::ImageResponse& s)
         {
-            pixels_as_float = s.pixels_as_float;
-            
-            image_data_uint8 = s.image_data_uint8;
-            image_data_float = s.image_data_float;
+            image_data_uint8 = std::make_shared<std::vector<uint8_t>>(s.image_data_uint8);
+            image_data_float = std::make_shared<std::vector<float>>(s.image_data_float);
+            setFields(s);
+        }
 
-            //TODO: remove bug workaround for https://github.com/rpclib/rpclib/issues/152
-            if (image_data_uint8.size() == 0)
-                image_data_uint8.push_back(0);
-            if (image_data_float.size() == 0)
-                image_data_float.push_back(0);
+        ImageResponse(msr::airlib::ImageCaptureBase::ImageResponse&& s)
+        {
+            image_data_uint8 = std::make_shared<std::vector<uint8_t>>(std::move(s.image_data_uint8));
+            image_data_float = std::make_shared<std::vector<float>>(std::move(s.image_data_float));
+            setFields(s);
+        }
+
+        msr::airlib::ImageCaptureBase::ImageResponse to() const &
+        {
+            msr::airlib::ImageCaptureBase::ImageResponse d;
+            getFields(d);
+
+            if (! pixels_as_float)
+                d.image_data_uint8 = *image_data_uint8;
+            else
+                d.image_data_float = *image_data_float;
+
+            return d;
+        }
+
+        msr::airlib::ImageCaptureBase::ImageResponse to() &&
+        {
+            msr::airlib::ImageCaptureBase::ImageResponse d;
+            getFields(d);
+
+            //buffer may still be referenced by msgpack zone in which case it must be copied
+            if (! pixels_as_float)
+                d.image_data_uint8 = image_data_uint8.use_count() == 1 ? std::move(*image_data_uint8) : *image_data_uint8;
+            else
+                d.image_data_float = image_data_float.use_count() == 1 ? std::move(*image_data_float) : *image_data_float;
+
+            return d;
+        }
+
+        static std::vector<msr::airlib::ImageCaptureBase::ImageResponse> to(
+            const std::vector<ImageResponse>& response_adapter
+        ) {
+            std::vector<msr::airlib::ImageCaptureBase::ImageResponse> response;
+            for (const auto& item : response_adapter)
+                response.push_back(item.to());
+
+            return response;
+        }
+        static std::vector<msr::airlib::ImageCaptureBase::ImageResponse> to(
+            std::vector<ImageResponse>&& response_adapter
+        ) {
+            std::vector<msr::airlib::ImageCaptureBase::ImageResponse> response;
+            response.reserve(response_adapter.size());
+            for (auto& item : response_adapter)
+                response.push_back(std::move(item).to());
+
+            return response;
+        }
+        static std::vector<ImageResponse> from(
+            const std::vector<msr::airlib::ImageCaptureBase::ImageResponse>& response
+        ) {
+            std::vector<ImageResponse> response_adapter;
+            for (const auto& item : response)
+                response_adapter.push_back(ImageResponse(item));
+
+            return response_adapter;
+        }
+        static std::vector<ImageResponse> from(
+            std::vector<msr::airlib::ImageCaptureBase::ImageResponse>&& response
+        ) {
+            std::vector<ImageResponse> response_adapter;
+            response_adapter.reserve(response.size());
+            for (auto& item : response)
+                response_adapter.push_back(ImageResponse(std::move(item)));
 
+            return response_adapter;
+        }
+
+        //decode array of responses from message, existing elements of response and their buffers are reused
+        static void unpackTo(const RPCLIB_MSGPACK::object& o, std::vector<msr::airlib::ImageCaptureBase::ImageResponse>& response)
+        {
+            if (o.type != RPCLIB_MSGPACK::type::ARRAY)
+                throw RPCLIB_MSGPACK::type_error();
+
+            response.resize(o.via.array.size);
+            for (uint32_t i = 0; i < o.via.array.size; ++i)
+                unpackTo(o.via.array.ptr[i], response[i]);
+        }
+
+        static void unpackTo(const RPCLIB_MSGPACK::object& o, msr::airlib::ImageCaptureBase::ImageResponse& d)
+        {
+            if (o.type != RPCLIB_MSGPACK::type::MAP)
+                throw RPCLIB_MSGPACK::type_error();
+
+            for (uint32_t i = 0; i < o.via.map.size; ++i) {
+                const RPCLIB_MSGPACK::object& key = o.via.map.ptr[i].key;
+                const RPCLIB_MSGPACK::object& val = o.via.map.ptr[i].val;
+                if (key.type != RPCLIB_MSGPACK::type::STR)
+                    continue;
+                const std::string name(key.via.str.ptr, key.via.str.size);
+
+                if (name == "image_data_uint8")
+                    unpackBuffer(val, d.image_data_uint8);
+                else if (name == "image_data_float")
+                    unpackBuffer(val, d.image_data_float);
+                else if (name == "camera_name")
+                    val.convert(d.camera_name);
+                else if (name == "camera_position")
+                    d.camera_position = val.as<Vector3r>().to();
+                else if (name == "camera_orientation")
+                    d.camera_orientation = val.as<Quaternionr>().to();
+                else if (name == "time_stamp")
+                    val.convert(d.time_stamp);
+                else if (name == "message")
+                    val.convert(d.message);
+                else if (name == "pixels_as_float")
+                    val.convert(d.pixels_as_float);
+                else if (name == "compress")
+                    val.convert(d.compress);
+                else if (name == "width")
+                    val.convert(d.width);
+                else if (name == "height")
+                    val.convert(d.height);
+                else if (name == "image_type")
+                    d.image_type = static_cast<msr::airlib::ImageCaptureBase::ImageType>(val.as<int>());
+            }
+
+            //older servers send one placeholder element in unused buffer
+            if (d.pixels_as_float)
+                d.image_data_uint8.clear();
+            else
+                d.image_data_float.clear();
+        }
+
+        //*** msgpack adaptor, this is what MSGPACK_DEFINE_MAP would generate except for the buffers ***//
+        template <typename Packer>
+        void msgpack_pack(Packer& pk) const
+        {
+            pk.pack_map(kFieldCount);
+
+            pk.pack(std::string("image_data_uint8"));
+            pk.pack_bin(static_cast<uint32_t>(image_data_uint8->size()));
+            pk.pack_bin_body(reinterpret_cast<const char*>(image_data_uint8->data()), static_cast<uint32_t>(image_data_uint8->size()));
+
+            pk.pack(std::string("image_data_float"));
+            pk.pack_array(static_cast<uint32_t>(image_data_float->size()));
+            for (float value : *image_data_float)
+                pk.pack_float(value);
+
+            pk.pack(std::string("camera_position")); pk.pack(camera_position);
+            pk.pack(std::string("camera_name")); pk.pack(camera_name);
+            pk.pack(std::string("camera_orientation")); pk.pack(camera_orientation);
+            pk.pack(std::string("time_stamp")); pk.pack(time_stamp);
+            pk.pack(std::string("message")); pk.pack(message);
+            pk.pack(std::string("pixels_as_float")); pk.pack(pixels_as_float);
+            pk.pack(std::string("compress")); pk.pack(compress);
+            pk.pack(std::string("width")); pk.pack(width);
+            pk.pack(std::string("height")); pk.pack(height);
+            pk.pack(std::string("image_type")); pk.pack(static_cast<int>(image_type));
+        }
+
+        void msgpack_unpack(const RPCLIB_MSGPACK::object& o)
+        {
+            msr::airlib::ImageCaptureBase::ImageResponse d;
+            unpackTo(o, d);
+            *this = ImageResponse(std::move(d));
+        }
+
+        //used by rpclib to convert return value of server function, zone keeps buffers alive until reply is written
+        void msgpack_object(RPCLIB_MSGPACK::object* o, RPCLIB_MSGPACK::zone& z) const
+        {
+            o->type = RPCLIB_MSGPACK::type::MAP;
+            o->via.map.size = kFieldCount;
+            o->via.map.ptr = static_cast<RPCLIB_MSGPACK::object_kv*>(
+                z.allocate_align(sizeof(RPCLIB_MSGPACK::object_kv) * kFieldCount));
+            RPCLIB_MSGPACK::object_kv* kv = o->via.map.ptr;
+
+            kv->key = RPCLIB_MSGPACK::object(std::string("image_data_uint8"), z);
+            kv->val.type = RPCLIB_MSGPACK::type::BIN;
+            kv->val.via.bin.size = static_cast<uint32_t>(image_data_uint8->size());
+            kv->val.via.bin.ptr = reinterpret_cast<const char*>(image_data_uint8->data());
+            keepAlive(image_data_uint8, z);
+            ++kv;
+
+            kv->key = RPCLIB_MSGPACK::object(std::string("image_data_float"), z);
+            kv->val.type = RPCLIB_MSGPACK::type::ARRAY;
+            kv->val.via.array.size = static_cast<uint32_t>(image_data_float->size());
+            kv->val.via.array.ptr = image_data_float->empty() ? nullptr : static_cast<RPCLIB_MSGPACK::object*>(
+                z.allocate_align(sizeof(RPCLIB_MSGPACK::object) * image_data_float->size()));
+            for (size_t i = 0; i < image_data_float->size(); ++i)
+                kv->val.via.array.ptr[i] = RPCLIB_MSGPACK::object((*image_data_float)[i]);
+            ++kv;
+
+            setObjectField(kv++, "camera_position", camera_position, z);
+            setObjectField(kv++, "camera_name", camera_name, z);
+            setObjectField(kv++, "camera_orientation", camera_orientation, z);
+            setObjectField(kv++, "time_stamp", time_stamp, z);
+            setObjectField(kv++, "message", message, z);
+            setObjectField(kv++, "pixels_as_float", pixels_as_float, z);
+            setObjectField(kv++, "compress", compress, z);
+            setObjectField(kv++, "width", width, z);
+            setObjectField(kv++, "height", height, z);
+            setObjectField(kv++, "image_type", static_cast<int>(image_type), z);
+        }
+
+    private:
+        static constexpr uint32_t kFieldCount = 12;
+
+        void setFields(const msr::airlib::ImageCaptureBase::ImageResponse& s)
+        {
+            pixels_as_float = s.pixels_as_float;
             camera_name = s.camera_name;
             camera_position = Vector3r(s.camera_position);
             camera_orientation = Quaternionr(s.camera_orientation);
@@ -422,17 +637,9 @@ public:
             image_type = s.image_type;
         }
 
-        msr::airlib::ImageCaptureBase::ImageResponse to() const
+        void getFields(msr::airlib::ImageCaptureBase::ImageResponse& d) const
         {
-            msr::airlib::ImageCaptureBase::ImageResponse d;
-
             d.pixels_as_float = pixels_as_float;
-
-            if (! pixels_as_float)
-                d.image_data_uint8 = image_data_uint8;
-            else
-                d.image_data_float = image_data_float;
-
             d.camera_name = camera_name;
             d.camera_position = camera_position.to();
             d.camera_orientation = camera_orientation.to();
@@ -442,27 +649,174 @@ public:
             d.width = width;
             d.height = height;
             d.image_type = image_type;
+        }
+
+        template <typename T>
+        static void setObjectField(RPCLIB_MSGPACK::object_kv* kv, const char* name, const T& value, RPCLIB_MSGPACK::zone& z)
+        {
+            kv->key = RPCLIB_MSGPACK::object(std::string(name), z);
+            kv->val = RPCLIB_MSGPACK::object(value, z);
+        }
+
+        //zone holds a reference to buffer and releases it when zone is destroyed
+        template <typename T>
+        static void keepAlive(const std::shared_ptr<T>& buffer, RPCLIB_MSGPACK::zone& z)
+        {
+            z.push_finalizer(&releaseBuffer<T>, new std::shared_ptr<T>(buffer));
+        }
+        template <typename T>
+        static void releaseBuffer(void* buffer)
+        {
+            delete static_cast<std::shared_ptr<T>*>(buffer);
+        }
+
+        static void unpackBuffer(const RPCLIB_MSGPACK::object& o, std::vector<uint8_t>& buffer)
+        {
+            //assign reuses capacity of buffer and, unlike msgpack's own adaptor, works for empty data
+            if (o.type == RPCLIB_MSGPACK::type::BIN)
+                buffer.assign(o.via.bin.ptr, o.via.bin.ptr + o.via.bin.size);
+            else if (o.type == RPCLIB_MSGPACK::type::STR)
+                buffer.assign(o.via.str.ptr, o.via.str.ptr + o.via.str.size);
+            else if (o.type == RPCLIB_MSGPACK::type::ARRAY) {
+                buffer.resize(o.via.array.size);
+                for (uint32_t i = 0; i < o.via.array.size; ++i)
+                    buffer[i] = o.via.array.ptr[i].as<uint8_t>();
+            }
+            else if (o.type == RPCLIB_MSGPACK::type::NIL)
+                buffer.clear();
+            else
+                throw RPCLIB_MSGPACK::type_error();
+        }
+
+        static void unpackBuffer(const RPCLIB_MSGPACK::object& o, std::vector<float>& buffer)
+        {
+            if (o.type == RPCLIB_MSGPACK::type::ARRAY) {
+                buffer.resize(o.via.array.size);
+                for (uint32_t i = 0; i < o.via.array.size; ++i)
+                    buffer[i] = o.via.array.ptr[i].as<float>();
+            }
+            else if (o.type == RPCLIB_MSGPACK::type::NIL)
+                buffer.clear();
+            else
+                throw RPCLIB_MSGPACK::type_error();
+        }
+    };
+
+    //location of data that server has written to shared memory instead of sending it in reply
+    struct SharedMemoryFrame {
+        int slot = -1;
+        uint64_t sequence = 0;
+        uint64_t size = 0;
+
+        MSGPACK_DEFINE_MAP(slot, sequence, size);
+
+        SharedMemoryFrame()
+        {}
+
+        SharedMemoryFrame(const common_utils::SharedMemoryRing::Frame& s)
+        {
+            slot = s.slot;
+            sequence = s.sequence;
+            size = s.size;
+        }
+
+        common_utils::SharedMemoryRing::Frame to() const
+        {
+            common_utils::SharedMemoryRing::Frame d;
+            d.slot = slot;
+            d.sequence = sequence;
+            d.size = size;
 
             return d;
         }
+    };
 
-        static std::vector<msr::airlib::ImageCaptureBase::ImageResponse> to(
-            const std::vector<ImageResponse>& response_adapter
-        ) {
-            std::vector<msr::airlib::ImageCaptureBase::ImageResponse> response;
-            for (const auto& item : response_adapter)
-                response.push_back(item.to());
+    //pixel buffers of response are empty if they were written to shared memory
+    struct SharedMemoryImageResponse {
+        ImageResponse response;
+        SharedMemoryFrame frame;
 
-            return response;
+        MSGPACK_DEFINE_MAP(response, frame);
+
+        SharedMemoryImageResponse()
+        {}
+
+        SharedMemoryImageResponse(msr::airlib::ImageCaptureBase::ImageResponse&& s, const common_utils::SharedMemoryRing::Frame& f)
+            : response(std::move(s)), frame(f)
+        {}
+
+        //decode array of responses from message, returns false if any frame was overwritten before it could be read
+        static bool unpackTo(const RPCLIB_MSGPACK::object& o, const common_utils::SharedMemoryRing& shared_memory,
+            std::vector<msr::airlib::ImageCaptureBase::ImageResponse>& response)
+        {
+            if (o.type != RPCLIB_MSGPACK::type::ARRAY)
+                throw RPCLIB_MSGPACK::type_error();
+
+            response.resize(o.via.array.size);
+            for (uint32_t i = 0; i < o.via.array.size; ++i) {
+                const RPCLIB_MSGPACK::object& item = o.via.array.ptr[i];
+                if (item.type != RPCLIB_MSGPACK::type::MAP)
+                    throw RPCLIB_MSGPACK::type_error();
+
+                msr::airlib::ImageCaptureBase::ImageResponse& d = response[i];
+                common_utils::SharedMemoryRing::Frame item_frame;
+                for (uint32_t j = 0; j < item.via.map.size; ++j) {
+                    const RPCLIB_MSGPACK::object& key = item.via.map.ptr[j].key;
+                    const RPCLIB_MSGPACK::object& val = item.via.map.ptr[j].val;
+                    const std::string name(key.via.str.ptr, key.type == RPCLIB_MSGPACK::type::STR ? key.via.str.size : 0);
+                    if (name == "response")
+                        ImageResponse::unpackTo(val, d);
+                    else if (name == "frame")
+                        item_frame = val.as<SharedMemoryFrame>().to();
+                }
+
+                if (item_frame.slot >= 0) {
+                    bool is_read = d.pixels_as_float ? shared_memory.read(item_frame, d.image_data_float)
+                        : shared_memory.read(item_frame, d.image_data_uint8);
+                    if (!is_read)
+                        return false;
+                }
+            }
+
+            return true;
         }
-        static std::vector<ImageResponse> from(
-            const std::vector<msr::airlib::ImageCaptureBase::ImageResponse>& response
-        ) {
-            std::vector<ImageResponse> response_adapter;
-            for (const auto& item : response)
-                response_adapter.push_back(ImageResponse(item));
+    };
 
-            return response_adapter;
+    //images pushed to subscriber, see ApiSubscription
+    struct ImageSample {
+        uint64_t sequence = 0;
+        msr::airlib::TTimePoint time_stamp = 0;
+        std::vector<ImageResponse> response;
+
+        MSGPACK_DEFINE_MAP(sequence, time_stamp, response);
+    };
+
+    //sensor output pushed to subscriber, payload is msgpack encoded adaptor such as ImuData
+    struct SensorSample {
+        uint64_t sequence = 0;
+        msr::airlib::TTimePoint time_stamp = 0;
+        std::vector<uint8_t> payload;
+
+        MSGPACK_DEFINE_MAP(sequence, time_stamp, payload);
+
+        SensorSample()
+        {}
+
+        template <typename TData>
+        explicit SensorSample(const TData& data)
+        {
+            time_stamp = data.time_stamp;
+
+            RPCLIB_MSGPACK::sbuffer buffer;
+            RPCLIB_MSGPACK::pack(buffer, data);
+            payload.assign(buffer.data(), buffer.data() + buffer.size());
+        }
+
+        template <typename TData>
+        TData to() const
+        {
+            RPCLIB_MSGPACK::object_handle handle = RPCLIB_MSGPACK::unpack(reinterpret_cast<const char*>(payload.data()), payload.size());
+            return handle.get().as<TData>();
         }
     };
 
@@ -501,6 +855,21 @@ public:
         }
     };
 
+    //point cloud of data is empty if it was written to shared memory
+    struct SharedMemoryLidarData {
+        LidarData data;
+        SharedMemoryFrame frame;
+
+        MSGPACK_DEFINE_MAP(data, frame);
+
+        SharedMemoryLidarData()
+        {}
+
+        SharedMemoryLidarData(const msr::airlib::LidarData& s, const common_utils::SharedMemoryRing::Frame& f)
+            : data(s), frame(f)
+        {}
+    };
+
     struct ImuData {
         msr::airlib::TTimePoint time_stamp;
         Quaternionr orientation;
@@ -694,6 +1063,159 @@ public:
             return d;
         }
     };
+
+    struct VehicleStateRequest {
+        std::string vehicle_name;
+        bool estimated_state = false;
+        std::vector<std::string> imu_names;
+        std::vector<std::string> barometer_names;
+        std::vector<std::string> magnetometer_names;
+        std::vector<std::string> gps_names;
+        std::vector<std::string> distance_sensor_names;
+
+        MSGPACK_DEFINE_MAP(vehicle_name, estimated_state, imu_names, barometer_names, magnetometer_names, gps_names, distance_sensor_names);
+
+        VehicleStateRequest()
+        {}
+
+        VehicleStateRequest(const msr::airlib::VehicleStateQuery::Request& s)
+        {
+            vehicle_name = s.vehicle_name;
+            estimated_state = s.estimated_state;
+            imu_names = s.imu_names;
+            barometer_names = s.barometer_names;
+            magnetometer_names = s.magnetometer_names;
+            gps_names = s.gps_names;
+            distance_sensor_names = s.distance_sensor_names;
+        }
+
+        msr::airlib::VehicleStateQuery::Request to() const
+        {
+            msr::airlib::VehicleStateQuery::Request d;
+            d.vehicle_name = vehicle_name;
+            d.estimated_state = estimated_state;
+            d.imu_names = imu_names;
+            d.barometer_names = barometer_names;
+            d.magnetometer_names = magnetometer_names;
+            d.gps_names = gps_names;
+            d.distance_sensor_names = distance_sensor_names;
+
+            return d;
+        }
+
+        static std::vector<VehicleStateRequest> from(
+            const std::vector<msr::airlib::VehicleStateQuery::Request>& request
+        ) {
+            std::vector<VehicleStateRequest> request_adaptor;
+            for (const auto& item : request)
+                request_adaptor.push_back(VehicleStateRequest(item));
+
+            return request_adaptor;
+        }
+        static std::vector<msr::airlib::VehicleStateQuery::Request> to(
+            const std::vector<VehicleStateRequest>& request_adapter
+        ) {
+            std::vector<msr::airlib::VehicleStateQuery::Request> request;
+            for (const auto& item : request_adapter)
+                request.push_back(item.to());
+
+            return request;
+        }
+    };
+
+    struct VehicleStateResponse {
+        std::string vehicle_name;
+        msr::airlib::TTimePoint time_stamp = 0;
+
+        KinematicsState kinematics;
+        EnvironmentState environment;
+        CollisionInfo collision_info;
+        KinematicsState kinematics_estimated;
+        GeoPoint gps_location;
+
+        std::map<std::string, ImuData> imu_data;
+        std::map<std::string, BarometerData> barometer_data;
+        std::map<std::string, MagnetometerData> magnetometer_data;
+        std::map<std::string, GpsData> gps_data;
+        std::map<std::string, DistanceSensorData> distance_sensor_data;
+
+        MSGPACK_DEFINE_MAP(vehicle_name, time_stamp, kinematics, environment, collision_info, kinematics_estimated, gps_location,
+            imu_data, barometer_data, magnetometer_data, gps_data, distance_sensor_data);
+
+        VehicleStateResponse()
+        {}
+
+        VehicleStateResponse(const msr::airlib::VehicleStateQuery::Response& s)
+        {
+            vehicle_name = s.vehicle_name;
+            time_stamp = s.time_stamp;
+            kinematics = s.kinematics;
+            environment = s.environment;
+            collision_info = s.collision_info;
+            kinematics_estimated = s.kinematics_estimated;
+            gps_location = s.gps_location;
+
+            fromMap(s.imu_data, imu_data);
+            fromMap(s.barometer_data, barometer_data);
+            fromMap(s.magnetometer_data, magnetometer_data);
+            fromMap(s.gps_data, gps_data);
+            fromMap(s.distance_sensor_data, distance_sensor_data);
+        }
+
+        msr::airlib::VehicleStateQuery::Response to() const
+        {
+            msr::airlib::VehicleStateQuery::Response d;
+            d.vehicle_name = vehicle_name;
+            d.time_stamp = time_stamp;
+            d.kinematics = kinematics.to();
+            d.environment = environment.to();
+            d.collision_info = collision_info.to();
+            d.kinematics_estimated = kinematics_estimated.to();
+            d.gps_location = gps_location.to();
+
+            toMap(imu_data, d.imu_data);
+            toMap(barometer_data, d.barometer_data);
+            toMap(magnetometer_data, d.magnetometer_data);
+            toMap(gps_data, d.gps_data);
+            toMap(distance_sensor_data, d.distance_sensor_data);
+
+            return d;
+        }
+
+        static std::vector<VehicleStateResponse> from(
+            const std::vector<msr::airlib::VehicleStateQuery::Response>& response
+        ) {
+            std::vector<VehicleStateResponse> response_adapter;
+            for (const auto& item : response)
+                response_adapter.push_back(VehicleStateResponse(item));
+
+            return response_adapter;
+        }
+        static std::vector<msr::airlib::VehicleStateQuery::Response> to(
+            const std::vector<VehicleStateResponse>& response_adapter
+        ) {
+            std::vector<msr::airlib::VehicleStateQuery::Response> response;
+            for (const auto& item : response_adapter)
+                response.push_back(item.to());
+
+            return response;
+        }
+
+    private:
+        template <typename TSrc, typename TDest>
+        static void fromMap(const std::map<std::string, TSrc>& s, std::map<std::string, TDest>& d)
+        {
+            for (const auto& item : s)
+                d[item.first] = TDest(item.second);
+        }
+
+        template <typename TSrc, typename TDest>
+        static void toMap(const std::map<std::string, TSrc>& s, std::map<std::string, TDest>& d)
+        {
+            for (const auto& item : s)
+                d[item.first] = item.second.to();
+        }
+    };
 };
 
 }} //namespace
@@ -15,6 +15,8 @@
 #include "physics/Kinematics.hpp"
 #include "physics/Environment.hpp"
 #include "api/WorldSimApiBase.hpp"
+#include "api/VehicleStateQuery.hpp"
+#include <future>
 
 namespace msr { namespace airlib {
 
@@ -75,13 +77,45 @@ public:
     msr::airlib::GpsBase::Output getGpsData(const std::string& gps_name = "", const std::string& vehicle_name = "") const;
     msr::airlib::DistanceBase::Output getDistanceSensorData(const std::string& distance_sensor_name = "", const std::string& vehicle_name = "") const;
 
+    /* Subscriptions: server samples images or sensor at given rate and callback is called with each new sample
+       exactly once, along with its sequence number, as soon as it is available. Callbacks are called on a background
+       thread owned by the subscription, so they should return quickly. Gaps in sequence numbers mean samples were
+       dropped because callback couldn't keep up. Only half of the server's RPC workers wait for samples at a time,
+       subscriptions over that limit are polled every 10 ms instead. Returns id to pass to unsubscribe. */
+    int subscribeImages(const vector<ImageCaptureBase::ImageRequest>& request, float rate_hz,
+        const std::function<void(uint64_t, const vector<ImageCaptureBase::ImageResponse>&)>& callback, const std::string& vehicle_name = "");
+    int subscribeLidarData(const std::string& lidar_name, float rate_hz,
+        const std::function<void(uint64_t, const msr::airlib::LidarData&)>& callback, const std::string& vehicle_name = "");
+    int subscribeImuData(const std::string& imu_name, float rate_hz,
+        const std::function<void(uint64_t, const msr::airlib::ImuBase::Output&)>& callback, const std::string& vehicle_name = "");
+    int subscribeBarometerData(const std::string& barometer_name, float rate_hz,
+        const std::function<void(uint64_t, const msr::airlib::BarometerBase::Output&)>& callback, const std::string& vehicle_name = "");
+    int subscribeMagnetometerData(const std::string& magnetometer_name, float rate_hz,
+        const std::function<void(uint64_t, const msr::airlib::MagnetometerBase::Output&)>& callback, const std::string& vehicle_name = "");
+    int subscribeGpsData(const std::string& gps_name, float rate_hz,
+        const std::function<void(uint64_t, const msr::airlib::GpsBase::Output&)>& callback, const std::string& vehicle_name = "");
+    int subscribeDistanceSensorData(const std::string& distance_sensor_name, float rate_hz,
+        const std::function<void(uint64_t, const msr::airlib::DistanceBase::Output&)>& callback, const std::string& vehicle_name = "");
+    void unsubscribe(int subscription_id);
+
     // sensor omniscient APIs
     vector<int> simGetLidarSegmentation(const std::string& lidar_name = "", const std::string& vehicle_name = "") const;
 
     Pose simGetVehiclePose(const std::string& vehicle_name = "") const;
     void simSetVehiclePose(const Pose& pose, bool ignore_collision, const std::string& vehicle_name = "");
 
+    /* When client runs on the same host as server, images and lidar point clouds can be passed through
+       shared memory instead of RPC reply. Returns false if this is not possible, e.g., server is on another host,
+       in which case everything continues to work over RPC. Each simGetImages image or lidar frame takes one slot
+       which must be large enough for it, otherwise that frame is sent over RPC. Only supported on Linux and macOS. */
+    bool enableSharedMemory(unsigned int slot_count = 8, uint64_t slot_size = 8 * 1024 * 1024);
+    void disableSharedMemory();
+    bool isSharedMemoryEnabled() const;
+
     vector<ImageCaptureBase::ImageResponse> simGetImages(vector<ImageCaptureBase::ImageRequest> request, const std::string& vehicle_name = "");
+    //same as above but reuses existing elements of response and their pixel buffers, useful for capture loops
+    void simGetImages(const vector<ImageCaptureBase::ImageRequest>& request, vector<ImageCaptureBase::ImageResponse>& response, 
+        const std::string& vehicle_name = "");
     vector<uint8_t> simGetImage(const std::string& camera_name, ImageCaptureBase::ImageType type, const std::string& vehicle_name = "");
 
     CollisionInfo simGetCollisionInfo(const std::string& vehicle_name = "") const;
@@ -92,6 +126,49 @@ public:
     msr::airlib::Kinematics::State simGetGroundTruthKinematics(const std::string& vehicle_name = "") const;
     msr::airlib::Environment::State simGetGroundTruthEnvironment(const std::string& vehicle_name = "") const;
 
+    //ground truth kinematics, environment, collision info and listed sensor outputs of several vehicles in one call
+    vector<VehicleStateQuery::Response> simGetVehicleStates(const vector<VehicleStateQuery::Request>& request) const;
+
+    /* Pipelined versions of the calls above. Request is sent right away and the result is taken from returned
+       future, so several requests can be in flight at the same time and network latency overlaps with caller's
+       own work. Results are decoded in future's get(), so use get() or wait() rather than wait_for().
+       These always go over RPC, even when shared memory is enabled. */
+    std::future<bool> simIsPausedFuture() const;
+    std::future<void> simPauseFuture(bool is_paused);
+    std::future<void> simContinueForTimeFuture(double seconds);
+    std::future<void> simSetTimeOfDayFuture(bool is_enabled, const string& start_datetime = "", bool is_start_datetime_dst = false,
+        float celestial_clock_speed = 1, float update_interval_secs = 60, bool move_sun = true);
+    std::future<void> simEnableWeatherFuture(bool enable);
+    std::future<void> simSetWeatherParameterFuture(WorldSimApiBase::WeatherParameter param, float val);
+    std::future<vector<string>> simListSceneObjectsFuture(const string& name_regex = string(".*")) const;
+    std::future<Pose> simGetObjectPoseFuture(const std::string& object_name) const;
+    std::future<bool> simSetObjectPoseFuture(const std::string& object_name, const Pose& pose, bool teleport = true);
+    std::future<void> cancelLastTaskFuture(const std::string& vehicle_name = "");
+    std::future<bool> simSetSegmentationObjectIDFuture(const std::string& mesh_name, int object_id, bool is_name_regex = false);
+    std::future<int> simGetSegmentationObjectIDFuture(const std::string& mesh_name) const;
+    std::future<void> simPrintLogMessageFuture(const std::string& message, const std::string& message_param = "", unsigned char severity = 0);
+    std::future<bool> armDisarmFuture(bool arm, const std::string& vehicle_name = "");
+    std::future<bool> isApiControlEnabledFuture(const std::string& vehicle_name = "") const;
+    std::future<void> enableApiControlFuture(bool is_enabled, const std::string& vehicle_name = "");
+    std::future<msr::airlib::GeoPoint> getHomeGeoPointFuture(const std::string& vehicle_name = "") const;
+    std::future<msr::airlib::LidarData> getLidarDataFuture(const std::string& lidar_name = "", const std::string& vehicle_name = "") const;
+    std::future<msr::airlib::ImuBase::Output> getImuDataFuture(const std::string& imu_name = "", const std::string& vehicle_name = "") const;
+    std::future<msr::airlib::BarometerBase::Output> getBarometerDataFuture(const std::string& barometer_name = "", const std::string& vehicle_name = "") const;
+    std::future<msr::airlib::MagnetometerBase::Output> getMagnetometerDataFuture(const std::string& magnetometer_name = "", const std::string& vehicle_name = "") const;
+    std::future<msr::airlib::GpsBase::Output> getGpsDataFuture(const std::string& gps_name = "", const std::string& vehicle_name = "") const;
+    std::future<msr::airlib::DistanceBase::Output> getDistanceSensorDataFuture(const std::string& distance_sensor_name = "", const std::string& vehicle_name = "") const;
+    std::future<vector<int>> simGetLidarSegmentationFuture(const std::string& lidar_name = "", const std::string& vehicle_name = "") const;
+    std::future<Pose> simGetVehiclePoseFuture(const std::string& vehicle_name = "") const;
+    std::future<void> simSetVehiclePoseFuture(const Pose& pose, bool ignore_collision, const std::string& vehicle_name = "");
+    std::future<vector<ImageCaptureBase::ImageResponse>> simGetImagesFuture(const vector<ImageCaptureBase::ImageRequest>& request, const std::string& vehicle_name = "");
+    std::future<vector<uint8_t>> simGetImageFuture(const std::string& camera_name, ImageCaptureBase::ImageType type, const std::string& vehicle_name = "");
+    std::future<CollisionInfo> simGetCollisionInfoFuture(const std::string& vehicle_name = "") const;
+    std::future<CameraInfo> simGetCameraInfoFuture(const std::string& camera_name, const std::string& vehicle_name = "") const;
+    std::future<void> simSetCameraOrientationFuture(const std::string& camera_name, const Quaternionr& orientation, const std::string& vehicle_name = "");
+    std::future<msr::airlib::Kinematics::State> simGetGroundTruthKinematicsFuture(const std::string& vehicle_name = "") const;
+    std::future<msr::airlib::Environment::State> simGetGroundTruthEnvironmentFuture(const std::string& vehicle_name = "") const;
+    std::future<vector<VehicleStateQuery::Response>> simGetVehicleStatesFuture(const vector<VehicleStateQuery::Request>& request) const;
+
     //----------- APIs to control ACharacter in scene ----------/
     void simCharSetFaceExpression(const std::string& expression_name, float value, const std::string& character_name = "");
     float simCharGetFaceExpression(const std::string& expression_name, const std::string& character_name = "") const;
@@ -113,6 +190,7 @@ public:
 protected:
     void* getClient();
     const void* getClient() const;
+    float getTimeoutSec() const;
 
 private:
     struct impl;
@@ -0,0 +1,97 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef air_RpcLibFuture_hpp
+#define air_RpcLibFuture_hpp
+
+#include <future>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include "common/Common.hpp"
+
+#include "common/common_utils/WindowsApisCommonPre.hpp"
+#include "rpc/msgpack.hpp"
+#include "common/common_utils/WindowsApisCommonPost.hpp"
+
+#ifndef RPCLIB_MSGPACK
+#define RPCLIB_MSGPACK clmdep_msgpack
+#endif // !RPCLIB_MSGPACK
+
+namespace msr { namespace airlib_rpclib {
+
+/*
+    Turns future of rpclib reply into future of the value client API returns. Request is already on its way
+    when rpclib async_call returns, so several calls can be in flight at the same time. rpclib doesn't apply
+    the client's timeout to async calls, so each reply is waited for on a helper thread which fails the
+    returned future with an error once timeout_sec has passed, and otherwise converts the reply. Returned
+    future supports wait_for() and wait_until() and doesn't block in its destructor if it is dropped.
+*/
+class RpcLibFuture {
+public:
+    typedef std::future<RPCLIB_MSGPACK::object_handle> Reply;
+
+    //convert reply with func(const object_handle&)
+    template <typename TFunc>
+    static auto then(Reply&& reply, float timeout_sec, TFunc func) -> std::future<decltype(func(std::declval<const RPCLIB_MSGPACK::object_handle&>()))>
+    {
+        typedef decltype(func(std::declval<const RPCLIB_MSGPACK::object_handle&>())) TResult;
+
+        auto promise = std::make_shared<std::promise<TResult>>();
+        auto result = promise->get_future();
+        std::thread([promise, func, timeout_sec](Reply r) {
+            try {
+                if (r.wait_for(std::chrono::duration<float>(timeout_sec)) == std::future_status::timeout)
+                    throw std::runtime_error(common_utils::Utils::stringf("No reply from server within timeout of %f seconds", timeout_sec));
+                setValue(*promise, func, r.get());
+            }
+            catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        }, std::move(reply)).detach();
+        return result;
+    }
+
+    //reply is plain value such as bool or vector<string>
+    template <typename T>
+    static std::future<T> as(Reply&& reply, float timeout_sec)
+    {
+        return then(std::move(reply), timeout_sec, [](const RPCLIB_MSGPACK::object_handle& r) {
+            return r.template as<T>();
+        });
+    }
+
+    //reply is adaptor which is converted to AirLib type with to()
+    template <typename TAdaptor>
+    static auto to(Reply&& reply, float timeout_sec) -> std::future<decltype(std::declval<TAdaptor>().to())>
+    {
+        return then(std::move(reply), timeout_sec, [](const RPCLIB_MSGPACK::object_handle& r) {
+            return r.template as<TAdaptor>().to();
+        });
+    }
+
+    //reply has no value, get() only reports errors
+    static std::future<void> done(Reply&& reply, float timeout_sec)
+    {
+        return then(std::move(reply), timeout_sec, [](const RPCLIB_MSGPACK::object_handle&) {});
+    }
+
+private:
+    template <typename T, typename TFunc>
+    static void setValue(std::promise<T>& promise, const TFunc& func, const RPCLIB_MSGPACK::object_handle& reply)
+    {
+        promise.set_value(func(reply));
+    }
+
+    template <typename TFunc>
+    static void setValue(std::promise<void>& promise, const TFunc& func, const RPCLIB_MSGPACK::object_handle& reply)
+    {
+        func(reply);
+        promise.set_value();
+    }
+};
+
+}} //namespace
+#endif
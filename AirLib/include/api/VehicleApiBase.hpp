@@ -58,6 +58,17 @@ public:
         return true;
     }
 
+    //state as estimated by the vehicle's own controller, as opposed to ground truth from the simulator
+    virtual Kinematics::State getKinematicsEstimated() const
+    {
+        throw VehicleCommandNotImplementedException("getKinematicsEstimated API is not supported for this vehicle");
+    }
+
+    virtual GeoPoint getGpsLocation() const
+    {
+        throw VehicleCommandNotImplementedException("getGpsLocation API is not supported for this vehicle");
+    }
+
     //if vehicle supports it, call this method to send
     //kinematics and other info to somewhere (ex. log viewer, file, cloud etc)
     virtual void sendTelemetry(float last_interval = -1)
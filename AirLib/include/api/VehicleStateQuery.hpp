@@ -0,0 +1,95 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef air_VehicleStateQuery_hpp
+#define air_VehicleStateQuery_hpp
+
+#include <map>
+#include "common/Common.hpp"
+#include "common/CommonStructs.hpp"
+#include "common/ClockFactory.hpp"
+#include "physics/Kinematics.hpp"
+#include "physics/Environment.hpp"
+#include "api/VehicleApiBase.hpp"
+#include "api/VehicleSimApiBase.hpp"
+
+namespace msr { namespace airlib {
+
+/*
+    State of several vehicles collected at once, so clients such as the ROS wrapper that publish state of
+    all vehicles every tick need one round trip instead of one per vehicle and sensor. Sensors are listed
+    by name, empty name means first sensor of that type like in the individual get*Data APIs. Lidar is not
+    included as point clouds are large, use getLidarData for those. Kinematics and GPS location estimated by the
+    vehicle's controller, as in getMultirotorState, are included on request.
+*/
+class VehicleStateQuery {
+public:
+    struct Request {
+        std::string vehicle_name;
+        bool estimated_state = false;
+        vector<std::string> imu_names;
+        vector<std::string> barometer_names;
+        vector<std::string> magnetometer_names;
+        vector<std::string> gps_names;
+        vector<std::string> distance_sensor_names;
+
+        Request()
+        {}
+
+        Request(const std::string& vehicle_name_val)
+            : vehicle_name(vehicle_name_val)
+        {}
+    };
+
+    struct Response {
+        std::string vehicle_name;
+        TTimePoint time_stamp = 0;
+
+        Kinematics::State kinematics;
+        Environment::State environment;
+        CollisionInfo collision_info;
+
+        //only set if estimated_state was requested
+        Kinematics::State kinematics_estimated;
+        GeoPoint gps_location;
+
+        std::map<std::string, ImuBase::Output> imu_data;
+        std::map<std::string, BarometerBase::Output> barometer_data;
+        std::map<std::string, MagnetometerBase::Output> magnetometer_data;
+        std::map<std::string, GpsBase::Output> gps_data;
+        std::map<std::string, DistanceBase::Output> distance_sensor_data;
+    };
+
+public:
+    static Response query(const Request& request, const VehicleApiBase* vehicle_api, const VehicleSimApiBase* vehicle_sim_api)
+    {
+        Response response;
+        response.vehicle_name = request.vehicle_name;
+        response.time_stamp = ClockFactory::get()->nowNanos();
+
+        response.kinematics = *vehicle_sim_api->getGroundTruthKinematics();
+        response.environment = vehicle_sim_api->getGroundTruthEnvironment()->getState();
+        response.collision_info = vehicle_sim_api->getCollisionInfo();
+
+        if (request.estimated_state) {
+            response.kinematics_estimated = vehicle_api->getKinematicsEstimated();
+            response.gps_location = vehicle_api->getGpsLocation();
+        }
+
+        for (const auto& name : request.imu_names)
+            response.imu_data[name] = vehicle_api->getImuData(name);
+        for (const auto& name : request.barometer_names)
+            response.barometer_data[name] = vehicle_api->getBarometerData(name);
+        for (const auto& name : request.magnetometer_names)
+            response.magnetometer_data[name] = vehicle_api->getMagnetometerData(name);
+        for (const auto& name : request.gps_names)
+            response.gps_data[name] = vehicle_api->getGpsData(name);
+        for (const auto& name : request.distance_sensor_names)
+            response.distance_sensor_data[name] = vehicle_api->getDistanceSensorData(name);
+
+        return response;
+    }
+};
+
+}} //namespace
+#endif
@@ -320,6 +320,17 @@ public: //types
         bool move_sun = true;
     };
 
+    struct ParallelUpdateSetting {
+        bool enabled = false;
+        unsigned int thread_count = 0; //0 means use all hardware threads
+        bool deterministic = false;
+    };
+
+    struct ThreadWaiterSetting {
+        std::string strategy = "Hybrid"; //Spin, Sleep, Hybrid or TimerFd
+        unsigned int spin_threshold_us = 0; //0 means use platform default
+    };
+
 private: //fields
     float settings_version_actual;
     float settings_version_minimum = 1.2f;
@@ -331,6 +342,8 @@ public: //fields
     RecordingSetting recording_setting;
     SegmentationSetting segmentation_setting;
     TimeOfDaySetting tod_setting;
+    ParallelUpdateSetting parallel_update_setting;
+    ThreadWaiterSetting thread_waiter_setting;
 
     std::vector<std::string> warning_messages;
     std::vector<std::string> error_messages;
@@ -1049,6 +1062,31 @@ private:
                 tod_setting.move_sun = tod_settings_json.getBool("MoveSun", tod_setting.move_sun);
             }
         }
+
+        {   //parallel world update settings_json
+            Settings parallel_update_json;
+            if (settings_json.getChild("ParallelUpdate", parallel_update_json)) {
+                parallel_update_setting.enabled = parallel_update_json.getBool("Enabled", parallel_update_setting.enabled);
+                parallel_update_setting.thread_count = static_cast<unsigned int>(
+                    parallel_update_json.getInt("ThreadCount", static_cast<int>(parallel_update_setting.thread_count)));
+                parallel_update_setting.deterministic = parallel_update_json.getBool("Deterministic", parallel_update_setting.deterministic);
+            }
+        }
+
+        {
+            Settings thread_waiter_json;
+            if (settings_json.getChild("ThreadWaiter", thread_waiter_json)) {
+                //unknown strategy would make ThreadWaiter::toStrategy throw when sim mode starts, so keep default
+                std::string strategy = thread_waiter_json.getString("Strategy", thread_waiter_setting.strategy);
+                if (strategy == "Spin" || strategy == "Sleep" || strategy == "Hybrid" || strategy == "TimerFd")
+                    thread_waiter_setting.strategy = strategy;
+                else
+                    warning_messages.push_back("ThreadWaiter Strategy setting is not recognized: " + strategy
+                        + ", using " + thread_waiter_setting.strategy);
+                thread_waiter_setting.spin_threshold_us = static_cast<unsigned int>(
+                    thread_waiter_json.getInt("SpinThresholdUs", static_cast<int>(thread_waiter_setting.spin_threshold_us)));
+            }
+        }
     }
 
     static void loadDefaultCameraSetting(const Settings& settings_json, CameraSetting& camera_defaults)
@@ -8,6 +8,7 @@
 #include <atomic>
 #include "common/Common.hpp"
 #include "common/common_utils/Utils.hpp"
+#include "common/ClockFactory.hpp"
 
 namespace msr { namespace airlib {
 
@@ -44,13 +45,14 @@ public:
             return false;
         }
 
-        TTimePoint start = ClockFactory::get()->nowNanos();
-        static constexpr std::chrono::duration<double> MinSleepDuration(0);
+        ClockBase* clock = ClockFactory::get();
+        TTimePoint start = clock->nowNanos();
+        TTimePoint deadline = clock->addTo(start, secs);
 
         while (secs > 0 && !isCancelled() &&
-            ClockFactory::get()->elapsedSince(start) < secs) {
+            clock->elapsedSince(start) < secs) {
 
-            std::this_thread::sleep_for(MinSleepDuration);
+            clock->yieldUntil(deadline);
         }
 
         return !isCancelled();
@@ -63,11 +63,21 @@ public:
         if (dt <= 0)
             return;
 
-        static constexpr std::chrono::duration<double> MinSleepDuration(0);
         TTimePoint start = nowNanos();
+        TTimePoint deadline = addTo(start, dt);
         //spin wait
         while (elapsedSince(start) < dt)
-            std::this_thread::sleep_for(MinSleepDuration);
+            yieldUntil(deadline);
+    }
+
+    //called in spin loops waiting for clock to reach deadline, by default this just gives up time slice
+    //clocks that are advanced by simulation may block here instead, so callers must check their condition again
+    virtual void yieldUntil(TTimePoint deadline)
+    {
+        unused(deadline);
+
+        static constexpr std::chrono::duration<double> MinSleepDuration(0);
+        std::this_thread::sleep_for(MinSleepDuration);
     }
 
     double getTrueScaleWrtWallClock()
@@ -0,0 +1,125 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef airsim_core_LockstepClock_hpp
+#define airsim_core_LockstepClock_hpp
+
+#include "SteppableClock.hpp"
+#include "Common.hpp"
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <algorithm>
+
+namespace msr { namespace airlib {
+
+/*
+    SteppableClock that keeps simulation and API threads in lockstep. When simulation runs
+    faster than real-time, thread calling APIs such as moveToPosition may not get scheduled for many
+    simulation steps which makes results depend on OS scheduler. With this clock, step() blocks until every
+    joined thread is waiting on the clock (via sleep_for, CancelToken or Waiter). Waiting threads are released
+    at the start of the first step() at which their deadline has been reached, i.e., after previous simulation
+    update was fully done, so they never run concurrently with simulation. Threads that have not joined behave
+    same as with SteppableClock.
+
+    Usage: call expectThreads(n) before simulation starts stepping, then each of n threads calls
+    joinThread() when it starts and leaveThread() when it is done with the clock.
+*/
+class LockstepClock : public SteppableClock {
+public:
+    LockstepClock(TTimeDelta step = DefaultStepSize, TTimePoint start = 0)
+        : SteppableClock(step, start)
+    {
+    }
+
+    void expectThreads(unsigned int count)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        expected_count_ += count;
+    }
+
+    void joinThread()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (expected_count_ == 0)
+            throw std::logic_error("LockstepClock::joinThread() called without expectThreads()");
+
+        --expected_count_;
+        ++joined_count_;
+        isJoinedThread() = true;
+    }
+
+    void leaveThread()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --joined_count_;
+        isJoinedThread() = false;
+        step_cv_.notify_all();
+    }
+
+    virtual TTimePoint step() override
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        //let threads whose deadline has arrived run and wait until they are waiting again
+        releaseWaits(nowNanos());
+        step_cv_.wait(lock, [this]() {
+            return expected_count_ == 0 && waits_.size() == joined_count_;
+        });
+
+        return SteppableClock::step();
+    }
+
+    virtual void yieldUntil(TTimePoint deadline) override
+    {
+        if (!isJoinedThread()) {
+            SteppableClock::yieldUntil(deadline);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (nowNanos() >= deadline)
+            return;
+
+        Wait wait { deadline, false };
+        waits_.push_back(&wait);
+        step_cv_.notify_all();
+        wake_cv_.wait(lock, [&wait]() { return wait.is_released; });
+    }
+
+private:
+    struct Wait {
+        TTimePoint deadline;
+        bool is_released;
+    };
+
+    void releaseWaits(TTimePoint now)
+    {
+        auto released = std::partition(waits_.begin(), waits_.end(), [now](const Wait* wait) {
+            return wait->deadline > now;
+        });
+        if (released != waits_.end()) {
+            for (auto it = released; it != waits_.end(); ++it)
+                (*it)->is_released = true;
+            waits_.erase(released, waits_.end());
+            wake_cv_.notify_all();
+        }
+    }
+
+    static bool& isJoinedThread()
+    {
+        static thread_local bool is_joined = false;
+        return is_joined;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable step_cv_, wake_cv_;
+
+    unsigned int expected_count_ = 0;
+    unsigned int joined_count_ = 0;
+    std::vector<Wait*> waits_;
+};
+
+}} //namespace
+#endif
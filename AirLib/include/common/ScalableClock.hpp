@@ -6,6 +6,7 @@
 
 #include "ClockBase.hpp"
 #include "Common.hpp"
+#include "common_utils/ThreadWaiter.hpp"
 
 namespace msr { namespace airlib {
 
@@ -47,13 +48,24 @@ public:
 
     virtual void sleep_for(TTimeDelta dt) override
     {
-        //for intervals > 2ms just sleep otherwise do spilling otherwise delay won't be accurate
-        if (dt > 2.0 / 1000) {
-            TTimeDelta dt_scaled = fromWallDelta(dt);
-            std::this_thread::sleep_for(std::chrono::duration<double>(dt_scaled));
-        }
-        else
-            ClockBase::sleep_for(dt);
+        if (dt <= 0)
+            return;
+
+        //this clock is wall clock scaled so we can let OS put thread to sleep, waiter takes
+        //care of spinning only for last bit so delay is still accurate
+        getWaiter().sleepFor(static_cast<uint64_t>(fromWallDelta(dt) * 1E9));
+    }
+
+    virtual void yieldUntil(TTimePoint deadline) override
+    {
+        TTimePoint now = nowNanos();
+        if (deadline <= now)
+            return;
+
+        //sleep in short slices because callers such as CancelToken check for cancellation in between
+        static constexpr TTimeDelta MaxSliceDuration = 1E-3;
+        TTimeDelta remaining = std::min(elapsedBetween(deadline, now), MaxSliceDuration);
+        getWaiter().sleepFor(static_cast<uint64_t>(fromWallDelta(remaining) * 1E9));
     }
 
 protected:
@@ -74,6 +86,14 @@ protected:
     }
 
 
+private:
+    static common_utils::ThreadWaiter& getWaiter()
+    {
+        //clock is shared by threads but waiter is meant for one thread
+        static thread_local common_utils::ThreadWaiter waiter;
+        return waiter;
+    }
+
 private:
     double scale_;
     TTimeDelta latency_;
@@ -0,0 +1,483 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef common_utils_DatasetWriter_hpp
+#define common_utils_DatasetWriter_hpp
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include "PngEncoder.hpp"
+
+namespace common_utils {
+
+/*
+    Writes dataset samples on a pool of worker threads. Each sample is a Frame with any number of named
+    images or files, e.g. "left/000001.png". Workers encode the images (deflate compressed PNG, 8 or 16 bit,
+    or PFM) and write them either as single files below the root folder or, with frames_per_shard > 0, into
+    tar archives shard_000000.tar, shard_000001.tar, ... of that many frames each, which avoids millions of
+    small files on the file system. Frames of a shard are in the order they were encoded, not submitted.
+
+    submit() blocks while max_pending frames are queued or being written, so capture can't run ahead of
+    the disks and fill up memory. Errors while encoding or writing stop nothing else, the first one is
+    re-thrown by the next call to submit(), flush() or close().
+
+    In single file mode the folders of the file names must exist.
+*/
+class DatasetWriter {
+public:
+    struct Options {
+        unsigned int workers = 0;           //0 means all hardware threads
+        unsigned int max_pending = 0;       //0 means twice the number of workers
+        unsigned int frames_per_shard = 0;  //0 writes single files
+        int png_level = 4;                  //deflate level 0 (stored) to 9
+    };
+
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t files = 0;
+        uint64_t bytes = 0;                 //bytes written, after compression
+        double encode_seconds = 0;          //summed over workers
+        double write_seconds = 0;           //summed over workers
+        double blocked_seconds = 0;         //time submit() waited for workers
+    };
+
+    class Frame {
+    public:
+        //pixels are rows without padding, channels 1, 3 or 4
+        void addPng(const std::string& name, unsigned int width, unsigned int height, unsigned int channels, std::vector<uint8_t> pixels)
+        {
+            Entry entry = makeEntry(name, Entry::Png8, width, height, channels);
+            entry.bytes = std::move(pixels);
+            entries_.push_back(std::move(entry));
+        }
+
+        //16 bit gray, e.g. depth in millimeters from ImageKernels::toUInt16
+        void addPng(const std::string& name, unsigned int width, unsigned int height, std::vector<uint16_t> pixels)
+        {
+            Entry entry = makeEntry(name, Entry::Png16, width, height, 1);
+            entry.samples16 = std::move(pixels);
+            entries_.push_back(std::move(entry));
+        }
+
+        //same layout as Utils::writePfmFile
+        void addPfm(const std::string& name, unsigned int width, unsigned int height, std::vector<float> pixels)
+        {
+            Entry entry = makeEntry(name, Entry::Pfm, width, height, 1);
+            entry.floats = std::move(pixels);
+            entries_.push_back(std::move(entry));
+        }
+
+        //written as is, e.g. images that are compressed already
+        void addFile(const std::string& name, std::vector<uint8_t> bytes)
+        {
+            Entry entry = makeEntry(name, Entry::Raw, 0, 0, 0);
+            entry.bytes = std::move(bytes);
+            entries_.push_back(std::move(entry));
+        }
+
+    private:
+        friend class DatasetWriter;
+
+        struct Entry {
+            enum Kind { Png8, Png16, Pfm, Raw };
+
+            Kind kind;
+            std::string name;
+            unsigned int width, height, channels;
+            std::vector<uint8_t> bytes;
+            std::vector<uint16_t> samples16;
+            std::vector<float> floats;
+        };
+
+        static Entry makeEntry(const std::string& name, Entry::Kind kind, unsigned int width, unsigned int height, unsigned int channels)
+        {
+            Entry entry;
+            entry.kind = kind;
+            entry.name = name;
+            entry.width = width;
+            entry.height = height;
+            entry.channels = channels;
+            return entry;
+        }
+
+        std::vector<Entry> entries_;
+    };
+
+public:
+    DatasetWriter(const std::string& root_dir)
+        : DatasetWriter(root_dir, Options())
+    {
+    }
+
+    DatasetWriter(const std::string& root_dir, const Options& options)
+        : root_dir_(root_dir), options_(options)
+    {
+        if (options_.workers == 0)
+            options_.workers = std::max(1u, std::thread::hardware_concurrency());
+        if (options_.max_pending == 0)
+            options_.max_pending = 2 * options_.workers;
+
+        for (unsigned int i = 0; i < options_.workers; ++i)
+            workers_.emplace_back(&DatasetWriter::workerLoop, this);
+    }
+
+    ~DatasetWriter()
+    {
+        try {
+            close();
+        }
+        catch (...) {
+            //errors can only be reported by calling close() before
+        }
+    }
+
+    void submit(Frame&& frame)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        throwIfFailed();
+        if (closed_)
+            throw std::logic_error("DatasetWriter is closed");
+
+        if (pending_ >= options_.max_pending) {
+            auto start = std::chrono::steady_clock::now();
+            slot_free_.wait(lock, [this]() { return pending_ < options_.max_pending; });
+            stats_.blocked_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        queue_.push_back(std::move(frame));
+        ++pending_;
+        work_available_.notify_one();
+    }
+
+    //waits until all submitted frames are written
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slot_free_.wait(lock, [this]() { return pending_ == 0; });
+        throwIfFailed();
+    }
+
+    //writes all submitted frames, finishes the last shard and stops the workers
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_)
+                return;
+            closed_ = true;
+        }
+        work_available_.notify_all();
+        for (auto& worker : workers_)
+            worker.join();
+        workers_.clear();
+
+        //every shard is finished even if one of them fails
+        std::exception_ptr shard_error;
+        {
+            std::lock_guard<std::mutex> lock(shard_mutex_);
+            for (auto& shard : shards_) {
+                try {
+                    finishShard(*shard.second);
+                }
+                catch (...) {
+                    if (!shard_error)
+                        shard_error = std::current_exception();
+                }
+            }
+            shards_.clear();
+        }
+
+        std::lock_guard<std::mutex> state_lock(mutex_);
+        if (!first_error_)
+            first_error_ = shard_error;
+        throwIfFailed();
+    }
+
+    //buffers of written frames are kept for reuse, so frames of the same size don't allocate once as many
+    //of them as can be pending were written. Size is as requested, contents are unspecified.
+    std::vector<uint8_t> getBytes(size_t size)
+    {
+        return takeBuffer(free_bytes_, size);
+    }
+
+    std::vector<uint16_t> getSamples16(size_t size)
+    {
+        return takeBuffer(free_samples16_, size);
+    }
+
+    std::vector<float> getFloats(size_t size)
+    {
+        return takeBuffer(free_floats_, size);
+    }
+
+    Stats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    const Options& getOptions() const
+    {
+        return options_;
+    }
+
+private:
+    struct Shard {
+        std::ofstream file;
+        std::string path;
+        unsigned int frames = 0;
+    };
+
+    void workerLoop()
+    {
+        PngEncoder encoder;
+        std::vector<std::vector<uint8_t>> encoded;
+
+        while (true) {
+            Frame frame;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_available_.wait(lock, [this]() { return closed_ || !queue_.empty(); });
+                if (queue_.empty())
+                    return;
+                frame = std::move(queue_.front());
+                queue_.pop_front();
+            }
+
+            double encode_seconds = 0, write_seconds = 0;
+            uint64_t bytes = 0;
+            try {
+                auto start = std::chrono::steady_clock::now();
+                encoded.resize(frame.entries_.size());
+                for (size_t i = 0; i < frame.entries_.size(); ++i)
+                    encode(encoder, frame.entries_[i], encoded[i]);
+                auto encoded_time = std::chrono::steady_clock::now();
+                encode_seconds = std::chrono::duration<double>(encoded_time - start).count();
+
+                for (size_t i = 0; i < frame.entries_.size(); ++i)
+                    bytes += entryData(frame.entries_[i], encoded[i]).size();
+                if (options_.frames_per_shard > 0)
+                    writeToShard(frame, encoded);
+                else {
+                    for (size_t i = 0; i < frame.entries_.size(); ++i)
+                        writeFile(root_dir_ + "/" + frame.entries_[i].name, entryData(frame.entries_[i], encoded[i]));
+                }
+                write_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - encoded_time).count();
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!first_error_)
+                    first_error_ = std::current_exception();
+            }
+
+            recycle(frame);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++stats_.frames;
+                stats_.files += frame.entries_.size();
+                stats_.bytes += bytes;
+                stats_.encode_seconds += encode_seconds;
+                stats_.write_seconds += write_seconds;
+                --pending_;
+            }
+            slot_free_.notify_all();
+        }
+    }
+
+    void encode(PngEncoder& encoder, const Frame::Entry& entry, std::vector<uint8_t>& out) const
+    {
+        switch (entry.kind) {
+        case Frame::Entry::Png8:
+            encoder.encode(entry.bytes.data(), entry.width, entry.height, entry.channels, out, options_.png_level);
+            break;
+        case Frame::Entry::Png16:
+            encoder.encode(entry.samples16.data(), entry.width, entry.height, entry.channels, out, options_.png_level);
+            break;
+        case Frame::Entry::Pfm: {
+            //negative scale means little endian
+            std::ostringstream header;
+            header << "Pf\n" << entry.width << " " << entry.height << "\n" << (isLittleEndian() ? -1 : 1) << "\n";
+            const std::string text = header.str();
+            const size_t data_size = entry.floats.size() * sizeof(float);
+            out.resize(text.size() + data_size);
+            std::memcpy(out.data(), text.data(), text.size());
+            std::memcpy(out.data() + text.size(), entry.floats.data(), data_size);
+            break;
+        }
+        case Frame::Entry::Raw:
+            break;
+        }
+    }
+
+    template<typename T>
+    std::vector<T> takeBuffer(std::vector<std::vector<T>>& pool, size_t size)
+    {
+        std::vector<T> buffer;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex_);
+            if (!pool.empty()) {
+                buffer = std::move(pool.back());
+                pool.pop_back();
+            }
+        }
+        buffer.resize(size);
+        return buffer;
+    }
+
+    //keeps at most as many buffers as max_pending frames like this one hold
+    void recycle(Frame& frame)
+    {
+        const size_t limit = static_cast<size_t>(options_.max_pending) * frame.entries_.size();
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        for (Frame::Entry& entry : frame.entries_) {
+            keepBuffer(free_bytes_, entry.bytes, limit);
+            keepBuffer(free_samples16_, entry.samples16, limit);
+            keepBuffer(free_floats_, entry.floats, limit);
+        }
+    }
+
+    template<typename T>
+    static void keepBuffer(std::vector<std::vector<T>>& pool, std::vector<T>& buffer, size_t limit)
+    {
+        if (buffer.capacity() > 0 && pool.size() < limit)
+            pool.push_back(std::move(buffer));
+    }
+
+    //raw files are written from the frame without copy
+    static const std::vector<uint8_t>& entryData(const Frame::Entry& entry, const std::vector<uint8_t>& encoded)
+    {
+        return entry.kind == Frame::Entry::Raw ? entry.bytes : encoded;
+    }
+
+    static void writeFile(const std::string& path, const std::vector<uint8_t>& data)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!file)
+            throw std::runtime_error("Could not write " + path);
+    }
+
+    void writeToShard(const Frame& frame, const std::vector<std::vector<uint8_t>>& encoded)
+    {
+        //whole frames are appended under the lock so a shard gets exactly frames_per_shard of them
+        std::lock_guard<std::mutex> lock(shard_mutex_);
+        uint64_t index = shard_frames_++ / options_.frames_per_shard;
+        std::unique_ptr<Shard>& shard = shards_[index];
+        if (!shard) {
+            shard.reset(new Shard());
+            char name[32];
+            std::snprintf(name, sizeof(name), "shard_%06llu.tar", static_cast<unsigned long long>(index));
+            shard->path = root_dir_ + "/" + name;
+            shard->file.open(shard->path, std::ios::binary);
+            if (!shard->file)
+                throw std::runtime_error("Could not create " + shard->path);
+        }
+
+        for (size_t i = 0; i < frame.entries_.size(); ++i)
+            writeTarEntry(shard->file, frame.entries_[i].name, entryData(frame.entries_[i], encoded[i]));
+        if (!shard->file)
+            throw std::runtime_error("Could not write " + shard->path);
+
+        if (++shard->frames == options_.frames_per_shard) {
+            finishShard(*shard);
+            shards_.erase(index);
+        }
+    }
+
+    //ustar header followed by data padded to 512 bytes
+    static void writeTarEntry(std::ofstream& file, const std::string& name, const std::vector<uint8_t>& data)
+    {
+        if (name.size() >= 100)
+            throw std::invalid_argument("Name is too long for tar archive: " + name);
+
+        char header[512] = {};
+        std::memcpy(header, name.data(), name.size());
+        std::snprintf(header + 100, 8, "%07o", 0644);
+        std::snprintf(header + 108, 8, "%07o", 0);
+        std::snprintf(header + 116, 8, "%07o", 0);
+        std::snprintf(header + 124, 12, "%011llo", static_cast<unsigned long long>(data.size()));
+        std::snprintf(header + 136, 12, "%011llo", static_cast<unsigned long long>(std::time(nullptr)));
+        header[156] = '0';
+        std::memcpy(header + 257, "ustar", 6);
+        std::memcpy(header + 263, "00", 2);
+
+        //checksum is computed with its own field as spaces
+        std::memset(header + 148, ' ', 8);
+        unsigned int checksum = 0;
+        for (unsigned char c : header)
+            checksum += c;
+        std::snprintf(header + 148, 8, "%06o", checksum);
+
+        file.write(header, sizeof(header));
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        static const char padding[512] = {};
+        file.write(padding, (512 - data.size() % 512) % 512);
+    }
+
+    static void finishShard(Shard& shard)
+    {
+        //end of archive are two empty records
+        static const char end[1024] = {};
+        shard.file.write(end, sizeof(end));
+        shard.file.close();
+        if (!shard.file)
+            throw std::runtime_error("Could not write " + shard.path);
+    }
+
+    static bool isLittleEndian()
+    {
+        const uint16_t one = 1;
+        return *reinterpret_cast<const uint8_t*>(&one) == 1;
+    }
+
+    void throwIfFailed()
+    {
+        if (first_error_) {
+            std::exception_ptr error = first_error_;
+            first_error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    std::string root_dir_;
+    Options options_;
+    std::vector<std::thread> workers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable slot_free_;
+    std::deque<Frame> queue_;
+    unsigned int pending_ = 0;
+    bool closed_ = false;
+    std::exception_ptr first_error_;
+    Stats stats_;
+
+    std::mutex shard_mutex_;
+    std::map<uint64_t, std::unique_ptr<Shard>> shards_;
+    uint64_t shard_frames_ = 0;
+
+    std::mutex pool_mutex_;
+    std::vector<std::vector<uint8_t>> free_bytes_;
+    std::vector<std::vector<uint16_t>> free_samples16_;
+    std::vector<std::vector<float>> free_floats_;
+};
+
+}
+#endif
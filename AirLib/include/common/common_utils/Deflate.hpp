@@ -0,0 +1,503 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef common_utils_Deflate_hpp
+#define common_utils_Deflate_hpp
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace common_utils {
+
+/*
+    Compressor for zlib streams (RFC 1950 and 1951) as used in PNG files, so AirLib doesn't need to link zlib.
+
+    Matches are found with hash chains over the 32K window, from level 4 on with one step of lazy matching.
+    Each block of up to kBlockSymbols symbols gets its own dynamic Huffman codes, or is stored if that
+    would be smaller. Level 0 only stores, levels 1 to 9 search longer chains for better ratio at lower speed.
+
+    An instance keeps its tables between calls, so each thread should have its own.
+*/
+class Deflate {
+public:
+    Deflate()
+        : head_(kHashSize), prev_(kWindowSize)
+    {
+        //length and distance codes with their extra bits, RFC 1951 section 3.2.5
+        int length = 3;
+        for (int code = 0; code < 28; ++code) {
+            length_base_[code] = static_cast<uint16_t>(length);
+            length_extra_[code] = static_cast<uint8_t>(code < 8 ? 0 : (code - 4) / 4);
+            for (int i = 0; i < (1 << length_extra_[code]); ++i)
+                length_code_[length++] = static_cast<uint8_t>(code);
+        }
+        length_base_[28] = 258;
+        length_extra_[28] = 0;
+        length_code_[258] = 28;
+
+        int distance = 1;
+        for (int code = 0; code < 30; ++code) {
+            dist_base_[code] = static_cast<uint16_t>(distance);
+            dist_extra_[code] = static_cast<uint8_t>(code < 4 ? 0 : (code - 2) / 2);
+            //distances up to 256 are looked up directly, longer ones by groups of 128
+            for (int i = 0; i < (1 << dist_extra_[code]); ++i, ++distance)
+                dist_code_[distance <= 256 ? distance : 257 + ((distance - 1) >> 7)] = static_cast<uint8_t>(code);
+        }
+    }
+
+    //appends zlib stream of data to out
+    void compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out, int level = 6)
+    {
+        level = std::max(0, std::min(level, 9));
+        out_ = &out;
+        bits_ = 0;
+        bit_count_ = 0;
+
+        //CMF: deflate with 32K window, FLG: check bits so that CMF * 256 + FLG is a multiple of 31
+        out.push_back(0x78);
+        out.push_back(0x01);
+
+        if (level == 0 || size == 0)
+            writeStored(data, size, true);
+        else
+            compressBlocks(data, size, level);
+
+        flushBits();
+        uint32_t adler = adler32(data, size);
+        for (int shift = 24; shift >= 0; shift -= 8)
+            out.push_back(static_cast<uint8_t>(adler >> shift));
+        out_ = nullptr;
+    }
+
+    static uint32_t adler32(const uint8_t* data, size_t size)
+    {
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            //largest run for which b can't overflow before the modulo
+            size_t run = std::min(size, static_cast<size_t>(5552));
+            size -= run;
+            for (size_t i = 0; i < run; ++i) {
+                a += data[i];
+                b += a;
+            }
+            data += run;
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+private:
+    static constexpr int kWindowSize = 32768;
+    static constexpr int kHashBits = 15;
+    static constexpr int kHashSize = 1 << kHashBits;
+    static constexpr int kMinMatch = 3;
+    static constexpr int kMaxMatch = 258;
+    static constexpr size_t kBlockSymbols = 32768;
+    static constexpr size_t kMaxStored = 65535;
+
+    struct Symbol {
+        uint16_t value;     //literal, or match length if distance > 0
+        uint16_t distance;
+    };
+
+    //same meaning as in zlib
+    struct LevelParams {
+        int good_length;    //search a quarter of the chain for the lazy match if the current one is this long
+        int max_lazy;       //lazy matching only below this length, without lazy matching insert matches only up to it
+        int nice_length;    //stop searching once a match is this long
+        int max_chain;
+        bool lazy;
+    };
+
+    void compressBlocks(const uint8_t* data, size_t size, int level)
+    {
+        //zlib's configuration table
+        static const LevelParams params[10] = {
+            { 0, 0, 0, 0, false }, { 4, 4, 8, 4, false }, { 4, 5, 16, 8, false }, { 4, 6, 32, 32, false },
+            { 4, 4, 16, 16, true }, { 8, 16, 32, 32, true }, { 8, 16, 128, 128, true }, { 8, 32, 128, 256, true },
+            { 32, 128, 258, 1024, true }, { 32, 258, 258, 4096, true }
+        };
+        const LevelParams& param = params[level];
+
+        std::fill(head_.begin(), head_.end(), -1);
+        inserted_ = 0;
+        symbols_.clear();
+        size_t block_start = 0;
+
+        size_t pos = 0;
+        while (pos < size) {
+            insertUpTo(data, size, pos);
+            int length, distance;
+            findMatch(data, size, pos, param.max_chain, param.nice_length, length, distance);
+            if (length > 0 && param.lazy && length < param.max_lazy && pos + 1 < size) {
+                //a longer match at the next byte is worth a literal
+                insertUpTo(data, size, pos + 1);
+                int next_length, next_distance;
+                int chain = length >= param.good_length ? param.max_chain / 4 : param.max_chain;
+                findMatch(data, size, pos + 1, chain, param.nice_length, next_length, next_distance);
+                if (next_length > length) {
+                    symbols_.push_back({ data[pos], 0 });
+                    ++pos;
+                    length = next_length;
+                    distance = next_distance;
+                }
+            }
+
+            if (length > 0) {
+                symbols_.push_back({ static_cast<uint16_t>(length), static_cast<uint16_t>(distance) });
+                if (!param.lazy && length > param.max_lazy)
+                    inserted_ = std::max(inserted_, pos + length);
+                pos += length;
+            }
+            else {
+                symbols_.push_back({ data[pos], 0 });
+                ++pos;
+            }
+
+            if (symbols_.size() >= kBlockSymbols || pos >= size) {
+                writeBlock(data + block_start, pos - block_start, pos >= size);
+                symbols_.clear();
+                block_start = pos;
+            }
+        }
+    }
+
+    static uint32_t hash(const uint8_t* p)
+    {
+        uint32_t v = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+        return (v * 2654435761u) >> (32 - kHashBits);
+    }
+
+    //adds the positions before end to their hash chains
+    void insertUpTo(const uint8_t* data, size_t size, size_t end)
+    {
+        end = std::min(end, size - std::min(size, static_cast<size_t>(kMinMatch - 1)));
+        for (; inserted_ < end; ++inserted_) {
+            uint32_t h = hash(data + inserted_);
+            prev_[inserted_ & (kWindowSize - 1)] = head_[h];
+            head_[h] = static_cast<int32_t>(inserted_);
+        }
+    }
+
+    void findMatch(const uint8_t* data, size_t size, size_t pos, int max_chain, int nice_length, int& best_length, int& best_distance) const
+    {
+        best_length = 0;
+        best_distance = 0;
+        if (pos + kMinMatch > size)
+            return;
+        best_length = kMinMatch - 1;
+
+        const int max_length = static_cast<int>(std::min(size - pos, static_cast<size_t>(kMaxMatch)));
+        const uint8_t* current = data + pos;
+        int32_t candidate = head_[hash(current)];
+        for (int chain = max_chain; candidate >= 0 && chain > 0; --chain) {
+            if (pos - candidate > static_cast<size_t>(kWindowSize))
+                break;
+            const uint8_t* match = data + candidate;
+            if (match[best_length] == current[best_length] && match[0] == current[0]) {
+                int length = matchLength(match, current, max_length);
+                if (length > best_length) {
+                    best_length = length;
+                    best_distance = static_cast<int>(pos - candidate);
+                    if (length >= nice_length || length == max_length)
+                        break;
+                }
+            }
+            int32_t next = prev_[candidate & (kWindowSize - 1)];
+            //the slot may already hold a newer position, chains only go back in the data
+            if (next >= candidate)
+                break;
+            candidate = next;
+        }
+        if (best_length < kMinMatch)
+            best_length = 0;
+    }
+
+    //number of equal bytes, compared 8 at a time
+    static int matchLength(const uint8_t* a, const uint8_t* b, int max_length)
+    {
+        int length = 0;
+        while (length + 8 <= max_length) {
+            uint64_t x, y;
+            std::memcpy(&x, a + length, 8);
+            std::memcpy(&y, b + length, 8);
+            if (x != y)
+                break;
+            length += 8;
+        }
+        while (length < max_length && a[length] == b[length])
+            ++length;
+        return length;
+    }
+
+    int distanceCode(int distance) const
+    {
+        return distance <= 256 ? dist_code_[distance] : dist_code_[257 + ((distance - 1) >> 7)];
+    }
+
+    void writeBlock(const uint8_t* data, size_t size, bool final)
+    {
+        uint32_t lit_freq[286] = {}, dist_freq[30] = {};
+        for (auto& symbol : symbols_) {
+            if (symbol.distance == 0)
+                ++lit_freq[symbol.value];
+            else {
+                ++lit_freq[257 + length_code_[symbol.value]];
+                ++dist_freq[distanceCode(symbol.distance)];
+            }
+        }
+        lit_freq[256] = 1;
+
+        uint8_t lit_lengths[286], dist_lengths[30];
+        buildLengths(lit_freq, 286, 15, lit_lengths);
+        buildLengths(dist_freq, 30, 15, dist_lengths);
+
+        int lit_count = 286, dist_count = 30;
+        while (lit_count > 257 && lit_lengths[lit_count - 1] == 0)
+            --lit_count;
+        while (dist_count > 1 && dist_lengths[dist_count - 1] == 0)
+            --dist_count;
+
+        //code lengths of both codes run length encoded with symbols 16 to 18
+        uint8_t all_lengths[286 + 30];
+        std::copy(lit_lengths, lit_lengths + lit_count, all_lengths);
+        std::copy(dist_lengths, dist_lengths + dist_count, all_lengths + lit_count);
+        std::vector<Symbol>& rle = rle_;
+        rle.clear();
+        int total = lit_count + dist_count;
+        for (int i = 0; i < total;) {
+            int run = 1;
+            while (i + run < total && all_lengths[i + run] == all_lengths[i])
+                ++run;
+            uint8_t value = all_lengths[i];
+            i += run;
+            if (value == 0) {
+                while (run >= 11) { int n = std::min(run, 138); rle.push_back({ 18, static_cast<uint16_t>(n - 11) }); run -= n; }
+                if (run >= 3) { rle.push_back({ 17, static_cast<uint16_t>(run - 3) }); run = 0; }
+            }
+            else {
+                rle.push_back({ value, 0 });
+                --run;
+                while (run >= 3) { int n = std::min(run, 6); rle.push_back({ 16, static_cast<uint16_t>(n - 3) }); run -= n; }
+            }
+            for (; run > 0; --run)
+                rle.push_back({ value, 0 });
+        }
+
+        uint32_t cl_freq[19] = {};
+        for (auto& symbol : rle)
+            ++cl_freq[symbol.value];
+        uint8_t cl_lengths[19];
+        buildLengths(cl_freq, 19, 7, cl_lengths);
+        static const uint8_t cl_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        int cl_count = 19;
+        while (cl_count > 4 && cl_lengths[cl_order[cl_count - 1]] == 0)
+            --cl_count;
+
+        //size of the dynamic block in bits to decide against storing
+        static const uint8_t cl_extra[19] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+        uint64_t dynamic_bits = 3 + 5 + 5 + 4 + 3 * cl_count;
+        for (int i = 0; i < 19; ++i)
+            dynamic_bits += static_cast<uint64_t>(cl_freq[i]) * (cl_lengths[i] + cl_extra[i]);
+        for (int i = 0; i < 286; ++i)
+            dynamic_bits += static_cast<uint64_t>(lit_freq[i]) * (lit_lengths[i] + (i > 256 ? length_extra_[i - 257] : 0));
+        for (int i = 0; i < 30; ++i)
+            dynamic_bits += static_cast<uint64_t>(dist_freq[i]) * (dist_lengths[i] + dist_extra_[i]);
+        uint64_t stored_bits = (size + (size + kMaxStored - 1) / kMaxStored * 5) * 8 + 7;
+        if (stored_bits <= dynamic_bits) {
+            writeStored(data, size, final);
+            return;
+        }
+
+        uint16_t lit_codes[286], dist_codes[30], cl_codes[19];
+        buildCodes(lit_lengths, 286, lit_codes);
+        buildCodes(dist_lengths, 30, dist_codes);
+        buildCodes(cl_lengths, 19, cl_codes);
+
+        putBits(final ? 1 : 0, 1);
+        putBits(2, 2);
+        putBits(lit_count - 257, 5);
+        putBits(dist_count - 1, 5);
+        putBits(cl_count - 4, 4);
+        for (int i = 0; i < cl_count; ++i)
+            putBits(cl_lengths[cl_order[i]], 3);
+        for (auto& symbol : rle) {
+            putBits(cl_codes[symbol.value], cl_lengths[symbol.value]);
+            if (symbol.value >= 16)
+                putBits(symbol.distance, cl_extra[symbol.value]);
+        }
+
+        for (auto& symbol : symbols_) {
+            if (symbol.distance == 0)
+                putBits(lit_codes[symbol.value], lit_lengths[symbol.value]);
+            else {
+                int code = length_code_[symbol.value];
+                putBits(lit_codes[257 + code], lit_lengths[257 + code]);
+                putBits(symbol.value - length_base_[code], length_extra_[code]);
+                int dcode = distanceCode(symbol.distance);
+                putBits(dist_codes[dcode], dist_lengths[dcode]);
+                putBits(symbol.distance - dist_base_[dcode], dist_extra_[dcode]);
+            }
+        }
+        putBits(lit_codes[256], lit_lengths[256]);
+    }
+
+    void writeStored(const uint8_t* data, size_t size, bool final)
+    {
+        //local copy, std::min takes references and kMaxStored has no definition outside the class
+        const size_t max_stored = kMaxStored;
+        do {
+            size_t n = std::min(size, max_stored);
+            size -= n;
+            putBits(final && size == 0 ? 1 : 0, 1);
+            putBits(0, 2);
+            flushBits();
+            out_->push_back(static_cast<uint8_t>(n));
+            out_->push_back(static_cast<uint8_t>(n >> 8));
+            out_->push_back(static_cast<uint8_t>(~n));
+            out_->push_back(static_cast<uint8_t>(~n >> 8));
+            out_->insert(out_->end(), data, data + n);
+            data += n;
+        } while (size > 0);
+    }
+
+    //Huffman code lengths of at most max_length bits. Zero frequencies give no code, but there are always at
+    //least two codes so that the code is complete as inflate implementations expect.
+    void buildLengths(const uint32_t* freq, int count, int max_length, uint8_t* lengths)
+    {
+        std::fill(lengths, lengths + count, 0);
+        std::vector<int>& leaves = leaves_;
+        leaves.clear();
+        for (int i = 0; i < count; ++i)
+            if (freq[i] > 0)
+                leaves.push_back(i);
+        for (int i = 0; leaves.size() < 2; ++i)
+            if (freq[i] == 0)
+                leaves.push_back(i);
+        std::stable_sort(leaves.begin(), leaves.end(), [freq](int a, int b) { return freq[a] < freq[b]; });
+
+        //two queue construction: leaves in order of frequency, inner nodes are created in order of weight
+        const size_t n = leaves.size();
+        std::vector<uint64_t>& weight = weight_;
+        std::vector<int>& parent = parent_;
+        weight.assign(2 * n - 1, 0);
+        parent.assign(2 * n - 1, 0);
+        for (size_t i = 0; i < n; ++i)
+            weight[i] = freq[leaves[i]];
+        size_t next_leaf = 0, next_inner = n;
+        for (size_t inner = n; inner < 2 * n - 1; ++inner) {
+            size_t pick[2];
+            for (size_t& p : pick) {
+                if (next_leaf < n && (next_inner >= inner || weight[next_leaf] <= weight[next_inner]))
+                    p = next_leaf++;
+                else
+                    p = next_inner++;
+            }
+            weight[inner] = weight[pick[0]] + weight[pick[1]];
+            parent[pick[0]] = parent[pick[1]] = static_cast<int>(inner);
+        }
+
+        //depths, root is the last node and parents come after their children
+        std::vector<int>& depth = depth_;
+        depth.assign(2 * n - 1, 0);
+        int length_count[16] = {};
+        int overflow = 0;
+        for (size_t i = 2 * n - 1; i-- > 0;) {
+            if (i != 2 * n - 2)
+                depth[i] = depth[parent[i]] + 1;
+            if (i < n) {
+                if (depth[i] > max_length) {
+                    ++length_count[max_length];
+                    ++overflow;
+                }
+                else
+                    ++length_count[depth[i]];
+            }
+        }
+
+        //too long codes are made max_length and shorter ones longer until the code is complete again, as zlib does
+        while (overflow > 0) {
+            int bits = max_length - 1;
+            while (length_count[bits] == 0)
+                --bits;
+            --length_count[bits];
+            length_count[bits + 1] += 2;
+            --length_count[max_length];
+            overflow -= 2;
+        }
+
+        //rarest symbols get the longest codes
+        size_t leaf = 0;
+        for (int bits = max_length; bits > 0; --bits)
+            for (int i = 0; i < length_count[bits]; ++i)
+                lengths[leaves[leaf++]] = static_cast<uint8_t>(bits);
+    }
+
+    //canonical codes, bit reversed because deflate writes Huffman codes from their most significant bit
+    static void buildCodes(const uint8_t* lengths, int count, uint16_t* codes)
+    {
+        int length_count[16] = {};
+        for (int i = 0; i < count; ++i)
+            ++length_count[lengths[i]];
+        length_count[0] = 0;
+        uint16_t next_code[16] = {};
+        uint16_t code = 0;
+        for (int bits = 1; bits < 16; ++bits) {
+            code = static_cast<uint16_t>((code + length_count[bits - 1]) << 1);
+            next_code[bits] = code;
+        }
+        for (int i = 0; i < count; ++i) {
+            int bits = lengths[i];
+            if (bits == 0)
+                continue;
+            uint16_t c = next_code[bits]++, reversed = 0;
+            for (int b = 0; b < bits; ++b)
+                reversed = static_cast<uint16_t>((reversed << 1) | ((c >> b) & 1));
+            codes[i] = reversed;
+        }
+    }
+
+    void putBits(uint32_t value, int count)
+    {
+        bits_ |= static_cast<uint64_t>(value) << bit_count_;
+        bit_count_ += count;
+        while (bit_count_ >= 8) {
+            out_->push_back(static_cast<uint8_t>(bits_));
+            bits_ >>= 8;
+            bit_count_ -= 8;
+        }
+    }
+
+    void flushBits()
+    {
+        if (bit_count_ > 0)
+            out_->push_back(static_cast<uint8_t>(bits_));
+        bits_ = 0;
+        bit_count_ = 0;
+    }
+
+private:
+    std::vector<int32_t> head_, prev_;
+    size_t inserted_ = 0;
+    std::vector<Symbol> symbols_, rle_;
+    std::vector<int> leaves_, parent_, depth_;
+    std::vector<uint64_t> weight_;
+
+    uint8_t length_code_[259];
+    uint16_t length_base_[29];
+    uint8_t length_extra_[29];
+    uint16_t dist_base_[30];
+    uint8_t dist_extra_[30];
+    uint8_t dist_code_[257 + 256];
+
+    std::vector<uint8_t>* out_ = nullptr;
+    uint64_t bits_ = 0;
+    int bit_count_ = 0;
+};
+
+}
+#endif
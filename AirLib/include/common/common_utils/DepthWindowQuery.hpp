@@ -0,0 +1,222 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef common_utils_DepthWindowQuery_hpp
+#define common_utils_DepthWindowQuery_hpp
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <stdexcept>
+
+namespace common_utils {
+
+/*
+    Answers questions about rectangular windows of a depth image in constant time: number of pixels, sum of
+    depths, number of pixels closer than the obstacle distance and minimum depth. Built once per frame, it
+    replaces loops over every pixel of a window, so planners can check many more candidate windows.
+
+    Sums and counts come from summed-area tables. The minimum comes from a 2D sparse table which holds
+    the minimum of every window of 2^i x 2^j pixels, any window is covered by 4 of them. It is only built
+    by buildMinDepth(). Levels up to the whole image take log(width) * log(height) copies of the image, so
+    they can be limited to the largest window expected. Larger windows are then covered by more blocks.
+
+    NaN depths count as pixels but add nothing to sums, are never the minimum and never closer than the
+    obstacle distance.
+
+    Windows are [x0, x1) x [y0, y1) in pixels and are clipped to the image.
+*/
+class DepthWindowQuery {
+public:
+    //sums and counts for the image, minDepth() needs buildMinDepth() as well
+    void build(const float* depth, unsigned int width, unsigned int height, float obstacle_dist)
+    {
+        width_ = width;
+        height_ = height;
+        obstacle_dist_ = obstacle_dist;
+        levels_x_ = levels_y_ = 0;
+        buildSums(depth);
+    }
+
+    //same image as given to build(). max_window_width and max_window_height: largest windows minDepth()
+    //needs 4 lookups for, 0 for the whole image
+    void buildMinDepth(const float* depth, unsigned int max_window_width = 0, unsigned int max_window_height = 0)
+    {
+        buildMinTable(depth, max_window_width == 0 ? width_ : max_window_width,
+            max_window_height == 0 ? height_ : max_window_height);
+    }
+
+    unsigned int getWidth() const { return width_; }
+    unsigned int getHeight() const { return height_; }
+    float getObstacleDist() const { return obstacle_dist_; }
+
+    unsigned int pixelCount(int x0, int y0, int x1, int y1) const
+    {
+        if (!clip(x0, y0, x1, y1))
+            return 0;
+        return static_cast<unsigned int>((x1 - x0) * (y1 - y0));
+    }
+
+    double depthSum(int x0, int y0, int x1, int y1) const
+    {
+        if (!clip(x0, y0, x1, y1))
+            return 0;
+        return areaSum(depth_sum_, x0, y0, x1, y1);
+    }
+
+    //pixels with depth < obstacle distance given to build()
+    unsigned int obstacleCount(int x0, int y0, int x1, int y1) const
+    {
+        if (!clip(x0, y0, x1, y1))
+            return 0;
+        return areaSum(obstacle_count_, x0, y0, x1, y1);
+    }
+
+    //FLT_MAX for empty windows
+    float minDepth(int x0, int y0, int x1, int y1) const
+    {
+        if (levels_x_ == 0)
+            throw std::logic_error("DepthWindowQuery::buildMinDepth() was not called");
+        if (!clip(x0, y0, x1, y1))
+            return FLT_MAX;
+
+        const unsigned int kx = std::min(floorLog2(x1 - x0), levels_x_ - 1);
+        const unsigned int ky = std::min(floorLog2(y1 - y0), levels_y_ - 1);
+        const int block_width = 1 << kx, block_height = 1 << ky;
+        const float* level = &min_table_[(static_cast<size_t>(ky) * levels_x_ + kx) * width_ * height_];
+
+        //blocks overlap where the window is not a multiple of the block size
+        float result = FLT_MAX;
+        for (int y = y0; ; y += block_height) {
+            const int block_y = std::min(y, y1 - block_height);
+            const float* row = level + static_cast<size_t>(block_y) * width_;
+            for (int x = x0; ; x += block_width) {
+                result = std::min(result, row[std::min(x, x1 - block_width)]);
+                if (x + block_width >= x1)
+                    break;
+            }
+            if (y + block_height >= y1)
+                break;
+        }
+        return result;
+    }
+
+    //true if any pixel of the window is closer than dist
+    bool isCloser(int x0, int y0, int x1, int y1, float dist) const
+    {
+        return minDepth(x0, y0, x1, y1) < dist;
+    }
+
+private:
+    bool clip(int& x0, int& y0, int& x1, int& y1) const
+    {
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, static_cast<int>(width_));
+        y1 = std::min(y1, static_cast<int>(height_));
+        return x0 < x1 && y0 < y1;
+    }
+
+    template<typename T>
+    T areaSum(const std::vector<T>& table, int x0, int y0, int x1, int y1) const
+    {
+        const size_t stride = width_ + 1;
+        return table[y1 * stride + x1] - table[y0 * stride + x1] - table[y1 * stride + x0] + table[y0 * stride + x0];
+    }
+
+    void buildSums(const float* depth)
+    {
+        //one row and column of zeros in front so windows at the border need no special case
+        const size_t stride = width_ + 1;
+        depth_sum_.assign(stride * (height_ + 1), 0);
+        obstacle_count_.assign(stride * (height_ + 1), 0);
+
+        for (unsigned int y = 0; y < height_; ++y) {
+            const float* row = depth + static_cast<size_t>(y) * width_;
+            double* sum = &depth_sum_[(y + 1) * stride + 1];
+            const double* sum_above = sum - stride;
+            uint32_t* count = &obstacle_count_[(y + 1) * stride + 1];
+            const uint32_t* count_above = count - stride;
+
+            double row_sum = 0;
+            uint32_t row_count = 0;
+            for (unsigned int x = 0; x < width_; ++x) {
+                //a NaN would spoil every sum below and right of it
+                row_sum += row[x] == row[x] ? row[x] : 0;
+                row_count += row[x] < obstacle_dist_ ? 1 : 0;
+                sum[x] = sum_above[x] + row_sum;
+                count[x] = count_above[x] + row_count;
+            }
+        }
+    }
+
+    void buildMinTable(const float* depth, unsigned int max_window_width, unsigned int max_window_height)
+    {
+        levels_x_ = floorLog2(std::max(1u, std::min(max_window_width, width_))) + 1;
+        levels_y_ = floorLog2(std::max(1u, std::min(max_window_height, height_))) + 1;
+        const size_t pixels = static_cast<size_t>(width_) * height_;
+        min_table_.resize(pixels * levels_x_ * levels_y_);
+
+        //level (0, 0) is the image, NaN never is the minimum
+        float* base = min_table_.data();
+        for (size_t i = 0; i < pixels; ++i)
+            base[i] = depth[i] == depth[i] ? depth[i] : FLT_MAX;
+
+        //level (kx, ky) at x, y is the minimum of 2^kx x 2^ky pixels from x, y. Entries where the block
+        //would leave the image are never read and not computed.
+        for (unsigned int ky = 0; ky < levels_y_; ++ky) {
+            for (unsigned int kx = 0; kx < levels_x_; ++kx) {
+                if (kx == 0 && ky == 0)
+                    continue;
+                float* level = base + (static_cast<size_t>(ky) * levels_x_ + kx) * pixels;
+                if (kx > 0) {
+                    //two blocks of half the width next to each other
+                    const float* half = level - pixels;
+                    const unsigned int offset = 1u << (kx - 1);
+                    const unsigned int valid_x = width_ - (1u << kx) + 1;
+                    const unsigned int valid_y = height_ - (1u << ky) + 1;
+                    for (unsigned int y = 0; y < valid_y; ++y) {
+                        const float* in = half + static_cast<size_t>(y) * width_;
+                        float* out = level + static_cast<size_t>(y) * width_;
+                        for (unsigned int x = 0; x < valid_x; ++x)
+                            out[x] = std::min(in[x], in[x + offset]);
+                    }
+                }
+                else {
+                    //two blocks of half the height above each other
+                    const float* half = level - levels_x_ * pixels;
+                    const size_t offset = static_cast<size_t>(1u << (ky - 1)) * width_;
+                    const size_t valid = static_cast<size_t>(height_ - (1u << ky) + 1) * width_;
+                    for (size_t i = 0; i < valid; ++i)
+                        level[i] = std::min(half[i], half[i + offset]);
+                }
+            }
+        }
+    }
+
+    static unsigned int floorLog2(unsigned int value)
+    {
+        unsigned int result = 0;
+        while (value >>= 1)
+            ++result;
+        return result;
+    }
+
+    static unsigned int floorLog2(int value)
+    {
+        return floorLog2(static_cast<unsigned int>(value));
+    }
+
+private:
+    unsigned int width_ = 0, height_ = 0;
+    float obstacle_dist_ = 0;
+    std::vector<double> depth_sum_;
+    std::vector<uint32_t> obstacle_count_;
+    unsigned int levels_x_ = 0, levels_y_ = 0;
+    std::vector<float> min_table_;
+};
+
+}
+#endif
@@ -24,6 +24,11 @@ public:
     EnumFlags(const EnumFlags& original) 
         : flags_(original.flags_)
     {}
+    EnumFlags& operator =(const EnumFlags& original)
+    {
+        flags_ = original.flags_;
+        return *this;
+    }
 
     EnumFlags& operator |=(TEnum add_value)
     { 
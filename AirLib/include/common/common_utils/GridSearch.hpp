@@ -0,0 +1,540 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef common_utils_GridSearch_hpp
+#define common_utils_GridSearch_hpp
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+namespace common_utils {
+
+/*
+    Shortest paths on a 3D grid of free and blocked cells with 26-connectivity (8 when the grid is one cell
+    high). A move costs its length in cells, kept as fixed point integers so keys compare exactly and ties
+    between equally long paths can't stop a search early. Moves in to blocked cells are not allowed while moves out of
+    them are, so a start inside an inflated obstacle can still leave it.
+
+    findPath() is a plain A* search. setGoal() and replan() run D* Lite (Koenig and Likhachev, optimized
+    version) which searches from the goal towards the start and keeps its results: after the start moved and
+    some cells changed with setBlocked(), replan() only repairs the part of the search the changes affect,
+    which is usually a small fraction of a full search.
+
+    All per cell state lives in arrays allocated by resize(). Searches use a generation stamp instead of
+    clearing them, so nothing is allocated or cleared per search and the grid can be reused every control
+    iteration. The open list is a binary heap which knows the position of each cell for decrease-key.
+
+    findPath() shares the arrays with D* Lite and discards its state, setGoal() is needed again after it.
+*/
+class GridSearch {
+public:
+    GridSearch()
+    {
+    }
+
+    GridSearch(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+    {
+        resize(size_x, size_y, size_z);
+    }
+
+    //all cells become free
+    void resize(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+    {
+        const size_t count = static_cast<size_t>(size_x) * size_y * size_z;
+        if (count == 0 || count >= kClosed)
+            throw std::length_error("GridSearch size is out of range");
+
+        size_x_ = size_x;
+        size_y_ = size_y;
+        size_z_ = size_z;
+        blocked_.assign(count, 0);
+        g_.resize(count);
+        rhs_.resize(count);
+        heap_pos_.resize(count);
+        parent_.resize(count);
+        stamps_.assign(count, 0);
+        generation_ = 0;
+
+        heap_.clear();
+        changed_.clear();
+        incremental_ = false;
+        buildNeighbors();
+    }
+
+    unsigned int getSizeX() const { return size_x_; }
+    unsigned int getSizeY() const { return size_y_; }
+    unsigned int getSizeZ() const { return size_z_; }
+    size_t getCellCount() const { return blocked_.size(); }
+
+    size_t toCell(unsigned int x, unsigned int y, unsigned int z) const
+    {
+        return (static_cast<size_t>(z) * size_y_ + y) * size_x_ + x;
+    }
+
+    void toCoords(size_t cell, unsigned int& x, unsigned int& y, unsigned int& z) const
+    {
+        x = static_cast<unsigned int>(cell % size_x_);
+        cell /= size_x_;
+        y = static_cast<unsigned int>(cell % size_y_);
+        z = static_cast<unsigned int>(cell / size_y_);
+    }
+
+    bool isBlocked(size_t cell) const
+    {
+        return blocked_[cell] != 0;
+    }
+
+    //changes are picked up by the next replan()
+    void setBlocked(size_t cell, bool blocked)
+    {
+        if (isBlocked(cell) == blocked)
+            return;
+        blocked_[cell] = blocked ? 1 : 0;
+        if (incremental_)
+            changed_.push_back(cell);
+    }
+
+    //A* from start to goal, path includes both. False if goal can't be reached.
+    bool findPath(size_t start, size_t goal, std::vector<size_t>& path)
+    {
+        newGeneration();
+        incremental_ = false;
+        changed_.clear();
+        expanded_ = 0;
+        path.clear();
+        path_cost_ = kInfinity;
+
+        unsigned int target[3];
+        toCoords(goal, target[0], target[1], target[2]);
+
+        touch(start);
+        g_[start] = 0;
+        parent_[start] = static_cast<uint32_t>(start);
+        heapPush(start, Key(heuristic(start, target), 0));
+
+        while (!heap_.empty()) {
+            const size_t u = heap_[0].cell;
+            heapRemove(u);
+            heap_pos_[u] = kClosed;
+            ++expanded_;
+
+            if (u == goal) {
+                path_cost_ = g_[goal];
+                for (size_t cell = goal; cell != start; cell = parent_[cell])
+                    path.push_back(cell);
+                path.push_back(start);
+                std::reverse(path.begin(), path.end());
+                return true;
+            }
+
+            const Cost g_u = g_[u];
+            forNeighbors(u, [&](size_t v, Cost cost) {
+                if (blocked_[v])
+                    return;
+                touch(v);
+                if (heap_pos_[v] == kClosed || !(g_u + cost < g_[v]))
+                    return;
+                g_[v] = g_u + cost;
+                parent_[v] = static_cast<uint32_t>(u);
+                //ties go to the cell closer to the goal
+                const Cost h = heuristic(v, target);
+                heapPushOrUpdate(v, Key(g_[v] + h, h));
+            });
+        }
+        return false;
+    }
+
+    //starts an incremental search towards goal, run by replan()
+    void setGoal(size_t goal)
+    {
+        newGeneration();
+        heap_.clear();
+        changed_.clear();
+        incremental_ = true;
+        has_start_ = false;
+        goal_ = goal;
+        km_ = 0;
+
+        touch(goal);
+        rhs_[goal] = 0;
+    }
+
+    //D* Lite from start to the goal given to setGoal(), path includes both. False if goal can't be reached.
+    bool replan(size_t start, std::vector<size_t>& path)
+    {
+        if (!incremental_)
+            throw std::logic_error("GridSearch::setGoal() was not called");
+
+        expanded_ = 0;
+        start_ = start;
+        unsigned int start_coords[3];
+        toCoords(start, start_coords[0], start_coords[1], start_coords[2]);
+        if (!has_start_) {
+            std::copy(start_coords, start_coords + 3, start_coords_);
+            has_start_ = true;
+            heapPush(goal_, calculateKey(goal_));
+        }
+        else {
+            //keys already in the heap were computed with heuristic from the previous start
+            km_ += heuristic(start, start_coords_);
+            std::copy(start_coords, start_coords + 3, start_coords_);
+        }
+
+        //edges in to changed cells have new costs
+        for (size_t v : changed_) {
+            forNeighbors(v, [&](size_t u, Cost) {
+                if (u == goal_)
+                    return;
+                touch(u);
+                rhs_[u] = minSuccessor(u);
+                updateVertex(u);
+            });
+        }
+        changed_.clear();
+
+        computeShortestPath();
+        return extractPath(path);
+    }
+
+    //nodes expanded by the last findPath() or replan()
+    size_t getExpandedCount() const
+    {
+        return expanded_;
+    }
+
+    //length of the last path in cells, infinity if there was none
+    float getPathCost() const
+    {
+        return path_cost_ >= kInfinity ? std::numeric_limits<float>::infinity() : static_cast<float>(path_cost_) / kUnit;
+    }
+
+private:
+    typedef uint64_t Cost;
+
+    struct Key {
+        Cost k1, k2;
+
+        Key()
+        {
+        }
+
+        Key(Cost k1_val, Cost k2_val)
+            : k1(k1_val), k2(k2_val)
+        {
+        }
+
+        bool operator<(const Key& other) const
+        {
+            return k1 < other.k1 || (k1 == other.k1 && k2 < other.k2);
+        }
+    };
+
+    struct HeapEntry {
+        Key key;
+        uint32_t cell;
+    };
+
+    struct Neighbor {
+        int dx, dy, dz;
+        ptrdiff_t offset;
+        Cost cost;
+    };
+
+    void buildNeighbors()
+    {
+        neighbors_.clear();
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    //flat grids only move within their plane
+                    if ((dx == 0 && dy == 0 && dz == 0) || (dz != 0 && size_z_ == 1))
+                        continue;
+                    Neighbor neighbor;
+                    neighbor.dx = dx;
+                    neighbor.dy = dy;
+                    neighbor.dz = dz;
+                    neighbor.offset = (static_cast<ptrdiff_t>(dz) * size_y_ + dy) * size_x_ + dx;
+                    const int squared = dx * dx + dy * dy + dz * dz;
+                    neighbor.cost = squared == 1 ? kUnit : (squared == 2 ? kDiagonal2 : kDiagonal3);
+                    neighbors_.push_back(neighbor);
+                }
+            }
+        }
+    }
+
+    template<typename Func>
+    void forNeighbors(size_t cell, Func&& func) const
+    {
+        unsigned int x, y, z;
+        toCoords(cell, x, y, z);
+        for (const Neighbor& neighbor : neighbors_) {
+            //unsigned wrap around catches -1
+            if (x + neighbor.dx >= size_x_ || y + neighbor.dy >= size_y_ || z + neighbor.dz >= size_z_)
+                continue;
+            func(static_cast<size_t>(static_cast<ptrdiff_t>(cell) + neighbor.offset), neighbor.cost);
+        }
+    }
+
+    //length of the shortest move sequence ignoring blocked cells, consistent for 26-connectivity
+    Cost heuristic(size_t cell, const unsigned int target[3]) const
+    {
+        unsigned int coords[3];
+        toCoords(cell, coords[0], coords[1], coords[2]);
+        unsigned int d[3];
+        for (int i = 0; i < 3; ++i)
+            d[i] = coords[i] > target[i] ? coords[i] - target[i] : target[i] - coords[i];
+        std::sort(d, d + 3);
+        return kDiagonal3 * d[0] + kDiagonal2 * (d[1] - d[0]) + kUnit * (d[2] - d[1]);
+    }
+
+    void newGeneration()
+    {
+        if (++generation_ == 0) {
+            std::fill(stamps_.begin(), stamps_.end(), 0u);
+            generation_ = 1;
+        }
+        heap_.clear();
+    }
+
+    //cells not seen in this search start unreached
+    void touch(size_t cell)
+    {
+        if (stamps_[cell] == generation_)
+            return;
+        stamps_[cell] = generation_;
+        g_[cell] = rhs_[cell] = kInfinity;
+        heap_pos_[cell] = kNone;
+    }
+
+    Key calculateKey(size_t cell) const
+    {
+        const Cost m = std::min(g_[cell], rhs_[cell]);
+        return Key(m + heuristic(cell, start_coords_) + km_, m);
+    }
+
+    Cost minSuccessor(size_t cell)
+    {
+        Cost result = kInfinity;
+        forNeighbors(cell, [&](size_t v, Cost cost) {
+            if (blocked_[v])
+                return;
+            touch(v);
+            result = std::min(result, cost + g_[v]);
+        });
+        return result;
+    }
+
+    void updateVertex(size_t cell)
+    {
+        if (g_[cell] != rhs_[cell])
+            heapPushOrUpdate(cell, calculateKey(cell));
+        else if (heap_pos_[cell] != kNone)
+            heapRemove(cell);
+    }
+
+    void computeShortestPath()
+    {
+        touch(start_);
+        while (!heap_.empty()) {
+            const Key top_key = heap_[0].key;
+            if (!(top_key < calculateKey(start_)) && !(rhs_[start_] > g_[start_]))
+                break;
+
+            const size_t u = heap_[0].cell;
+            const Key new_key = calculateKey(u);
+            if (top_key < new_key) {
+                heapUpdate(u, new_key);
+                continue;
+            }
+
+            ++expanded_;
+            if (g_[u] > rhs_[u]) {
+                g_[u] = rhs_[u];
+                heapRemove(u);
+                if (blocked_[u])
+                    continue;
+                forNeighbors(u, [&](size_t s, Cost cost) {
+                    if (s == goal_)
+                        return;
+                    touch(s);
+                    if (cost + g_[u] < rhs_[s]) {
+                        rhs_[s] = cost + g_[u];
+                        updateVertex(s);
+                    }
+                });
+            }
+            else {
+                const Cost g_old = g_[u];
+                g_[u] = kInfinity;
+                if (!blocked_[u]) {
+                    forNeighbors(u, [&](size_t s, Cost cost) {
+                        if (s == goal_)
+                            return;
+                        touch(s);
+                        if (rhs_[s] == cost + g_old) {
+                            rhs_[s] = minSuccessor(s);
+                            updateVertex(s);
+                        }
+                    });
+                }
+                updateVertex(u);
+            }
+        }
+    }
+
+    //follows the cheapest successors from start
+    bool extractPath(std::vector<size_t>& path)
+    {
+        path.clear();
+        path_cost_ = kInfinity;
+        if (rhs_[start_] == kInfinity && start_ != goal_)
+            return false;
+
+        Cost cost = 0;
+        size_t cell = start_;
+        path.push_back(cell);
+        while (cell != goal_) {
+            size_t best = kNone;
+            Cost best_value = kInfinity, best_cost = 0;
+            forNeighbors(cell, [&](size_t v, Cost step) {
+                if (blocked_[v])
+                    return;
+                touch(v);
+                if (step + g_[v] < best_value) {
+                    best_value = step + g_[v];
+                    best_cost = step;
+                    best = v;
+                }
+            });
+            //a loop would mean inconsistent values, not expected but never hang on it
+            if (best == kNone || path.size() > getCellCount()) {
+                path.clear();
+                return false;
+            }
+            cost += best_cost;
+            cell = best;
+            path.push_back(cell);
+        }
+        path_cost_ = cost;
+        return true;
+    }
+
+    void heapPush(size_t cell, const Key& key)
+    {
+        HeapEntry entry;
+        entry.key = key;
+        entry.cell = static_cast<uint32_t>(cell);
+        heap_.push_back(entry);
+        heap_pos_[cell] = static_cast<uint32_t>(heap_.size() - 1);
+        siftUp(heap_.size() - 1);
+    }
+
+    void heapUpdate(size_t cell, const Key& key)
+    {
+        const size_t pos = heap_pos_[cell];
+        const bool decreased = key < heap_[pos].key;
+        heap_[pos].key = key;
+        if (decreased)
+            siftUp(pos);
+        else
+            siftDown(pos);
+    }
+
+    void heapPushOrUpdate(size_t cell, const Key& key)
+    {
+        if (heap_pos_[cell] == kNone || heap_pos_[cell] == kClosed)
+            heapPush(cell, key);
+        else
+            heapUpdate(cell, key);
+    }
+
+    void heapRemove(size_t cell)
+    {
+        const size_t pos = heap_pos_[cell];
+        heap_pos_[cell] = kNone;
+        if (pos + 1 == heap_.size()) {
+            heap_.pop_back();
+            return;
+        }
+
+        heap_[pos] = heap_.back();
+        heap_.pop_back();
+        heap_pos_[heap_[pos].cell] = static_cast<uint32_t>(pos);
+        if (pos > 0 && heap_[pos].key < heap_[(pos - 1) / 2].key)
+            siftUp(pos);
+        else
+            siftDown(pos);
+    }
+
+    void siftUp(size_t pos)
+    {
+        const HeapEntry entry = heap_[pos];
+        while (pos > 0) {
+            const size_t parent = (pos - 1) / 2;
+            if (!(entry.key < heap_[parent].key))
+                break;
+            heap_[pos] = heap_[parent];
+            heap_pos_[heap_[pos].cell] = static_cast<uint32_t>(pos);
+            pos = parent;
+        }
+        heap_[pos] = entry;
+        heap_pos_[entry.cell] = static_cast<uint32_t>(pos);
+    }
+
+    void siftDown(size_t pos)
+    {
+        const HeapEntry entry = heap_[pos];
+        const size_t size = heap_.size();
+        while (true) {
+            size_t child = 2 * pos + 1;
+            if (child >= size)
+                break;
+            if (child + 1 < size && heap_[child + 1].key < heap_[child].key)
+                ++child;
+            if (!(heap_[child].key < entry.key))
+                break;
+            heap_[pos] = heap_[child];
+            heap_pos_[heap_[pos].cell] = static_cast<uint32_t>(pos);
+            pos = child;
+        }
+        heap_[pos] = entry;
+        heap_pos_[entry.cell] = static_cast<uint32_t>(pos);
+    }
+
+private:
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+    static constexpr uint32_t kClosed = 0xFFFFFFFEu;
+    //move lengths 1, sqrt(2) and sqrt(3) in 1/10000 cells, infinity leaves room for additions
+    static constexpr Cost kUnit = 10000;
+    static constexpr Cost kDiagonal2 = 14142;
+    static constexpr Cost kDiagonal3 = 17321;
+    static constexpr Cost kInfinity = std::numeric_limits<Cost>::max() / 4;
+
+    unsigned int size_x_ = 0, size_y_ = 0, size_z_ = 0;
+    std::vector<Neighbor> neighbors_;
+
+    //node pool, valid for cells whose stamp is the current generation
+    std::vector<uint8_t> blocked_;
+    std::vector<Cost> g_, rhs_;
+    std::vector<uint32_t> heap_pos_, parent_, stamps_;
+    uint32_t generation_ = 0;
+    std::vector<HeapEntry> heap_;
+
+    size_t expanded_ = 0;
+    Cost path_cost_ = kInfinity;
+
+    //D* Lite
+    bool incremental_ = false, has_start_ = false;
+    size_t start_ = 0, goal_ = 0;
+    unsigned int start_coords_[3] = { 0, 0, 0 };
+    Cost km_ = 0;
+    std::vector<size_t> changed_;
+};
+
+}
+#endif
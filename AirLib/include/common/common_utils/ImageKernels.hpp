@@ -0,0 +1,328 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef common_utils_ImageKernels_hpp
+#define common_utils_ImageKernels_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COMMON_UTILS_IMAGE_KERNELS_SSE2 1
+#define COMMON_UTILS_IMAGE_KERNELS_HAS_SIMD 1
+#include <emmintrin.h>
+#if defined(__SSSE3__) || defined(__AVX__)
+#define COMMON_UTILS_IMAGE_KERNELS_SSSE3 1
+#include <tmmintrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define COMMON_UTILS_IMAGE_KERNELS_NEON 1
+#define COMMON_UTILS_IMAGE_KERNELS_HAS_SIMD 1
+#include <arm_neon.h>
+#endif
+
+namespace common_utils {
+
+/*
+    Per-pixel conversions of depth, disparity and color images as needed to write datasets. All of them
+    work in place or on buffers given by the caller, nothing is allocated, so buffers can be reused from
+    frame to frame.
+
+    Four pixels are processed at a time with SSE2 on x86 and NEON on ARM64, the remaining pixels and other
+    targets go through the scalar code which does the same operations in the same order, so results only
+    differ where the compiler contracts multiply and add in the scalar code.
+*/
+class ImageKernels {
+public:
+    //distance from camera center (DepthPerspective) to distance from image plane (DepthPlanner), principal
+    //point at (width / 2 - 1, height / 2 - 1) and focal length in pixels
+    static void perspectiveToPlanarDepth(float* depth, int width, int height, float f_px)
+    {
+        const float center_x = width / 2.0f - 1;
+        const float center_y = height / 2.0f - 1;
+        const float inv_f2 = 1.0f / (f_px * f_px);
+
+        for (int y = 0; y < height; ++y) {
+            float* row = depth + static_cast<size_t>(y) * width;
+            const float dy = static_cast<float>(y) - center_y;
+            const float dy2 = dy * dy;
+            int x = 0;
+#ifdef COMMON_UTILS_IMAGE_KERNELS_HAS_SIMD
+            const Vec4 vdy2 = vSet1(dy2), vcenter = vSet1(center_x), vinv_f2 = vSet1(inv_f2), one = vSet1(1);
+            for (; x + 4 <= width; x += 4) {
+                const Vec4 dx = vSub(vIota(x), vcenter);
+                const Vec4 r2 = vAdd(vMul(dx, dx), vdy2);
+                vStore(row + x, vDiv(vLoad(row + x), vSqrt(vAdd(one, vMul(r2, vinv_f2)))));
+            }
+#endif
+            for (; x < width; ++x) {
+                const float dx = static_cast<float>(x) - center_x;
+                const float r2 = dx * dx + dy2;
+                row[x] = row[x] / std::sqrt(1 + r2 * inv_f2);
+            }
+        }
+    }
+
+    //disparity = f_px * baseline / depth, in place
+    static void depthToDisparity(float* data, size_t count, float f_px, float baseline_meters)
+    {
+        const float fb = f_px * baseline_meters;
+        size_t i = 0;
+#ifdef COMMON_UTILS_IMAGE_KERNELS_HAS_SIMD
+        const Vec4 vfb = vSet1(fb);
+        for (; i + 4 <= count; i += 4)
+            vStore(data + i, vDiv(vfb, vLoad(data + i)));
+#endif
+        for (; i < count; ++i)
+            data[i] = fb / data[i];
+    }
+
+    //depth = f_px * baseline / |disparity| for disparities of either sign (SGM gives negative ones). Where
+    //disparity is 0, FLT_MAX (no match), infinite or NaN, depth is 0. abs_disparity, if not null, receives
+    //|disparity| with the same pixels set to 0.
+    static void disparityToDepth(const float* disparity, size_t count, float f_px, float baseline_meters,
+        float* depth, float* abs_disparity = nullptr)
+    {
+        const float fb = f_px * baseline_meters;
+        size_t i = 0;
+#ifdef COMMON_UTILS_IMAGE_KERNELS_HAS_SIMD
+        const Vec4 vfb = vSet1(fb), zero = vSet1(0), vmax = vSet1(FLT_MAX);
+        for (; i + 4 <= count; i += 4) {
+            const Vec4 d = vAbs(vLoad(disparity + i));
+            const Mask4 valid = vMaskAnd(vLess(zero, d), vLess(d, vmax));
+            vStore(depth + i, vSelect(valid, vDiv(vfb, d), zero));
+            if (abs_disparity)
+                vStore(abs_disparity + i, vSelect(valid, d, zero));
+        }
+#endif
+        for (; i < count; ++i) {
+            const float d = std::fabs(disparity[i]);
+            const bool valid = 0 < d && d < FLT_MAX;
+            depth[i] = valid ? fb / d : 0;
+            if (abs_disparity)
+                abs_disparity[i] = valid ? d : 0;
+        }
+    }
+
+    //DisparityNormalized images hold disparity / width, in place
+    static void denormalizeDisparity(float* data, size_t count, int width)
+    {
+        const float scale = static_cast<float>(width);
+        size_t i = 0;
+#ifdef COMMON_UTILS_IMAGE_KERNELS_HAS_SIMD
+        const Vec4 vscale = vSet1(scale);
+        for (; i + 4 <= count; i += 4)
+            vStore(data + i, vMul(vLoad(data + i), vscale));
+#endif
+        for (; i < count; ++i)
+            data[i] = data[i] * scale;
+    }
+
+    //rgb (3 bytes per pixel) color map running red, yellow, green, cyan, blue, magenta over [0, max_value),
+    //values outside that range are black
+    static void colorize(const float* values, size_t count, float max_value, uint8_t* rgb)
+    {
+        const float inc = 6.0f / max_value;
+        size_t i = 0;
+#ifdef COMMON_UTILS_IMAGE_KERNELS_HAS_SIMD
+        const Vec4 vinc = vSet1(inc), vmax = vSet1(max_value), zero = vSet1(0), one = vSet1(1), two = vSet1(2);
+        const Vec4 three = vSet1(3), four = vSet1(4), full = vSet1(255);
+        //each iteration writes one byte past its last pixel, that is the next pixel which is written again
+        for (; i + 5 <= count; i += 4) {
+            const Vec4 v = vLoad(values + i);
+            const Mask4 valid = vMaskAnd(vLessEqual(zero, v), vLess(v, vmax));
+            const Vec4 x = vMul(v, vinc);
+            const Vec4 r = vMin(vMax(vSub(vAbs(vSub(x, three)), one), zero), one);
+            const Vec4 g = vMin(vMax(vSub(two, vAbs(vSub(x, two))), zero), one);
+            const Vec4 b = vMin(vMax(vSub(two, vAbs(vSub(x, four))), zero), one);
+            uint32_t pixels[4];
+            vPackBytes(vSelect(valid, vMul(r, full), zero), vSelect(valid, vMul(g, full), zero),
+                vSelect(valid, vMul(b, full), zero), pixels);
+            for (int k = 0; k < 4; ++k)
+                std::memcpy(rgb + 3 * (i + k), &pixels[k], 4);
+        }
+#endif
+        for (; i < count; ++i) {
+            const float v = values[i];
+            uint8_t* pixel = rgb + 3 * i;
+            if (0 <= v && v < max_value) {
+                const float x = v * inc;
+                pixel[0] = static_cast<uint8_t>(clamp01(std::fabs(x - 3) - 1) * 255);
+                pixel[1] = static_cast<uint8_t>(clamp01(2 - std::fabs(x - 2)) * 255);
+                pixel[2] = static_cast<uint8_t>(clamp01(2 - std::fabs(x - 4)) * 255);
+            }
+            else
+                pixel[0] = pixel[1] = pixel[2] = 0;
+        }
+    }
+
+    //gray = value * scale, or scale / value if invert, saturated to [0, 255] with NaN giving 0
+    static void toGray(const float* values, size_t count, uint8_t* gray, bool invert = false, float scale = 1)
+    {
+        size_t i = 0;
+#ifdef COMMON_UTILS_IMAGE_KERNELS_HAS_SIMD
+        const Vec4 vscale = vSet1(scale);
+        for (; i + 16 <= count; i += 16) {
+            Vec4 v[4];
+            for (int k = 0; k < 4; ++k) {
+                v[k] = vLoad(values + i + 4 * k);
+                v[k] = invert ? vDiv(vscale, v[k]) : vMul(v[k], vscale);
+            }
+            vStoreBytes(v, gray + i);
+        }
+#endif
+        for (; i < count; ++i)
+            gray[i] = toByte(invert ? scale / values[i] : values[i] * scale);
+    }
+
+    //values times scale, rounded and saturated to 16 bit, e.g. depth in meters to millimeters for 16 bit PNG.
+    //NaN and values that saturate at 65535 such as FLT_MAX are written as 0, meaning no data
+    static void toUInt16(const float* values, size_t count, float scale, uint16_t* out)
+    {
+        //simple enough for the compiler to vectorize, packing to 16 bit unsigned would need SSE4.1
+        for (size_t i = 0; i < count; ++i) {
+            float x = values[i] * scale + 0.5f;
+            x = x > 0 ? x : 0;
+            out[i] = static_cast<uint16_t>(x < 65535 ? x : 0);
+        }
+    }
+
+    //drops alpha of RGBA (or BGRA) pixels, rgba and rgb must not overlap
+    static void rgbaToRgb(const uint8_t* rgba, size_t count, uint8_t* rgb)
+    {
+        size_t i = 0;
+#if defined(COMMON_UTILS_IMAGE_KERNELS_SSSE3)
+        const __m128i pick = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        for (; i + 16 <= count; i += 16) {
+            //4 times 12 bytes are merged into 3 stores of 16
+            const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + 4 * i)), pick);
+            const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + 4 * i + 16)), pick);
+            const __m128i c = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + 4 * i + 32)), pick);
+            const __m128i d = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + 4 * i + 48)), pick);
+            __m128i* out = reinterpret_cast<__m128i*>(rgb + 3 * i);
+            _mm_storeu_si128(out, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+            _mm_storeu_si128(out + 1, _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+            _mm_storeu_si128(out + 2, _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+        }
+#elif defined(COMMON_UTILS_IMAGE_KERNELS_NEON)
+        for (; i + 16 <= count; i += 16) {
+            const uint8x16x4_t in = vld4q_u8(rgba + 4 * i);
+            uint8x16x3_t out;
+            out.val[0] = in.val[0];
+            out.val[1] = in.val[1];
+            out.val[2] = in.val[2];
+            vst3q_u8(rgb + 3 * i, out);
+        }
+#endif
+        for (; i < count; ++i) {
+            rgb[3 * i] = rgba[4 * i];
+            rgb[3 * i + 1] = rgba[4 * i + 1];
+            rgb[3 * i + 2] = rgba[4 * i + 2];
+        }
+    }
+
+private:
+    static float clamp01(float x)
+    {
+        return x < 0 ? 0 : (x > 1 ? 1 : x);
+    }
+
+    static uint8_t toByte(float x)
+    {
+        //written so that NaN gives 0
+        x = x > 0 ? x : 0;
+        return static_cast<uint8_t>(x < 255 ? x : 255);
+    }
+
+#if defined(COMMON_UTILS_IMAGE_KERNELS_SSE2)
+    typedef __m128 Vec4;
+    typedef __m128 Mask4;
+
+    static Vec4 vLoad(const float* p) { return _mm_loadu_ps(p); }
+    static void vStore(float* p, Vec4 v) { _mm_storeu_ps(p, v); }
+    static Vec4 vSet1(float x) { return _mm_set1_ps(x); }
+    static Vec4 vIota(int first) { return _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(first), _mm_setr_epi32(0, 1, 2, 3))); }
+    static Vec4 vAdd(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+    static Vec4 vSub(Vec4 a, Vec4 b) { return _mm_sub_ps(a, b); }
+    static Vec4 vMul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+    static Vec4 vDiv(Vec4 a, Vec4 b) { return _mm_div_ps(a, b); }
+    static Vec4 vSqrt(Vec4 a) { return _mm_sqrt_ps(a); }
+    static Vec4 vMin(Vec4 a, Vec4 b) { return _mm_min_ps(a, b); }
+    static Vec4 vMax(Vec4 a, Vec4 b) { return _mm_max_ps(a, b); }
+    static Vec4 vAbs(Vec4 a) { return _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff))); }
+    static Mask4 vLess(Vec4 a, Vec4 b) { return _mm_cmplt_ps(a, b); }
+    static Mask4 vLessEqual(Vec4 a, Vec4 b) { return _mm_cmple_ps(a, b); }
+    static Mask4 vMaskAnd(Mask4 a, Mask4 b) { return _mm_and_ps(a, b); }
+    static Vec4 vSelect(Mask4 m, Vec4 a, Vec4 b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+    //lane k of a, b and c saturated to bytes 0, 1 and 2 of pixels[k], NaN gives 0
+    static void vPackBytes(Vec4 a, Vec4 b, Vec4 c, uint32_t* pixels)
+    {
+        const Vec4 zero = _mm_setzero_ps(), full = _mm_set1_ps(255);
+        const __m128i ia = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(a, zero), full));
+        const __m128i ib = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(b, zero), full));
+        const __m128i ic = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(c, zero), full));
+        const __m128i packed = _mm_or_si128(ia, _mm_or_si128(_mm_slli_epi32(ib, 8), _mm_slli_epi32(ic, 16)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), packed);
+    }
+
+    //16 values saturated to bytes, NaN gives 0
+    static void vStoreBytes(const Vec4 v[4], uint8_t* bytes)
+    {
+        const Vec4 zero = _mm_setzero_ps(), full = _mm_set1_ps(255);
+        __m128i i[4];
+        for (int k = 0; k < 4; ++k)
+            i[k] = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v[k], zero), full));
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(i[0], i[1]), _mm_packs_epi32(i[2], i[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), packed);
+    }
+#elif defined(COMMON_UTILS_IMAGE_KERNELS_NEON)
+    typedef float32x4_t Vec4;
+    typedef uint32x4_t Mask4;
+
+    static Vec4 vLoad(const float* p) { return vld1q_f32(p); }
+    static void vStore(float* p, Vec4 v) { vst1q_f32(p, v); }
+    static Vec4 vSet1(float x) { return vdupq_n_f32(x); }
+    static Vec4 vIota(int first)
+    {
+        const int32_t lanes[4] = { 0, 1, 2, 3 };
+        return vcvtq_f32_s32(vaddq_s32(vdupq_n_s32(first), vld1q_s32(lanes)));
+    }
+    static Vec4 vAdd(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+    static Vec4 vSub(Vec4 a, Vec4 b) { return vsubq_f32(a, b); }
+    static Vec4 vMul(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+    static Vec4 vDiv(Vec4 a, Vec4 b) { return vdivq_f32(a, b); }
+    static Vec4 vSqrt(Vec4 a) { return vsqrtq_f32(a); }
+    static Vec4 vMin(Vec4 a, Vec4 b) { return vminnmq_f32(a, b); }
+    static Vec4 vMax(Vec4 a, Vec4 b) { return vmaxnmq_f32(a, b); }
+    static Vec4 vAbs(Vec4 a) { return vabsq_f32(a); }
+    static Mask4 vLess(Vec4 a, Vec4 b) { return vcltq_f32(a, b); }
+    static Mask4 vLessEqual(Vec4 a, Vec4 b) { return vcleq_f32(a, b); }
+    static Mask4 vMaskAnd(Mask4 a, Mask4 b) { return vandq_u32(a, b); }
+    static Vec4 vSelect(Mask4 m, Vec4 a, Vec4 b) { return vbslq_f32(m, a, b); }
+
+    static void vPackBytes(Vec4 a, Vec4 b, Vec4 c, uint32_t* pixels)
+    {
+        const Vec4 zero = vdupq_n_f32(0), full = vdupq_n_f32(255);
+        const uint32x4_t ia = vcvtq_u32_f32(vminnmq_f32(vmaxnmq_f32(a, zero), full));
+        const uint32x4_t ib = vcvtq_u32_f32(vminnmq_f32(vmaxnmq_f32(b, zero), full));
+        const uint32x4_t ic = vcvtq_u32_f32(vminnmq_f32(vmaxnmq_f32(c, zero), full));
+        vst1q_u32(pixels, vorrq_u32(ia, vorrq_u32(vshlq_n_u32(ib, 8), vshlq_n_u32(ic, 16))));
+    }
+
+    static void vStoreBytes(const Vec4 v[4], uint8_t* bytes)
+    {
+        const Vec4 zero = vdupq_n_f32(0), full = vdupq_n_f32(255);
+        uint16x4_t i[4];
+        for (int k = 0; k < 4; ++k)
+            i[k] = vmovn_u32(vcvtq_u32_f32(vminnmq_f32(vmaxnmq_f32(v[k], zero), full)));
+        vst1q_u8(bytes, vcombine_u8(vmovn_u16(vcombine_u16(i[0], i[1])), vmovn_u16(vcombine_u16(i[2], i[3]))));
+    }
+#endif
+};
+
+} //namespace
+#endif
@@ -0,0 +1,140 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef common_utils_LatencyHistogram_hpp
+#define common_utils_LatencyHistogram_hpp
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+namespace common_utils {
+
+/*
+    Histogram of durations in nanoseconds which can be recorded from one thread and read from any other
+    thread without locks. Buckets are log-linear: each power of two is split in 4 buckets so any value
+    is reported within 25% of its actual value and full 64-bit range fits in fixed number of buckets.
+
+    Snapshot is not atomic across buckets, i.e., values recorded while snapshot is being taken may or may
+    not be included, which is fine for monitoring purposes.
+*/
+class LatencyHistogram {
+public:
+    static constexpr unsigned int kSubBucketBits = 2;
+    static constexpr unsigned int kSubBucketCount = 1 << kSubBucketBits;
+    static constexpr unsigned int kBucketCount = kSubBucketCount + (64 - kSubBucketBits) * kSubBucketCount;
+
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sum_nanos = 0;
+        uint64_t max_nanos = 0;
+        std::array<uint64_t, kBucketCount> buckets {};
+
+        double mean() const
+        {
+            return count > 0 ? static_cast<double>(sum_nanos) / count : 0;
+        }
+
+        //upper bound of bucket that contains given fraction of samples, p is in [0, 1]
+        uint64_t percentile(double p) const
+        {
+            if (count == 0)
+                return 0;
+
+            uint64_t rank = static_cast<uint64_t>(std::max(p, 0.0) * count);
+            if (rank >= count)
+                rank = count - 1;
+
+            uint64_t seen = 0;
+            for (unsigned int i = 0; i < kBucketCount; ++i) {
+                seen += buckets[i];
+                if (seen > rank)
+                    return std::min(bucketUpperBound(i), max_nanos);
+            }
+            return max_nanos;
+        }
+    };
+
+public:
+    LatencyHistogram()
+    {
+        reset();
+    }
+
+    void record(uint64_t nanos)
+    {
+        buckets_[bucketIndex(nanos)].fetch_add(1, std::memory_order_relaxed);
+        sum_nanos_.fetch_add(nanos, std::memory_order_relaxed);
+
+        uint64_t current_max = max_nanos_.load(std::memory_order_relaxed);
+        while (nanos > current_max && !max_nanos_.compare_exchange_weak(current_max, nanos, std::memory_order_relaxed))
+            ;
+
+        //count is published last so readers don't see count without its bucket
+        count_.fetch_add(1, std::memory_order_release);
+    }
+
+    Snapshot snapshot() const
+    {
+        Snapshot result;
+        result.count = count_.load(std::memory_order_acquire);
+        result.sum_nanos = sum_nanos_.load(std::memory_order_relaxed);
+        result.max_nanos = max_nanos_.load(std::memory_order_relaxed);
+
+        //use bucket totals for count so percentiles are consistent with buckets
+        uint64_t bucket_total = 0;
+        for (unsigned int i = 0; i < kBucketCount; ++i) {
+            result.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+            bucket_total += result.buckets[i];
+        }
+        result.count = std::min(result.count, bucket_total);
+
+        return result;
+    }
+
+    //not safe to call while other thread is recording
+    void reset()
+    {
+        for (auto& bucket : buckets_)
+            bucket.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        sum_nanos_.store(0, std::memory_order_relaxed);
+        max_nanos_.store(0, std::memory_order_release);
+    }
+
+    static unsigned int bucketIndex(uint64_t nanos)
+    {
+        if (nanos < kSubBucketCount)
+            return static_cast<unsigned int>(nanos);
+
+        unsigned int msb = 0;
+        for (uint64_t v = nanos; v > 1; v >>= 1)
+            ++msb;
+
+        unsigned int shift = msb - kSubBucketBits;
+        unsigned int sub_bucket = static_cast<unsigned int>(nanos >> shift) & (kSubBucketCount - 1);
+        return kSubBucketCount + shift * kSubBucketCount + sub_bucket;
+    }
+
+    //largest value that goes in the bucket
+    static uint64_t bucketUpperBound(unsigned int index)
+    {
+        if (index < kSubBucketCount)
+            return index;
+
+        unsigned int shift = (index - kSubBucketCount) / kSubBucketCount;
+        uint64_t sub_bucket = (index - kSubBucketCount) % kSubBucketCount;
+        uint64_t lower = (kSubBucketCount + sub_bucket) << shift;
+        return lower + ((1ULL << shift) - 1);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_nanos_;
+    std::atomic<uint64_t> max_nanos_;
+};
+
+}
+#endif
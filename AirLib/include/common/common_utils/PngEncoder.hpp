@@ -0,0 +1,183 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef common_utils_PngEncoder_hpp
+#define common_utils_PngEncoder_hpp
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <stdexcept>
+#include "Deflate.hpp"
+
+namespace common_utils {
+
+/*
+    Writes compressed PNG images: 8 bit gray, RGB or RGBA, and 16 bit gray or RGB such as depth in millimeters.
+    Each row is filtered with the filter that gives the smallest sum of absolute residuals, as libpng does by
+    default, then all rows are deflated into one IDAT chunk.
+
+    An instance keeps its buffers between calls, so each thread should have its own.
+*/
+class PngEncoder {
+public:
+    PngEncoder()
+    {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            crc_table_[n] = c;
+        }
+    }
+
+    //channels: 1 gray, 3 RGB, 4 RGBA. Rows are packed without padding. png is overwritten.
+    void encode(const uint8_t* pixels, unsigned int width, unsigned int height, unsigned int channels,
+        std::vector<uint8_t>& png, int level = 6)
+    {
+        encodeRows(pixels, width, height, channels, 1, png, level);
+    }
+
+    //16 bit samples in host byte order, channels 1 or 3
+    void encode(const uint16_t* pixels, unsigned int width, unsigned int height, unsigned int channels,
+        std::vector<uint8_t>& png, int level = 6)
+    {
+        //PNG stores samples most significant byte first
+        const size_t count = static_cast<size_t>(width) * height * channels;
+        big_endian_.resize(count * 2);
+        for (size_t i = 0; i < count; ++i) {
+            big_endian_[2 * i] = static_cast<uint8_t>(pixels[i] >> 8);
+            big_endian_[2 * i + 1] = static_cast<uint8_t>(pixels[i]);
+        }
+        encodeRows(big_endian_.data(), width, height, channels, 2, png, level);
+    }
+
+private:
+    void encodeRows(const uint8_t* data, unsigned int width, unsigned int height, unsigned int channels,
+        unsigned int sample_bytes, std::vector<uint8_t>& png, int level)
+    {
+        uint8_t color_type;
+        switch (channels) {
+        case 1: color_type = 0; break;
+        case 3: color_type = 2; break;
+        case 4: color_type = 6; break;
+        default: throw std::invalid_argument("PNG images need 1, 3 or 4 channels");
+        }
+        if (width == 0 || height == 0)
+            throw std::invalid_argument("PNG images can't be empty");
+
+        const size_t bpp = channels * sample_bytes;
+        const size_t row_bytes = width * bpp;
+        filtered_.resize(height * (row_bytes + 1));
+        for (unsigned int y = 0; y < height; ++y) {
+            const uint8_t* row = data + y * row_bytes;
+            const uint8_t* above = y > 0 ? row - row_bytes : nullptr;
+            filterRow(row, above, row_bytes, bpp, level == 0, filtered_.data() + y * (row_bytes + 1));
+        }
+
+        compressed_.clear();
+        deflate_.compress(filtered_.data(), filtered_.size(), compressed_, level);
+
+        png.clear();
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        png.insert(png.end(), signature, signature + 8);
+
+        uint8_t header[13];
+        putUInt32(header, width);
+        putUInt32(header + 4, height);
+        header[8] = static_cast<uint8_t>(8 * sample_bytes);
+        header[9] = color_type;
+        header[10] = 0;     //deflate
+        header[11] = 0;     //adaptive filtering
+        header[12] = 0;     //no interlace
+        writeChunk(png, "IHDR", header, sizeof(header));
+        writeChunk(png, "IDAT", compressed_.data(), compressed_.size());
+        writeChunk(png, "IEND", nullptr, 0);
+    }
+
+    //writes filter type and filtered row to out
+    void filterRow(const uint8_t* row, const uint8_t* above, size_t row_bytes, size_t bpp, bool no_filter, uint8_t* out)
+    {
+        if (no_filter) {
+            out[0] = 0;
+            std::copy(row, row + row_bytes, out + 1);
+            return;
+        }
+
+        candidate_.resize(row_bytes);
+        uint64_t best_cost = UINT64_MAX;
+        for (uint8_t filter = 0; filter < 5; ++filter) {
+            //Up, Average and Paeth without row above are the same as None or Sub
+            if (!above && filter >= 2)
+                break;
+            uint64_t cost = 0;
+            for (size_t i = 0; i < row_bytes; ++i) {
+                int left = i >= bpp ? row[i - bpp] : 0;
+                int up = above ? above[i] : 0;
+                int up_left = above && i >= bpp ? above[i - bpp] : 0;
+                int predicted;
+                switch (filter) {
+                case 0: predicted = 0; break;
+                case 1: predicted = left; break;
+                case 2: predicted = up; break;
+                case 3: predicted = (left + up) / 2; break;
+                default: predicted = paeth(left, up, up_left); break;
+                }
+                uint8_t residual = static_cast<uint8_t>(row[i] - predicted);
+                candidate_[i] = residual;
+                //residuals as signed bytes, small ones compress best
+                cost += residual < 128 ? residual : 256 - residual;
+            }
+            if (cost < best_cost) {
+                best_cost = cost;
+                out[0] = filter;
+                std::copy(candidate_.begin(), candidate_.end(), out + 1);
+            }
+        }
+    }
+
+    static int paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return a;
+        return pb <= pc ? b : c;
+    }
+
+    static void putUInt32(uint8_t* p, uint32_t value)
+    {
+        p[0] = static_cast<uint8_t>(value >> 24);
+        p[1] = static_cast<uint8_t>(value >> 16);
+        p[2] = static_cast<uint8_t>(value >> 8);
+        p[3] = static_cast<uint8_t>(value);
+    }
+
+    void writeChunk(std::vector<uint8_t>& png, const char* type, const uint8_t* data, size_t size)
+    {
+        uint8_t field[4];
+        putUInt32(field, static_cast<uint32_t>(size));
+        png.insert(png.end(), field, field + 4);
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        if (size > 0)
+            png.insert(png.end(), data, data + size);
+
+        //CRC covers type and data
+        uint32_t crc = 0xffffffffu;
+        for (size_t i = start; i < png.size(); ++i)
+            crc = crc_table_[(crc ^ png[i]) & 0xff] ^ (crc >> 8);
+        putUInt32(field, crc ^ 0xffffffffu);
+        png.insert(png.end(), field, field + 4);
+    }
+
+private:
+    Deflate deflate_;
+    uint32_t crc_table_[256];
+    std::vector<uint8_t> big_endian_, filtered_, candidate_, compressed_;
+};
+
+}
+#endif
@@ -11,10 +11,33 @@
 #include <system_error>
 #include <mutex>
 #include <cstdint>
+#include <memory>
+#include "ThreadWaiter.hpp"
+#include "LatencyHistogram.hpp"
 
 namespace common_utils {
 
+/*
+    Calls callback on its own thread once every period. Periods are scheduled on absolute deadlines
+    (start + n * period) so timing error doesn't accumulate over time. If callback takes longer than
+    its period, the period is counted as overrun and any periods that have fully passed are skipped
+    instead of running callbacks back to back, so schedule stays aligned to original deadlines.
+*/
 class ScheduledExecutor {
+public:
+    struct Stats {
+        //number of periods run since start()
+        uint64_t period_count = 0;
+        //periods at the end of which next deadline was already passed
+        uint64_t overrun_count = 0;
+        //deadlines skipped entirely because of overruns
+        uint64_t missed_period_count = 0;
+        //time spent inside callback
+        LatencyHistogram::Snapshot callback_duration;
+        //how late each period started compared to its deadline
+        LatencyHistogram::Snapshot wake_jitter;
+    };
+
 public:
     ScheduledExecutor()
     {}
@@ -32,6 +55,8 @@ public:
         period_nanos_ = period_nanos;
         started_ = false;
 
+        //wait strategy comes from ThreadWaiter default config so it can be selected from settings
+        waiter_.reset(new ThreadWaiter());
     }
 
     void start()
@@ -42,6 +67,7 @@ public:
         initializePauseState();
         
         sleep_time_avg_ = 0;
+        resetStats();
         Utils::cleanupThread(th_);
         th_ = std::thread(&ScheduledExecutor::executorLoop, this);
     }
@@ -68,15 +94,16 @@ public:
         if (started_) {
             started_ = false;
             initializePauseState();
+        }
 
-            try {
-                if (th_.joinable()) {
-                    th_.join();
-                }
+        //thread also needs join if loop ended because callback returned false
+        try {
+            if (th_.joinable()) {
+                th_.join();
             }
-            catch(const std::system_error& /* e */)
-            { }
         }
+        catch(const std::system_error& /* e */)
+        { }
     }
 
     bool isRunning() const
@@ -84,14 +111,29 @@ public:
         return started_ && !paused_;
     }
 
+    //how late executor thread woke up compared to when it wanted to
+    ThreadWaiter::Stats getWaitStats() const
+    {
+        return waiter_ ? waiter_->getStats() : ThreadWaiter::Stats();
+    }
+
     double getSleepTimeAvg() const
     {
-        //TODO: make this function thread safe by using atomic types
-        //right now this is not implemented for performance and that
-        //return of this function is purely informational/debugging purposes
         return sleep_time_avg_;
     }
 
+    //can be called from any thread while executor is running
+    Stats getStats() const
+    {
+        Stats stats;
+        stats.period_count = period_count_;
+        stats.overrun_count = overrun_count_;
+        stats.missed_period_count = missed_period_count_;
+        stats.callback_duration = callback_duration_.snapshot();
+        stats.wake_jitter = wake_jitter_.snapshot();
+        return stats;
+    }
+
     void lock()
     {
         mutex_.lock();
@@ -110,46 +152,30 @@ private:
     }
 
 private:
-    typedef std::chrono::high_resolution_clock clock;
     typedef uint64_t TTimePoint;
     typedef uint64_t TTimeDelta;
-    template <typename T>
-    using duration = std::chrono::duration<T>;
 
     static TTimePoint nanos()
     {
-        return clock::now().time_since_epoch().count();
+        return ThreadWaiter::nanos();
     }
 
-    static void sleep_for(TTimePoint delay_nanos)
+    void resetStats()
     {
-        /*
-        This is spin loop implementation which may be suitable for sub-millisecond resolution.
-        //TODO: investigate below alternatives
-        On Windows we can use multimedia timers however this requires including entire Win32 header.
-        On Linux we can use nanosleep however below 2ms delays in real-time scheduler settings this 
-        probbaly does spin loop anyway.
-
-        */
-
-        if (delay_nanos >= 5000000LL) { //put thread to sleep
-            std::this_thread::sleep_for(std::chrono::duration<double>(delay_nanos / 1.0E9));
-        }
-        else { //for more precise timing, do spinning
-            auto start = nanos();
-            while ((nanos() - start) < delay_nanos) {
-                std::this_thread::yield();
-                //std::this_thread::sleep_for(std::chrono::duration<double>(0));
-            }
-        }
+        period_count_ = overrun_count_ = missed_period_count_ = 0;
+        callback_duration_.reset();
+        wake_jitter_.reset();
     }
 
     void executorLoop()
     {
         TTimePoint call_end = nanos();
+        TTimePoint deadline = call_end;
         while (started_) {
             TTimePoint period_start = nanos();
             TTimeDelta since_last_call = period_start - call_end;
+            if (!is_first_period_ && period_nanos_ > 0)
+                wake_jitter_.record(period_start > deadline ? period_start - deadline : 0);
             
             if (pause_period_start_ > 0) {
                 if (nanos() - pause_period_start_ >= pause_period_) {
@@ -166,7 +192,9 @@ private:
                     //when we are doing work, don't let other thread to cause contention
                     std::lock_guard<std::mutex> locker(mutex_);
 
+                    TTimePoint callback_start = nanos();
                     bool result = callback_(since_last_call);
+                    callback_duration_.record(nanos() - callback_start);
                     if (!result) {
                         started_ = result;
                     }
@@ -176,14 +204,26 @@ private:
                 is_first_period_ = false;
             
             call_end = nanos();
+            ++period_count_;
+
+            //next deadline is computed from previous one instead of from now so error doesn't accumulate
+            deadline += period_nanos_;
+            if (period_nanos_ > 0 && call_end > deadline) {
+                //we are already late for next period, skip periods that have passed entirely
+                TTimeDelta missed_periods = (call_end - deadline) / period_nanos_;
+                ++overrun_count_;
+                missed_period_count_ += missed_periods;
+                deadline += missed_periods * period_nanos_;
+            }
 
-            TTimeDelta elapsed_period = nanos() - period_start;
             //prevent underflow: https://github.com/Microsoft/AirSim/issues/617
-            TTimeDelta delay_nanos = period_nanos_ > elapsed_period ? period_nanos_ - elapsed_period : 0;
+            TTimeDelta delay_nanos = deadline > call_end ? deadline - call_end : 0;
             //moving average of how much we are sleeping
             sleep_time_avg_ = 0.25f * sleep_time_avg_ + 0.75f * delay_nanos;
+            //see ThreadWaiter for available strategies, the default one sleeps in OS until
+            //shortly before deadline and spins only for the rest
             if (delay_nanos > 0 && started_)
-                sleep_for(delay_nanos);
+                waiter_->sleepUntil(deadline);
         }
     }
 
@@ -192,14 +232,21 @@ private:
     std::thread th_;
     std::function<bool(uint64_t)> callback_;
     bool is_first_period_;
-    std::atomic_bool started_;
+    std::atomic_bool started_ {false};
     std::atomic_bool paused_;
     std::atomic<TTimeDelta> pause_period_;
     std::atomic<TTimePoint> pause_period_start_;
     
-    double sleep_time_avg_;
+    std::atomic<double> sleep_time_avg_ {0};
+
+    std::atomic<uint64_t> period_count_ {0};
+    std::atomic<uint64_t> overrun_count_ {0};
+    std::atomic<uint64_t> missed_period_count_ {0};
+    LatencyHistogram callback_duration_;
+    LatencyHistogram wake_jitter_;
 
     std::mutex mutex_;
+    std::unique_ptr<ThreadWaiter> waiter_;
 };
 
 }
@@ -0,0 +1,267 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef common_utils_SharedMemoryRing_hpp
+#define common_utils_SharedMemoryRing_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include <sys/types.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#define COMMON_UTILS_HAS_POSIX_SHM 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace common_utils {
+
+/*
+    Ring of fixed size slots in POSIX shared memory used to pass large frames such as images between
+    processes on the same host. The process that creates the ring is the only writer (any number of its
+    threads may write concurrently), other processes open it by name and read.
+
+    Each write goes to the next slot and gets a sequence number, writer then sends (slot, sequence, size)
+    to reader over some other channel, e.g. RPC reply. Each slot is guarded by seqlock so reader can detect
+    if slot was overwritten while or before it was read, in which case read() returns false. Number of slots
+    should therefore cover all frames that can be in flight at the same time.
+
+    On platforms without POSIX shared memory isSupported() returns false and constructors throw.
+*/
+class SharedMemoryRing {
+public:
+    struct Frame {
+        int slot = -1;  //-1 means frame was not written to shared memory
+        uint64_t sequence = 0;
+        uint64_t size = 0;
+    };
+
+    static bool isSupported()
+    {
+#ifdef COMMON_UTILS_HAS_POSIX_SHM
+        return ATOMIC_LLONG_LOCK_FREE == 2;
+#else
+        return false;
+#endif
+    }
+
+    //create new ring as writer, name must start with '/' and must not exist
+    SharedMemoryRing(const std::string& name, unsigned int slot_count, uint64_t slot_size)
+        : name_(name), is_owner_(true)
+    {
+        if (slot_count == 0 || slot_size == 0)
+            throw std::invalid_argument("SharedMemoryRing needs at least one slot of non-zero size");
+
+        if (slot_size > std::numeric_limits<uint64_t>::max() - kAlignment)
+            throw std::length_error("SharedMemoryRing slot is too large");
+        slot_size = alignUp(slot_size);
+        mapRegion(true, layoutSize(slot_count, slot_size));
+
+        header_->magic = kMagic;
+        header_->slot_count = slot_count;
+        header_->slot_size = slot_size;
+        header_->next_sequence.store(0);
+        for (unsigned int i = 0; i < slot_count; ++i) {
+            slots_[i].state.store(0);
+            slots_[i].size = 0;
+        }
+    }
+
+    //open existing ring as reader
+    explicit SharedMemoryRing(const std::string& name)
+        : name_(name), is_owner_(false)
+    {
+        mapRegion(false, sizeof(Header));
+        if (header_->magic != kMagic) {
+            unmapRegion();
+            throw std::runtime_error("Shared memory " + name + " is not a SharedMemoryRing");
+        }
+
+        //remap with full size now that we know the layout
+        unsigned int slot_count = header_->slot_count;
+        uint64_t slot_size = header_->slot_size;
+        unmapRegion();
+        mapRegion(false, layoutSize(slot_count, slot_size));
+    }
+
+    ~SharedMemoryRing()
+    {
+        unmapRegion();
+#ifdef COMMON_UTILS_HAS_POSIX_SHM
+        if (is_owner_)
+            shm_unlink(name_.c_str());
+#endif
+    }
+
+    SharedMemoryRing(const SharedMemoryRing&) = delete;
+    SharedMemoryRing& operator=(const SharedMemoryRing&) = delete;
+
+    Frame write(const void* data, uint64_t size)
+    {
+        Frame frame;
+        if (size > header_->slot_size)
+            return frame;
+
+        frame.sequence = header_->next_sequence.fetch_add(1) + 1;
+        frame.slot = static_cast<int>(frame.sequence % header_->slot_count);
+        frame.size = size;
+
+        //odd state marks slot as being written
+        Slot& slot = slots_[frame.slot];
+        slot.state.store(frame.sequence * 2 + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        if (size > 0)
+            std::memcpy(slotData(frame.slot), data, static_cast<size_t>(size));
+        slot.size = size;
+
+        slot.state.store(frame.sequence * 2, std::memory_order_release);
+        return frame;
+    }
+
+    //copy frame into buffer which is resized to fit, returns false if frame is no longer in the ring
+    template <typename T>
+    bool read(const Frame& frame, std::vector<T>& buffer) const
+    {
+        if (frame.slot < 0 || static_cast<unsigned int>(frame.slot) >= header_->slot_count || frame.size % sizeof(T) != 0)
+            return false;
+
+        const Slot& slot = slots_[frame.slot];
+        uint64_t state = slot.state.load(std::memory_order_acquire);
+        if (state != frame.sequence * 2 || slot.size != frame.size)
+            return false;
+
+        buffer.resize(static_cast<size_t>(frame.size / sizeof(T)));
+        if (frame.size > 0)
+            std::memcpy(buffer.data(), slotData(frame.slot), static_cast<size_t>(frame.size));
+
+        //if writer started on this slot while we were copying then data may be torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.state.load(std::memory_order_relaxed) == state;
+    }
+
+    const std::string& getName() const
+    {
+        return name_;
+    }
+
+    unsigned int getSlotCount() const
+    {
+        return header_->slot_count;
+    }
+
+    uint64_t getSlotSize() const
+    {
+        return header_->slot_size;
+    }
+
+private:
+    static constexpr uint32_t kMagic = 0x41534d52; //"ASMR"
+    static constexpr uint64_t kAlignment = 64;
+
+    struct alignas(kAlignment) Header {
+        uint32_t magic;
+        uint32_t slot_count;
+        uint64_t slot_size;
+        std::atomic<uint64_t> next_sequence;
+    };
+
+    struct alignas(kAlignment) Slot {
+        std::atomic<uint64_t> state;
+        uint64_t size;
+    };
+
+    static uint64_t alignUp(uint64_t size)
+    {
+        return (size + kAlignment - 1) / kAlignment * kAlignment;
+    }
+
+    //throws if the region can't be addressed, slot_count and slot_size may come from another process
+    static uint64_t layoutSize(unsigned int slot_count, uint64_t slot_size)
+    {
+        const uint64_t max_size = std::min<uint64_t>(std::numeric_limits<size_t>::max(), std::numeric_limits<off_t>::max());
+        const uint64_t slot_bytes = sizeof(Slot) + slot_size;
+        if (slot_size > max_size || slot_bytes > (max_size - sizeof(Header)) / std::max(slot_count, 1u))
+            throw std::length_error("SharedMemoryRing is too large");
+        return sizeof(Header) + slot_count * slot_bytes;
+    }
+
+    unsigned char* slotData(int slot) const
+    {
+        unsigned char* data_start = reinterpret_cast<unsigned char*>(slots_ + header_->slot_count);
+        return data_start + static_cast<uint64_t>(slot) * header_->slot_size;
+    }
+
+    void mapRegion(bool create, uint64_t size)
+    {
+#ifdef COMMON_UTILS_HAS_POSIX_SHM
+        int fd = create ? shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR)
+            : shm_open(name_.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            throw std::runtime_error("Could not open shared memory " + name_ + ": " + std::strerror(errno));
+
+        //on Linux allocate pages now so we fail here instead of getting SIGBUS later if /dev/shm is too small
+#ifdef __linux__
+        if (create && posix_fallocate(fd, 0, static_cast<off_t>(size)) != 0) {
+#else
+        if (create && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+#endif
+            close(fd);
+            shm_unlink(name_.c_str());
+            throw std::runtime_error("Could not allocate shared memory " + name_ + ": " + std::strerror(errno));
+        }
+
+        void* region = mmap(nullptr, static_cast<size_t>(size), create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (region == MAP_FAILED) {
+            if (create)
+                shm_unlink(name_.c_str());
+            throw std::runtime_error("Could not map shared memory " + name_ + ": " + std::strerror(errno));
+        }
+
+        region_ = region;
+        region_size_ = size;
+        header_ = static_cast<Header*>(region);
+        slots_ = reinterpret_cast<Slot*>(header_ + 1);
+#else
+        unused(create);
+        unused(size);
+        throw std::runtime_error("Shared memory is not supported on this platform");
+#endif
+    }
+
+    void unmapRegion()
+    {
+#ifdef COMMON_UTILS_HAS_POSIX_SHM
+        if (region_ != nullptr)
+            munmap(region_, static_cast<size_t>(region_size_));
+#endif
+        region_ = nullptr;
+        header_ = nullptr;
+        slots_ = nullptr;
+    }
+
+    template <typename T>
+    static void unused(const T&) {}
+
+private:
+    std::string name_;
+    bool is_owner_;
+
+    void* region_ = nullptr;
+    uint64_t region_size_ = 0;
+    Header* header_ = nullptr;
+    Slot* slots_ = nullptr;
+};
+
+}
+#endif
@@ -0,0 +1,266 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef common_utils_ThreadWaiter_hpp
+#define common_utils_ThreadWaiter_hpp
+
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <cmath>
+#include <cstdint>
+#include <cerrno>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#endif
+
+namespace common_utils {
+
+/*
+    Puts calling thread to sleep until deadline on steady clock with sub-millisecond accuracy.
+
+    Spin: yield in loop until deadline. Most accurate but keeps one core busy.
+    Sleep: only OS sleep. Cheapest but accuracy depends on OS timer slack.
+    Hybrid: OS sleep on absolute deadline (clock_nanosleep on Linux) until spin_threshold before deadline,
+        then spin for the rest. This keeps accuracy of spinning with CPU usage close to sleeping.
+    TimerFd: same as Hybrid but OS sleep is done on timerfd armed with absolute deadline. Linux only,
+        elsewhere this is same as Hybrid.
+
+    Each wait records how late thread woke up compared to deadline so period accuracy can be verified.
+    Instance is meant to be used by one waiting thread, statistics can be read from any thread.
+*/
+class ThreadWaiter {
+public:
+    enum class Strategy {
+        Spin, Sleep, Hybrid, TimerFd
+    };
+
+    struct Stats {
+        uint64_t wait_count = 0;
+        double late_mean_nanos = 0;
+        double late_stddev_nanos = 0;
+        uint64_t late_max_nanos = 0;
+        //total time spent spinning, this is time when waiting thread was still using CPU
+        uint64_t spin_nanos = 0;
+    };
+
+    struct Config {
+        Strategy strategy = Strategy::Hybrid;
+        //0 means use platform default
+        uint64_t spin_threshold_nanos = 0;
+    };
+
+public:
+    ThreadWaiter()
+        : ThreadWaiter(getSetDefaultConfig())
+    {
+    }
+
+    ThreadWaiter(const Config& config)
+        : strategy_(config.strategy),
+        spin_threshold_nanos_(config.spin_threshold_nanos ? config.spin_threshold_nanos : getPlatformSpinThreshold())
+    {
+#ifdef __linux__
+        if (strategy_ == Strategy::TimerFd) {
+            timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+            if (timer_fd_ < 0)
+                strategy_ = Strategy::Hybrid;
+        }
+#else
+        if (strategy_ == Strategy::TimerFd)
+            strategy_ = Strategy::Hybrid;
+#endif
+    }
+
+    ~ThreadWaiter()
+    {
+#ifdef __linux__
+        if (timer_fd_ >= 0)
+            close(timer_fd_);
+#endif
+    }
+
+    ThreadWaiter(const ThreadWaiter&) = delete;
+    ThreadWaiter& operator=(const ThreadWaiter&) = delete;
+
+    //nanoseconds on steady clock, deadlines passed to this class must use same time base
+    static uint64_t nanos()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void sleepFor(uint64_t delay_nanos)
+    {
+        sleepUntil(nanos() + delay_nanos);
+    }
+
+    void sleepUntil(uint64_t deadline_nanos)
+    {
+        switch (strategy_) {
+        case Strategy::Spin:
+            spinUntil(deadline_nanos);
+            break;
+        case Strategy::Sleep:
+            osSleepUntil(deadline_nanos);
+            break;
+        case Strategy::Hybrid:
+        case Strategy::TimerFd:
+            if (deadline_nanos > spin_threshold_nanos_)
+                osSleepUntil(deadline_nanos - spin_threshold_nanos_);
+            spinUntil(deadline_nanos);
+            break;
+        }
+
+        uint64_t now = nanos();
+        recordWait(now > deadline_nanos ? now - deadline_nanos : 0);
+    }
+
+    Stats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+
+        Stats stats;
+        stats.wait_count = wait_count_;
+        stats.late_max_nanos = late_max_nanos_;
+        stats.spin_nanos = spin_nanos_;
+        if (wait_count_ > 0) {
+            stats.late_mean_nanos = late_sum_nanos_ / wait_count_;
+            double variance = late_sum_sq_nanos_ / wait_count_ - stats.late_mean_nanos * stats.late_mean_nanos;
+            stats.late_stddev_nanos = std::sqrt(std::max(variance, 0.0));
+        }
+        return stats;
+    }
+
+    void resetStats()
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        wait_count_ = late_max_nanos_ = spin_nanos_ = 0;
+        late_sum_nanos_ = late_sum_sq_nanos_ = 0;
+    }
+
+    Strategy getStrategy() const
+    {
+        return strategy_;
+    }
+
+    uint64_t getSpinThresholdNanos() const
+    {
+        return spin_threshold_nanos_;
+    }
+
+    static Strategy toStrategy(const std::string& name)
+    {
+        if (name == "Spin")
+            return Strategy::Spin;
+        else if (name == "Sleep")
+            return Strategy::Sleep;
+        else if (name == "Hybrid")
+            return Strategy::Hybrid;
+        else if (name == "TimerFd")
+            return Strategy::TimerFd;
+        else
+            throw std::invalid_argument("Unknown ThreadWaiter strategy: " + name);
+    }
+
+    //config used by waiters created without explicit config, i.e., ScheduledExecutor and ScalableClock
+    static Config& getSetDefaultConfig(const Config* config = nullptr)
+    {
+        static Config default_config;
+        if (config != nullptr)
+            default_config = *config;
+        return default_config;
+    }
+
+private:
+    static uint64_t getPlatformSpinThreshold()
+    {
+#ifdef __linux__
+        //typical wakeup latency of clock_nanosleep on non-RT kernel is well below this
+        return 100000LL;
+#else
+        //other platforms don't have high resolution absolute sleep so keep larger margin
+        return 2000000LL;
+#endif
+    }
+
+    void spinUntil(uint64_t deadline_nanos)
+    {
+        uint64_t start = nanos();
+        uint64_t now = start;
+        while (now < deadline_nanos) {
+            std::this_thread::yield();
+            now = nanos();
+        }
+
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        spin_nanos_ += now - start;
+    }
+
+    void osSleepUntil(uint64_t deadline_nanos)
+    {
+#ifdef __linux__
+        if (strategy_ == Strategy::TimerFd) {
+            itimerspec spec {};
+            spec.it_value = toTimespec(deadline_nanos);
+            if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) == 0) {
+                uint64_t expirations;
+                //read blocks until timer expires, it fails only if interrupted
+                if (read(timer_fd_, &expirations, sizeof(expirations)) == sizeof(expirations))
+                    return;
+            }
+        }
+
+        timespec deadline_spec = toTimespec(deadline_nanos);
+        //restart if interrupted by signal, other errors mean deadline is invalid or already passed
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline_spec, nullptr) == EINTR)
+            ;
+#else
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadline_nanos))));
+#endif
+    }
+
+#ifdef __linux__
+    //std::chrono::steady_clock is CLOCK_MONOTONIC on Linux so deadlines can be passed to OS as is
+    static timespec toTimespec(uint64_t nanos_val)
+    {
+        timespec spec;
+        spec.tv_sec = static_cast<time_t>(nanos_val / 1000000000LL);
+        spec.tv_nsec = static_cast<long>(nanos_val % 1000000000LL);
+        return spec;
+    }
+#endif
+
+    void recordWait(uint64_t late_nanos)
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        ++wait_count_;
+        late_sum_nanos_ += static_cast<double>(late_nanos);
+        late_sum_sq_nanos_ += static_cast<double>(late_nanos) * late_nanos;
+        late_max_nanos_ = std::max(late_max_nanos_, late_nanos);
+    }
+
+private:
+    Strategy strategy_;
+    uint64_t spin_threshold_nanos_;
+#ifdef __linux__
+    int timer_fd_ = -1;
+#endif
+
+    mutable std::mutex stats_mutex_;
+    uint64_t wait_count_ = 0;
+    double late_sum_nanos_ = 0;
+    double late_sum_sq_nanos_ = 0;
+    uint64_t late_max_nanos_ = 0;
+    uint64_t spin_nanos_ = 0;
+};
+
+}
+#endif
@@ -0,0 +1,195 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef commn_utils_WorkStealingPool_hpp
+#define commn_utils_WorkStealingPool_hpp
+
+#include <thread>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstddef>
+#include <cstdint>
+
+namespace common_utils {
+
+/*
+    Fork-join pool for running a batch of independent tasks and waiting for all of them.
+
+    Each call to parallelFor() distributes task indices round-robin over per-worker queues,
+    where slot 0 belongs to the calling thread which also does work instead of just waiting.
+    Worker pops tasks from the front of its own queue and, once it runs out, steals from the back
+    of other queues. When stealing is disabled, task i is always executed by worker (i % worker count)
+    in ascending index order so thread assignment is identical on every call.
+
+    parallelFor() returns only after every task has finished (i.e. it acts as barrier). If any task
+    throws then the first exception is re-thrown on the calling thread after the barrier.
+    Only one batch can be in flight at a time, concurrent callers are serialized.
+*/
+class WorkStealingPool {
+public:
+    //thread_count is number of additional threads, 0 means use all available hardware threads
+    WorkStealingPool(unsigned int thread_count = 0)
+    {
+        if (thread_count == 0) {
+            unsigned int hw_threads = std::thread::hardware_concurrency();
+            thread_count = hw_threads > 1 ? hw_threads - 1 : 1;
+        }
+
+        for (unsigned int i = 0; i <= thread_count; ++i)
+            queues_.emplace_back(new TaskQueue());
+
+        for (unsigned int i = 1; i <= thread_count; ++i)
+            threads_.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            stop_ = true;
+        }
+        work_available_.notify_all();
+
+        for (auto& th : threads_) {
+            if (th.joinable())
+                th.join();
+        }
+    }
+
+    //number of threads that execute tasks including the calling thread
+    unsigned int getWorkerCount() const
+    {
+        return static_cast<unsigned int>(queues_.size());
+    }
+
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& func, bool allow_stealing = true)
+    {
+        if (count == 0)
+            return;
+
+        std::lock_guard<std::mutex> batch_lock(batch_mutex_);
+
+        func_ = &func;
+        allow_stealing_ = allow_stealing;
+        first_error_ = nullptr;
+        pending_ = count;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            TaskQueue& queue = *queues_[i % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(i);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(state_mutex_);
+            ++generation_;
+        }
+        work_available_.notify_all();
+
+        runTasks(0);
+
+        {
+            std::unique_lock<std::mutex> lock(state_mutex_);
+            work_done_.wait(lock, [this]() { return pending_ == 0; });
+        }
+
+        func_ = nullptr;
+        if (first_error_)
+            std::rethrow_exception(first_error_);
+    }
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    void workerLoop(unsigned int worker_index)
+    {
+        uint64_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(state_mutex_);
+                work_available_.wait(lock, [&]() { return stop_ || generation_ != seen_generation; });
+                if (stop_)
+                    return;
+                seen_generation = generation_;
+            }
+
+            runTasks(worker_index);
+        }
+    }
+
+    void runTasks(unsigned int worker_index)
+    {
+        std::size_t task_index;
+        while (popOwn(worker_index, task_index) || (allow_stealing_ && steal(worker_index, task_index))) {
+            try {
+                (*func_)(task_index);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex_);
+                if (!first_error_)
+                    first_error_ = std::current_exception();
+            }
+
+            if (--pending_ == 0) {
+                //take the lock so notification can't slip in between predicate check and wait
+                { std::lock_guard<std::mutex> lock(state_mutex_); }
+                work_done_.notify_all();
+            }
+        }
+    }
+
+    bool popOwn(unsigned int worker_index, std::size_t& task_index)
+    {
+        TaskQueue& queue = *queues_[worker_index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            return false;
+        task_index = queue.tasks.front();
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(unsigned int worker_index, std::size_t& task_index)
+    {
+        for (std::size_t offset = 1; offset < queues_.size(); ++offset) {
+            TaskQueue& queue = *queues_[(worker_index + offset) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                task_index = queue.tasks.back();
+                queue.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex batch_mutex_;
+    std::mutex state_mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable work_done_;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+
+    const std::function<void(std::size_t)>* func_ = nullptr;
+    std::atomic_bool allow_stealing_ { true };
+    std::atomic<std::size_t> pending_ { 0 };
+
+    std::mutex error_mutex_;
+    std::exception_ptr first_error_;
+};
+
+}
+#endif
@@ -42,6 +42,9 @@ public:
     {
         PhysicsBody::updateKinematics(kinematics);
 
+        if (!print_kinematics_)
+            return;
+
         std::cout << " Pos: " << VectorMath::toString(kinematics.pose.position);
         std::cout << " Ori: " << VectorMath::toString(kinematics.pose.orientation) << std::endl;
         std::cout << " Lin Vel: " << VectorMath::toString(kinematics.twist.linear);
@@ -49,6 +52,11 @@ public:
         std::cout << " ------------------------------------------------" << std::endl;
     }
 
+    void setPrintKinematics(bool is_enabled)
+    {
+        print_kinematics_ = is_enabled;
+    }
+
     virtual real_T getRestitution() const override 
     {
         return restitution_;
@@ -144,6 +152,7 @@ private:
     real_T mass_ = 1.0f;
     real_T restitution_ = 0.5f;
     real_T friction_ = 0.7f;
+    bool print_kinematics_ = true;
 
     Matrix3x3r inertia_;
 
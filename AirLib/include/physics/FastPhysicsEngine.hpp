@@ -6,6 +6,7 @@
 
 #include "common/Common.hpp"
 #include "physics/PhysicsEngineBase.hpp"
+#include "physics/PhysicsBodyBatch.hpp"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -18,8 +19,8 @@ namespace msr { namespace airlib {
 
 class FastPhysicsEngine : public PhysicsEngineBase {
 public:
-    FastPhysicsEngine(bool enable_ground_lock = true)
-        : enable_ground_lock_(enable_ground_lock)
+    FastPhysicsEngine(bool enable_ground_lock = true, bool enable_batch_integration = false)
+        : enable_ground_lock_(enable_ground_lock), enable_batch_integration_(enable_batch_integration)
     { 
     }
 
@@ -42,10 +43,25 @@ public:
     {
         PhysicsEngineBase::update();
 
-        for (PhysicsBody* body_ptr : *this) {
-            updatePhysics(*body_ptr);
+        if (enable_batch_integration_)
+            updatePhysicsBatched();
+        else {
+            for (PhysicsBody* body_ptr : *this) {
+                updatePhysics(*body_ptr);
+            }
         }
     }
+
+    //bodies only collide with static environment so each one can be stepped separately
+    virtual bool canUpdateBodiesIndependently() const override
+    {
+        return true;
+    }
+    virtual void updateBody(PhysicsBody* body_ptr) override
+    {
+        updatePhysics(*body_ptr);
+    }
+
     virtual void reportState(StateReporter& reporter) override
     {
         for (PhysicsBody* body_ptr : *this) {
@@ -81,8 +97,7 @@ private:
         //if there is collision, see if we need collision response
         const CollisionInfo collision_info = body.getCollisionInfo();
         CollisionResponse& collision_response = body.getCollisionResponseInfo();
-        //if collision was already responded then do not respond to it until we get updated information
-        if (body.isGrounded() || (collision_info.has_collided && collision_response.collision_time_stamp != collision_info.time_stamp)) {
+        if (needsCollisionResponse(body)) {
             bool is_collision_response = getNextKinematicsOnCollision(dt, collision_info, body, 
                 current, next, next_wrench, enable_ground_lock_);
             updateCollisionResponseInfo(collision_info, next, is_collision_response, collision_response);
@@ -104,6 +119,42 @@ private:
 		
 	}
 
+    //bodies in free flight are integrated together in SoA batch, only bodies that
+    //are grounded or colliding go through per-body path
+    void updatePhysicsBatched()
+    {
+        batch_.clear();
+        for (PhysicsBody* body_ptr : *this) {
+            if (needsCollisionResponse(*body_ptr))
+                updatePhysics(*body_ptr);
+            else
+                batch_.addBody(*body_ptr, clock()->updateSince(body_ptr->last_kinematics_time));
+        }
+
+        batch_.integrate(kDragMinVelocity);
+
+        Kinematics::State next;
+        Wrench next_wrench;
+        for (uint i = 0; i < batch_.size(); ++i) {
+            batch_.getNext(i, next, next_wrench);
+            if (VectorMath::hasNan(next.pose.orientation))
+                Utils::log("orientation had NaN!", Utils::kLogLevelError);
+
+            PhysicsBody& body = batch_.getBody(i);
+            body.setWrench(next_wrench);
+            body.updateKinematics(next);
+        }
+    }
+
+    static bool needsCollisionResponse(const PhysicsBody& body)
+    {
+        const CollisionInfo& collision_info = body.getCollisionInfo();
+        const CollisionResponse& collision_response = body.getCollisionResponseInfo();
+
+        //if collision was already responded then do not respond to it until we get updated information
+        return body.isGrounded() || (collision_info.has_collided && collision_response.collision_time_stamp != collision_info.time_stamp);
+    }
+
     static void updateCollisionResponseInfo(const CollisionInfo& collision_info, const Kinematics::State& next, 
         bool is_collision_response, CollisionResponse& collision_response)
     {
@@ -447,6 +498,8 @@ private:
 
     std::stringstream debug_string_;
     bool enable_ground_lock_;
+    bool enable_batch_integration_;
+    PhysicsBodyBatch batch_;
     TTimePoint last_message_time;
 };
 
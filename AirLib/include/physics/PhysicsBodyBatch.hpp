@@ -0,0 +1,673 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef airsim_core_PhysicsBodyBatch_hpp
+#define airsim_core_PhysicsBodyBatch_hpp
+
+#include "common/Common.hpp"
+#include "common/CommonStructs.hpp"
+#include "common/EarthUtils.hpp"
+#include "PhysicsBody.hpp"
+#include <cmath>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AIRLIB_PHYSICS_BODY_BATCH_SSE2 1
+#define AIRLIB_PHYSICS_BODY_BATCH_HAS_SIMD 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define AIRLIB_PHYSICS_BODY_BATCH_NEON 1
+#define AIRLIB_PHYSICS_BODY_BATCH_HAS_SIMD 1
+#include <arm_neon.h>
+#endif
+
+namespace msr { namespace airlib {
+
+/*
+    Structure-of-arrays copy of state of many physics bodies so FastPhysicsEngine can compute
+    wrench, drag and Verlet integration for all of them in flat loops over contiguous buffers,
+    instead of chasing pointers body by body. The loops do four bodies or vertices at a time with
+    SSE2 on x86 and NEON on ARM64, only sin and cos of rotation angles are computed one by one.
+
+    Only the no-collision part of physics is done here, i.e. bodies must not be grounded and must
+    not have pending collision response. Math is same as FastPhysicsEngine::getNextKinematicsNoCollision
+    but results may differ in last bits because of different order of floating point operations.
+
+    Usage: clear(), addBody() for each body, integrate(), then getNext() for each body.
+    Buffers are only grown, never shrunk, so steady state doesn't allocate.
+*/
+class PhysicsBodyBatch {
+public:
+    void clear()
+    {
+        body_count_ = wrench_vertex_count_ = drag_vertex_count_ = 0;
+    }
+
+    uint size() const
+    {
+        return body_count_;
+    }
+
+    PhysicsBody& getBody(uint index) const
+    {
+        return *bodies_[index];
+    }
+
+    uint addBody(PhysicsBody& body, TTimeDelta dt)
+    {
+        const uint bi = body_count_++;
+        if (bodies_.size() < body_count_)
+            resizeBodies(body_count_);
+
+        const Kinematics::State& current = body.getKinematics();
+        const Environment::State& environment = body.getEnvironment().getState();
+
+        bodies_[bi] = &body;
+        dt_[bi] = static_cast<real_T>(dt);
+        mass_inv_[bi] = body.getMassInv();
+        air_density_[bi] = environment.air_density;
+        gravity_.set(bi, environment.gravity);
+        orientation_.set(bi, current.pose.orientation);
+        position_.set(bi, current.pose.position);
+        linear_vel_.set(bi, current.twist.linear);
+        angular_vel_.set(bi, current.twist.angular);
+        linear_acc_.set(bi, current.accelerations.linear);
+        angular_acc_.set(bi, current.accelerations.angular);
+        inertia_.set(bi, body.getInertia());
+        inertia_inv_.set(bi, body.getInertiaInv());
+
+        wrench_vertex_start_[bi] = wrench_vertex_count_;
+        for (uint i = 0; i < body.wrenchVertexCount(); ++i) {
+            const PhysicsBodyVertex& vertex = body.getWrenchVertex(i);
+            const Wrench vertex_wrench = vertex.getWrench();
+
+            const uint vi = wrench_vertex_count_++;
+            if (wrench_vertex_body_.size() < wrench_vertex_count_)
+                resizeWrenchVertices(wrench_vertex_count_ * 2);
+
+            wrench_vertex_body_[vi] = bi;
+            wrench_vertex_position_.set(vi, vertex.getPosition());
+            wrench_vertex_force_.set(vi, vertex_wrench.force);
+            wrench_vertex_torque_.set(vi, vertex_wrench.torque);
+        }
+        wrench_vertex_end_[bi] = wrench_vertex_count_;
+
+        drag_vertex_start_[bi] = drag_vertex_count_;
+        for (uint i = 0; i < body.dragVertexCount(); ++i) {
+            const PhysicsBodyVertex& vertex = body.getDragVertex(i);
+
+            const uint vi = drag_vertex_count_++;
+            if (drag_vertex_body_.size() < drag_vertex_count_)
+                resizeDragVertices(drag_vertex_count_ * 2);
+
+            drag_vertex_body_[vi] = bi;
+            drag_vertex_position_.set(vi, vertex.getPosition());
+            drag_vertex_normal_.set(vi, vertex.getNormal());
+            drag_vertex_factor_[vi] = vertex.getDragFactor();
+        }
+        drag_vertex_end_[bi] = drag_vertex_count_;
+
+        return bi;
+    }
+
+    void integrate(real_T drag_min_velocity)
+    {
+        computeAverageVelocities();
+        accumulateBodyWrench();
+        accumulateDragWrench(drag_min_velocity);
+        computeAccelerations();
+        computeNextTwistAndPose();
+    }
+
+    void getNext(uint index, Kinematics::State& next, Wrench& next_wrench) const
+    {
+        next.pose.position = next_position_.get(index);
+        next.pose.orientation = next_orientation_.get(index);
+        next.twist.linear = next_linear_vel_.get(index);
+        next.twist.angular = next_angular_vel_.get(index);
+        next.accelerations.linear = next_linear_acc_.get(index);
+        next.accelerations.angular = next_angular_acc_.get(index);
+
+        next_wrench.force = force_.get(index);
+        next_wrench.torque = torque_.get(index);
+    }
+
+private:
+    struct Vec3Array {
+        vector<real_T> x, y, z;
+
+        void resize(size_t n)
+        {
+            x.resize(n); y.resize(n); z.resize(n);
+        }
+        void set(uint i, const Vector3r& v)
+        {
+            x[i] = v.x(); y[i] = v.y(); z[i] = v.z();
+        }
+        Vector3r get(uint i) const
+        {
+            return Vector3r(x[i], y[i], z[i]);
+        }
+    };
+
+    struct QuatArray {
+        vector<real_T> w, x, y, z;
+
+        void resize(size_t n)
+        {
+            w.resize(n); x.resize(n); y.resize(n); z.resize(n);
+        }
+        void set(uint i, const Quaternionr& q)
+        {
+            w[i] = q.w(); x[i] = q.x(); y[i] = q.y(); z[i] = q.z();
+        }
+        Quaternionr get(uint i) const
+        {
+            return Quaternionr(w[i], x[i], y[i], z[i]);
+        }
+    };
+
+    struct Mat3Array {
+        vector<real_T> m[3][3];
+
+        void resize(size_t n)
+        {
+            for (auto& row : m)
+                for (auto& col : row)
+                    col.resize(n);
+        }
+        void set(uint i, const Matrix3x3r& mat)
+        {
+            for (uint r = 0; r < 3; ++r)
+                for (uint c = 0; c < 3; ++c)
+                    m[r][c][i] = mat(r, c);
+        }
+    };
+
+    void resizeBodies(size_t n)
+    {
+        bodies_.resize(n);
+        dt_.resize(n); mass_inv_.resize(n); air_density_.resize(n);
+        gravity_.resize(n); orientation_.resize(n); position_.resize(n);
+        linear_vel_.resize(n); angular_vel_.resize(n); linear_acc_.resize(n); angular_acc_.resize(n);
+        inertia_.resize(n); inertia_inv_.resize(n);
+        wrench_vertex_start_.resize(n); wrench_vertex_end_.resize(n);
+        drag_vertex_start_.resize(n); drag_vertex_end_.resize(n);
+
+        avg_linear_.resize(n); avg_angular_.resize(n); avg_linear_body_.resize(n);
+        force_body_.resize(n); force_.resize(n); torque_.resize(n);
+        next_orientation_.resize(n); next_position_.resize(n);
+        next_linear_vel_.resize(n); next_angular_vel_.resize(n);
+        next_linear_acc_.resize(n); next_angular_acc_.resize(n);
+        rotation_w_.resize(n); rotation_s_.resize(n);
+    }
+
+    void resizeWrenchVertices(size_t n)
+    {
+        wrench_vertex_body_.resize(n);
+        wrench_vertex_position_.resize(n); wrench_vertex_force_.resize(n); wrench_vertex_torque_.resize(n);
+    }
+
+    void resizeDragVertices(size_t n)
+    {
+        drag_vertex_body_.resize(n);
+        drag_vertex_position_.resize(n); drag_vertex_normal_.resize(n); drag_vertex_factor_.resize(n);
+        drag_vertex_force_.resize(n); drag_vertex_torque_.resize(n);
+        drag_vertex_vel_.resize(n); drag_vertex_angular_.resize(n); drag_vertex_density_.resize(n);
+    }
+
+    //every per body and per vertex loop is a template over the lane type, run on four lanes at a time with
+    //SIMD as far as whole steps go and on single lanes for the rest, both with the same operations in the same order
+    void computeAverageVelocities()
+    {
+        uint i = 0;
+#ifdef AIRLIB_PHYSICS_BODY_BATCH_HAS_SIMD
+        i = averageVelocities<SimdLanes>(i);
+#endif
+        averageVelocities<ScalarLanes>(i);
+    }
+
+    void accumulateBodyWrench()
+    {
+        //torque due to force applied farther than COG, tau = r X F
+        uint i = 0;
+#ifdef AIRLIB_PHYSICS_BODY_BATCH_HAS_SIMD
+        i = bodyTorques<SimdLanes>(i);
+#endif
+        bodyTorques<ScalarLanes>(i);
+
+        const real_T* fx = wrench_vertex_force_.x.data(); const real_T* fy = wrench_vertex_force_.y.data(); const real_T* fz = wrench_vertex_force_.z.data();
+        const real_T* tx = wrench_vertex_torque_.x.data(); const real_T* ty = wrench_vertex_torque_.y.data(); const real_T* tz = wrench_vertex_torque_.z.data();
+        for (uint bi = 0; bi < body_count_; ++bi) {
+            real_T sfx = 0, sfy = 0, sfz = 0, stx = 0, sty = 0, stz = 0;
+            for (uint vi = wrench_vertex_start_[bi]; vi < wrench_vertex_end_[bi]; ++vi) {
+                sfx += fx[vi]; sfy += fy[vi]; sfz += fz[vi];
+                stx += tx[vi]; sty += ty[vi]; stz += tz[vi];
+            }
+            force_body_.x[bi] = sfx; force_body_.y[bi] = sfy; force_body_.z[bi] = sfz;
+            torque_.x[bi] = stx; torque_.y[bi] = sty; torque_.z[bi] = stz;
+        }
+    }
+
+    void accumulateDragWrench(real_T drag_min_velocity)
+    {
+        const uint vn = drag_vertex_count_;
+
+        //gather per-body values next to each vertex so main loop has only contiguous accesses
+        for (uint vi = 0; vi < vn; ++vi) {
+            const uint bi = drag_vertex_body_[vi];
+            drag_vertex_vel_.x[vi] = avg_linear_body_.x[bi]; drag_vertex_vel_.y[vi] = avg_linear_body_.y[bi]; drag_vertex_vel_.z[vi] = avg_linear_body_.z[bi];
+            drag_vertex_angular_.x[vi] = avg_angular_.x[bi]; drag_vertex_angular_.y[vi] = avg_angular_.y[bi]; drag_vertex_angular_.z[vi] = avg_angular_.z[bi];
+            drag_vertex_density_[vi] = air_density_[bi];
+        }
+
+        uint i = 0;
+#ifdef AIRLIB_PHYSICS_BODY_BATCH_HAS_SIMD
+        i = dragForces<SimdLanes>(i, drag_min_velocity);
+#endif
+        dragForces<ScalarLanes>(i, drag_min_velocity);
+
+        const real_T* fx = drag_vertex_force_.x.data(); const real_T* fy = drag_vertex_force_.y.data(); const real_T* fz = drag_vertex_force_.z.data();
+        const real_T* tx = drag_vertex_torque_.x.data(); const real_T* ty = drag_vertex_torque_.y.data(); const real_T* tz = drag_vertex_torque_.z.data();
+        for (uint bi = 0; bi < body_count_; ++bi) {
+            real_T sfx = 0, sfy = 0, sfz = 0, stx = 0, sty = 0, stz = 0;
+            for (uint vi = drag_vertex_start_[bi]; vi < drag_vertex_end_[bi]; ++vi) {
+                sfx += fx[vi]; sfy += fy[vi]; sfz += fz[vi];
+                stx += tx[vi]; sty += ty[vi]; stz += tz[vi];
+            }
+            force_body_.x[bi] += sfx; force_body_.y[bi] += sfy; force_body_.z[bi] += sfz;
+            torque_.x[bi] += stx; torque_.y[bi] += sty; torque_.z[bi] += stz;
+        }
+    }
+
+    void computeAccelerations()
+    {
+        uint i = 0;
+#ifdef AIRLIB_PHYSICS_BODY_BATCH_HAS_SIMD
+        i = accelerations<SimdLanes>(i);
+#endif
+        accelerations<ScalarLanes>(i);
+    }
+
+    void computeNextTwistAndPose()
+    {
+        uint i = 0;
+#ifdef AIRLIB_PHYSICS_BODY_BATCH_HAS_SIMD
+        i = nextTwistAndPosition<SimdLanes>(i);
+#endif
+        nextTwistAndPosition<ScalarLanes>(i);
+
+        //sin and cos have no SIMD version, half of rotation quaternion for angular displacement in last dt
+        //seconds is computed body by body
+        const real_T* avg_ax = avg_angular_.x.data(); const real_T* avg_ay = avg_angular_.y.data(); const real_T* avg_az = avg_angular_.z.data();
+        const real_T* dt = dt_.data();
+        real_T* rotation_w = rotation_w_.data(); real_T* rotation_s = rotation_s_.data();
+        for (uint bi = 0; bi < body_count_; ++bi) {
+            const real_T angle_per_unit = std::sqrt(avg_ax[bi] * avg_ax[bi] + avg_ay[bi] * avg_ay[bi] + avg_az[bi] * avg_az[bi]);
+            const real_T half_angle = 0.5f * angle_per_unit * dt[bi];
+            rotation_s[bi] = angle_per_unit > 0 ? std::sin(half_angle) / angle_per_unit : 0.0f;
+            rotation_w[bi] = angle_per_unit > 0 ? std::cos(half_angle) : 1.0f;
+        }
+
+        i = 0;
+#ifdef AIRLIB_PHYSICS_BODY_BATCH_HAS_SIMD
+        i = nextOrientation<SimdLanes>(i);
+#endif
+        nextOrientation<ScalarLanes>(i);
+    }
+
+    //kernels below process lanes from first on in steps of L::width while whole steps fit and return the first
+    //lane left
+
+    template<typename L>
+    uint averageVelocities(uint first)
+    {
+        typedef typename L::Value V;
+        const uint n = body_count_;
+        real_T* avg_lx = avg_linear_.x.data(); real_T* avg_ly = avg_linear_.y.data(); real_T* avg_lz = avg_linear_.z.data();
+        real_T* avg_ax = avg_angular_.x.data(); real_T* avg_ay = avg_angular_.y.data(); real_T* avg_az = avg_angular_.z.data();
+        real_T* blx = avg_linear_body_.x.data(); real_T* bly = avg_linear_body_.y.data(); real_T* blz = avg_linear_body_.z.data();
+        const real_T* dt = dt_.data();
+        const real_T* qw = orientation_.w.data(); const real_T* qx = orientation_.x.data();
+        const real_T* qy = orientation_.y.data(); const real_T* qz = orientation_.z.data();
+        const real_T* vx = linear_vel_.x.data(); const real_T* vy = linear_vel_.y.data(); const real_T* vz = linear_vel_.z.data();
+        const real_T* wx = angular_vel_.x.data(); const real_T* wy = angular_vel_.y.data(); const real_T* wz = angular_vel_.z.data();
+        const real_T* ax = linear_acc_.x.data(); const real_T* ay = linear_acc_.y.data(); const real_T* az = linear_acc_.z.data();
+        const real_T* alx = angular_acc_.x.data(); const real_T* aly = angular_acc_.y.data(); const real_T* alz = angular_acc_.z.data();
+        const V half = L::set(0.5f);
+
+        uint i = first;
+        for (; i + L::width <= n; i += L::width) {
+            const V half_dt = half * L::load(dt + i);
+            const V lx = L::load(vx + i) + L::load(ax + i) * half_dt;
+            const V ly = L::load(vy + i) + L::load(ay + i) * half_dt;
+            const V lz = L::load(vz + i) + L::load(az + i) * half_dt;
+            L::store(avg_lx + i, lx); L::store(avg_ly + i, ly); L::store(avg_lz + i, lz);
+            L::store(avg_ax + i, L::load(wx + i) + L::load(alx + i) * half_dt);
+            L::store(avg_ay + i, L::load(wy + i) + L::load(aly + i) * half_dt);
+            L::store(avg_az + i, L::load(wz + i) + L::load(alz + i) * half_dt);
+
+            //linear velocity in body frame: rotate by conjugate of orientation
+            V bx, by, bz;
+            rotate(L::load(qw + i), -L::load(qx + i), -L::load(qy + i), -L::load(qz + i), lx, ly, lz, bx, by, bz);
+            L::store(blx + i, bx); L::store(bly + i, by); L::store(blz + i, bz);
+        }
+        return i;
+    }
+
+    template<typename L>
+    uint bodyTorques(uint first)
+    {
+        typedef typename L::Value V;
+        const uint vn = wrench_vertex_count_;
+        const real_T* px = wrench_vertex_position_.x.data(); const real_T* py = wrench_vertex_position_.y.data(); const real_T* pz = wrench_vertex_position_.z.data();
+        const real_T* fx = wrench_vertex_force_.x.data(); const real_T* fy = wrench_vertex_force_.y.data(); const real_T* fz = wrench_vertex_force_.z.data();
+        real_T* tx = wrench_vertex_torque_.x.data(); real_T* ty = wrench_vertex_torque_.y.data(); real_T* tz = wrench_vertex_torque_.z.data();
+
+        uint i = first;
+        for (; i + L::width <= vn; i += L::width) {
+            const V rx = L::load(px + i), ry = L::load(py + i), rz = L::load(pz + i);
+            const V f_x = L::load(fx + i), f_y = L::load(fy + i), f_z = L::load(fz + i);
+            L::store(tx + i, L::load(tx + i) + (ry * f_z - rz * f_y));
+            L::store(ty + i, L::load(ty + i) + (rz * f_x - rx * f_z));
+            L::store(tz + i, L::load(tz + i) + (rx * f_y - ry * f_x));
+        }
+        return i;
+    }
+
+    template<typename L>
+    uint dragForces(uint first, real_T drag_min_velocity)
+    {
+        typedef typename L::Value V;
+        const uint vn = drag_vertex_count_;
+        const real_T* px = drag_vertex_position_.x.data(); const real_T* py = drag_vertex_position_.y.data(); const real_T* pz = drag_vertex_position_.z.data();
+        const real_T* nx = drag_vertex_normal_.x.data(); const real_T* ny = drag_vertex_normal_.y.data(); const real_T* nz = drag_vertex_normal_.z.data();
+        const real_T* factor = drag_vertex_factor_.data();
+        const real_T* density = drag_vertex_density_.data();
+        const real_T* vx = drag_vertex_vel_.x.data(); const real_T* vy = drag_vertex_vel_.y.data(); const real_T* vz = drag_vertex_vel_.z.data();
+        const real_T* wx = drag_vertex_angular_.x.data(); const real_T* wy = drag_vertex_angular_.y.data(); const real_T* wz = drag_vertex_angular_.z.data();
+        real_T* fx = drag_vertex_force_.x.data(); real_T* fy = drag_vertex_force_.y.data(); real_T* fz = drag_vertex_force_.z.data();
+        real_T* tx = drag_vertex_torque_.x.data(); real_T* ty = drag_vertex_torque_.y.data(); real_T* tz = drag_vertex_torque_.z.data();
+        const V min_velocity = L::set(drag_min_velocity), zero = L::set(0);
+
+        uint i = first;
+        for (; i + L::width <= vn; i += L::width) {
+            const V rx = L::load(px + i), ry = L::load(py + i), rz = L::load(pz + i);
+            const V n_x = L::load(nx + i), n_y = L::load(ny + i), n_z = L::load(nz + i);
+            const V w_x = L::load(wx + i), w_y = L::load(wy + i), w_z = L::load(wz + i);
+
+            //velocity of vertex in body frame is v + omega X r
+            const V vel_x = L::load(vx + i) + (w_y * rz - w_z * ry);
+            const V vel_y = L::load(vy + i) + (w_z * rx - w_x * rz);
+            const V vel_z = L::load(vz + i) + (w_x * ry - w_y * rx);
+            const V vel_comp = n_x * vel_x + n_y * vel_y + n_z * vel_z;
+
+            //if vel_comp is -ve then we cull the face. If velocity too low then drag is not generated
+            const V mag = L::select(L::greater(vel_comp, min_velocity),
+                -L::load(factor + i) * L::load(density + i) * vel_comp * vel_comp, zero);
+            const V f_x = n_x * mag, f_y = n_y * mag, f_z = n_z * mag;
+            L::store(fx + i, f_x); L::store(fy + i, f_y); L::store(fz + i, f_z);
+            L::store(tx + i, ry * f_z - rz * f_y);
+            L::store(ty + i, rz * f_x - rx * f_z);
+            L::store(tz + i, rx * f_y - ry * f_x);
+        }
+        return i;
+    }
+
+    template<typename L>
+    uint accelerations(uint first)
+    {
+        typedef typename L::Value V;
+        const uint n = body_count_;
+        const real_T* qw = orientation_.w.data(); const real_T* qx = orientation_.x.data();
+        const real_T* qy = orientation_.y.data(); const real_T* qz = orientation_.z.data();
+        const real_T* fbx = force_body_.x.data(); const real_T* fby = force_body_.y.data(); const real_T* fbz = force_body_.z.data();
+        real_T* fx = force_.x.data(); real_T* fy = force_.y.data(); real_T* fz = force_.z.data();
+        const real_T* tx = torque_.x.data(); const real_T* ty = torque_.y.data(); const real_T* tz = torque_.z.data();
+        const real_T* mass_inv = mass_inv_.data();
+        const real_T* gx = gravity_.x.data(); const real_T* gy = gravity_.y.data(); const real_T* gz = gravity_.z.data();
+        const real_T* wx = avg_angular_.x.data(); const real_T* wy = avg_angular_.y.data(); const real_T* wz = avg_angular_.z.data();
+        real_T* ax = next_linear_acc_.x.data(); real_T* ay = next_linear_acc_.y.data(); real_T* az = next_linear_acc_.z.data();
+        real_T* alx = next_angular_acc_.x.data(); real_T* aly = next_angular_acc_.y.data(); real_T* alz = next_angular_acc_.z.data();
+        const real_T* in[3][3];
+        const real_T* in_inv[3][3];
+        for (uint r = 0; r < 3; ++r) {
+            for (uint c = 0; c < 3; ++c) {
+                in[r][c] = inertia_.m[r][c].data();
+                in_inv[r][c] = inertia_inv_.m[r][c].data();
+            }
+        }
+
+        uint i = first;
+        for (; i + L::width <= n; i += L::width) {
+            //force is computed in body frame, convert it to world frame, leave torque in body frame
+            V f_x, f_y, f_z;
+            rotate(L::load(qw + i), L::load(qx + i), L::load(qy + i), L::load(qz + i),
+                L::load(fbx + i), L::load(fby + i), L::load(fbz + i), f_x, f_y, f_z);
+            L::store(fx + i, f_x); L::store(fy + i, f_y); L::store(fz + i, f_z);
+
+            const V m_inv = L::load(mass_inv + i);
+            L::store(ax + i, f_x * m_inv + L::load(gx + i));
+            L::store(ay + i, f_y * m_inv + L::load(gy + i));
+            L::store(az + i, f_z * m_inv + L::load(gz + i));
+
+            //Euler's rotation equation, angular momentum L = I * omega
+            const V w_x = L::load(wx + i), w_y = L::load(wy + i), w_z = L::load(wz + i);
+            const V lx = L::load(in[0][0] + i) * w_x + L::load(in[0][1] + i) * w_y + L::load(in[0][2] + i) * w_z;
+            const V ly = L::load(in[1][0] + i) * w_x + L::load(in[1][1] + i) * w_y + L::load(in[1][2] + i) * w_z;
+            const V lz = L::load(in[2][0] + i) * w_x + L::load(in[2][1] + i) * w_y + L::load(in[2][2] + i) * w_z;
+            const V rx = L::load(tx + i) - (w_y * lz - w_z * ly);
+            const V ry = L::load(ty + i) - (w_z * lx - w_x * lz);
+            const V rz = L::load(tz + i) - (w_x * ly - w_y * lx);
+            L::store(alx + i, L::load(in_inv[0][0] + i) * rx + L::load(in_inv[0][1] + i) * ry + L::load(in_inv[0][2] + i) * rz);
+            L::store(aly + i, L::load(in_inv[1][0] + i) * rx + L::load(in_inv[1][1] + i) * ry + L::load(in_inv[1][2] + i) * rz);
+            L::store(alz + i, L::load(in_inv[2][0] + i) * rx + L::load(in_inv[2][1] + i) * ry + L::load(in_inv[2][2] + i) * rz);
+        }
+        return i;
+    }
+
+    template<typename L>
+    uint nextTwistAndPosition(uint first)
+    {
+        typedef typename L::Value V;
+        typedef typename L::Mask M;
+        const uint n = body_count_;
+        const real_T* dt = dt_.data();
+        const real_T* vx = linear_vel_.x.data(); const real_T* vy = linear_vel_.y.data(); const real_T* vz = linear_vel_.z.data();
+        const real_T* wx = angular_vel_.x.data(); const real_T* wy = angular_vel_.y.data(); const real_T* wz = angular_vel_.z.data();
+        const real_T* ax = linear_acc_.x.data(); const real_T* ay = linear_acc_.y.data(); const real_T* az = linear_acc_.z.data();
+        const real_T* alx = angular_acc_.x.data(); const real_T* aly = angular_acc_.y.data(); const real_T* alz = angular_acc_.z.data();
+        real_T* nax = next_linear_acc_.x.data(); real_T* nay = next_linear_acc_.y.data(); real_T* naz = next_linear_acc_.z.data();
+        real_T* nalx = next_angular_acc_.x.data(); real_T* naly = next_angular_acc_.y.data(); real_T* nalz = next_angular_acc_.z.data();
+        real_T* nvx = next_linear_vel_.x.data(); real_T* nvy = next_linear_vel_.y.data(); real_T* nvz = next_linear_vel_.z.data();
+        real_T* nwx = next_angular_vel_.x.data(); real_T* nwy = next_angular_vel_.y.data(); real_T* nwz = next_angular_vel_.z.data();
+        const real_T* avg_lx = avg_linear_.x.data(); const real_T* avg_ly = avg_linear_.y.data(); const real_T* avg_lz = avg_linear_.z.data();
+        const real_T* px = position_.x.data(); const real_T* py = position_.y.data(); const real_T* pz = position_.z.data();
+        real_T* npx = next_position_.x.data(); real_T* npy = next_position_.y.data(); real_T* npz = next_position_.z.data();
+        const V max_speed_sq = L::set(static_cast<real_T>(EarthUtils::SpeedOfLight * EarthUtils::SpeedOfLight));
+        const V max_speed = L::set(static_cast<real_T>(EarthUtils::SpeedOfLight));
+        const V half = L::set(0.5f), one = L::set(1), zero = L::set(0);
+
+        //Verlet integration: http://www.physics.udel.edu/~bnikolic/teaching/phys660/numerical_ode/node5.html
+        uint i = first;
+        for (; i + L::width <= n; i += L::width) {
+            const V step = L::load(dt + i);
+            const V half_dt = half * step;
+            const V next_ax = L::load(nax + i), next_ay = L::load(nay + i), next_az = L::load(naz + i);
+            const V next_alx = L::load(nalx + i), next_aly = L::load(naly + i), next_alz = L::load(nalz + i);
+            const V lin_x = L::load(vx + i) + (L::load(ax + i) + next_ax) * half_dt;
+            const V lin_y = L::load(vy + i) + (L::load(ay + i) + next_ay) * half_dt;
+            const V lin_z = L::load(vz + i) + (L::load(az + i) + next_az) * half_dt;
+            const V ang_x = L::load(wx + i) + (L::load(alx + i) + next_alx) * half_dt;
+            const V ang_y = L::load(wy + i) + (L::load(aly + i) + next_aly) * half_dt;
+            const V ang_z = L::load(wz + i) + (L::load(alz + i) + next_alz) * half_dt;
+
+            //if controller has bug, velocities can increase idenfinitely
+            //so we need to clip this or everything will turn in to infinity/nans
+            const V lin_sq = lin_x * lin_x + lin_y * lin_y + lin_z * lin_z;
+            const M lin_clip = L::greater(lin_sq, max_speed_sq);
+            const V lin_scale = L::select(lin_clip, max_speed / L::sqrt(lin_sq), one);
+            L::store(nvx + i, lin_x * lin_scale); L::store(nvy + i, lin_y * lin_scale); L::store(nvz + i, lin_z * lin_scale);
+            L::store(nax + i, L::select(lin_clip, zero, next_ax));
+            L::store(nay + i, L::select(lin_clip, zero, next_ay));
+            L::store(naz + i, L::select(lin_clip, zero, next_az));
+
+            const V ang_sq = ang_x * ang_x + ang_y * ang_y + ang_z * ang_z;
+            const M ang_clip = L::greater(ang_sq, max_speed_sq);
+            const V ang_scale = L::select(ang_clip, max_speed / L::sqrt(ang_sq), one);
+            L::store(nwx + i, ang_x * ang_scale); L::store(nwy + i, ang_y * ang_scale); L::store(nwz + i, ang_z * ang_scale);
+            L::store(nalx + i, L::select(ang_clip, zero, next_alx));
+            L::store(naly + i, L::select(ang_clip, zero, next_aly));
+            L::store(nalz + i, L::select(ang_clip, zero, next_alz));
+
+            L::store(npx + i, L::load(px + i) + L::load(avg_lx + i) * step);
+            L::store(npy + i, L::load(py + i) + L::load(avg_ly + i) * step);
+            L::store(npz + i, L::load(pz + i) + L::load(avg_lz + i) * step);
+        }
+        return i;
+    }
+
+    //new attitude is q0 * q1 where q1 is rotation by angular displacement from computeNextTwistAndPose
+    template<typename L>
+    uint nextOrientation(uint first)
+    {
+        typedef typename L::Value V;
+        typedef typename L::Mask M;
+        const uint n = body_count_;
+        const real_T* avg_ax = avg_angular_.x.data(); const real_T* avg_ay = avg_angular_.y.data(); const real_T* avg_az = avg_angular_.z.data();
+        const real_T* rotation_w = rotation_w_.data(); const real_T* rotation_s = rotation_s_.data();
+        const real_T* qw = orientation_.w.data(); const real_T* qx = orientation_.x.data();
+        const real_T* qy = orientation_.y.data(); const real_T* qz = orientation_.z.data();
+        real_T* nqw = next_orientation_.w.data(); real_T* nqx = next_orientation_.x.data();
+        real_T* nqy = next_orientation_.y.data(); real_T* nqz = next_orientation_.z.data();
+        const V zero = L::set(0), one = L::set(1);
+
+        uint i = first;
+        for (; i + L::width <= n; i += L::width) {
+            const V avg_x = L::load(avg_ax + i), avg_y = L::load(avg_ay + i), avg_z = L::load(avg_az + i);
+            const M has_rotation = L::greater(avg_x * avg_x + avg_y * avg_y + avg_z * avg_z, zero);
+            const V s = L::load(rotation_s + i), dw = L::load(rotation_w + i);
+            const V dx = avg_x * s, dy = avg_y * s, dz = avg_z * s;
+            const V q_w = L::load(qw + i), q_x = L::load(qx + i), q_y = L::load(qy + i), q_z = L::load(qz + i);
+
+            const V rw = q_w * dw - q_x * dx - q_y * dy - q_z * dz;
+            const V rx = q_w * dx + dw * q_x + (q_y * dz - q_z * dy);
+            const V ry = q_w * dy + dw * q_y + (q_z * dx - q_x * dz);
+            const V rz = q_w * dz + dw * q_z + (q_x * dy - q_y * dx);
+
+            //re-normalize quaternion to avoid accumulating error
+            const V norm = L::sqrt(rw * rw + rx * rx + ry * ry + rz * rz);
+            const V norm_inv = L::select(L::maskAnd(has_rotation, L::greater(norm, zero)), one / norm, one);
+            L::store(nqw + i, L::select(has_rotation, rw * norm_inv, q_w));
+            L::store(nqx + i, L::select(has_rotation, rx * norm_inv, q_x));
+            L::store(nqy + i, L::select(has_rotation, ry * norm_inv, q_y));
+            L::store(nqz + i, L::select(has_rotation, rz * norm_inv, q_z));
+        }
+        return i;
+    }
+
+    //rotates v by unit quaternion (w, x, y, z): t = 2 q.vec X v, v' = v + w t + q.vec X t
+    template<typename V>
+    static void rotate(V w, V x, V y, V z, V vx, V vy, V vz, V& ox, V& oy, V& oz)
+    {
+        const V cx = y * vz - z * vy, cy = z * vx - x * vz, cz = x * vy - y * vx;
+        const V tx = cx + cx, ty = cy + cy, tz = cz + cz;
+        ox = vx + w * tx + (y * tz - z * ty);
+        oy = vy + w * ty + (z * tx - x * tz);
+        oz = vz + w * tz + (x * ty - y * tx);
+    }
+
+    //one lane, arithmetic with the usual operators
+    struct ScalarLanes {
+        typedef real_T Value;
+        typedef bool Mask;
+        static constexpr uint width = 1;
+
+        static Value load(const real_T* p) { return *p; }
+        static void store(real_T* p, Value v) { *p = v; }
+        static Value set(real_T x) { return x; }
+        static Value sqrt(Value x) { return std::sqrt(x); }
+        static Mask greater(Value a, Value b) { return a > b; }
+        static Mask maskAnd(Mask a, Mask b) { return a && b; }
+        static Value select(Mask m, Value a, Value b) { return m ? a : b; }
+    };
+
+#ifdef AIRLIB_PHYSICS_BODY_BATCH_HAS_SIMD
+    //four lanes in a SIMD register with the same operators so kernels read the same for both lane types
+    struct Float4 {
+#if defined(AIRLIB_PHYSICS_BODY_BATCH_SSE2)
+        __m128 v;
+
+        friend Float4 operator+(Float4 a, Float4 b) { return Float4{ _mm_add_ps(a.v, b.v) }; }
+        friend Float4 operator-(Float4 a, Float4 b) { return Float4{ _mm_sub_ps(a.v, b.v) }; }
+        friend Float4 operator*(Float4 a, Float4 b) { return Float4{ _mm_mul_ps(a.v, b.v) }; }
+        friend Float4 operator/(Float4 a, Float4 b) { return Float4{ _mm_div_ps(a.v, b.v) }; }
+        friend Float4 operator-(Float4 a) { return Float4{ _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) }; }
+#else
+        float32x4_t v;
+
+        friend Float4 operator+(Float4 a, Float4 b) { return Float4{ vaddq_f32(a.v, b.v) }; }
+        friend Float4 operator-(Float4 a, Float4 b) { return Float4{ vsubq_f32(a.v, b.v) }; }
+        friend Float4 operator*(Float4 a, Float4 b) { return Float4{ vmulq_f32(a.v, b.v) }; }
+        friend Float4 operator/(Float4 a, Float4 b) { return Float4{ vdivq_f32(a.v, b.v) }; }
+        friend Float4 operator-(Float4 a) { return Float4{ vnegq_f32(a.v) }; }
+#endif
+    };
+
+    struct SimdLanes {
+        typedef Float4 Value;
+        static constexpr uint width = 4;
+
+#if defined(AIRLIB_PHYSICS_BODY_BATCH_SSE2)
+        typedef __m128 Mask;
+
+        static Value load(const real_T* p) { return Value{ _mm_loadu_ps(p) }; }
+        static void store(real_T* p, Value v) { _mm_storeu_ps(p, v.v); }
+        static Value set(real_T x) { return Value{ _mm_set1_ps(x) }; }
+        static Value sqrt(Value x) { return Value{ _mm_sqrt_ps(x.v) }; }
+        static Mask greater(Value a, Value b) { return _mm_cmpgt_ps(a.v, b.v); }
+        static Mask maskAnd(Mask a, Mask b) { return _mm_and_ps(a, b); }
+        static Value select(Mask m, Value a, Value b) { return Value{ _mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v)) }; }
+#else
+        typedef uint32x4_t Mask;
+
+        static Value load(const real_T* p) { return Value{ vld1q_f32(p) }; }
+        static void store(real_T* p, Value v) { vst1q_f32(p, v.v); }
+        static Value set(real_T x) { return Value{ vdupq_n_f32(x) }; }
+        static Value sqrt(Value x) { return Value{ vsqrtq_f32(x.v) }; }
+        static Mask greater(Value a, Value b) { return vcgtq_f32(a.v, b.v); }
+        static Mask maskAnd(Mask a, Mask b) { return vandq_u32(a, b); }
+        static Value select(Mask m, Value a, Value b) { return Value{ vbslq_f32(m, a.v, b.v) }; }
+#endif
+    };
+#endif
+
+private:
+    uint body_count_ = 0;
+    uint wrench_vertex_count_ = 0;
+    uint drag_vertex_count_ = 0;
+
+    //per body inputs
+    vector<PhysicsBody*> bodies_;
+    vector<real_T> dt_, mass_inv_, air_density_;
+    Vec3Array gravity_, position_, linear_vel_, angular_vel_, linear_acc_, angular_acc_;
+    QuatArray orientation_;
+    Mat3Array inertia_, inertia_inv_;
+    vector<uint> wrench_vertex_start_, wrench_vertex_end_, drag_vertex_start_, drag_vertex_end_;
+
+    //per body intermediates and outputs
+    Vec3Array avg_linear_, avg_angular_, avg_linear_body_;
+    Vec3Array force_body_, force_, torque_;
+    QuatArray next_orientation_;
+    Vec3Array next_position_, next_linear_vel_, next_angular_vel_, next_linear_acc_, next_angular_acc_;
+    vector<real_T> rotation_w_, rotation_s_;
+
+    //per vertex
+    vector<uint> wrench_vertex_body_;
+    Vec3Array wrench_vertex_position_, wrench_vertex_force_, wrench_vertex_torque_;
+    vector<uint> drag_vertex_body_;
+    Vec3Array drag_vertex_position_, drag_vertex_normal_, drag_vertex_force_, drag_vertex_torque_;
+    Vec3Array drag_vertex_vel_, drag_vertex_angular_;
+    vector<real_T> drag_vertex_factor_, drag_vertex_density_;
+};
+
+}} //namespace
+#endif
@@ -23,6 +23,18 @@ public:
         //default nothing to report for physics engine
     }
 
+    //engines in which bodies don't interact with each other can step each body on its own,
+    //this allows World to update different bodies on different threads
+    virtual bool canUpdateBodiesIndependently() const
+    {
+        return false;
+    }
+    virtual void updateBody(PhysicsBody* body_ptr)
+    {
+        unused(body_ptr);
+        throw std::logic_error("This physics engine does not support updating bodies independently");
+    }
+
     //TODO: reduce copy-past from UpdatableContainer which has same code
     /********************** Container interface **********************/
     typedef PhysicsBody* TUpdatableObjectPtr;
@@ -91,6 +91,23 @@ public:
         world_.continueForTime(seconds);
     }
 
+    void enableParallelUpdate(unsigned int thread_count = 0, bool deterministic = false)
+    {
+        lock();
+        world_.enableParallelUpdate(thread_count, deterministic);
+        unlock();
+    }
+
+    common_utils::ThreadWaiter::Stats getWaitStats() const
+    {
+        return world_.getWaitStats();
+    }
+
+    common_utils::ScheduledExecutor::Stats getExecutorStats() const
+    {
+        return world_.getExecutorStats();
+    }
+
 private:
     void initializeWorld(const std::vector<UpdatableObject*>& bodies, bool start_async_updator)
     {
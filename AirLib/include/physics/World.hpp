@@ -10,6 +10,7 @@
 #include "PhysicsEngineBase.hpp"
 #include "PhysicsBody.hpp"
 #include "common/common_utils/ScheduledExecutor.hpp"
+#include "common/common_utils/WorkStealingPool.hpp"
 #include "common/ClockFactory.hpp"
 
 namespace msr { namespace airlib {
@@ -39,17 +40,37 @@ public:
     {
         ClockFactory::get()->step();
 
-        //first update our objects
-        UpdatableContainer::update();
+        if (update_pool_) {
+            updateParallel();
+        }
+        else {
+            //first update our objects
+            UpdatableContainer::update();
 
-        //now update kinematics state
-        if (physics_engine_)
-            physics_engine_->update();
+            //now update kinematics state
+            if (physics_engine_)
+                physics_engine_->update();
+        }
     }
 
     virtual void reportState(StateReporter& reporter) override
     {
         reporter.writeValue("Sleep", 1.0f / executor_.getSleepTimeAvg());
+        //how late physics thread wakes up compared to its deadline
+        common_utils::ThreadWaiter::Stats wait_stats = executor_.getWaitStats();
+        reporter.writeValue("Wake Late Avg (us)", wait_stats.late_mean_nanos / 1E3);
+        reporter.writeValue("Wake Late Std (us)", wait_stats.late_stddev_nanos / 1E3);
+        reporter.writeValue("Wake Late Max (us)", wait_stats.late_max_nanos / 1E3);
+        reporter.writeValue("Wait Spin (ms)", wait_stats.spin_nanos / 1E6);
+        //overruns mean host can't keep physics loop in real-time
+        common_utils::ScheduledExecutor::Stats executor_stats = executor_.getStats();
+        reporter.writeValue("Periods", executor_stats.period_count);
+        reporter.writeValue("Overruns", executor_stats.overrun_count);
+        reporter.writeValue("Missed Periods", executor_stats.missed_period_count);
+        reporter.writeValue("Update p50 (us)", executor_stats.callback_duration.percentile(0.5) / 1E3);
+        reporter.writeValue("Update p99 (us)", executor_stats.callback_duration.percentile(0.99) / 1E3);
+        reporter.writeValue("Update Max (us)", executor_stats.callback_duration.max_nanos / 1E3);
+        reporter.writeValue("Jitter p99 (us)", executor_stats.wake_jitter.percentile(0.99) / 1E3);
         if (physics_engine_)
             physics_engine_->reportState(reporter);
 
@@ -64,6 +85,7 @@ public:
         if (physics_engine_)
             physics_engine_->clear();
         UpdatableContainer::clear();
+        updatePartitions();
     }
 
     virtual void insert(UpdatableObject* member) override
@@ -72,6 +94,7 @@ public:
             physics_engine_->insert(static_cast<PhysicsBody*>(member->getPhysicsBody()));
 
         UpdatableContainer::insert(member);
+        updatePartitions();
     }
 
     virtual void erase_remove(UpdatableObject* member) override
@@ -81,6 +104,47 @@ public:
                 member->getPhysicsBody()));
 
         UpdatableContainer::erase_remove(member);
+        updatePartitions();
+    }
+
+    /*
+        In parallel update mode, each member that owns physics body (i.e. vehicle along with its
+        sensors and firmware) forms task group together with the physics step of that body. Groups are
+        run on work-stealing pool and all of them complete before next clock step. Members without physics
+        body, such as state reporter, are updated serially before groups start.
+
+        Vehicles don't share any state so results are same as serial path. In deterministic mode
+        work-stealing is disabled so every group always runs on the same thread in the same order which
+        makes execution repeatable even for side effects such as logging.
+        thread_count = 0 uses all hardware threads. Not thread-safe with running async updator, use lock().
+    */
+    void enableParallelUpdate(unsigned int thread_count = 0, bool deterministic = false)
+    {
+        if (physics_engine_ && !physics_engine_->canUpdateBodiesIndependently()) {
+            Utils::log("Physics engine does not support updating bodies independently, parallel update is not enabled",
+                Utils::kLogLevelWarn);
+            return;
+        }
+
+        update_pool_.reset(new common_utils::WorkStealingPool(thread_count));
+        update_deterministic_ = deterministic;
+    }
+    void disableParallelUpdate()
+    {
+        update_pool_.reset();
+    }
+    bool isParallelUpdateEnabled() const
+    {
+        return update_pool_ != nullptr;
+    }
+
+    common_utils::ThreadWaiter::Stats getWaitStats() const
+    {
+        return executor_.getWaitStats();
+    }
+    common_utils::ScheduledExecutor::Stats getExecutorStats() const
+    {
+        return executor_.getStats();
     }
 
     //async updater thread
@@ -143,9 +207,46 @@ private:
         return true;
     }
 
+    void updateParallel()
+    {
+        //keep reset/update sequence checks same as in serial path
+        UpdatableObject::update();
+        if (physics_engine_)
+            physics_engine_->PhysicsEngineBase::update();
+
+        for (UpdatableObject* member : serial_members_)
+            member->update();
+
+        update_pool_->parallelFor(partitioned_members_.size(), [this](std::size_t group_index) {
+            UpdatableObject* member = partitioned_members_[group_index];
+            member->update();
+
+            if (physics_engine_)
+                physics_engine_->updateBody(static_cast<PhysicsBody*>(member->getPhysicsBody()));
+        }, !update_deterministic_);
+    }
+
+    void updatePartitions()
+    {
+        serial_members_.clear();
+        partitioned_members_.clear();
+
+        for (UpdatableObject* member : *this) {
+            if (member->getPhysicsBody() != nullptr)
+                partitioned_members_.push_back(member);
+            else
+                serial_members_.push_back(member);
+        }
+    }
+
 private:
     std::unique_ptr<PhysicsEngineBase> physics_engine_ = nullptr;
     common_utils::ScheduledExecutor executor_;
+
+    std::unique_ptr<common_utils::WorkStealingPool> update_pool_;
+    bool update_deterministic_ = false;
+    vector<UpdatableObject*> serial_members_;
+    vector<UpdatableObject*> partitioned_members_;
 };
 
 }} //namespace
@@ -5,6 +5,7 @@
 #define air_ObstacleMap_hpp
 
 #include <mutex>
+#include <atomic>
 #include "common/Common.hpp"
 
 namespace msr { namespace airlib {
@@ -33,14 +34,28 @@ namespace msr { namespace airlib {
 
     Another design criteria is that this class is thread safe for concurrent updates and queries.
     We fully expect one thread to continuously update the obstacles while another to query the map.
+    Queries must not wait for updates, so the map is kept twice using the Left-Right technique
+    (Ramalhete and Correia): queries read the copy that is currently published and only announce
+    themselves in an atomic counter, which makes them wait-free. An update changes the other copy,
+    publishes it, waits until no query reads the old one any more and then repeats the change there.
+    Each copy has a segment tree over the distances so a window of any size is answered in O(log ticks)
+    instead of scanning every tick, which matters for maps with hundreds of ticks from a lidar.
 */
 
 class ObstacleMap {
 private:
-    //stores distances for each tick segment
-    vector<float> distances_;
-    //what is the confidence in these values? This should typically be the standard deviation
-    vector<float> confidences_; 
+    //one copy of the map
+    struct Snapshot {
+        //stores distances for each tick segment
+        vector<float> distances;
+        //what is the confidence in these values? This should typically be the standard deviation
+        vector<float> confidences;
+        //segment tree with the first tick of minimum distance below each node, leaves start at
+        //leaf_count and padding leaves are -1
+        vector<int> tree;
+        int leaf_count;
+    };
+
     //number of ticks, this decides reolution
     int ticks_;
     //blind spots don't get updated so we get its value from neighbours
@@ -58,13 +73,41 @@ public:
         }
     };
 
-    //private version of hasObstacle doesn't do lock or check inputs
-    ObstacleInfo hasObstacle_(int from_tick, int to_tick) const;    
 private:
+    //private version of hasObstacle doesn't check inputs
+    ObstacleInfo hasObstacle_(const Snapshot& snapshot, int from_tick, int to_tick) const;
     int wrap(int tick) const;
 
-    //currently we employ simple thread safe model: just serialize queries and updates
-    std::mutex mutex_;
+    //first tick of minimum distance in [from_tick, to_tick] without wrapping
+    static int closestTick(const Snapshot& snapshot, int from_tick, int to_tick);
+    static int closerTick(const Snapshot& snapshot, int tick1, int tick2);
+    static void setTick(Snapshot& snapshot, int tick, float distance, float confidence);
+    static void fixTree(Snapshot& snapshot, int tick);
+    static void buildTree(Snapshot& snapshot);
+
+    //applies change to the copy no query reads, publishes it and applies change again to the other
+    template<typename Change>
+    void write(Change&& change);
+    void waitForReaders(int version) const;
+
+    //queries register in readers_[version_] for their duration and read snapshots_[active_]
+    class ReadGuard {
+    public:
+        ReadGuard(const ObstacleMap& map);
+        ~ReadGuard();
+        const Snapshot& getSnapshot() const;
+    private:
+        std::atomic<int>& indicator_;
+        const Snapshot* snapshot_;
+    };
+
+    Snapshot snapshots_[2];
+    std::atomic<int> active_;
+    std::atomic<int> version_;
+    mutable std::atomic<int> readers_[2];
+
+    //updates are serialized with each other, never with queries
+    std::mutex write_mutex_;
 public:
     //if odd_blindspots = true then set all odd ticks as blind spots
     ObstacleMap(int ticks, bool odd_blindspots = false);
@@ -73,13 +116,14 @@ public:
     void update(float distance, int tick, int window, float confidence);
     void update(float distances[], float confidences[]);
 
+    //blind spots are not part of the copies, set them before the map is shared with other threads
     void setBlindspot(int tick, bool blindspot);
 
     //query if we have obstacle in segment that starts at from to segment that starts at to
-    ObstacleInfo hasObstacle(int from_tick, int to_tick);
+    ObstacleInfo hasObstacle(int from_tick, int to_tick) const;
 
     //search entire map to find obstacle at minimum distance
-    ObstacleInfo getClosestObstacle();
+    ObstacleInfo getClosestObstacle() const;
 
     //number of ticks the map was initialized with
     int getTicks() const;
@@ -0,0 +1,593 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef air_OccupancyMap_hpp
+#define air_OccupancyMap_hpp
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include "common/Common.hpp"
+#include "common/ImageCaptureBase.hpp"
+#include "common/common_utils/WorkStealingPool.hpp"
+#include "ObstacleMap.hpp"
+
+namespace msr { namespace airlib {
+
+/*
+    OccupancyMap is a persistent 3D map of obstacles in world (NED) frame built from depth images, so that
+    obstacles which left the field of view of the camera are still known to planners and safety checks.
+
+    Space is divided in to cubic voxels, each holding log-odds of being occupied. Every pixel of a depth image
+    is a ray from the camera: voxels the ray passes through get miss_log_odds and the voxel at its end gets
+    hit_log_odds. Values are clamped so voxels can change state again after a few observations. A voxel is
+    occupied when its log-odds is above occupied_log_odds, voxels never observed are 0 and count as free.
+
+    Voxels are stored in blocks of 8x8x8 in a hash map keyed by block coordinates, so memory grows only with
+    observed space and neighbouring voxels are close together.
+
+    Rays of different image rows are cast in parallel, each task collecting keys of the voxels it hit and
+    passed. Keys are then applied to the map on the calling thread with every voxel updated at most once per
+    image and hits taking precedence over misses, which makes the result independent of thread count.
+
+    One thread is expected to integrate images while others query. Queries and the update step share a mutex,
+    ray casting is done without holding it.
+*/
+class OccupancyMap {
+public:
+    struct Params {
+        //edge of a voxel in meters
+        real_T resolution = 0.2f;
+
+        //log-odds added by one observation, 0.85 and -0.4 are probabilities 0.7 and 0.4
+        float hit_log_odds = 0.85f;
+        float miss_log_odds = -0.4f;
+        //clamping limits, probabilities 0.12 and 0.97
+        float min_log_odds = -2.0f;
+        float max_log_odds = 3.5f;
+        //voxels above this are occupied
+        float occupied_log_odds = 0.0f;
+
+        //depths closer than min_range are ignored, depths beyond max_range only clear space up to max_range.
+        //max_range = 0 means no limit
+        real_T min_range = 0.1f;
+        real_T max_range = 20.0f;
+
+        //cast a ray for every pixel_stride-th pixel in both directions
+        unsigned int pixel_stride = 1;
+
+        //threads in addition to the calling one to cast rays with, 0 casts on the calling thread only
+        unsigned int threads = 0;
+    };
+
+public:
+    OccupancyMap()
+        : OccupancyMap(Params())
+    {
+    }
+
+    OccupancyMap(const Params& params)
+        : params_(params)
+    {
+        if (params_.threads > 0)
+            pool_.reset(new common_utils::WorkStealingPool(params_.threads));
+    }
+
+    const Params& getParams() const
+    {
+        return params_;
+    }
+
+    //response must be DepthPlanner or DepthPerspective image with pixels_as_float, fov is horizontal field of
+    //view of the camera in radians
+    void integrateDepth(const ImageCaptureBase::ImageResponse& response, real_T fov)
+    {
+        bool perspective;
+        if (response.image_type == ImageCaptureBase::ImageType::DepthPlanner)
+            perspective = false;
+        else if (response.image_type == ImageCaptureBase::ImageType::DepthPerspective)
+            perspective = true;
+        else
+            throw std::invalid_argument("OccupancyMap can only integrate DepthPlanner or DepthPerspective images");
+
+        if (!response.pixels_as_float || response.width <= 0 || response.height <= 0 ||
+            response.image_data_float.size() != static_cast<size_t>(response.width) * response.height)
+            throw std::invalid_argument("OccupancyMap needs depth image with float pixels");
+
+        integrateDepth(response.image_data_float.data(), response.width, response.height, fov, perspective,
+            Pose(response.camera_position, response.camera_orientation));
+    }
+
+    //depth is width x height row major image in meters from camera at camera_pose (NED, looking along +X with
+    //+Y right and +Z down). perspective = false means depth is along the camera axis (DepthPlanner), true
+    //means distance from camera (DepthPerspective).
+    void integrateDepth(const float* depth, unsigned int width, unsigned int height, real_T fov, bool perspective, const Pose& camera_pose)
+    {
+        const Camera camera = makeCamera(width, height, fov, perspective, camera_pose);
+        const unsigned int stride = std::max(1u, params_.pixel_stride);
+        const unsigned int rows = (height + stride - 1) / stride;
+
+        //a few tasks per worker so rows with long rays don't leave others idle
+        const unsigned int workers = pool_ ? pool_->getWorkerCount() : 1;
+        const unsigned int task_count = std::min(rows, workers * 4);
+        if (buffers_.size() < task_count)
+            buffers_.resize(task_count);
+
+        auto cast_task = [&](size_t task) {
+            RayBuffer& buffer = buffers_[task];
+            buffer.hits.clear();
+            buffer.misses.clear();
+            const unsigned int row_begin = static_cast<unsigned int>(task * rows / task_count);
+            const unsigned int row_end = static_cast<unsigned int>((task + 1) * rows / task_count);
+            for (unsigned int row = row_begin; row < row_end; ++row)
+                castRow(depth, width, row * stride, stride, camera, buffer);
+        };
+        if (pool_)
+            pool_->parallelFor(task_count, cast_task);
+        else {
+            for (unsigned int task = 0; task < task_count; ++task)
+                cast_task(task);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++scan_;
+        for (unsigned int task = 0; task < task_count; ++task)
+            applyKeys(buffers_[task].hits, params_.hit_log_odds);
+        for (unsigned int task = 0; task < task_count; ++task)
+            applyKeys(buffers_[task].misses, params_.miss_log_odds);
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        blocks_.clear();
+    }
+
+    //number of allocated 8x8x8 blocks
+    size_t getBlockCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return blocks_.size();
+    }
+
+    //0 for voxels that were never observed
+    float getLogOdds(const Vector3r& point) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t key;
+        if (!pointToKey(point, key))
+            return 0;
+        auto it = blocks_.find(key >> kLocalBits);
+        return it == blocks_.end() ? 0 : it->second.log_odds[key & kLocalMask];
+    }
+
+    real_T getProbability(const Vector3r& point) const
+    {
+        return toProbability(getLogOdds(point));
+    }
+
+    bool isOccupied(const Vector3r& point) const
+    {
+        return getLogOdds(point) > params_.occupied_log_odds;
+    }
+
+    //true if no occupied voxel center is closer than radius to center
+    bool isCollisionFree(const Vector3r& center, real_T radius) const
+    {
+        const Vector3r extent(radius, radius, radius);
+        std::lock_guard<std::mutex> lock(mutex_);
+        return forOccupiedVoxels(center - extent, center + extent,
+            [&](const Vector3r& block_min, const Vector3r& block_max) {
+                return boxDistance(center, block_min, block_max) < radius;
+            },
+            [&](const Vector3r& voxel, float) {
+                return (voxel - center).norm() >= radius;
+            });
+    }
+
+    //true if no occupied voxel center is closer than radius to the segment from-to, meant for short segments
+    //such as one control step
+    bool isSegmentFree(const Vector3r& from, const Vector3r& to, real_T radius) const
+    {
+        const Vector3r extent(radius, radius, radius);
+        const Vector3r segment = to - from;
+        const real_T length2 = segment.squaredNorm();
+        std::lock_guard<std::mutex> lock(mutex_);
+        return forOccupiedVoxels(from.cwiseMin(to) - extent, from.cwiseMax(to) + extent,
+            [](const Vector3r&, const Vector3r&) {
+                return true;
+            },
+            [&](const Vector3r& voxel, float) {
+                real_T t = length2 > 0 ? (voxel - from).dot(segment) / length2 : 0;
+                t = std::max(0.0f, std::min(1.0f, t));
+                return (from + segment * t - voxel).norm() >= radius;
+            });
+    }
+
+    //distance from point to the closest occupied voxel center, max_dist if there is none closer
+    real_T distanceToObstacle(const Vector3r& point, real_T max_dist) const
+    {
+        const Vector3r extent(max_dist, max_dist, max_dist);
+        real_T closest = max_dist;
+        std::lock_guard<std::mutex> lock(mutex_);
+        forOccupiedVoxels(point - extent, point + extent,
+            [&](const Vector3r& block_min, const Vector3r& block_max) {
+                return boxDistance(point, block_min, block_max) < closest;
+            },
+            [&](const Vector3r& voxel, float) {
+                closest = std::min(closest, (voxel - point).norm());
+                return true;
+            });
+        return closest;
+    }
+
+    //centers of occupied voxels in [min_point, max_point], e.g. to rasterize the map in to a planning grid
+    void getOccupiedVoxels(const Vector3r& min_point, const Vector3r& max_point, std::vector<Vector3r>& centers) const
+    {
+        centers.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        forOccupiedVoxels(min_point, max_point,
+            [](const Vector3r&, const Vector3r&) {
+                return true;
+            },
+            [&](const Vector3r& voxel, float) {
+                centers.push_back(voxel);
+                return true;
+            });
+    }
+
+    //fill obstacle_map with the closest occupied voxel in every tick around the vehicle. Voxels within +/-height
+    //of the vehicle and up to max_dist away horizontally are considered, confidence is the probability of the
+    //voxel. Ticks without obstacles get the same distance as a new ObstacleMap.
+    void updateObstacleMap(ObstacleMap& obstacle_map, const Pose& vehicle_pose, real_T max_dist, real_T height) const
+    {
+        const int ticks = obstacle_map.getTicks();
+        std::vector<float> distances(ticks, Utils::max<float>() / 2);
+        std::vector<float> confidences(ticks, 1);
+
+        const Vector3r extent(max_dist, max_dist, height);
+        const Vector3r& position = vehicle_pose.position;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            forOccupiedVoxels(position - extent, position + extent,
+                [](const Vector3r&, const Vector3r&) {
+                    return true;
+                },
+                [&](const Vector3r& voxel, float log_odds) {
+                    const Vector3r body = VectorMath::transformToBodyFrame(voxel - position, vehicle_pose.orientation, true);
+                    const float dist = std::sqrt(body.x() * body.x() + body.y() * body.y());
+                    if (dist > max_dist)
+                        return true;
+                    int tick = obstacle_map.angleToTick(std::atan2(body.y(), body.x())) % ticks;
+                    if (tick < 0)
+                        tick += ticks;
+                    if (dist < distances[tick]) {
+                        distances[tick] = dist;
+                        confidences[tick] = toProbability(log_odds);
+                    }
+                    return true;
+                });
+        }
+
+        obstacle_map.update(distances.data(), confidences.data());
+    }
+
+    static real_T toProbability(float log_odds)
+    {
+        return 1 - 1 / (1 + std::exp(log_odds));
+    }
+
+private:
+    //voxel coordinates are offset to be unsigned, 21 bits per axis of which the lower 3 address voxel within block
+    static constexpr int kAxisBits = 21;
+    static constexpr int64_t kAxisOffset = int64_t(1) << (kAxisBits - 1);
+    static constexpr int kBlockBits = 3;
+    static constexpr int kLocalBits = 3 * kBlockBits;
+    static constexpr uint64_t kLocalMask = (uint64_t(1) << kLocalBits) - 1;
+    static constexpr int kBlockSize = 1 << kBlockBits;
+    static constexpr int kBlockAxisBits = kAxisBits - kBlockBits;
+
+    struct Block {
+        Block()
+        {
+            std::fill(log_odds, log_odds + kVoxels, 0.0f);
+            std::fill(stamps, stamps + kVoxels, 0u);
+        }
+
+        static constexpr int kVoxels = kBlockSize * kBlockSize * kBlockSize;
+        float log_odds[kVoxels];
+        //scan that last updated the voxel, each voxel is updated once per image
+        uint32_t stamps[kVoxels];
+        //voxels above occupied_log_odds, blocks without any are skipped by queries
+        unsigned int occupied = 0;
+    };
+
+    struct RayBuffer {
+        std::vector<uint64_t> hits, misses;
+    };
+
+    //camera in voxel units
+    struct Camera {
+        double origin[3];
+        double rotation[3][3];
+        double f, center_x, center_y;
+        double min_range, max_range;
+        bool perspective;
+    };
+
+    Camera makeCamera(unsigned int width, unsigned int height, real_T fov, bool perspective, const Pose& camera_pose) const
+    {
+        Camera camera;
+        const double resolution = params_.resolution;
+        const Matrix3x3r rotation = camera_pose.orientation.normalized().toRotationMatrix();
+        for (int i = 0; i < 3; ++i) {
+            camera.origin[i] = camera_pose.position[i] / resolution;
+            for (int j = 0; j < 3; ++j)
+                camera.rotation[i][j] = rotation(i, j);
+            if (!(std::abs(camera.origin[i]) < kAxisOffset - 1))
+                throw std::out_of_range("Camera position is outside of OccupancyMap");
+        }
+        camera.f = width / (2 * std::tan(fov / 2.0));
+        camera.center_x = (width - 1) / 2.0;
+        camera.center_y = (height - 1) / 2.0;
+        camera.min_range = params_.min_range / resolution;
+        camera.max_range = params_.max_range / resolution;
+        camera.perspective = perspective;
+        return camera;
+    }
+
+    void castRow(const float* depth, unsigned int width, unsigned int y, unsigned int stride, const Camera& camera, RayBuffer& buffer) const
+    {
+        const float* row = depth + static_cast<size_t>(y) * width;
+        const double dz = (y - camera.center_y) / camera.f;
+        const double inv_resolution = 1.0 / params_.resolution;
+
+        //neighbouring pixels often end in the same voxel and would cast the same ray again
+        int64_t last_end[3] = { 0, 0, 0 };
+        bool last_hit = false, has_last = false;
+
+        for (unsigned int x = 0; x < width; x += stride) {
+            const float d = row[x];
+            //also skips NaN
+            if (!(d > 0))
+                continue;
+
+            //direction with unit length along the camera axis
+            const double dy = (x - camera.center_x) / camera.f;
+            const double axis_length = std::sqrt(1 + dy * dy + dz * dz);
+            double scale = (camera.perspective ? d / axis_length : d) * inv_resolution;
+            const double range = scale * axis_length;
+            if (range < camera.min_range)
+                continue;
+            bool hit = true;
+            if (camera.max_range > 0 && range > camera.max_range) {
+                scale *= camera.max_range / range;
+                hit = false;
+            }
+
+            double end[3];
+            int64_t end_voxel[3];
+            bool inside = true;
+            for (int i = 0; i < 3; ++i) {
+                end[i] = camera.origin[i] + scale * (camera.rotation[i][0] + camera.rotation[i][1] * dy + camera.rotation[i][2] * dz);
+                inside = inside && std::abs(end[i]) < kAxisOffset - 1;
+                end_voxel[i] = inside ? static_cast<int64_t>(std::floor(end[i])) : 0;
+            }
+            if (!inside)
+                continue;
+            if (has_last && hit == last_hit && std::equal(end_voxel, end_voxel + 3, last_end))
+                continue;
+            std::copy(end_voxel, end_voxel + 3, last_end);
+            last_hit = hit;
+            has_last = true;
+
+            castRay(camera.origin, end, end_voxel, hit, buffer);
+        }
+    }
+
+    //visits voxels from start to end (Amanatides and Woo), everything but a hit end voxel is a miss
+    void castRay(const double start[3], const double end[3], const int64_t end_voxel[3], bool hit, RayBuffer& buffer) const
+    {
+        int64_t voxel[3], step[3];
+        double t_max[3], t_delta[3];
+        int64_t steps = 0;
+        for (int i = 0; i < 3; ++i) {
+            voxel[i] = static_cast<int64_t>(std::floor(start[i]));
+            steps += std::abs(end_voxel[i] - voxel[i]);
+
+            const double dir = end[i] - start[i];
+            if (dir > 0) {
+                step[i] = 1;
+                t_delta[i] = 1 / dir;
+                t_max[i] = (voxel[i] + 1 - start[i]) / dir;
+            }
+            else if (dir < 0) {
+                step[i] = -1;
+                t_delta[i] = -1 / dir;
+                t_max[i] = (voxel[i] - start[i]) / dir;
+            }
+            else {
+                step[i] = 0;
+                t_delta[i] = t_max[i] = std::numeric_limits<double>::infinity();
+            }
+        }
+
+        for (int64_t n = 0; n < steps; ++n) {
+            buffer.misses.push_back(toKey(voxel));
+            const int axis = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+            voxel[axis] += step[axis];
+            t_max[axis] += t_delta[axis];
+        }
+        (hit ? buffer.hits : buffer.misses).push_back(toKey(voxel));
+    }
+
+    //block coordinates in the upper bits so keys of a block sort together and consecutive voxels of a ray
+    //mostly share the block
+    static uint64_t toKey(const int64_t voxel[3])
+    {
+        uint64_t key = 0, local = 0;
+        for (int i = 0; i < 3; ++i) {
+            const uint64_t u = static_cast<uint64_t>(voxel[i] + kAxisOffset);
+            key = (key << kBlockAxisBits) | (u >> kBlockBits);
+            local = (local << kBlockBits) | (u & (kBlockSize - 1));
+        }
+        return (key << kLocalBits) | local;
+    }
+
+    bool pointToKey(const Vector3r& point, uint64_t& key) const
+    {
+        int64_t voxel[3];
+        for (int i = 0; i < 3; ++i) {
+            const double v = std::floor(point[i] / static_cast<double>(params_.resolution));
+            if (!(std::abs(v) < kAxisOffset - 1))
+                return false;
+            voxel[i] = static_cast<int64_t>(v);
+        }
+        key = toKey(voxel);
+        return true;
+    }
+
+    //first voxel of block in voxel coordinates
+    static void blockOrigin(uint64_t block_key, int64_t origin[3])
+    {
+        const uint64_t mask = (uint64_t(1) << kBlockAxisBits) - 1;
+        for (int i = 2; i >= 0; --i) {
+            origin[i] = static_cast<int64_t>((block_key & mask) << kBlockBits) - kAxisOffset;
+            block_key >>= kBlockAxisBits;
+        }
+    }
+
+    void applyKeys(const std::vector<uint64_t>& keys, float delta)
+    {
+        Block* block = nullptr;
+        uint64_t block_key = 0;
+        for (uint64_t key : keys) {
+            if (block == nullptr || (key >> kLocalBits) != block_key) {
+                block_key = key >> kLocalBits;
+                block = &blocks_[block_key];
+            }
+
+            const size_t index = key & kLocalMask;
+            if (block->stamps[index] == scan_)
+                continue;
+            block->stamps[index] = scan_;
+
+            float& log_odds = block->log_odds[index];
+            const bool was_occupied = log_odds > params_.occupied_log_odds;
+            log_odds = std::max(params_.min_log_odds, std::min(params_.max_log_odds, log_odds + delta));
+            const bool is_occupied = log_odds > params_.occupied_log_odds;
+            if (is_occupied != was_occupied) {
+                if (is_occupied)
+                    ++block->occupied;
+                else
+                    --block->occupied;
+            }
+        }
+    }
+
+    static real_T boxDistance(const Vector3r& point, const Vector3r& box_min, const Vector3r& box_max)
+    {
+        return (point - point.cwiseMax(box_min).cwiseMin(box_max)).norm();
+    }
+
+    //calls voxel_func(center, log_odds) for occupied voxels with centers in [min_point, max_point] of blocks
+    //for which block_filter(block_min, block_max) is true, until voxel_func returns false. Returns false if
+    //stopped. Caller holds mutex_.
+    template<typename BlockFilter, typename VoxelFunc>
+    bool forOccupiedVoxels(const Vector3r& min_point, const Vector3r& max_point, BlockFilter&& block_filter, VoxelFunc&& voxel_func) const
+    {
+        const double resolution = params_.resolution;
+        int64_t lo[3], hi[3];
+        uint64_t block_lo[3], block_hi[3];
+        double block_count = 1;
+        for (int i = 0; i < 3; ++i) {
+            //voxels whose centers are in range
+            lo[i] = static_cast<int64_t>(std::max<double>(std::ceil(min_point[i] / resolution - 0.5), -kAxisOffset));
+            hi[i] = static_cast<int64_t>(std::min<double>(std::floor(max_point[i] / resolution - 0.5), kAxisOffset - 1));
+            if (lo[i] > hi[i])
+                return true;
+            block_lo[i] = static_cast<uint64_t>(lo[i] + kAxisOffset) >> kBlockBits;
+            block_hi[i] = static_cast<uint64_t>(hi[i] + kAxisOffset) >> kBlockBits;
+            block_count *= static_cast<double>(block_hi[i] - block_lo[i] + 1);
+        }
+
+        auto visit_block = [&](uint64_t block_key, const Block& block) -> bool {
+            if (block.occupied == 0)
+                return true;
+
+            int64_t origin[3];
+            blockOrigin(block_key, origin);
+            const Vector3r block_min(static_cast<real_T>(origin[0] * resolution), static_cast<real_T>(origin[1] * resolution),
+                static_cast<real_T>(origin[2] * resolution));
+            const Vector3r block_max = block_min + Vector3r::Constant(static_cast<real_T>(kBlockSize * resolution));
+            if (!block_filter(block_min, block_max))
+                return true;
+
+            int64_t from[3], to[3];
+            for (int i = 0; i < 3; ++i) {
+                from[i] = std::max<int64_t>(lo[i] - origin[i], 0);
+                to[i] = std::min<int64_t>(hi[i] - origin[i], kBlockSize - 1);
+                if (from[i] > to[i])
+                    return true;
+            }
+            for (int64_t x = from[0]; x <= to[0]; ++x) {
+                for (int64_t y = from[1]; y <= to[1]; ++y) {
+                    for (int64_t z = from[2]; z <= to[2]; ++z) {
+                        const float log_odds = block.log_odds[(x << (2 * kBlockBits)) | (y << kBlockBits) | z];
+                        if (log_odds <= params_.occupied_log_odds)
+                            continue;
+                        const Vector3r center(static_cast<real_T>((origin[0] + x + 0.5) * resolution),
+                            static_cast<real_T>((origin[1] + y + 0.5) * resolution), static_cast<real_T>((origin[2] + z + 0.5) * resolution));
+                        if (!voxel_func(center, log_odds))
+                            return false;
+                    }
+                }
+            }
+            return true;
+        };
+
+        //look up every block in range unless the map has fewer blocks than that
+        if (block_count > static_cast<double>(blocks_.size())) {
+            const uint64_t mask = (uint64_t(1) << kBlockAxisBits) - 1;
+            for (const auto& entry : blocks_) {
+                const uint64_t bx = entry.first >> (2 * kBlockAxisBits), by = (entry.first >> kBlockAxisBits) & mask, bz = entry.first & mask;
+                if (bx < block_lo[0] || bx > block_hi[0] || by < block_lo[1] || by > block_hi[1] || bz < block_lo[2] || bz > block_hi[2])
+                    continue;
+                if (!visit_block(entry.first, entry.second))
+                    return false;
+            }
+        }
+        else {
+            for (uint64_t bx = block_lo[0]; bx <= block_hi[0]; ++bx) {
+                for (uint64_t by = block_lo[1]; by <= block_hi[1]; ++by) {
+                    for (uint64_t bz = block_lo[2]; bz <= block_hi[2]; ++bz) {
+                        auto it = blocks_.find((((bx << kBlockAxisBits) | by) << kBlockAxisBits) | bz);
+                        if (it != blocks_.end() && !visit_block(it->first, it->second))
+                            return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    Params params_;
+    std::unordered_map<uint64_t, Block> blocks_;
+    uint32_t scan_ = 0;
+    mutable std::mutex mutex_;
+
+    std::unique_ptr<common_utils::WorkStealingPool> pool_;
+    std::vector<RayBuffer> buffers_;
+};
+
+}} //namespace
+#endif
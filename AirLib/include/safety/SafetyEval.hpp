@@ -8,6 +8,7 @@
 #include <array>
 #include <memory>
 #include "ObstacleMap.hpp"
+#include "OccupancyMap.hpp"
 #include "common/common_utils/Utils.hpp"
 #include "IGeoFence.hpp"
 #include "common/Common.hpp"
@@ -75,6 +76,7 @@ private:
     MultirotorApiParams vehicle_params_;
     shared_ptr<IGeoFence> fence_ptr_;
     shared_ptr<ObstacleMap> obs_xy_ptr_;
+    shared_ptr<OccupancyMap> occupancy_map_ptr_;
     SafetyViolationType enable_reasons_ = SafetyEval::SafetyViolationType_::GeoFence;
     ObsAvoidanceStrategy obs_strategy_ = SafetyEval::ObsAvoidanceStrategy::RaiseException;
 
@@ -83,6 +85,10 @@ private:
     Vector3r getDestination(const Vector3r& cur_pos, const Vector3r& velocity) const;
     bool isThisRiskDistLess(float this_risk_dist, float other_risk_dist) const;
     void isCurrentSafer(SafetyEval::EvalResult& result);
+    void checkOccupancyMap(const Vector3r& dest_pos, const Vector3r& cur_pos, SafetyEval::EvalResult& result);
+    float getOccupancyMapClearance(const Vector3r& cur_pos) const;
+    bool isSuggestionFree(int tick, const Vector3r& cur_pos, const Quaternionr& quaternion) const;
+    Vector3r tickToWorld(int tick, const Quaternionr& quaternion) const;
     void setSuggestedVelocity(SafetyEval::EvalResult& result, const Quaternionr& quaternion);
     float adjustClearanceForPrStl(float base_clearance, float obs_confidence);
 public:
@@ -96,6 +102,9 @@ public:
         const Vector3r& origin, float xy_length, float max_z, float min_z);
     void setObsAvoidanceStrategy(SafetyEval::ObsAvoidanceStrategy obs_strategy);
     SafetyEval::ObsAvoidanceStrategy getObsAvoidanceStrategy();
+    //obstacles in the map are checked in addition to obs_xy, also for suggested directions, nullptr to disable.
+    //Map is only read here, caller keeps integrating depth in to it
+    void setOccupancyMap(shared_ptr<OccupancyMap> occupancy_map_ptr);
 };
 
 }} //namespace
@@ -21,6 +21,12 @@ public:
     void setCarControls(const CarApiBase::CarControls& controls, const std::string& vehicle_name = "");
     CarApiBase::CarState getCarState(const std::string& vehicle_name = "");
 	CarApiBase::CarControls getCarControls(const std::string& vehicle_name = "");
+
+    //pipelined versions, see RpcLibClientBase
+    std::future<void> setCarControlsFuture(const CarApiBase::CarControls& controls, const std::string& vehicle_name = "");
+    std::future<CarApiBase::CarState> getCarStateFuture(const std::string& vehicle_name = "");
+    std::future<CarApiBase::CarControls> getCarControlsFuture(const std::string& vehicle_name = "");
+
     virtual ~CarRpcLibClient();    //required for pimpl
 };
 
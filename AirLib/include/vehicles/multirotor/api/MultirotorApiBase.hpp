@@ -99,6 +99,10 @@ public: //these APIs uses above low level APIs
     
     /************************* Safety APIs *********************************/
     virtual void setSafetyEval(const shared_ptr<SafetyEval> safety_eval_ptr);
+    //map that safety checks use in addition to obstacles in SafetyEval's obs_xy. Nothing fills it for the vehicle,
+    //caller must supply it and keep integrating depth images, e.g. from the vehicle's cameras. Kept for SafetyEval
+    //set later, nullptr to disable
+    virtual void setOccupancyMap(const shared_ptr<OccupancyMap> occupancy_map_ptr);
     virtual bool setSafety(SafetyEval::SafetyViolationType enable_reasons, float obs_clearance, SafetyEval::ObsAvoidanceStrategy obs_startegy,
         float obs_avoidance_vel, const Vector3r& origin, float xy_length, float max_z, float min_z);
 
@@ -311,6 +315,7 @@ private: //variables
     std::recursive_mutex status_mutex_;
     RCData rc_data_trims_;
     shared_ptr<SafetyEval> safety_eval_ptr_;
+    shared_ptr<OccupancyMap> occupancy_map_ptr_;
     float obs_avoidance_vel_ = 0.5f;
 
     //TODO: make this configurable?
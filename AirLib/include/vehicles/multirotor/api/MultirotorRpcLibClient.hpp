@@ -51,6 +51,12 @@ public:
     bool setSafety(SafetyEval::SafetyViolationType enable_reasons, float obs_clearance, SafetyEval::ObsAvoidanceStrategy obs_startegy,
         float obs_avoidance_vel, const Vector3r& origin, float xy_length, float max_z, float min_z, const std::string& vehicle_name = "");
 
+    //pipelined versions, see RpcLibClientBase. *Async commands above are already pipelined
+    std::future<void> moveByRCFuture(const RCData& rc_data, const std::string& vehicle_name = "");
+    std::future<MultirotorState> getMultirotorStateFuture(const std::string& vehicle_name = "");
+    std::future<bool> setSafetyFuture(SafetyEval::SafetyViolationType enable_reasons, float obs_clearance, SafetyEval::ObsAvoidanceStrategy obs_startegy,
+        float obs_avoidance_vel, const Vector3r& origin, float xy_length, float max_z, float min_z, const std::string& vehicle_name = "");
+
     virtual MultirotorRpcLibClient* waitOnLastTask(bool* task_result = nullptr, float timeout_sec = Utils::nan<float>()) override;
 
     virtual ~MultirotorRpcLibClient();    //required for pimpl
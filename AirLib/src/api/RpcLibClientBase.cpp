@@ -14,6 +14,9 @@
 #include <functional>
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <map>
 STRICT_MODE_OFF
 
 #ifndef RPCLIB_MSGPACK
@@ -35,6 +38,7 @@ STRICT_MODE_OFF
 #include "common/common_utils/WindowsApisCommonPost.hpp"
 
 #include "api/RpcLibAdapatorsBase.hpp"
+#include "api/RpcLibFuture.hpp"
 
 
 STRICT_MODE_ON
@@ -45,18 +49,127 @@ __pragma(warning( disable : 4239))
 
 namespace msr { namespace airlib {
 
+typedef msr::airlib_rpclib::RpcLibAdapatorsBase RpcLibAdapatorsBase;
+typedef msr::airlib_rpclib::RpcLibFuture RpcLibFuture;
+
 struct RpcLibClientBase::impl {
     impl(const string&  ip_address, uint16_t port, float timeout_sec)
-        : client(ip_address, port)
+        : client(ip_address, port), ip_address_(ip_address), port_(port), timeout_sec_(timeout_sec)
     {
         // some long flight path commands can take a while, so we give it up to 1 hour max.
         client.set_timeout(static_cast<int64_t>(timeout_sec * 1.0E3));
     }
 
+    struct Subscription {
+        std::atomic<bool> is_stopping {false};
+        std::thread thread;
+    };
+
+    //each subscription polls on its own connection so that waiting for samples doesn't block other calls
+    template <typename TSample>
+    void startSubscription(int subscription_id, const std::string& poll_method, const std::function<void(TSample&)>& handler)
+    {
+        std::unique_ptr<Subscription> subscription(new Subscription());
+        Subscription* subscription_ptr = subscription.get();
+
+        subscription->thread = std::thread([this, subscription_id, poll_method, handler, subscription_ptr]() {
+            try {
+                rpc::client poll_client(ip_address_, port_);
+                poll_client.set_timeout(static_cast<int64_t>((timeout_sec_ + kPollTimeoutSec) * 1.0E3));
+
+                while (!subscription_ptr->is_stopping) {
+                    auto samples = poll_client.call(poll_method, subscription_id, kPollTimeoutSec).template as<std::vector<TSample>>();
+                    //server returns without waiting when too many polls are already waiting, don't spin then
+                    if (samples.empty())
+                        std::this_thread::sleep_for(std::chrono::duration<float>(kPollRetrySec));
+                    for (auto& sample : samples) {
+                        if (subscription_ptr->is_stopping)
+                            break;
+                        try {
+                            handler(sample);
+                        }
+                        catch (const std::exception& ex) {
+                            Utils::log(Utils::stringf("Subscription %d callback failed: %s", subscription_id, ex.what()), Utils::kLogLevelError);
+                        }
+                    }
+                }
+            }
+            catch (const std::exception& ex) {
+                //server has stopped subscription or went away
+                if (!subscription_ptr->is_stopping)
+                    Utils::log(Utils::stringf("Subscription %d ended: %s", subscription_id, ex.what()), Utils::kLogLevelWarn);
+            }
+        });
+
+        std::lock_guard<std::mutex> lock(subscription_mutex_);
+        subscriptions_[subscription_id] = std::move(subscription);
+    }
+
+    template <typename TAdaptor, typename TOutput>
+    int subscribeSensor(const std::string& sensor_type, const std::string& sensor_name, const std::string& vehicle_name, float rate_hz,
+        const std::function<void(uint64_t, const TOutput&)>& callback)
+    {
+        int subscription_id = client.call("subscribeSensor", sensor_type, sensor_name, vehicle_name, rate_hz, kQueueSize).as<int>();
+        startSubscription<RpcLibAdapatorsBase::SensorSample>(subscription_id, "pollSensorSubscription",
+            [callback](RpcLibAdapatorsBase::SensorSample& sample) {
+                callback(sample.sequence, sample.to<TAdaptor>().to());
+            });
+        return subscription_id;
+    }
+
+    void stopSubscription(int subscription_id, bool notify_server)
+    {
+        std::unique_ptr<Subscription> subscription;
+        {
+            std::lock_guard<std::mutex> lock(subscription_mutex_);
+            auto it = subscriptions_.find(subscription_id);
+            if (it == subscriptions_.end())
+                return;
+            subscription = std::move(it->second);
+            subscriptions_.erase(it);
+        }
+
+        subscription->is_stopping = true;
+        if (notify_server) {
+            try {
+                //this also wakes up the pending poll
+                client.call("unsubscribe", subscription_id);
+            }
+            catch (const std::exception&) {
+                //poll returns within its timeout anyway
+            }
+        }
+        if (subscription->thread.joinable())
+            subscription->thread.join();
+    }
+
+    std::vector<int> getSubscriptionIds()
+    {
+        std::lock_guard<std::mutex> lock(subscription_mutex_);
+        std::vector<int> ids;
+        for (const auto& subscription : subscriptions_)
+            ids.push_back(subscription.first);
+        return ids;
+    }
+
+    static constexpr float kPollTimeoutSec = 1;
+    static constexpr float kPollRetrySec = 0.01f;
+    static constexpr unsigned int kQueueSize = 8;
+
     rpc::client client;
+    std::unique_ptr<common_utils::SharedMemoryRing> shared_memory;
+
+    const std::string ip_address_;
+    const uint16_t port_;
+    const float timeout_sec_;
+
+    std::mutex subscription_mutex_;
+    std::map<int, std::unique_ptr<Subscription>> subscriptions_;
 };
 
-typedef msr::airlib_rpclib::RpcLibAdapatorsBase RpcLibAdapatorsBase;
+constexpr float RpcLibClientBase::impl::kPollTimeoutSec;
+constexpr float RpcLibClientBase::impl::kPollRetrySec;
+constexpr unsigned int RpcLibClientBase::impl::kQueueSize;
 
 RpcLibClientBase::RpcLibClientBase(const string&  ip_address, uint16_t port, float timeout_sec)
 {
@@ -64,7 +177,110 @@ RpcLibClientBase::RpcLibClientBase(const string&  ip_address, uint16_t port, flo
 }
 
 RpcLibClientBase::~RpcLibClientBase()
-{}
+{
+    //don't wait for timeout if server is already gone
+    bool is_connected = pimpl_->client.get_connection_state() == rpc::client::connection_state::connected;
+    for (int subscription_id : pimpl_->getSubscriptionIds())
+        pimpl_->stopSubscription(subscription_id, is_connected);
+    if (pimpl_->shared_memory && is_connected)
+        disableSharedMemory();
+}
+
+bool RpcLibClientBase::enableSharedMemory(unsigned int slot_count, uint64_t slot_size)
+{
+    disableSharedMemory();
+    if (!common_utils::SharedMemoryRing::isSupported())
+        return false;
+
+    //name must be unique so that region created by server on another host can't be found on this host
+    const std::string name = Utils::stringf("/airsim_%llu_%llu", 
+        static_cast<unsigned long long>(Utils::getTimeSinceEpochNanos()), 
+        static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(this)));
+
+    try {
+        if (!pimpl_->client.call("simCreateSharedMemory", name, slot_count, slot_size).as<bool>())
+            return false;
+    }
+    catch (const std::exception&) {
+        //server doesn't support shared memory
+        return false;
+    }
+
+    try {
+        pimpl_->shared_memory.reset(new common_utils::SharedMemoryRing(name));
+        return true;
+    }
+    catch (const std::exception&) {
+        //server is on another host
+        pimpl_->client.call("simReleaseSharedMemory", name);
+        return false;
+    }
+}
+
+void RpcLibClientBase::disableSharedMemory()
+{
+    if (pimpl_->shared_memory) {
+        const std::string name = pimpl_->shared_memory->getName();
+        pimpl_->shared_memory.reset();
+        try {
+            pimpl_->client.call("simReleaseSharedMemory", name);
+        }
+        catch (const std::exception&) {
+            //region is removed anyway when server exits
+        }
+    }
+}
+
+bool RpcLibClientBase::isSharedMemoryEnabled() const
+{
+    return pimpl_->shared_memory != nullptr;
+}
+
+int RpcLibClientBase::subscribeImages(const vector<ImageCaptureBase::ImageRequest>& request, float rate_hz,
+    const std::function<void(uint64_t, const vector<ImageCaptureBase::ImageResponse>&)>& callback, const std::string& vehicle_name)
+{
+    int subscription_id = pimpl_->client.call("subscribeImages", RpcLibAdapatorsBase::ImageRequest::from(request), 
+        vehicle_name, rate_hz, impl::kQueueSize).as<int>();
+    pimpl_->startSubscription<RpcLibAdapatorsBase::ImageSample>(subscription_id, "pollImageSubscription",
+        [callback](RpcLibAdapatorsBase::ImageSample& sample) {
+            callback(sample.sequence, RpcLibAdapatorsBase::ImageResponse::to(std::move(sample.response)));
+        });
+    return subscription_id;
+}
+int RpcLibClientBase::subscribeLidarData(const std::string& lidar_name, float rate_hz,
+    const std::function<void(uint64_t, const msr::airlib::LidarData&)>& callback, const std::string& vehicle_name)
+{
+    return pimpl_->subscribeSensor<RpcLibAdapatorsBase::LidarData>("Lidar", lidar_name, vehicle_name, rate_hz, callback);
+}
+int RpcLibClientBase::subscribeImuData(const std::string& imu_name, float rate_hz,
+    const std::function<void(uint64_t, const msr::airlib::ImuBase::Output&)>& callback, const std::string& vehicle_name)
+{
+    return pimpl_->subscribeSensor<RpcLibAdapatorsBase::ImuData>("Imu", imu_name, vehicle_name, rate_hz, callback);
+}
+int RpcLibClientBase::subscribeBarometerData(const std::string& barometer_name, float rate_hz,
+    const std::function<void(uint64_t, const msr::airlib::BarometerBase::Output&)>& callback, const std::string& vehicle_name)
+{
+    return pimpl_->subscribeSensor<RpcLibAdapatorsBase::BarometerData>("Barometer", barometer_name, vehicle_name, rate_hz, callback);
+}
+int RpcLibClientBase::subscribeMagnetometerData(const std::string& magnetometer_name, float rate_hz,
+    const std::function<void(uint64_t, const msr::airlib::MagnetometerBase::Output&)>& callback, const std::string& vehicle_name)
+{
+    return pimpl_->subscribeSensor<RpcLibAdapatorsBase::MagnetometerData>("Magnetometer", magnetometer_name, vehicle_name, rate_hz, callback);
+}
+int RpcLibClientBase::subscribeGpsData(const std::string& gps_name, float rate_hz,
+    const std::function<void(uint64_t, const msr::airlib::GpsBase::Output&)>& callback, const std::string& vehicle_name)
+{
+    return pimpl_->subscribeSensor<RpcLibAdapatorsBase::GpsData>("Gps", gps_name, vehicle_name, rate_hz, callback);
+}
+int RpcLibClientBase::subscribeDistanceSensorData(const std::string& distance_sensor_name, float rate_hz,
+    const std::function<void(uint64_t, const msr::airlib::DistanceBase::Output&)>& callback, const std::string& vehicle_name)
+{
+    return pimpl_->subscribeSensor<RpcLibAdapatorsBase::DistanceSensorData>("Distance", distance_sensor_name, vehicle_name, rate_hz, callback);
+}
+void RpcLibClientBase::unsubscribe(int subscription_id)
+{
+    pimpl_->stopSubscription(subscription_id, true);
+}
 
 bool RpcLibClientBase::ping()
 {
@@ -161,6 +377,16 @@ msr::airlib::GeoPoint RpcLibClientBase::getHomeGeoPoint(const std::string& vehic
 
 msr::airlib::LidarData RpcLibClientBase::getLidarData(const std::string& lidar_name, const std::string& vehicle_name) const
 {
+    if (pimpl_->shared_memory) {
+        auto result = pimpl_->client.call("getLidarDataSharedMemory", lidar_name, vehicle_name, pimpl_->shared_memory->getName())
+            .as<RpcLibAdapatorsBase::SharedMemoryLidarData>();
+
+        msr::airlib::LidarData lidar_data = result.data.to();
+        if (result.frame.slot < 0 || pimpl_->shared_memory->read(result.frame.to(), lidar_data.point_cloud))
+            return lidar_data;
+        //frame was overwritten before we could read it, get it over RPC instead
+    }
+
     return pimpl_->client.call("getLidarData", lidar_name, vehicle_name).as<RpcLibAdapatorsBase::LidarData>().to();
 }
 
@@ -221,11 +447,27 @@ void RpcLibClientBase::simSetVehiclePose(const Pose& pose, bool ignore_collision
 
 vector<ImageCaptureBase::ImageResponse> RpcLibClientBase::simGetImages(vector<ImageCaptureBase::ImageRequest> request, const std::string& vehicle_name)
 {
-    const auto& response_adaptor = pimpl_->client.call("simGetImages", 
-        RpcLibAdapatorsBase::ImageRequest::from(request), vehicle_name)
-        .as<vector<RpcLibAdapatorsBase::ImageResponse>>();
+    vector<ImageCaptureBase::ImageResponse> response;
+    simGetImages(request, response, vehicle_name);
+    return response;
+}
+void RpcLibClientBase::simGetImages(const vector<ImageCaptureBase::ImageRequest>& request, vector<ImageCaptureBase::ImageResponse>& response, 
+    const std::string& vehicle_name)
+{
+    if (pimpl_->shared_memory) {
+        const auto& result = pimpl_->client.call("simGetImagesSharedMemory", 
+            RpcLibAdapatorsBase::ImageRequest::from(request), vehicle_name, pimpl_->shared_memory->getName());
 
-    return RpcLibAdapatorsBase::ImageResponse::to(response_adaptor);
+        if (RpcLibAdapatorsBase::SharedMemoryImageResponse::unpackTo(result.get(), *pimpl_->shared_memory, response))
+            return;
+        //some frames were overwritten before we could read them, get images over RPC instead
+    }
+
+    //decode directly from received message without going through adaptor objects
+    const auto& result = pimpl_->client.call("simGetImages", 
+        RpcLibAdapatorsBase::ImageRequest::from(request), vehicle_name);
+
+    RpcLibAdapatorsBase::ImageResponse::unpackTo(result.get(), response);
 }
 vector<uint8_t> RpcLibClientBase::simGetImage(const std::string& camera_name, ImageCaptureBase::ImageType type, const std::string& vehicle_name)
 {
@@ -305,6 +547,202 @@ msr::airlib::Environment::State RpcLibClientBase::simGetGroundTruthEnvironment(c
     return pimpl_->client.call("simGetGroundTruthEnvironment", vehicle_name).as<RpcLibAdapatorsBase::EnvironmentState>().to();;
 }
 
+vector<VehicleStateQuery::Response> RpcLibClientBase::simGetVehicleStates(const vector<VehicleStateQuery::Request>& request) const
+{
+    return RpcLibAdapatorsBase::VehicleStateResponse::to(
+        pimpl_->client.call("simGetVehicleStates", RpcLibAdapatorsBase::VehicleStateRequest::from(request))
+        .as<vector<RpcLibAdapatorsBase::VehicleStateResponse>>());
+}
+
+std::future<bool> RpcLibClientBase::simIsPausedFuture() const
+{
+    return RpcLibFuture::as<bool>(pimpl_->client.async_call("simIsPaused"), pimpl_->timeout_sec_);
+}
+
+std::future<void> RpcLibClientBase::simPauseFuture(bool is_paused)
+{
+    return RpcLibFuture::done(pimpl_->client.async_call("simPause", is_paused), pimpl_->timeout_sec_);
+}
+
+std::future<void> RpcLibClientBase::simContinueForTimeFuture(double seconds)
+{
+    return RpcLibFuture::done(pimpl_->client.async_call("simContinueForTime", seconds), pimpl_->timeout_sec_);
+}
+
+std::future<void> RpcLibClientBase::simSetTimeOfDayFuture(bool is_enabled, const string& start_datetime, bool is_start_datetime_dst,
+    float celestial_clock_speed, float update_interval_secs, bool move_sun)
+{
+    return RpcLibFuture::done(pimpl_->client.async_call("simSetTimeOfDay", is_enabled, start_datetime, is_start_datetime_dst,
+        celestial_clock_speed, update_interval_secs, move_sun), pimpl_->timeout_sec_);
+}
+
+std::future<void> RpcLibClientBase::simEnableWeatherFuture(bool enable)
+{
+    return RpcLibFuture::done(pimpl_->client.async_call("simEnableWeather", enable), pimpl_->timeout_sec_);
+}
+
+std::future<void> RpcLibClientBase::simSetWeatherParameterFuture(WorldSimApiBase::WeatherParameter param, float val)
+{
+    return RpcLibFuture::done(pimpl_->client.async_call("simSetWeatherParameter", param, val), pimpl_->timeout_sec_);
+}
+
+std::future<vector<string>> RpcLibClientBase::simListSceneObjectsFuture(const string& name_regex) const
+{
+    return RpcLibFuture::as<vector<string>>(pimpl_->client.async_call("simListSceneObjects", name_regex), pimpl_->timeout_sec_);
+}
+
+std::future<Pose> RpcLibClientBase::simGetObjectPoseFuture(const std::string& object_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::Pose>(pimpl_->client.async_call("simGetObjectPose", object_name), pimpl_->timeout_sec_);
+}
+
+std::future<bool> RpcLibClientBase::simSetObjectPoseFuture(const std::string& object_name, const Pose& pose, bool teleport)
+{
+    return RpcLibFuture::as<bool>(pimpl_->client.async_call("simSetObjectPose", object_name, RpcLibAdapatorsBase::Pose(pose), teleport), pimpl_->timeout_sec_);
+}
+
+std::future<void> RpcLibClientBase::cancelLastTaskFuture(const std::string& vehicle_name)
+{
+    return RpcLibFuture::done(pimpl_->client.async_call("cancelLastTask", vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<bool> RpcLibClientBase::simSetSegmentationObjectIDFuture(const std::string& mesh_name, int object_id, bool is_name_regex)
+{
+    return RpcLibFuture::as<bool>(pimpl_->client.async_call("simSetSegmentationObjectID", mesh_name, object_id, is_name_regex), pimpl_->timeout_sec_);
+}
+
+std::future<int> RpcLibClientBase::simGetSegmentationObjectIDFuture(const std::string& mesh_name) const
+{
+    return RpcLibFuture::as<int>(pimpl_->client.async_call("simGetSegmentationObjectID", mesh_name), pimpl_->timeout_sec_);
+}
+
+std::future<void> RpcLibClientBase::simPrintLogMessageFuture(const std::string& message, const std::string& message_param, unsigned char severity)
+{
+    return RpcLibFuture::done(pimpl_->client.async_call("simPrintLogMessage", message, message_param, severity), pimpl_->timeout_sec_);
+}
+
+std::future<bool> RpcLibClientBase::armDisarmFuture(bool arm, const std::string& vehicle_name)
+{
+    return RpcLibFuture::as<bool>(pimpl_->client.async_call("armDisarm", arm, vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<bool> RpcLibClientBase::isApiControlEnabledFuture(const std::string& vehicle_name) const
+{
+    return RpcLibFuture::as<bool>(pimpl_->client.async_call("isApiControlEnabled", vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<void> RpcLibClientBase::enableApiControlFuture(bool is_enabled, const std::string& vehicle_name)
+{
+    return RpcLibFuture::done(pimpl_->client.async_call("enableApiControl", is_enabled, vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<msr::airlib::GeoPoint> RpcLibClientBase::getHomeGeoPointFuture(const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::GeoPoint>(pimpl_->client.async_call("getHomeGeoPoint", vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<msr::airlib::LidarData> RpcLibClientBase::getLidarDataFuture(const std::string& lidar_name, const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::LidarData>(pimpl_->client.async_call("getLidarData", lidar_name, vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<msr::airlib::ImuBase::Output> RpcLibClientBase::getImuDataFuture(const std::string& imu_name, const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::ImuData>(pimpl_->client.async_call("getImuData", imu_name, vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<msr::airlib::BarometerBase::Output> RpcLibClientBase::getBarometerDataFuture(const std::string& barometer_name, const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::BarometerData>(pimpl_->client.async_call("getBarometerData", barometer_name, vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<msr::airlib::MagnetometerBase::Output> RpcLibClientBase::getMagnetometerDataFuture(const std::string& magnetometer_name, const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::MagnetometerData>(pimpl_->client.async_call("getMagnetometerData", magnetometer_name, vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<msr::airlib::GpsBase::Output> RpcLibClientBase::getGpsDataFuture(const std::string& gps_name, const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::GpsData>(pimpl_->client.async_call("getGpsData", gps_name, vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<msr::airlib::DistanceBase::Output> RpcLibClientBase::getDistanceSensorDataFuture(const std::string& distance_sensor_name, const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::DistanceSensorData>(pimpl_->client.async_call("getDistanceSensorData", distance_sensor_name, vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<vector<int>> RpcLibClientBase::simGetLidarSegmentationFuture(const std::string& lidar_name, const std::string& vehicle_name) const
+{
+    return RpcLibFuture::as<vector<int>>(pimpl_->client.async_call("simGetLidarSegmentation", lidar_name, vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<Pose> RpcLibClientBase::simGetVehiclePoseFuture(const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::Pose>(pimpl_->client.async_call("simGetVehiclePose", vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<void> RpcLibClientBase::simSetVehiclePoseFuture(const Pose& pose, bool ignore_collision, const std::string& vehicle_name)
+{
+    return RpcLibFuture::done(pimpl_->client.async_call("simSetVehiclePose", RpcLibAdapatorsBase::Pose(pose), ignore_collision, vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<vector<ImageCaptureBase::ImageResponse>> RpcLibClientBase::simGetImagesFuture(const vector<ImageCaptureBase::ImageRequest>& request, const std::string& vehicle_name)
+{
+    //decode directly from received message without going through adaptor objects
+    return RpcLibFuture::then(pimpl_->client.async_call("simGetImages", RpcLibAdapatorsBase::ImageRequest::from(request), vehicle_name), pimpl_->timeout_sec_,
+        [](const RPCLIB_MSGPACK::object_handle& reply) {
+            vector<ImageCaptureBase::ImageResponse> response;
+            RpcLibAdapatorsBase::ImageResponse::unpackTo(reply.get(), response);
+            return response;
+        });
+}
+
+std::future<vector<uint8_t>> RpcLibClientBase::simGetImageFuture(const std::string& camera_name, ImageCaptureBase::ImageType type, const std::string& vehicle_name)
+{
+    return RpcLibFuture::then(pimpl_->client.async_call("simGetImage", camera_name, type, vehicle_name), pimpl_->timeout_sec_,
+        [](const RPCLIB_MSGPACK::object_handle& reply) {
+            vector<uint8_t> result = reply.as<vector<uint8_t>>();
+            if (result.size() == 1) {
+                // rpclib has a bug with serializing empty vectors, so we return a 1 byte vector instead.
+                result.clear();
+            }
+            return result;
+        });
+}
+
+std::future<CollisionInfo> RpcLibClientBase::simGetCollisionInfoFuture(const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::CollisionInfo>(pimpl_->client.async_call("simGetCollisionInfo", vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<CameraInfo> RpcLibClientBase::simGetCameraInfoFuture(const std::string& camera_name, const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::CameraInfo>(pimpl_->client.async_call("simGetCameraInfo", camera_name, vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<void> RpcLibClientBase::simSetCameraOrientationFuture(const std::string& camera_name, const Quaternionr& orientation, const std::string& vehicle_name)
+{
+    return RpcLibFuture::done(pimpl_->client.async_call("simSetCameraOrientation", camera_name, RpcLibAdapatorsBase::Quaternionr(orientation), vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<msr::airlib::Kinematics::State> RpcLibClientBase::simGetGroundTruthKinematicsFuture(const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::KinematicsState>(pimpl_->client.async_call("simGetGroundTruthKinematics", vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<msr::airlib::Environment::State> RpcLibClientBase::simGetGroundTruthEnvironmentFuture(const std::string& vehicle_name) const
+{
+    return RpcLibFuture::to<RpcLibAdapatorsBase::EnvironmentState>(pimpl_->client.async_call("simGetGroundTruthEnvironment", vehicle_name), pimpl_->timeout_sec_);
+}
+
+std::future<vector<VehicleStateQuery::Response>> RpcLibClientBase::simGetVehicleStatesFuture(const vector<VehicleStateQuery::Request>& request) const
+{
+    return RpcLibFuture::then(pimpl_->client.async_call("simGetVehicleStates", RpcLibAdapatorsBase::VehicleStateRequest::from(request)), pimpl_->timeout_sec_,
+        [](const RPCLIB_MSGPACK::object_handle& reply) {
+            return RpcLibAdapatorsBase::VehicleStateResponse::to(reply.as<vector<RpcLibAdapatorsBase::VehicleStateResponse>>());
+        });
+}
+
 void RpcLibClientBase::cancelLastTask(const std::string& vehicle_name)
 {
     pimpl_->client.call("cancelLastTask", vehicle_name);
@@ -330,6 +768,10 @@ const void* RpcLibClientBase::getClient() const
 {
     return &pimpl_->client;
 }
+float RpcLibClientBase::getTimeoutSec() const
+{
+    return pimpl_->timeout_sec_;
+}
 
 //----------- APIs to control ACharacter in scene ----------/
 void RpcLibClientBase::simCharSetFaceExpression(const std::string& expression_name, float value, const std::string& character_name)
@@ -29,8 +29,11 @@ STRICT_MODE_OFF
 #include "common/common_utils/WindowsApisCommonPost.hpp"
 
 #include "api/RpcLibAdapatorsBase.hpp"
+#include "api/ApiSubscription.hpp"
 #include <functional>
 #include <thread>
+#include <mutex>
+#include <map>
 
 STRICT_MODE_ON
 
@@ -50,6 +53,8 @@ struct RpcLibServerBase::impl {
     }
 
     void stop() {        
+        //wake up clients waiting for subscribed data so their calls don't hold up shutdown
+        stopSubscriptions();
         server.close_sessions();
         if (!is_async_) {
             // this deadlocks UI thread if async_run was called while there are pending rpc calls.
@@ -63,14 +68,165 @@ struct RpcLibServerBase::impl {
             server.run();
         } else {
             is_async_ = true;
+            max_waiting_polls_ = thread_count / 2;
             server.async_run(thread_count);   //4 threads
         }
     }
 
+    //shared memory regions created on request of clients on the same host, these are removed with server.
+    //Pages of a region are committed when it is created, so any client could exhaust memory without the
+    //limits below: slots of up to 64 MB (a 4K float image is 33 MB), up to 64 of them, 1 GB for all regions.
+    bool createSharedMemory(const std::string& name, unsigned int slot_count, uint64_t slot_size)
+    {
+        if (!common_utils::SharedMemoryRing::isSupported())
+            return false;
+
+        const uint64_t max_slot_size = 64ull << 20, max_total_size = 1ull << 30;
+        const unsigned int max_slot_count = 64;
+        if (slot_count > max_slot_count || slot_size > max_slot_size) {
+            Utils::log(Utils::stringf("Shared memory for client was not created, %u slots of %llu bytes are over the limit",
+                slot_count, static_cast<unsigned long long>(slot_size)), Utils::kLogLevelWarn);
+            return false;
+        }
+
+        try {
+            //lock is held while creating so concurrent requests can't exceed the total together
+            std::lock_guard<std::mutex> lock(shared_memory_mutex_);
+            uint64_t total_size = slot_count * slot_size;
+            for (const auto& entry : shared_memory_)
+                total_size += entry.second->getSlotCount() * entry.second->getSlotSize();
+            if (total_size > max_total_size) {
+                Utils::log(Utils::stringf("Shared memory for client was not created, all regions would need %llu bytes",
+                    static_cast<unsigned long long>(total_size)), Utils::kLogLevelWarn);
+                return false;
+            }
+
+            shared_memory_[name] = std::make_shared<common_utils::SharedMemoryRing>(name, slot_count, slot_size);
+            return true;
+        }
+        catch (const std::exception& ex) {
+            Utils::log(Utils::stringf("Shared memory for client could not be created: %s", ex.what()), Utils::kLogLevelWarn);
+            return false;
+        }
+    }
+
+    void releaseSharedMemory(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(shared_memory_mutex_);
+        shared_memory_.erase(name);
+    }
+
+    //region stays alive while it is being written even if client releases it at the same time
+    std::shared_ptr<common_utils::SharedMemoryRing> getSharedMemory(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(shared_memory_mutex_);
+        auto it = shared_memory_.find(name);
+        if (it == shared_memory_.end())
+            throw std::invalid_argument(Utils::stringf("Shared memory '%s' was not created", name.c_str()));
+        return it->second;
+    }
+
+    typedef ApiSubscription<msr::airlib_rpclib::RpcLibAdapatorsBase::ImageSample> ImageSubscription;
+    typedef ApiSubscription<msr::airlib_rpclib::RpcLibAdapatorsBase::SensorSample> SensorSubscription;
+
+    template <typename TSubscription>
+    int addSubscription(std::map<int, std::shared_ptr<TSubscription>>& subscriptions, const std::shared_ptr<TSubscription>& subscription)
+    {
+        std::lock_guard<std::mutex> lock(subscription_mutex_);
+
+        //remove subscriptions of clients that went away without unsubscribing
+        for (auto it = subscriptions.begin(); it != subscriptions.end();) {
+            if (it->second->isStopped())
+                it = subscriptions.erase(it);
+            else
+                ++it;
+        }
+
+        int id = ++last_subscription_id_;
+        subscriptions[id] = subscription;
+        return id;
+    }
+
+    template <typename TSubscription>
+    std::shared_ptr<TSubscription> getSubscription(std::map<int, std::shared_ptr<TSubscription>>& subscriptions, int id)
+    {
+        std::lock_guard<std::mutex> lock(subscription_mutex_);
+        auto it = subscriptions.find(id);
+        if (it == subscriptions.end())
+            throw std::invalid_argument(Utils::stringf("Subscription %d does not exist", id));
+        return it->second;
+    }
+
+    void removeSubscription(int id)
+    {
+        std::lock_guard<std::mutex> lock(subscription_mutex_);
+        auto image_it = image_subscriptions_.find(id);
+        if (image_it != image_subscriptions_.end()) {
+            image_it->second->stop();
+            image_subscriptions_.erase(image_it);
+        }
+        auto sensor_it = sensor_subscriptions_.find(id);
+        if (sensor_it != sensor_subscriptions_.end()) {
+            sensor_it->second->stop();
+            sensor_subscriptions_.erase(sensor_it);
+        }
+    }
+
+    //waiting poll holds an rpclib worker, so at most half of the workers may wait for samples at a time and
+    //each for at most kMaxPollTimeoutSec, the rest keep serving other calls. Polls over the limit, and all polls
+    //if server runs on the calling thread, return queued samples without waiting.
+    template <typename TSubscription>
+    auto pollSubscription(TSubscription& subscription, float timeout_sec) -> decltype(subscription.poll(timeout_sec))
+    {
+        bool may_wait = false;
+        if (timeout_sec > 0) {
+            std::lock_guard<std::mutex> lock(subscription_mutex_);
+            if (waiting_polls_ < max_waiting_polls_) {
+                ++waiting_polls_;
+                may_wait = true;
+            }
+        }
+        if (!may_wait)
+            return subscription.poll(0);
+
+        struct WaitingPoll {
+            impl* owner;
+            ~WaitingPoll()
+            {
+                std::lock_guard<std::mutex> lock(owner->subscription_mutex_);
+                --owner->waiting_polls_;
+            }
+        } waiting_poll{ this };
+
+        return subscription.poll(std::min(timeout_sec, kMaxPollTimeoutSec));
+    }
+
+    void stopSubscriptions()
+    {
+        std::lock_guard<std::mutex> lock(subscription_mutex_);
+        for (auto& subscription : image_subscriptions_)
+            subscription.second->stop();
+        for (auto& subscription : sensor_subscriptions_)
+            subscription.second->stop();
+    }
+
     rpc::server server;
     bool is_async_ = false;
+
+    std::mutex subscription_mutex_;
+    int last_subscription_id_ = 0;
+    std::size_t waiting_polls_ = 0;
+    std::size_t max_waiting_polls_ = 0;
+    static constexpr float kMaxPollTimeoutSec = 1;
+    std::map<int, std::shared_ptr<ImageSubscription>> image_subscriptions_;
+    std::map<int, std::shared_ptr<SensorSubscription>> sensor_subscriptions_;
+
+    std::mutex shared_memory_mutex_;
+    std::map<std::string, std::shared_ptr<common_utils::SharedMemoryRing>> shared_memory_;
 };
 
+constexpr float RpcLibServerBase::impl::kMaxPollTimeoutSec;
+
 typedef msr::airlib_rpclib::RpcLibAdapatorsBase RpcLibAdapatorsBase;
 
 RpcLibServerBase::RpcLibServerBase(ApiProvider* api_provider, const std::string& server_address, uint16_t port)
@@ -125,8 +281,35 @@ RpcLibServerBase::RpcLibServerBase(ApiProvider* api_provider, const std::string&
 
     pimpl_->server.bind("simGetImages", [&](const std::vector<RpcLibAdapatorsBase::ImageRequest>& request_adapter, const std::string& vehicle_name) -> 
         vector<RpcLibAdapatorsBase::ImageResponse> {
-            const auto& response = getVehicleSimApi(vehicle_name)->getImages(RpcLibAdapatorsBase::ImageRequest::to(request_adapter));
-            return RpcLibAdapatorsBase::ImageResponse::from(response);
+            //pixel buffers are moved, not copied, into adaptors and from there into serialized reply
+            auto response = getVehicleSimApi(vehicle_name)->getImages(RpcLibAdapatorsBase::ImageRequest::to(request_adapter));
+            return RpcLibAdapatorsBase::ImageResponse::from(std::move(response));
+    });
+    pimpl_->server.bind("simCreateSharedMemory", [&](const std::string& name, unsigned int slot_count, uint64_t slot_size) -> bool {
+        return pimpl_->createSharedMemory(name, slot_count, slot_size);
+    });
+    pimpl_->server.bind("simReleaseSharedMemory", [&](const std::string& name) -> void {
+        pimpl_->releaseSharedMemory(name);
+    });
+    pimpl_->server.bind("simGetImagesSharedMemory", [&](const std::vector<RpcLibAdapatorsBase::ImageRequest>& request_adapter, const std::string& vehicle_name, 
+        const std::string& shared_memory_name) -> vector<RpcLibAdapatorsBase::SharedMemoryImageResponse> {
+            auto shared_memory = pimpl_->getSharedMemory(shared_memory_name);
+            auto response = getVehicleSimApi(vehicle_name)->getImages(RpcLibAdapatorsBase::ImageRequest::to(request_adapter));
+
+            //reply only carries slot of each image, images that don't fit in slot are sent as usual
+            vector<RpcLibAdapatorsBase::SharedMemoryImageResponse> response_adapter;
+            response_adapter.reserve(response.size());
+            for (auto& item : response) {
+                common_utils::SharedMemoryRing::Frame frame = item.pixels_as_float
+                    ? shared_memory->write(item.image_data_float.data(), item.image_data_float.size() * sizeof(float))
+                    : shared_memory->write(item.image_data_uint8.data(), item.image_data_uint8.size());
+                if (frame.slot >= 0) {
+                    item.image_data_uint8.clear();
+                    item.image_data_float.clear();
+                }
+                response_adapter.emplace_back(std::move(item), frame);
+            }
+            return response_adapter;
     });
     pimpl_->server.bind("simGetImage", [&](const std::string& camera_name, ImageCaptureBase::ImageType type, const std::string& vehicle_name) -> vector<uint8_t> {
         auto result = getVehicleSimApi(vehicle_name)->getImage(camera_name, type);
@@ -189,6 +372,16 @@ RpcLibServerBase::RpcLibServerBase(ApiProvider* api_provider, const std::string&
         const auto& lidar_data = getVehicleApi(vehicle_name)->getLidarData(lidar_name);
         return RpcLibAdapatorsBase::LidarData(lidar_data);
     });
+    pimpl_->server.bind("getLidarDataSharedMemory", [&](const std::string& lidar_name, const std::string& vehicle_name, 
+        const std::string& shared_memory_name) -> RpcLibAdapatorsBase::SharedMemoryLidarData {
+        auto shared_memory = pimpl_->getSharedMemory(shared_memory_name);
+        auto lidar_data = getVehicleApi(vehicle_name)->getLidarData(lidar_name);
+
+        common_utils::SharedMemoryRing::Frame frame = shared_memory->write(lidar_data.point_cloud.data(), lidar_data.point_cloud.size() * sizeof(float));
+        if (frame.slot >= 0)
+            lidar_data.point_cloud.clear();
+        return RpcLibAdapatorsBase::SharedMemoryLidarData(lidar_data, frame);
+    });
 
     pimpl_->server.bind("getImuData", [&](const std::string& imu_name, const std::string& vehicle_name) -> RpcLibAdapatorsBase::ImuData {
         const auto& imu_data = getVehicleApi(vehicle_name)->getImuData(imu_name);
@@ -215,6 +408,79 @@ RpcLibServerBase::RpcLibServerBase(ApiProvider* api_provider, const std::string&
         return RpcLibAdapatorsBase::DistanceSensorData(distance_sensor_data);
     });
 
+    //subscriptions: server samples data at requested rate and client gets each new sample once by polling,
+    //poll waits until there is new sample so data is effectively pushed to client as soon as it is available
+    pimpl_->server.bind("subscribeImages", [&](const std::vector<RpcLibAdapatorsBase::ImageRequest>& request_adapter, const std::string& vehicle_name,
+        float rate_hz, unsigned int queue_size) -> int {
+        getVehicleSimApi(vehicle_name); //throws now if vehicle doesn't exist
+        const auto request = RpcLibAdapatorsBase::ImageRequest::to(request_adapter);
+
+        auto subscription = std::make_shared<impl::ImageSubscription>([this, request, vehicle_name]() {
+            RpcLibAdapatorsBase::ImageSample sample;
+            sample.response = RpcLibAdapatorsBase::ImageResponse::from(getVehicleSimApi(vehicle_name)->getImages(request));
+            if (sample.response.size() > 0)
+                sample.time_stamp = sample.response.front().time_stamp;
+            return sample;
+        }, rate_hz, queue_size);
+        return pimpl_->addSubscription(pimpl_->image_subscriptions_, subscription);
+    });
+    pimpl_->server.bind("pollImageSubscription", [&](int subscription_id, float timeout_sec) -> std::vector<RpcLibAdapatorsBase::ImageSample> {
+        auto subscription = pimpl_->getSubscription(pimpl_->image_subscriptions_, subscription_id);
+        auto samples = pimpl_->pollSubscription(*subscription, timeout_sec);
+        //let client know it should stop polling, e.g., because subscription expired
+        if (samples.empty() && subscription->isStopped())
+            throw std::runtime_error(Utils::stringf("Subscription %d has stopped", subscription_id));
+        return samples;
+    });
+
+    pimpl_->server.bind("subscribeSensor", [&](const std::string& sensor_type, const std::string& sensor_name, const std::string& vehicle_name,
+        float rate_hz, unsigned int queue_size) -> int {
+        getVehicleApi(vehicle_name); //throws now if vehicle doesn't exist
+
+        impl::SensorSubscription::Sampler sampler;
+        if (sensor_type == "Imu")
+            sampler = [this, sensor_name, vehicle_name]() {
+                return RpcLibAdapatorsBase::SensorSample(RpcLibAdapatorsBase::ImuData(getVehicleApi(vehicle_name)->getImuData(sensor_name)));
+            };
+        else if (sensor_type == "Barometer")
+            sampler = [this, sensor_name, vehicle_name]() {
+                return RpcLibAdapatorsBase::SensorSample(RpcLibAdapatorsBase::BarometerData(getVehicleApi(vehicle_name)->getBarometerData(sensor_name)));
+            };
+        else if (sensor_type == "Magnetometer")
+            sampler = [this, sensor_name, vehicle_name]() {
+                return RpcLibAdapatorsBase::SensorSample(RpcLibAdapatorsBase::MagnetometerData(getVehicleApi(vehicle_name)->getMagnetometerData(sensor_name)));
+            };
+        else if (sensor_type == "Gps")
+            sampler = [this, sensor_name, vehicle_name]() {
+                return RpcLibAdapatorsBase::SensorSample(RpcLibAdapatorsBase::GpsData(getVehicleApi(vehicle_name)->getGpsData(sensor_name)));
+            };
+        else if (sensor_type == "Distance")
+            sampler = [this, sensor_name, vehicle_name]() {
+                return RpcLibAdapatorsBase::SensorSample(RpcLibAdapatorsBase::DistanceSensorData(getVehicleApi(vehicle_name)->getDistanceSensorData(sensor_name)));
+            };
+        else if (sensor_type == "Lidar")
+            sampler = [this, sensor_name, vehicle_name]() {
+                return RpcLibAdapatorsBase::SensorSample(RpcLibAdapatorsBase::LidarData(getVehicleApi(vehicle_name)->getLidarData(sensor_name)));
+            };
+        else
+            throw std::invalid_argument(Utils::stringf("Sensor type '%s' can't be subscribed", sensor_type.c_str()));
+
+        auto subscription = std::make_shared<impl::SensorSubscription>(sampler, rate_hz, queue_size);
+        return pimpl_->addSubscription(pimpl_->sensor_subscriptions_, subscription);
+    });
+    pimpl_->server.bind("pollSensorSubscription", [&](int subscription_id, float timeout_sec) -> std::vector<RpcLibAdapatorsBase::SensorSample> {
+        auto subscription = pimpl_->getSubscription(pimpl_->sensor_subscriptions_, subscription_id);
+        auto samples = pimpl_->pollSubscription(*subscription, timeout_sec);
+        //let client know it should stop polling, e.g., because subscription expired
+        if (samples.empty() && subscription->isStopped())
+            throw std::runtime_error(Utils::stringf("Subscription %d has stopped", subscription_id));
+        return samples;
+    });
+
+    pimpl_->server.bind("unsubscribe", [&](int subscription_id) -> void {
+        pimpl_->removeSubscription(subscription_id);
+    });
+
     pimpl_->server.bind("simGetCameraInfo", [&](const std::string& camera_name, const std::string& vehicle_name) -> RpcLibAdapatorsBase::CameraInfo {
         const auto& camera_info = getVehicleSimApi(vehicle_name)->getCameraInfo(camera_name);
         return RpcLibAdapatorsBase::CameraInfo(camera_info);
@@ -252,6 +518,18 @@ RpcLibServerBase::RpcLibServerBase(ApiProvider* api_provider, const std::string&
         return RpcLibAdapatorsBase::EnvironmentState(result);
     });
 
+    pimpl_->server.bind("simGetVehicleStates", [&](const std::vector<RpcLibAdapatorsBase::VehicleStateRequest>& request_adapter) 
+        -> std::vector<RpcLibAdapatorsBase::VehicleStateResponse> {
+        std::vector<RpcLibAdapatorsBase::VehicleStateResponse> response;
+        response.reserve(request_adapter.size());
+        for (const auto& item : request_adapter) {
+            const auto request = item.to();
+            response.push_back(RpcLibAdapatorsBase::VehicleStateResponse(VehicleStateQuery::query(request,
+                getVehicleApi(request.vehicle_name), getVehicleSimApi(request.vehicle_name))));
+        }
+        return response;
+    });
+
     pimpl_->server.bind("cancelLastTask", [&](const std::string& vehicle_name) -> void {
         getVehicleApi(vehicle_name)->cancelLastTask();
     });
@@ -5,6 +5,7 @@
 #ifndef AIRLIB_HEADER_ONLY
 
 #include <thread>
+#include <cmath>
 #include "safety/ObstacleMap.hpp"
 #include "common/common_utils/Utils.hpp"
 
@@ -12,11 +13,24 @@ namespace msr { namespace airlib {
 
 
 ObstacleMap::ObstacleMap(int ticks, bool odd_blindspots)
-    : distances_(ticks, Utils::max<float>()/2), confidences_(ticks, 1),
-      ticks_(ticks), blindspots_(ticks_, false)   //init with all distances at max/2 (setting it to max can cause overflow later)
+    : ticks_(ticks), blindspots_(ticks_, false), active_(0), version_(0)
 { 
+    readers_[0] = 0;
+    readers_[1] = 0;
+
+    for (Snapshot& snapshot : snapshots_) {
+        //init with all distances at max/2 (setting it to max can cause overflow later)
+        snapshot.distances.assign(ticks_, Utils::max<float>()/2);
+        snapshot.confidences.assign(ticks_, 1);
+        snapshot.leaf_count = 1;
+        while (snapshot.leaf_count < ticks_)
+            snapshot.leaf_count *= 2;
+        snapshot.tree.assign(2 * snapshot.leaf_count, -1);
+        buildTree(snapshot);
+    }
+
     if (odd_blindspots)
-        for(uint i = 1; i < distances_.size(); i+=2)
+        for(uint i = 1; i < blindspots_.size(); i+=2)
             blindspots_.at(i) = true;
 }
 
@@ -30,24 +44,72 @@ int ObstacleMap::wrap(int tick) const
     return iw;
 }
 
-void ObstacleMap::update(float distance, int tick, int window, float confidence)
+template<typename Change>
+void ObstacleMap::write(Change&& change)
 {
-    std::lock_guard<std::mutex> lock(mutex_);   //lock the map before update
+    std::lock_guard<std::mutex> lock(write_mutex_);   //lock against other updates, queries don't take it
 
-    //update the specified window on the map
-    for(int i = tick-window; i <= tick+window; ++i) {
-        int iw = wrap(i);
-        distances_[iw] = distance;
-        confidences_[iw] = confidence;
-    }
+    const int active = active_.load();
+    change(snapshots_[1 - active]);
+    active_.store(1 - active);
+
+    //queries starting now read the changed copy, wait for those that may still read the old one. Moving new
+    //queries to the other indicator first makes sure a steady stream of them can't keep us waiting.
+    const int version = version_.load();
+    waitForReaders(1 - version);
+    version_.store(1 - version);
+    waitForReaders(version);
+
+    change(snapshots_[active]);
 }
 
-void ObstacleMap::update(float distances[], float confidences[])
+void ObstacleMap::waitForReaders(int version) const
+{
+    while (readers_[version].load() != 0)
+        std::this_thread::yield();
+}
+
+ObstacleMap::ReadGuard::ReadGuard(const ObstacleMap& map)
+    : indicator_(map.readers_[map.version_.load()])
+{
+    indicator_.fetch_add(1);
+    snapshot_ = &map.snapshots_[map.active_.load()];
+}
+
+ObstacleMap::ReadGuard::~ReadGuard()
+{
+    indicator_.fetch_sub(1);
+}
+
+const ObstacleMap::Snapshot& ObstacleMap::ReadGuard::getSnapshot() const
+{
+    return *snapshot_;
+}
+
+void ObstacleMap::update(float distance, int tick, int window, float confidence)
 {
-    std::lock_guard<std::mutex> lock(mutex_);   //lock the map before update
+    write([&](Snapshot& snapshot) {
+        //update the specified window on the map, tree is rebuilt if that's cheaper than fixing every tick
+        const bool rebuild = 2 * window + 1 >= ticks_;
+        for(int i = tick-window; i <= tick+window; ++i) {
+            int iw = wrap(i);
+            snapshot.distances[iw] = distance;
+            snapshot.confidences[iw] = confidence;
+            if (!rebuild)
+                fixTree(snapshot, iw);
+        }
+        if (rebuild)
+            buildTree(snapshot);
+    });
+}
 
-    std::copy(distances, distances + ticks_, std::begin(distances_));
-    std::copy(confidences, confidences + ticks_, std::begin(confidences_));
+void ObstacleMap::update(float distances[], float confidences[])
+{
+    write([&](Snapshot& snapshot) {
+        std::copy(distances, distances + ticks_, std::begin(snapshot.distances));
+        std::copy(confidences, confidences + ticks_, std::begin(snapshot.confidences));
+        buildTree(snapshot);
+    });
 }
 
 void ObstacleMap::setBlindspot(int tick, bool blindspot)
@@ -55,7 +117,47 @@ void ObstacleMap::setBlindspot(int tick, bool blindspot)
     blindspots_.at(tick) = blindspot;
 }
 
-ObstacleMap::ObstacleInfo ObstacleMap::hasObstacle_(int from_tick, int to_tick) const
+//ties go to tick1, NaN distances lose against anything
+int ObstacleMap::closerTick(const Snapshot& snapshot, int tick1, int tick2)
+{
+    if (tick1 < 0)
+        return tick2;
+    if (tick2 < 0)
+        return tick1;
+    const float distance1 = snapshot.distances[tick1];
+    return snapshot.distances[tick2] < distance1 || std::isnan(distance1) ? tick2 : tick1;
+}
+
+void ObstacleMap::fixTree(Snapshot& snapshot, int tick)
+{
+    for (int node = (snapshot.leaf_count + tick) / 2; node >= 1; node /= 2)
+        snapshot.tree[node] = closerTick(snapshot, snapshot.tree[2 * node], snapshot.tree[2 * node + 1]);
+}
+
+void ObstacleMap::buildTree(Snapshot& snapshot)
+{
+    const int ticks = static_cast<int>(snapshot.distances.size());
+    for (int tick = 0; tick < ticks; ++tick)
+        snapshot.tree[snapshot.leaf_count + tick] = tick;
+    for (int node = snapshot.leaf_count - 1; node >= 1; --node)
+        snapshot.tree[node] = closerTick(snapshot, snapshot.tree[2 * node], snapshot.tree[2 * node + 1]);
+}
+
+//nodes covering the range are combined from both ends in to the middle, so ties go to the
+//first tick like in a linear scan
+int ObstacleMap::closestTick(const Snapshot& snapshot, int from_tick, int to_tick)
+{
+    int left = -1, right = -1;
+    for (int lo = snapshot.leaf_count + from_tick, hi = snapshot.leaf_count + to_tick + 1; lo < hi; lo /= 2, hi /= 2) {
+        if (lo & 1)
+            left = closerTick(snapshot, left, snapshot.tree[lo++]);
+        if (hi & 1)
+            right = closerTick(snapshot, snapshot.tree[--hi], right);
+    }
+    return closerTick(snapshot, left, right);
+}
+
+ObstacleMap::ObstacleInfo ObstacleMap::hasObstacle_(const Snapshot& snapshot, int from_tick, int to_tick) const
 {
     //make sure from <= to
     if (from_tick > to_tick) {
@@ -69,40 +171,44 @@ ObstacleMap::ObstacleInfo ObstacleMap::hasObstacle_(int from_tick, int to_tick)
             to_tick += ticks_;
     }
 
-    //find closest obstacle in given window
+    //find closest obstacle in given window, which is at most two ranges of valid indices
+    const int first = wrap(from_tick);
+    const int last = first + std::min(to_tick - from_tick, ticks_ - 1);
+    int tick;
+    if (last < ticks_)
+        tick = closestTick(snapshot, first, last);
+    else
+        tick = closerTick(snapshot, closestTick(snapshot, first, ticks_ - 1), closestTick(snapshot, 0, last - ticks_));
+
     ObstacleMap::ObstacleInfo obs;
-    obs.distance = Utils::max<float>();
-    obs.confidence = 0;
-    for(int i = from_tick; i <= to_tick; ++i) {
-        int iw = wrap(i);
-        if (obs.distance > distances_[iw]) {
-            obs.tick = iw;
-            obs.distance = distances_[iw];
-            obs.confidence = confidences_[iw];
-        }
+    obs.tick = tick;
+    obs.distance = snapshot.distances[tick];
+    obs.confidence = snapshot.confidences[tick];
+    if (!(obs.distance < Utils::max<float>())) {
+        obs.distance = Utils::max<float>();
+        obs.confidence = 0;
     }
     
     return obs;
 }
 
-ObstacleMap::ObstacleInfo ObstacleMap::hasObstacle(int from_tick, int to_tick) 
+ObstacleMap::ObstacleInfo ObstacleMap::hasObstacle(int from_tick, int to_tick) const
 {
-    std::lock_guard<std::mutex> lock(mutex_);   //lock the map before query
-
     if (blindspots_.at(wrap(from_tick)))
         from_tick--;
     if (blindspots_.at(wrap(to_tick)))
         to_tick++;
 
-    return hasObstacle_(from_tick, to_tick);
+    ReadGuard guard(*this);   //never waits for updates
+    return hasObstacle_(guard.getSnapshot(), from_tick, to_tick);
 }
 
 //search whole map to find closest obstacle
-ObstacleMap::ObstacleInfo ObstacleMap::getClosestObstacle()
+ObstacleMap::ObstacleInfo ObstacleMap::getClosestObstacle() const
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    ReadGuard guard(*this);
 
-    return hasObstacle_(0, ticks_ - 1);
+    return hasObstacle_(guard.getSnapshot(), 0, ticks_ - 1);
 }
 
 int ObstacleMap::getTicks() const
@@ -126,6 +126,9 @@ void SafetyEval::isSafeDestination(const Vector3r& dest_pos, const Vector3r& cur
         //else obstacle is too far
     }
 
+    //obstacles remembered by the occupancy map may be out of view of the sensors that fill obs_xy
+    checkOccupancyMap(dest_pos, cur_pos, result);
+
     //if we detected unsafe condition due to obstacle, find direction to move away to
     if (!result.is_safe && result.reason & SafetyViolationType_::Obstacle) {
         //look for each surrounding tick to see if we have obstacle free angle
@@ -137,6 +140,55 @@ void SafetyEval::isSafeDestination(const Vector3r& dest_pos, const Vector3r& cur
     //else no suggestions required
 }
 
+void SafetyEval::checkOccupancyMap(const Vector3r& dest_pos, const Vector3r& cur_pos, SafetyEval::EvalResult& result)
+{
+    if (occupancy_map_ptr_ == nullptr)
+        return;
+
+    float clearance = getOccupancyMapClearance(cur_pos);
+    if (!occupancy_map_ptr_->isSegmentFree(cur_pos, dest_pos, clearance)) {
+        result.is_safe = false;
+        result.reason |= SafetyViolationType_::Obstacle;
+        //suggestions start from the closest obstacle in obs_xy
+        result.cur_obs = obs_xy_ptr_->getClosestObstacle();
+
+        //risk of staying here is the larger of what obs_xy and the map see, so avoidance velocity also
+        //reacts to obstacles only the map knows about
+        float map_risk_dist = vehicle_params_.obs_clearance - occupancy_map_ptr_->distanceToObstacle(cur_pos, vehicle_params_.obs_clearance);
+        if (std::isnan(result.cur_risk_dist) || map_risk_dist > result.cur_risk_dist)
+            result.cur_risk_dist = map_risk_dist;
+
+        if (!result.message.empty())
+            result.message.append("; ");
+        result.message.append(
+            common_utils::Utils::stringf("Path to destination %s comes closer than %f to obstacle in occupancy map",
+                VectorMath::toString(dest_pos).c_str(), clearance));
+    }
+}
+
+float SafetyEval::getOccupancyMapClearance(const Vector3r& cur_pos) const
+{
+    //when we are already within clearance, moves that don't get us any closer are allowed
+    return std::min(vehicle_params_.obs_clearance, occupancy_map_ptr_->distanceToObstacle(cur_pos, vehicle_params_.obs_clearance));
+}
+
+bool SafetyEval::isSuggestionFree(int tick, const Vector3r& cur_pos, const Quaternionr& quaternion) const
+{
+    if (occupancy_map_ptr_ == nullptr)
+        return true;
+
+    //same check as for destinations, as far as we would go at unit velocity
+    const Vector3r dest_pos = getDestination(cur_pos, tickToWorld(tick, quaternion));
+    return occupancy_map_ptr_->isSegmentFree(cur_pos, dest_pos, getOccupancyMapClearance(cur_pos));
+}
+
+Vector3r SafetyEval::tickToWorld(int tick, const Quaternionr& quaternion) const
+{
+    float angle = obs_xy_ptr_->tickToAngleMid(tick);
+    const Vector3r body = Vector3r(std::cos(angle), std::sin(angle), 0).normalized();
+    return VectorMath::transformToWorldFrame(body, quaternion, true);
+}
+
 float SafetyEval::adjustClearanceForPrStl(float base_clearance, float obs_confidence)
 {
     //3.2 comes from inverse CDF for epsilon = 0.05 (i.e. 95% confidence), author: akapoor
@@ -173,13 +225,16 @@ void SafetyEval::setSuggestedVelocity(SafetyEval::EvalResult& result, const Quat
 
         //at this point we have already determined hover is better than going to dest
         //we now determine is moving to suggested angle better than hovering?
-        if (right_risk_dist <= 0 || left_risk_dist <= 0) {
-            int suggested_tick = right_risk_dist < left_risk_dist ? right_obs.tick : left_obs.tick;
-            result.suggested_obs = right_risk_dist < left_risk_dist ? right_obs : left_obs;
+        //obs_xy may not see obstacles remembered by the occupancy map, so directions running in to them are skipped
+        bool right_ok = right_risk_dist <= 0 && isSuggestionFree(right_obs.tick, result.cur_pos, quaternion);
+        bool left_ok = left_risk_dist <= 0 && isSuggestionFree(left_obs.tick, result.cur_pos, quaternion);
+        if (right_ok || left_ok) {
+            bool use_right = right_ok && (!left_ok || right_risk_dist < left_risk_dist);
+            int suggested_tick = use_right ? right_obs.tick : left_obs.tick;
+            result.suggested_obs = use_right ? right_obs : left_obs;
             
             float suggested_angle = obs_xy_ptr_->tickToAngleMid(suggested_tick);
-            const Vector3r suggested_body = Vector3r(std::cos(suggested_angle), std::sin(suggested_angle), 0).normalized();
-            result.suggested_vec = VectorMath::transformToWorldFrame(suggested_body, quaternion, true);
+            result.suggested_vec = tickToWorld(suggested_tick, quaternion);
 
             Utils::log(Utils::stringf("right_risk_dist=%f, left_risk_dist=%f, suggested_tick=%i, suggested_angle=%f", right_risk_dist, left_risk_dist, suggested_tick, suggested_angle, suggested_angle));
 
@@ -249,6 +304,10 @@ SafetyEval::ObsAvoidanceStrategy SafetyEval::getObsAvoidanceStrategy()
 {
     return obs_strategy_;
 }
+void SafetyEval::setOccupancyMap(shared_ptr<OccupancyMap> occupancy_map_ptr)
+{
+    occupancy_map_ptr_ = occupancy_map_ptr;
+}
 
 
 }} //namespace
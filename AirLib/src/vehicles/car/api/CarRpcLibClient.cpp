@@ -33,6 +33,7 @@ STRICT_MODE_OFF
 #include "common/common_utils/WindowsApisCommonPost.hpp"
 
 #include "vehicles/car/api/CarRpcLibAdapators.hpp"
+#include "api/RpcLibFuture.hpp"
 
 STRICT_MODE_ON
 #ifdef _MSC_VER
@@ -45,6 +46,7 @@ namespace msr { namespace airlib {
 
 
 typedef msr::airlib_rpclib::CarRpcLibAdapators CarRpcLibAdapators;
+typedef msr::airlib_rpclib::RpcLibFuture RpcLibFuture;
 
 CarRpcLibClient::CarRpcLibClient(const string&  ip_address, uint16_t port, float timeout_sec)
     : RpcLibClientBase(ip_address, port, timeout_sec)
@@ -71,6 +73,22 @@ CarApiBase::CarControls CarRpcLibClient::getCarControls(const std::string& vehic
 		call("getCarControls", vehicle_name).as<CarRpcLibAdapators::CarControls>().to();
 }
 
+std::future<void> CarRpcLibClient::setCarControlsFuture(const CarApiBase::CarControls& controls, const std::string& vehicle_name)
+{
+    return RpcLibFuture::done(static_cast<rpc::client*>(getClient())->
+        async_call("setCarControls", CarRpcLibAdapators::CarControls(controls), vehicle_name), getTimeoutSec());
+}
+std::future<CarApiBase::CarState> CarRpcLibClient::getCarStateFuture(const std::string& vehicle_name)
+{
+    return RpcLibFuture::to<CarRpcLibAdapators::CarState>(static_cast<rpc::client*>(getClient())->
+        async_call("getCarState", vehicle_name), getTimeoutSec());
+}
+std::future<CarApiBase::CarControls> CarRpcLibClient::getCarControlsFuture(const std::string& vehicle_name)
+{
+    return RpcLibFuture::to<CarRpcLibAdapators::CarControls>(static_cast<rpc::client*>(getClient())->
+        async_call("getCarControls", vehicle_name), getTimeoutSec());
+}
+
 
 }} //namespace
 
@@ -494,6 +494,16 @@ void MultirotorApiBase::setSafetyEval(const shared_ptr<SafetyEval> safety_eval_p
 {
     SingleCall lock(this);
     safety_eval_ptr_ = safety_eval_ptr;
+    if (safety_eval_ptr_ != nullptr && occupancy_map_ptr_ != nullptr)
+        safety_eval_ptr_->setOccupancyMap(occupancy_map_ptr_);
+}
+
+void MultirotorApiBase::setOccupancyMap(const shared_ptr<OccupancyMap> occupancy_map_ptr)
+{
+    SingleCall lock(this);
+    occupancy_map_ptr_ = occupancy_map_ptr;
+    if (safety_eval_ptr_ != nullptr)
+        safety_eval_ptr_->setOccupancyMap(occupancy_map_ptr_);
 }
 
 RCData MultirotorApiBase::estimateRCTrims(float trimduration, float minCountForTrim, float maxTrim)
@@ -32,6 +32,7 @@ STRICT_MODE_OFF
 #include "common/common_utils/WindowsApisCommonPost.hpp"
 
 #include "vehicles/multirotor/api/MultirotorRpcLibAdapators.hpp"
+#include "api/RpcLibFuture.hpp"
 
 STRICT_MODE_ON
 #ifdef _MSC_VER
@@ -43,6 +44,7 @@ namespace msr { namespace airlib {
 
 
 typedef msr::airlib_rpclib::MultirotorRpcLibAdapators MultirotorRpcLibAdapators;
+typedef msr::airlib_rpclib::RpcLibFuture RpcLibFuture;
 
 struct MultirotorRpcLibClient::impl {
 public:
@@ -174,6 +176,23 @@ void MultirotorRpcLibClient::moveByRC(const RCData& rc_data, const std::string&
     static_cast<rpc::client*>(getClient())->call("moveByRC", MultirotorRpcLibAdapators::RCData(rc_data), vehicle_name);
 }
 
+std::future<void> MultirotorRpcLibClient::moveByRCFuture(const RCData& rc_data, const std::string& vehicle_name)
+{
+    return RpcLibFuture::done(static_cast<rpc::client*>(getClient())->
+        async_call("moveByRC", MultirotorRpcLibAdapators::RCData(rc_data), vehicle_name), getTimeoutSec());
+}
+std::future<MultirotorState> MultirotorRpcLibClient::getMultirotorStateFuture(const std::string& vehicle_name)
+{
+    return RpcLibFuture::to<MultirotorRpcLibAdapators::MultirotorState>(static_cast<rpc::client*>(getClient())->
+        async_call("getMultirotorState", vehicle_name), getTimeoutSec());
+}
+std::future<bool> MultirotorRpcLibClient::setSafetyFuture(SafetyEval::SafetyViolationType enable_reasons, float obs_clearance, SafetyEval::ObsAvoidanceStrategy obs_startegy,
+    float obs_avoidance_vel, const Vector3r& origin, float xy_length, float max_z, float min_z, const std::string& vehicle_name)
+{
+    return RpcLibFuture::as<bool>(static_cast<rpc::client*>(getClient())->async_call("setSafety", static_cast<uint>(enable_reasons), obs_clearance, obs_startegy,
+        obs_avoidance_vel, MultirotorRpcLibAdapators::Vector3r(origin), xy_length, max_z, min_z, vehicle_name), getTimeoutSec());
+}
+
 //return value of last task. It should be true if task completed without
 //cancellation or timeout
 MultirotorRpcLibClient* MultirotorRpcLibClient::waitOnLastTask(bool* task_result, float timeout_sec)
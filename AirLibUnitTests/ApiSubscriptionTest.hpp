@@ -0,0 +1,85 @@
+#ifndef msr_AirLibUnitTests_ApiSubscriptionTest_hpp
+#define msr_AirLibUnitTests_ApiSubscriptionTest_hpp
+
+#include "TestBase.hpp"
+#include "api/ApiSubscription.hpp"
+#include <future>
+
+namespace msr { namespace airlib {
+
+class ApiSubscriptionTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        testNewSamplesOnly();
+        testBoundedQueue();
+        testStop();
+    }
+
+private:
+    struct Sample {
+        uint64_t sequence = 0;
+        TTimePoint time_stamp = 0;
+    };
+
+    //sensor updates at 1/4 of sampling rate so most samples are duplicates
+    void testNewSamplesOnly()
+    {
+        std::atomic<unsigned int> call_count(0);
+        ApiSubscription<Sample> subscription([&call_count]() {
+            Sample sample;
+            sample.time_stamp = ++call_count / 4;
+            return sample;
+        }, 1000, 100);
+
+        std::vector<Sample> samples;
+        while (samples.size() < 5) {
+            std::vector<Sample> polled = subscription.poll(1);
+            testAssert(!polled.empty(), "poll timed out although samples were available");
+            samples.insert(samples.end(), polled.begin(), polled.end());
+        }
+        subscription.stop();
+
+        for (size_t i = 1; i < samples.size(); ++i) {
+            testAssert(samples[i].sequence == samples[i - 1].sequence + 1, "sequence numbers are not consecutive");
+            testAssert(samples[i].time_stamp == samples[i - 1].time_stamp + 1, "sample was duplicated or lost");
+        }
+    }
+
+    void testBoundedQueue()
+    {
+        std::atomic<TTimePoint> time_stamp(0);
+        ApiSubscription<Sample> subscription([&time_stamp]() {
+            Sample sample;
+            sample.time_stamp = ++time_stamp;
+            return sample;
+        }, 1000, 3);
+
+        while (time_stamp < 10)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::vector<Sample> samples = subscription.poll(0);
+        subscription.stop();
+
+        testAssert(samples.size() == 3, "queue is not bounded");
+        testAssert(samples.back().sequence - samples.front().sequence == 2, "oldest samples were not dropped");
+    }
+
+    void testStop()
+    {
+        //nothing new is ever sampled so only stop can end the poll
+        ApiSubscription<Sample> subscription([]() { return Sample(); }, 1000, 3);
+        subscription.poll(1);
+
+        auto stopper = std::async(std::launch::async, [&subscription]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            subscription.stop();
+        });
+        std::vector<Sample> samples = subscription.poll(10);
+        stopper.get();
+
+        testAssert(samples.empty() && subscription.isStopped(), "stop did not end poll");
+    }
+};
+
+}}
+#endif
@@ -0,0 +1,180 @@
+#ifndef msr_AirLibUnitTests_DatasetWriterTest_hpp
+#define msr_AirLibUnitTests_DatasetWriterTest_hpp
+
+#include "TestBase.hpp"
+#include "common/common_utils/DatasetWriter.hpp"
+#include "common/common_utils/FileSystem.hpp"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <cstdlib>
+#include <cstring>
+
+namespace msr { namespace airlib {
+
+class DatasetWriterTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        using common_utils::FileSystem;
+
+        root_ = FileSystem::ensureFolder(FileSystem::getAppDataFolder(), "DatasetWriterTest");
+        FileSystem::ensureFolder(root_, "left");
+        FileSystem::ensureFolder(root_, "depth");
+
+        testFiles();
+        testShards();
+        testErrors();
+    }
+
+private:
+    typedef common_utils::DatasetWriter DatasetWriter;
+
+    void testFiles()
+    {
+        DatasetWriter::Options options;
+        options.workers = 2;
+        options.max_pending = 1;
+        DatasetWriter writer(root_, options);
+
+        //more frames than can be pending so submit has to wait for the workers
+        const unsigned int frame_count = 5;
+        for (unsigned int i = 0; i < frame_count; ++i)
+            writer.submit(makeFrame(i));
+        writer.flush();
+
+        DatasetWriter::Stats stats = writer.getStats();
+        testAssert(stats.frames == frame_count, "not all frames were written");
+        testAssert(stats.files == 3 * frame_count, "not all files were written");
+
+        std::vector<uint8_t> png = readFile(root_ + "/left/000003.png");
+        testAssert(png.size() > 33 && std::memcmp(png.data(), "\x89PNG\r\n\x1a\n", 8) == 0, "PNG signature is wrong");
+        testAssert(readUInt32(png.data() + 16) == width && readUInt32(png.data() + 20) == height, "PNG size is wrong");
+        testAssert(png[24] == 8 && png[25] == 2, "PNG format is wrong");
+        //smooth gradient must compress well
+        testAssert(png.size() < width * height * 3 / 4, "PNG is not compressed");
+
+        std::vector<uint8_t> depth = readFile(root_ + "/depth/000003.png");
+        testAssert(depth.size() > 33 && depth[24] == 16 && depth[25] == 0, "16 bit PNG format is wrong");
+
+        std::vector<uint8_t> pfm = readFile(root_ + "/000003.pfm");
+        const std::string header = "Pf\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1\n";
+        testAssert(pfm.size() == header.size() + width * height * sizeof(float), "PFM size is wrong");
+        testAssert(std::memcmp(pfm.data(), header.data(), header.size()) == 0, "PFM header is wrong");
+        std::vector<float> values = makeFloats(3);
+        testAssert(std::memcmp(pfm.data() + header.size(), values.data(), values.size() * sizeof(float)) == 0, "PFM data is wrong");
+
+        //buffers of written frames come back
+        const std::vector<uint8_t> bytes = writer.getBytes(16);
+        testAssert(bytes.size() == 16 && bytes.capacity() >= width * height * 3, "written buffer was not reused");
+
+        writer.close();
+    }
+
+    void testShards()
+    {
+        DatasetWriter::Options options;
+        options.workers = 3;
+        options.frames_per_shard = 2;
+        {
+            DatasetWriter writer(root_, options);
+            for (unsigned int i = 0; i < 5; ++i)
+                writer.submit(makeFrame(i));
+            writer.close();
+        }
+
+        //2 + 2 + 1 frames, 3 entries each
+        checkShard(root_ + "/shard_000000.tar", 6);
+        checkShard(root_ + "/shard_000001.tar", 6);
+        checkShard(root_ + "/shard_000002.tar", 3);
+    }
+
+    void testErrors()
+    {
+        DatasetWriter writer(root_ + "/does_not_exist");
+        writer.submit(makeFrame(0));
+
+        bool thrown = false;
+        try {
+            writer.flush();
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        testAssert(thrown, "write error was not reported");
+    }
+
+    void checkShard(const std::string& path, unsigned int expected_entries)
+    {
+        std::vector<uint8_t> tar = readFile(path);
+        testAssert(tar.size() % 512 == 0 && tar.size() >= 1024, "tar size is wrong");
+
+        unsigned int entries = 0;
+        size_t offset = 0;
+        while (offset + 512 <= tar.size() && tar[offset] != 0) {
+            const char* header = reinterpret_cast<const char*>(tar.data() + offset);
+            testAssert(std::memcmp(header + 257, "ustar", 5) == 0, "tar header is wrong");
+
+            unsigned int checksum = 0;
+            for (int i = 0; i < 512; ++i)
+                checksum += i >= 148 && i < 156 ? ' ' : static_cast<unsigned char>(header[i]);
+            testAssert(std::strtoul(header + 148, nullptr, 8) == checksum, "tar checksum is wrong");
+
+            size_t size = std::strtoull(header + 124, nullptr, 8);
+            offset += 512 + (size + 511) / 512 * 512;
+            ++entries;
+        }
+        testAssert(entries == expected_entries, "tar has wrong number of entries");
+        testAssert(offset + 1024 == tar.size(), "tar end is wrong");
+    }
+
+    DatasetWriter::Frame makeFrame(unsigned int index) const
+    {
+        std::vector<uint8_t> rgb(width * height * 3);
+        std::vector<uint16_t> depth(width * height);
+        for (unsigned int y = 0; y < height; ++y) {
+            for (unsigned int x = 0; x < width; ++x) {
+                uint8_t* pixel = &rgb[3 * (y * width + x)];
+                pixel[0] = static_cast<uint8_t>(x + index);
+                pixel[1] = static_cast<uint8_t>(y);
+                pixel[2] = static_cast<uint8_t>(x + y);
+                depth[y * width + x] = static_cast<uint16_t>(1000 + 10 * y + index);
+            }
+        }
+
+        char name[16];
+        std::snprintf(name, sizeof(name), "%06u", index);
+        DatasetWriter::Frame frame;
+        frame.addPng(std::string("left/") + name + ".png", width, height, 3, std::move(rgb));
+        frame.addPng(std::string("depth/") + name + ".png", width, height, std::move(depth));
+        frame.addPfm(std::string(name) + ".pfm", width, height, makeFloats(index));
+        return frame;
+    }
+
+    std::vector<float> makeFloats(unsigned int index) const
+    {
+        std::vector<float> values(width * height);
+        for (size_t i = 0; i < values.size(); ++i)
+            values[i] = i * 0.25f + index;
+        return values;
+    }
+
+    static std::vector<uint8_t> readFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    static uint32_t readUInt32(const uint8_t* p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+    }
+
+private:
+    static constexpr unsigned int width = 64, height = 48;
+    std::string root_;
+};
+
+}}
+#endif
@@ -0,0 +1,83 @@
+#ifndef msr_AirLibUnitTests_DepthWindowQueryTest_hpp
+#define msr_AirLibUnitTests_DepthWindowQueryTest_hpp
+
+#include "TestBase.hpp"
+#include "common/common_utils/DepthWindowQuery.hpp"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cfloat>
+
+namespace msr { namespace airlib {
+
+class DepthWindowQueryTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        //sizes that are not powers of 2 so blocks overlap
+        const int width = 45, height = 27;
+        std::mt19937 gen(7);
+        std::uniform_real_distribution<float> dist(0.5f, 20.0f);
+        std::vector<float> depth(width * height);
+        for (auto& v : depth)
+            v = dist(gen);
+        depth[5] = std::nanf("");
+
+        common_utils::DepthWindowQuery query;
+        query.build(depth.data(), width, height, 5.0f);
+        query.buildMinDepth(depth.data());
+        checkWindows(query, depth, width, height, gen);
+
+        //windows larger than the table need more blocks
+        query.buildMinDepth(depth.data(), 6, 3);
+        checkWindows(query, depth, width, height, gen);
+
+        query.buildMinDepth(depth.data(), 1, 1);
+        checkWindows(query, depth, width, height, gen);
+
+        testAssert(query.pixelCount(10, 10, 10, 20) == 0, "empty window has pixels");
+        testAssert(query.minDepth(-5, -5, 0, 3) == FLT_MAX, "window outside image has a minimum");
+    }
+
+private:
+    void checkWindows(const common_utils::DepthWindowQuery& query, const std::vector<float>& depth, int width, int height, std::mt19937& gen)
+    {
+        //windows may reach out of the image
+        std::uniform_int_distribution<int> x_dist(-3, width + 3), y_dist(-3, height + 3);
+        for (int n = 0; n < 500; ++n) {
+            int x0 = x_dist(gen), x1 = x_dist(gen), y0 = y_dist(gen), y1 = y_dist(gen);
+            if (x0 > x1)
+                std::swap(x0, x1);
+            if (y0 > y1)
+                std::swap(y0, y1);
+
+            unsigned int count = 0, obstacles = 0;
+            double sum = 0;
+            bool has_nan = false;
+            float min_depth = FLT_MAX;
+            for (int y = std::max(y0, 0); y < std::min(y1, height); ++y) {
+                for (int x = std::max(x0, 0); x < std::min(x1, width); ++x) {
+                    float d = depth[y * width + x];
+                    ++count;
+                    if (std::isnan(d)) {
+                        has_nan = true;
+                        continue;
+                    }
+                    sum += d;
+                    obstacles += d < 5.0f ? 1 : 0;
+                    min_depth = std::min(min_depth, d);
+                }
+            }
+
+            testAssert(query.pixelCount(x0, y0, x1, y1) == count, "pixel count is wrong");
+            testAssert(query.obstacleCount(x0, y0, x1, y1) == obstacles, "obstacle count is wrong");
+            testAssert(query.minDepth(x0, y0, x1, y1) == min_depth, "min depth is wrong");
+            testAssert(query.isCloser(x0, y0, x1, y1, min_depth + 0.01f) == (count > (has_nan ? 1u : 0u)),
+                "closer test is wrong");
+            testAssert(std::abs(query.depthSum(x0, y0, x1, y1) - sum) < 1E-6 * (1 + sum), "depth sum is wrong");
+        }
+    }
+};
+
+}}
+#endif
@@ -0,0 +1,138 @@
+#ifndef msr_AirLibUnitTests_GridSearchTest_hpp
+#define msr_AirLibUnitTests_GridSearchTest_hpp
+
+#include "TestBase.hpp"
+#include "common/common_utils/GridSearch.hpp"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <limits>
+#include <functional>
+#include <queue>
+
+namespace msr { namespace airlib {
+
+class GridSearchTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        std::mt19937 gen(11);
+
+        //flat and 3D grids
+        testSearches(23, 17, 1, gen);
+        testSearches(12, 9, 6, gen);
+
+        //start inside an obstacle can still leave it, blocked goal can't be reached
+        common_utils::GridSearch search(5, 5, 1);
+        std::vector<size_t> path;
+        search.setBlocked(search.toCell(0, 0, 0), true);
+        testAssert(search.findPath(search.toCell(0, 0, 0), search.toCell(4, 4, 0), path), "can't leave blocked start");
+        testAssert(path.size() == 5, "diagonal path has wrong length");
+        search.setBlocked(search.toCell(4, 4, 0), true);
+        testAssert(!search.findPath(search.toCell(0, 0, 0), search.toCell(4, 4, 0), path), "blocked goal was reached");
+    }
+
+private:
+    void testSearches(unsigned int size_x, unsigned int size_y, unsigned int size_z, std::mt19937& gen)
+    {
+        common_utils::GridSearch search(size_x, size_y, size_z);
+        const size_t count = search.getCellCount();
+        std::uniform_int_distribution<size_t> cell_dist(0, count - 1);
+        std::bernoulli_distribution blocked_dist(0.25);
+        for (size_t cell = 0; cell < count; ++cell)
+            search.setBlocked(cell, blocked_dist(gen));
+
+        //A* gives the shortest paths
+        std::vector<size_t> path;
+        for (int n = 0; n < 20; ++n) {
+            const size_t start = cell_dist(gen), goal = cell_dist(gen);
+            const float expected = dijkstra(search, start, goal);
+            const bool found = search.findPath(start, goal, path);
+            testAssert(found == (expected < std::numeric_limits<float>::infinity()), "A* found path to unreachable goal or missed one");
+            if (found) {
+                testAssert(std::abs(search.getPathCost() - expected) < 1E-3f, "A* path is not shortest");
+                checkPath(search, path, start, goal);
+            }
+        }
+
+        //D* Lite follows its path while cells change and stays shortest
+        const size_t goal = cell_dist(gen);
+        search.setBlocked(goal, false);
+        size_t start = cell_dist(gen);
+        search.setGoal(goal);
+        for (int step = 0; step < 30; ++step) {
+            const bool found = search.replan(start, path);
+            const float expected = dijkstra(search, start, goal);
+            testAssert(found == (expected < std::numeric_limits<float>::infinity()), "D* Lite found path to unreachable goal or missed one");
+            if (found) {
+                testAssert(std::abs(search.getPathCost() - expected) < 1E-3f, "D* Lite path is not shortest");
+                checkPath(search, path, start, goal);
+                if (path.size() > 1)
+                    start = path[1];
+            }
+            else
+                start = cell_dist(gen);
+
+            for (int k = 0; k < 5; ++k) {
+                const size_t cell = cell_dist(gen);
+                if (cell != goal)
+                    search.setBlocked(cell, !search.isBlocked(cell));
+            }
+        }
+    }
+
+    void checkPath(const common_utils::GridSearch& search, const std::vector<size_t>& path, size_t start, size_t goal)
+    {
+        testAssert(path.front() == start && path.back() == goal, "path doesn't connect start and goal");
+        float cost = 0;
+        for (size_t i = 1; i < path.size(); ++i) {
+            unsigned int x0, y0, z0, x1, y1, z1;
+            search.toCoords(path[i - 1], x0, y0, z0);
+            search.toCoords(path[i], x1, y1, z1);
+            const int dx = int(x1) - int(x0), dy = int(y1) - int(y0), dz = int(z1) - int(z0);
+            testAssert(std::abs(dx) <= 1 && std::abs(dy) <= 1 && std::abs(dz) <= 1, "path jumps");
+            testAssert(!search.isBlocked(path[i]), "path enters blocked cell");
+            cost += std::sqrt(float(dx * dx + dy * dy + dz * dz));
+        }
+        testAssert(std::abs(cost - search.getPathCost()) < 1E-3f, "path cost doesn't match path");
+    }
+
+    //reference search without heuristic or incremental state
+    float dijkstra(const common_utils::GridSearch& search, size_t start, size_t goal)
+    {
+        typedef std::pair<float, size_t> Entry;
+        std::vector<float> dist(search.getCellCount(), std::numeric_limits<float>::infinity());
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+        dist[start] = 0;
+        open.push(Entry(0.0f, start));
+        while (!open.empty()) {
+            const Entry top = open.top();
+            open.pop();
+            if (top.first > dist[top.second])
+                continue;
+            unsigned int x, y, z;
+            search.toCoords(top.second, x, y, z);
+            for (int dz = -1; dz <= 1; ++dz) {
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        const int nx = int(x) + dx, ny = int(y) + dy, nz = int(z) + dz;
+                        if (nx < 0 || ny < 0 || nz < 0 || nx >= int(search.getSizeX()) || ny >= int(search.getSizeY()) || nz >= int(search.getSizeZ()))
+                            continue;
+                        const size_t cell = search.toCell(nx, ny, nz);
+                        if (cell == top.second || search.isBlocked(cell))
+                            continue;
+                        const float d = top.first + std::sqrt(float(dx * dx + dy * dy + dz * dz));
+                        if (d < dist[cell]) {
+                            dist[cell] = d;
+                            open.push(Entry(d, cell));
+                        }
+                    }
+                }
+            }
+        }
+        return dist[goal];
+    }
+};
+
+}}
+#endif
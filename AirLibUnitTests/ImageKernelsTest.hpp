@@ -0,0 +1,144 @@
+#ifndef msr_AirLibUnitTests_ImageKernelsTest_hpp
+#define msr_AirLibUnitTests_ImageKernelsTest_hpp
+
+#include "TestBase.hpp"
+#include "common/common_utils/ImageKernels.hpp"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+
+namespace msr { namespace airlib {
+
+class ImageKernelsTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        using common_utils::ImageKernels;
+
+        //width is not a multiple of 4 so every row also goes through the scalar tail
+        const int width = 37, height = 5;
+        const size_t count = width * height;
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<float> dist(0.5f, 100.0f);
+
+        std::vector<float> depth(count);
+        for (auto& v : depth)
+            v = dist(gen);
+
+        std::vector<float> planar = depth;
+        ImageKernels::perspectiveToPlanarDepth(planar.data(), width, height, 20.0f);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                float dx = x - (width / 2.0f - 1), dy = y - (height / 2.0f - 1);
+                float expected = depth[y * width + x] / std::sqrt(1 + (dx * dx + dy * dy) / (20.0f * 20.0f));
+                testAssert(closeTo(planar[y * width + x], expected), "planar depth is wrong");
+            }
+        }
+
+        std::vector<float> disparity = depth;
+        ImageKernels::depthToDisparity(disparity.data(), count, 320, 0.25f);
+        for (size_t i = 0; i < count; ++i)
+            testAssert(closeTo(disparity[i], 80 / depth[i]), "disparity is wrong");
+
+        //SGM disparities are negative with FLT_MAX where there is no match
+        std::vector<float> sgm(count), sgm_depth(count), abs_disparity(count);
+        for (size_t i = 0; i < count; ++i)
+            sgm[i] = i % 7 == 0 ? FLT_MAX : (i % 11 == 0 ? 0 : -depth[i]);
+        ImageKernels::disparityToDepth(sgm.data(), count, 320, 0.25f, sgm_depth.data(), abs_disparity.data());
+        for (size_t i = 0; i < count; ++i) {
+            bool valid = sgm[i] < 0;
+            testAssert(closeTo(sgm_depth[i], valid ? 80 / depth[i] : 0), "depth from disparity is wrong");
+            testAssert(abs_disparity[i] == (valid ? depth[i] : 0), "absolute disparity is wrong");
+        }
+
+        std::vector<float> normalized = depth;
+        ImageKernels::denormalizeDisparity(normalized.data(), count, width);
+        for (size_t i = 0; i < count; ++i)
+            testAssert(normalized[i] == depth[i] * width, "denormalized disparity is wrong");
+
+        testColorize(depth, 90.0f);
+        testGray(depth);
+        testRgbaToRgb();
+
+        std::vector<float> meters = { 0.0004f, 1.2345f, 65.534f, 70.0f, -1.0f, FLT_MAX, std::nanf("") };
+        std::vector<uint16_t> millimeters(meters.size());
+        ImageKernels::toUInt16(meters.data(), meters.size(), 1000.0f, millimeters.data());
+        const uint16_t expected_mm[] = { 0, 1235, 65534, 0, 0, 0, 0 };
+        for (size_t i = 0; i < meters.size(); ++i)
+            testAssert(millimeters[i] == expected_mm[i], "16 bit value is wrong");
+    }
+
+private:
+    static bool closeTo(float value, float expected)
+    {
+        return std::abs(value - expected) <= 1E-5f * std::abs(expected);
+    }
+
+    //same colors as the loop DataCollectorSGM used before, up to rounding
+    void testColorize(std::vector<float> values, float max_value)
+    {
+        values[0] = -1;
+        values[1] = max_value;
+        values[2] = FLT_MAX;
+        values[3] = std::nanf("");
+
+        std::vector<uint8_t> rgb(values.size() * 3);
+        common_utils::ImageKernels::colorize(values.data(), values.size(), max_value, rgb.data());
+        for (size_t i = 0; i < values.size(); ++i) {
+            float x = values[i] * 6 / max_value;
+            float expected[3] = { 0, 0, 0 };
+            if (values[i] >= 0 && values[i] < max_value) {
+                if (x <= 1 || x >= 5) expected[0] = 1;
+                else if (x >= 4) expected[0] = x - 4;
+                else if (x < 2) expected[0] = 1 - (x - 1);
+
+                if (x >= 1 && x < 3) expected[1] = 1;
+                else if (x < 1) expected[1] = x;
+                else if (x < 4) expected[1] = 1 - (x - 3);
+
+                if (x >= 3 && x < 5) expected[2] = 1;
+                else if (x >= 2 && x < 3) expected[2] = x - 2;
+                else if (x >= 5) expected[2] = 1 - (x - 5);
+            }
+            for (int c = 0; c < 3; ++c)
+                testAssert(std::abs(rgb[3 * i + c] - expected[c] * 255) <= 1, "color is wrong");
+        }
+    }
+
+    void testGray(std::vector<float> values)
+    {
+        values[0] = -5;
+        values[1] = 1E6f;
+        values[2] = std::nanf("");
+
+        std::vector<uint8_t> gray(values.size());
+        common_utils::ImageKernels::toGray(values.data(), values.size(), gray.data(), false, 2.0f);
+        for (size_t i = 0; i < values.size(); ++i) {
+            float expected = values[i] * 2.0f;
+            uint8_t saturated = static_cast<uint8_t>(expected > 255 ? 255 : (expected > 0 ? expected : 0));
+            testAssert(gray[i] == saturated, "gray value is wrong");
+        }
+        common_utils::ImageKernels::toGray(values.data() + 3, values.size() - 3, gray.data(), true, 100.0f);
+        for (size_t i = 3; i < values.size(); ++i) {
+            float expected = 100.0f / values[i];
+            testAssert(gray[i - 3] == static_cast<uint8_t>(expected > 255 ? 255 : expected), "inverted gray value is wrong");
+        }
+    }
+
+    void testRgbaToRgb()
+    {
+        const size_t count = 53;
+        std::vector<uint8_t> rgba(count * 4), rgb(count * 3);
+        for (size_t i = 0; i < rgba.size(); ++i)
+            rgba[i] = static_cast<uint8_t>(i * 7);
+        common_utils::ImageKernels::rgbaToRgb(rgba.data(), count, rgb.data());
+        for (size_t i = 0; i < count; ++i)
+            for (int c = 0; c < 3; ++c)
+                testAssert(rgb[3 * i + c] == rgba[4 * i + c], "alpha was not removed");
+    }
+};
+
+}}
+#endif
@@ -0,0 +1,63 @@
+#ifndef msr_AirLibUnitTests_LockstepClockTest_hpp
+#define msr_AirLibUnitTests_LockstepClockTest_hpp
+
+#include "TestBase.hpp"
+#include "common/LockstepClock.hpp"
+#include <future>
+
+namespace msr { namespace airlib {
+
+class LockstepClockTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        //use step size that is exact in binary so deadlines fall exactly on steps
+        LockstepClock clock(1.0 / 64, static_cast<TTimePoint>(1E9));
+        const TTimePoint start = clock.nowNanos();
+
+        std::atomic<unsigned int> finished(0);
+        clock.expectThreads(2);
+        auto fast = std::async(std::launch::async, [&]() { return wakeTimes(clock, 1.0 / 16, finished); });
+        auto slow = std::async(std::launch::async, [&]() { return wakeTimes(clock, 3.0 / 16, finished); });
+
+        while (finished < 2)
+            clock.step();
+
+        std::vector<TTimePoint> fast_times = fast.get();
+        std::vector<TTimePoint> slow_times = slow.get();
+        for (unsigned int i = 0; i < kWaitCount; ++i) {
+            testAssert(fast_times[i] == clock.addTo(start, (i + 1) / 16.0), "thread was not released exactly at its deadline");
+            testAssert(slow_times[i] == clock.addTo(start, 3 * (i + 1) / 16.0), "thread was not released exactly at its deadline");
+        }
+    }
+
+private:
+    static constexpr unsigned int kWaitCount = 5;
+
+    static std::vector<TTimePoint> wakeTimes(LockstepClock& clock, TTimeDelta period, std::atomic<unsigned int>& finished)
+    {
+        clock.joinThread();
+
+        std::vector<TTimePoint> result;
+        TTimePoint deadline = clock.nowNanos();
+        for (unsigned int i = 0; i < kWaitCount; ++i) {
+            deadline = clock.addTo(deadline, period);
+            clock.sleep_for(clock.elapsedBetween(deadline, clock.nowNanos()));
+
+            //clock must not advance while joined thread is running
+            TTimePoint wake_time = clock.nowNanos();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (clock.nowNanos() != wake_time)
+                result.push_back(0);
+            else
+                result.push_back(wake_time);
+        }
+
+        clock.leaveThread();
+        ++finished;
+        return result;
+    }
+};
+
+}}
+#endif
@@ -0,0 +1,130 @@
+#ifndef msr_AirLibUnitTests_ObstacleMapTest_hpp
+#define msr_AirLibUnitTests_ObstacleMapTest_hpp
+
+#include "TestBase.hpp"
+#include "safety/ObstacleMap.hpp"
+#include <vector>
+#include <random>
+#include <thread>
+#include <atomic>
+
+namespace msr { namespace airlib {
+
+class ObstacleMapTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        std::mt19937 gen(5);
+        testQueries(7, false, gen);
+        testQueries(360, true, gen);
+        testConcurrency();
+    }
+
+private:
+    //window queries match a scan of every tick, ties included
+    void testQueries(int ticks, bool odd_blindspots, std::mt19937& gen)
+    {
+        ObstacleMap map(ticks, odd_blindspots);
+        std::vector<float> distances(ticks), confidences(ticks);
+        std::uniform_int_distribution<int> distance_dist(1, 6), tick_dist(-2 * ticks, 2 * ticks), window_dist(0, ticks / 3);
+        for (int i = 0; i < ticks; ++i) {
+            distances[i] = static_cast<float>(distance_dist(gen));
+            confidences[i] = static_cast<float>(i);
+        }
+        map.update(distances.data(), confidences.data());
+
+        for (int n = 0; n < 2000; ++n) {
+            if (n % 50 == 0) {
+                const int tick = tick_dist(gen), window = window_dist(gen);
+                const float distance = static_cast<float>(distance_dist(gen));
+                map.update(distance, tick, window, 100.0f + n);
+                for (int i = tick - window; i <= tick + window; ++i) {
+                    distances[wrap(i, ticks)] = distance;
+                    confidences[wrap(i, ticks)] = 100.0f + n;
+                }
+            }
+
+            int from_tick = tick_dist(gen), to_tick = tick_dist(gen);
+            const ObstacleMap::ObstacleInfo obs = map.hasObstacle(from_tick, to_tick);
+            if (odd_blindspots) {
+                from_tick -= wrap(from_tick, ticks) % 2;
+                to_tick += wrap(to_tick, ticks) % 2;
+            }
+            const int expected = scan(distances, from_tick, to_tick);
+            testAssert(obs.tick == expected, "window query found other tick");
+            testAssert(obs.distance == distances[expected] && obs.confidence == confidences[expected], "window query has wrong values");
+        }
+
+        const ObstacleMap::ObstacleInfo closest = map.getClosestObstacle();
+        testAssert(closest.tick == scan(distances, 0, ticks - 1), "closest obstacle is not the first closest tick");
+    }
+
+    //queries never see a partly updated map: every update sets all ticks to the same distance, so the
+    //first tick of a window must always win and distances only grow
+    void testConcurrency()
+    {
+        const int ticks = 360, updates = 2000;
+        ObstacleMap map(ticks);
+        std::atomic<bool> done(false), failed(false);
+
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 2; ++r) {
+            readers.emplace_back([&map, &done, &failed, r]() {
+                std::mt19937 gen(r);
+                std::uniform_int_distribution<int> tick_dist(0, ticks - 1);
+                float last = 0;
+                while (!done) {
+                    const int from_tick = tick_dist(gen), to_tick = tick_dist(gen);
+                    const ObstacleMap::ObstacleInfo obs = map.hasObstacle(from_tick, to_tick);
+                    if (obs.distance > updates)
+                        continue; //not updated yet
+                    if (obs.tick != from_tick || obs.distance != obs.confidence || obs.distance < last)
+                        failed = true;
+                    last = obs.distance;
+                }
+            });
+        }
+
+        std::vector<float> distances(ticks);
+        for (int k = 1; k <= updates; ++k) {
+            std::fill(distances.begin(), distances.end(), static_cast<float>(k));
+            if (k % 2)
+                map.update(distances.data(), distances.data());
+            else
+                map.update(static_cast<float>(k), 0, ticks / 2, static_cast<float>(k));
+        }
+        done = true;
+        for (std::thread& reader : readers)
+            reader.join();
+
+        testAssert(!failed, "query saw a partly updated map");
+        testAssert(map.getClosestObstacle().distance == updates, "last update was lost");
+    }
+
+    static int wrap(int tick, int ticks)
+    {
+        return ((tick % ticks) + ticks) % ticks;
+    }
+
+    //first closest tick of the window the way ObstacleMap used to scan it
+    static int scan(const std::vector<float>& distances, int from_tick, int to_tick)
+    {
+        const int ticks = static_cast<int>(distances.size());
+        if (from_tick > to_tick) {
+            from_tick = wrap(from_tick, ticks);
+            to_tick = wrap(to_tick, ticks);
+            if (from_tick > to_tick)
+                to_tick += ticks;
+        }
+        int best = -1;
+        for (int i = from_tick; i <= to_tick; ++i) {
+            const int iw = wrap(i, ticks);
+            if (best < 0 || distances[iw] < distances[best])
+                best = iw;
+        }
+        return best;
+    }
+};
+
+}}
+#endif
@@ -0,0 +1,145 @@
+#ifndef msr_AirLibUnitTests_OccupancyMapTest_hpp
+#define msr_AirLibUnitTests_OccupancyMapTest_hpp
+
+#include "TestBase.hpp"
+#include "safety/OccupancyMap.hpp"
+#include "safety/ObstacleMap.hpp"
+#include <vector>
+#include <cmath>
+
+namespace msr { namespace airlib {
+
+class OccupancyMapTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        //wall 5.1m in front of a camera at origin looking along +X, in the middle of a voxel
+        const unsigned int width = 64, height = 48;
+        const real_T fov = Utils::degreesToRadians(90.0f);
+        const std::vector<float> depth(width * height, 5.1f);
+        const Pose camera(Vector3r::Zero(), Quaternionr::Identity());
+
+        OccupancyMap map;
+        for (int i = 0; i < 3; ++i)
+            map.integrateDepth(depth.data(), width, height, fov, false, camera);
+
+        testAssert(map.isOccupied(Vector3r(5.1f, 0.1f, 0.1f)), "wall is not occupied");
+        testAssert(map.isOccupied(Vector3r(5.1f, -3.0f, 2.0f)), "wall is not occupied off center");
+        testAssert(map.getLogOdds(Vector3r(2.1f, 0.1f, 0.1f)) < 0, "space before wall is not free");
+        testAssert(map.getLogOdds(Vector3r(7.1f, 0.1f, 0.1f)) == 0, "space behind wall was observed");
+        testAssert(map.getLogOdds(Vector3r(-2.1f, 0.1f, 0.1f)) == 0, "space behind camera was observed");
+        testAssert(std::abs(map.distanceToObstacle(Vector3r(2, 0, 0), 10) - 3) < 0.3f, "wrong distance to wall");
+        testAssert(map.distanceToObstacle(Vector3r(-5, 0, 0), 2) == 2, "obstacle found out of range");
+        testAssert(map.isCollisionFree(Vector3r(2, 0, 0), 2), "free sphere collides");
+        testAssert(!map.isCollisionFree(Vector3r(4.5f, 0, 0), 1), "sphere at wall is free");
+        testAssert(map.isSegmentFree(Vector3r::Zero(), Vector3r(2, 1, 0), 1), "free segment collides");
+        testAssert(!map.isSegmentFree(Vector3r::Zero(), Vector3r(8, 0, 0), 0.5f), "segment through wall is free");
+        std::vector<Vector3r> voxels;
+        map.getOccupiedVoxels(Vector3r(0, -1, -1), Vector3r(8, 1, 1), voxels);
+        testAssert(voxels.size() == 100, "wrong number of wall voxels");
+        for (const Vector3r& voxel : voxels)
+            testAssert(std::abs(voxel.x() - 5.1f) < 1E-3f, "voxel is not on the wall");
+
+        //wall is still known after the camera turned away from it
+        const Pose turned(Vector3r::Zero(), VectorMath::toQuaternion(0, 0, Utils::degreesToRadians(180.0f)));
+        map.integrateDepth(depth.data(), width, height, fov, false, turned);
+        testAssert(map.isOccupied(Vector3r(5.1f, 0.1f, 0.1f)), "wall was forgotten");
+        testAssert(map.isOccupied(Vector3r(-5.1f, 0.1f, 0.1f)), "wall behind is not occupied");
+
+        //free observations clear the wall again
+        const std::vector<float> far_depth(width * height, 10.1f);
+        for (int i = 0; i < 8; ++i)
+            map.integrateDepth(far_depth.data(), width, height, fov, false, camera);
+        testAssert(!map.isOccupied(Vector3r(5.1f, 0.1f, 0.1f)), "wall was not cleared");
+        testAssert(map.isOccupied(Vector3r(10.1f, 0.1f, 0.1f)), "far wall is not occupied");
+
+        testObstacleMap(depth, width, height, fov, camera);
+        testResponse(depth, width, height, fov, camera);
+        testThreads(width, height, fov);
+    }
+
+private:
+    void testObstacleMap(const std::vector<float>& depth, unsigned int width, unsigned int height, real_T fov, const Pose& camera)
+    {
+        OccupancyMap map;
+        map.integrateDepth(depth.data(), width, height, fov, false, camera);
+
+        ObstacleMap obstacle_map(8);
+        map.updateObstacleMap(obstacle_map, Pose(Vector3r(0, 0, 0), Quaternionr::Identity()), 10, 1);
+        const ObstacleMap::ObstacleInfo front = obstacle_map.hasObstacle(0, 0);
+        testAssert(std::abs(front.distance - 5) < 0.3f, "wrong distance to wall in front");
+        testAssert(front.confidence > 0.5f, "wall has no confidence");
+        testAssert(obstacle_map.hasObstacle(4, 4).distance > 10, "obstacle behind");
+
+        //vehicle turned left sees the wall on its right
+        map.updateObstacleMap(obstacle_map, Pose(Vector3r(0, 0, 0), VectorMath::toQuaternion(0, 0, Utils::degreesToRadians(-90.0f))), 10, 1);
+        testAssert(std::abs(obstacle_map.hasObstacle(2, 2).distance - 5) < 0.3f, "wrong distance to wall on the right");
+        testAssert(obstacle_map.hasObstacle(0, 0).distance > 10, "obstacle in front");
+    }
+
+    //perspective depth of the same wall gives the same map
+    void testResponse(const std::vector<float>& depth, unsigned int width, unsigned int height, real_T fov, const Pose& camera)
+    {
+        ImageCaptureBase::ImageResponse response;
+        response.width = width;
+        response.height = height;
+        response.pixels_as_float = true;
+        response.image_type = ImageCaptureBase::ImageType::DepthPerspective;
+        response.camera_position = camera.position;
+        response.camera_orientation = camera.orientation;
+        const float f = width / (2 * std::tan(fov / 2));
+        for (unsigned int y = 0; y < height; ++y) {
+            for (unsigned int x = 0; x < width; ++x) {
+                const float dy = (x - (width - 1) / 2.0f) / f, dz = (y - (height - 1) / 2.0f) / f;
+                response.image_data_float.push_back(depth[y * width + x] * std::sqrt(1 + dy * dy + dz * dz));
+            }
+        }
+
+        OccupancyMap planar, perspective;
+        planar.integrateDepth(depth.data(), width, height, fov, false, camera);
+        perspective.integrateDepth(response, fov);
+        testAssert(planar.getBlockCount() == perspective.getBlockCount(), "perspective depth gives other blocks");
+        for (float y = -4; y <= 4; y += 0.5f)
+            testAssert(planar.getLogOdds(Vector3r(5.1f, y, 0.1f)) == perspective.getLogOdds(Vector3r(5.1f, y, 0.1f)),
+                "perspective depth gives other voxels");
+
+        bool thrown = false;
+        response.image_type = ImageCaptureBase::ImageType::Scene;
+        try {
+            perspective.integrateDepth(response, fov);
+        }
+        catch (const std::invalid_argument&) {
+            thrown = true;
+        }
+        testAssert(thrown, "scene image was integrated");
+    }
+
+    //rows cast on several threads give the same map as on one
+    void testThreads(unsigned int width, unsigned int height, real_T fov)
+    {
+        std::vector<float> depth(width * height);
+        for (unsigned int y = 0; y < height; ++y)
+            for (unsigned int x = 0; x < width; ++x)
+                depth[y * width + x] = 2.0f + (x * 7 + y * 3) % 13;
+
+        OccupancyMap::Params params;
+        OccupancyMap serial(params);
+        params.threads = 3;
+        OccupancyMap parallel(params);
+
+        for (int i = 0; i < 4; ++i) {
+            const Pose camera(Vector3r(i * 0.3f, -i * 0.2f, 0), VectorMath::toQuaternion(0, 0, i * 0.4f));
+            serial.integrateDepth(depth.data(), width, height, fov, false, camera);
+            parallel.integrateDepth(depth.data(), width, height, fov, false, camera);
+        }
+
+        testAssert(serial.getBlockCount() == parallel.getBlockCount(), "threads give other blocks");
+        for (float x = -15; x <= 15; x += 0.7f)
+            for (float y = -15; y <= 15; y += 0.7f)
+                testAssert(serial.getLogOdds(Vector3r(x, y, 0.3f)) == parallel.getLogOdds(Vector3r(x, y, 0.3f)),
+                    "threads give other voxels");
+    }
+};
+
+}}
+#endif
@@ -0,0 +1,89 @@
+#ifndef msr_AirLibUnitTests_ParallelUpdateTest_hpp
+#define msr_AirLibUnitTests_ParallelUpdateTest_hpp
+
+#include "TestBase.hpp"
+#include "physics/World.hpp"
+#include "physics/FastPhysicsEngine.hpp"
+#include "physics/DebugPhysicsBody.hpp"
+#include "common/SteppableClock.hpp"
+
+namespace msr { namespace airlib {
+
+class ParallelUpdateTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        const std::vector<Kinematics::State> serial = simulate(false, false);
+        const std::vector<Kinematics::State> parallel = simulate(true, false);
+        const std::vector<Kinematics::State> deterministic = simulate(true, true);
+
+        for (size_t i = 0; i < serial.size(); ++i) {
+            testAssert(isSame(serial[i], parallel[i]), "parallel update did not match serial update");
+            testAssert(isSame(serial[i], deterministic[i]), "deterministic parallel update did not match serial update");
+        }
+    }
+
+private:
+    static constexpr unsigned int kBodyCount = 16;
+    static constexpr unsigned int kStepCount = 500;
+
+    std::vector<Kinematics::State> simulate(bool is_parallel, bool is_deterministic)
+    {
+        auto clock = std::make_shared<SteppableClock>(3E-3f, static_cast<TTimePoint>(1E9));
+        ClockFactory::get(clock);
+
+        std::vector<std::unique_ptr<Kinematics>> kinematics;
+        std::vector<std::unique_ptr<Environment>> environments;
+        std::vector<std::unique_ptr<DebugPhysicsBody>> bodies;
+
+        World world(std::unique_ptr<PhysicsEngineBase>(new FastPhysicsEngine()));
+        for (unsigned int i = 0; i < kBodyCount; ++i) {
+            Kinematics::State initial = Kinematics::State::zero();
+            initial.pose.position = Vector3r(static_cast<real_T>(i), 0, -10);
+            initial.twist.linear = Vector3r(0.5f * i, -0.25f * i, 0);
+            initial.twist.angular = Vector3r(0.1f * i, 0, -0.05f * i);
+
+            //computed fields are overwritten by Environment, set here so no uninitialized values are copied
+            Environment::State initial_environment(initial.pose.position, GeoPoint());
+            initial_environment.gravity = Vector3r::Zero();
+            initial_environment.air_pressure = initial_environment.temperature = initial_environment.air_density = 0;
+
+            kinematics.emplace_back(new Kinematics(initial));
+            environments.emplace_back(new Environment(initial_environment));
+            bodies.emplace_back(new DebugPhysicsBody());
+            bodies.back()->initialize(kinematics.back().get(), environments.back().get());
+            bodies.back()->setPrintKinematics(false);
+            world.insert(bodies.back().get());
+        }
+
+        if (is_parallel)
+            world.enableParallelUpdate(4, is_deterministic);
+
+        world.reset();
+        for (auto& body_kinematics : kinematics)
+            body_kinematics->reset();
+
+        for (unsigned int step = 0; step < kStepCount; ++step)
+            world.update();
+
+        std::vector<Kinematics::State> result;
+        for (const auto& body : bodies)
+            result.push_back(body->getKinematics());
+
+        ClockFactory::get(std::make_shared<ScalableClock>());
+        return result;
+    }
+
+    static bool isSame(const Kinematics::State& lhs, const Kinematics::State& rhs)
+    {
+        return lhs.pose.position == rhs.pose.position
+            && lhs.pose.orientation.coeffs() == rhs.pose.orientation.coeffs()
+            && lhs.twist.linear == rhs.twist.linear
+            && lhs.twist.angular == rhs.twist.angular
+            && lhs.accelerations.linear == rhs.accelerations.linear
+            && lhs.accelerations.angular == rhs.accelerations.angular;
+    }
+};
+
+}}
+#endif
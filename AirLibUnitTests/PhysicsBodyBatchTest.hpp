@@ -0,0 +1,80 @@
+#ifndef msr_AirLibUnitTests_PhysicsBodyBatchTest_hpp
+#define msr_AirLibUnitTests_PhysicsBodyBatchTest_hpp
+
+#include "TestBase.hpp"
+#include "physics/FastPhysicsEngine.hpp"
+#include "physics/DebugPhysicsBody.hpp"
+#include "common/SteppableClock.hpp"
+
+namespace msr { namespace airlib {
+
+class PhysicsBodyBatchTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        const std::vector<Kinematics::State> per_body = simulate(false);
+        const std::vector<Kinematics::State> batched = simulate(true);
+
+        for (size_t i = 0; i < per_body.size(); ++i) {
+            testAssert(isClose(per_body[i].pose.position, batched[i].pose.position), "batched position differs from per-body integration");
+            testAssert(isClose(per_body[i].pose.orientation.coeffs(), batched[i].pose.orientation.coeffs()), "batched orientation differs from per-body integration");
+            testAssert(isClose(per_body[i].twist.linear, batched[i].twist.linear), "batched linear velocity differs from per-body integration");
+            testAssert(isClose(per_body[i].twist.angular, batched[i].twist.angular), "batched angular velocity differs from per-body integration");
+        }
+    }
+
+private:
+    static constexpr unsigned int kBodyCount = 9;
+    static constexpr unsigned int kStepCount = 300;
+
+    std::vector<Kinematics::State> simulate(bool enable_batch_integration)
+    {
+        auto clock = std::make_shared<SteppableClock>(3E-3f, static_cast<TTimePoint>(1E9));
+        ClockFactory::get(clock);
+
+        std::vector<std::unique_ptr<Kinematics>> kinematics;
+        std::vector<std::unique_ptr<Environment>> environments;
+        std::vector<std::unique_ptr<DebugPhysicsBody>> bodies;
+
+        FastPhysicsEngine physics(true, enable_batch_integration);
+        for (unsigned int i = 0; i < kBodyCount; ++i) {
+            Kinematics::State initial = Kinematics::State::zero();
+            initial.pose.position = Vector3r(static_cast<real_T>(i), 0, -10);
+            initial.twist.linear = Vector3r(2.0f - 0.5f * i, 0.25f * i, -1);
+            initial.twist.angular = Vector3r(0.1f * i, -0.2f, 0.05f * i);
+
+            kinematics.emplace_back(new Kinematics(initial));
+            environments.emplace_back(new Environment(Environment::State(initial.pose.position, GeoPoint())));
+            bodies.emplace_back(new DebugPhysicsBody());
+            bodies.back()->initialize(kinematics.back().get(), environments.back().get());
+            bodies.back()->setPrintKinematics(false);
+            bodies.back()->reset();
+            kinematics.back()->reset();
+            physics.insert(bodies.back().get());
+        }
+        physics.reset();
+
+        for (unsigned int step = 0; step < kStepCount; ++step) {
+            clock->step();
+            for (auto& body : bodies)
+                body->update();
+            physics.update();
+        }
+
+        std::vector<Kinematics::State> result;
+        for (const auto& body : bodies)
+            result.push_back(body->getKinematics());
+
+        ClockFactory::get(std::make_shared<ScalableClock>());
+        return result;
+    }
+
+    template<typename TVector>
+    static bool isClose(const TVector& lhs, const TVector& rhs)
+    {
+        return (lhs - rhs).norm() <= 1E-3f * (1 + lhs.norm());
+    }
+};
+
+}}
+#endif
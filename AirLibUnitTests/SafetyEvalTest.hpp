@@ -0,0 +1,79 @@
+#ifndef msr_AirLibUnitTests_SafetyEvalTest_hpp
+#define msr_AirLibUnitTests_SafetyEvalTest_hpp
+
+#include "TestBase.hpp"
+#include "safety/SafetyEval.hpp"
+#include "safety/IGeoFence.hpp"
+#include "safety/ObstacleMap.hpp"
+#include "safety/OccupancyMap.hpp"
+#include <vector>
+
+namespace msr { namespace airlib {
+
+class SafetyEvalTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        //obs_xy sees an obstacle straight ahead, the right side clearer than the left and nothing of a wall
+        //1.6m to the right that only the occupancy map remembers
+        const int ticks = 72;
+        auto obs_xy = std::make_shared<ObstacleMap>(ticks);
+        std::vector<float> distances(ticks), confidences(ticks, 1);
+        for (int i = 0; i < ticks; ++i) {
+            if (i <= 2 || i >= ticks - 2)
+                distances[i] = 0.5f;
+            else
+                distances[i] = i < ticks / 2 ? 100.0f : 50.0f;
+        }
+        obs_xy->update(distances.data(), confidences.data());
+
+        MultirotorApiParams params;
+        SafetyEval eval(params, std::make_shared<NoFence>(), obs_xy);
+        eval.setSafety(SafetyEval::SafetyViolationType_::Obstacle, Utils::nan<float>(), SafetyEval::ObsAvoidanceStrategy::ClosestMove,
+            VectorMath::nanVector(), Utils::nan<float>(), Utils::nan<float>(), Utils::nan<float>());
+
+        const Vector3r cur_pos = Vector3r::Zero();
+        const Quaternionr orientation = Quaternionr::Identity();
+        SafetyEval::EvalResult result = eval.isSafeDestination(Vector3r(1, 0, 0), cur_pos, orientation);
+        testAssert(!result.is_safe, "move in to obstacle ahead is safe");
+        testAssert(result.suggested_vec.y() > 0, "suggestion without map doesn't go to the clearer right side");
+
+        auto map = std::make_shared<OccupancyMap>();
+        const unsigned int width = 64, height = 48;
+        const std::vector<float> depth(width * height, 1.6f);
+        const Pose camera(Vector3r::Zero(), VectorMath::toQuaternion(0, 0, Utils::degreesToRadians(90.0f)));
+        for (int i = 0; i < 3; ++i)
+            map->integrateDepth(depth.data(), width, height, Utils::degreesToRadians(90.0f), false, camera);
+        eval.setOccupancyMap(map);
+
+        result = eval.isSafeDestination(Vector3r(1, 0, 0), cur_pos, orientation);
+        testAssert(!result.is_safe, "move in to obstacle ahead is safe with map");
+        testAssert(result.suggested_vec.y() < 0, "suggestion runs in to the mapped wall");
+        testAssert(map->isSegmentFree(cur_pos, cur_pos + result.suggested_vec, map->distanceToObstacle(cur_pos, params.obs_clearance)),
+            "suggested move comes closer to the mapped wall");
+        testAssert(result.message.find("safer; Path") != string::npos, "reasons in message are not separated");
+
+        result = eval.isSafeDestination(Vector3r(0, 3, 0), cur_pos, orientation);
+        testAssert(!result.is_safe && (result.reason & SafetyEval::SafetyViolationType_::Obstacle), "move through mapped wall is safe");
+        testAssert(!std::isnan(result.cur_risk_dist), "risk distance is not set when only the map sees the obstacle");
+        testAssert(eval.isSafeDestination(Vector3r(0, -3, 0), cur_pos, orientation).is_safe, "move away from mapped wall is unsafe");
+    }
+
+private:
+    //only obstacles are checked here
+    class NoFence : public IGeoFence {
+    public:
+        virtual void setBoundry(const Vector3r&, float, float, float) override {}
+        virtual void checkFence(const Vector3r&, const Vector3r&, bool& in_fence, bool& allow) override
+        {
+            in_fence = allow = true;
+        }
+        virtual string toString() const override
+        {
+            return "NoFence";
+        }
+    };
+};
+
+}}
+#endif
@@ -0,0 +1,71 @@
+#ifndef msr_AirLibUnitTests_ScheduledExecutorTest_hpp
+#define msr_AirLibUnitTests_ScheduledExecutorTest_hpp
+
+#include "TestBase.hpp"
+#include "common/common_utils/Utils.hpp"
+#include "common/common_utils/ScheduledExecutor.hpp"
+
+namespace msr { namespace airlib {
+
+class ScheduledExecutorTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        testHistogram();
+        testOverruns();
+    }
+
+private:
+    void testHistogram()
+    {
+        using common_utils::LatencyHistogram;
+
+        for (uint64_t value : { 0ULL, 3ULL, 4ULL, 7ULL, 1000ULL, 123456789ULL, ~0ULL }) {
+            unsigned int index = LatencyHistogram::bucketIndex(value);
+            testAssert(index < LatencyHistogram::kBucketCount, "bucket index out of range");
+            testAssert(LatencyHistogram::bucketUpperBound(index) >= value, "value is above its bucket");
+            testAssert(index == 0 || LatencyHistogram::bucketUpperBound(index - 1) < value, "value is below its bucket");
+        }
+
+        LatencyHistogram histogram;
+        for (uint64_t i = 1; i <= 100; ++i)
+            histogram.record(i * 1000);
+
+        LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+        testAssert(snapshot.count == 100, "histogram count is not correct");
+        testAssert(snapshot.max_nanos == 100000, "histogram max is not correct");
+        testAssert(std::abs(snapshot.mean() - 50500) < 1, "histogram mean is not correct");
+        //buckets are within 25% of actual value
+        testAssert(snapshot.percentile(0.5) >= 50000 && snapshot.percentile(0.5) <= 50000 * 1.25, "median is not correct");
+        testAssert(snapshot.percentile(1) == 100000, "max percentile is not clipped to max");
+    }
+
+    void testOverruns()
+    {
+        using common_utils::ScheduledExecutor;
+
+        //one slow call in the middle takes several periods
+        constexpr uint64_t period = 5000000;
+        std::atomic<unsigned int> call_count(0);
+        ScheduledExecutor executor([&call_count](uint64_t) {
+            if (++call_count == 5)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(period * 7 / 2));
+            return call_count < 20;
+        }, period);
+
+        executor.start();
+        while (executor.isRunning())
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        executor.stop();
+
+        ScheduledExecutor::Stats stats = executor.getStats();
+        testAssert(stats.callback_duration.count == 20, "callback durations were not recorded");
+        testAssert(stats.callback_duration.max_nanos >= period * 7 / 2, "slow callback was not recorded");
+        testAssert(stats.overrun_count >= 1, "overrun was not counted");
+        testAssert(stats.missed_period_count >= 2, "skipped periods were not counted");
+        testAssert(stats.period_count == stats.wake_jitter.count + 1, "first period should not record jitter");
+    }
+};
+
+}}
+#endif
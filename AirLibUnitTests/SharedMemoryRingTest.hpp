@@ -0,0 +1,95 @@
+#ifndef msr_AirLibUnitTests_SharedMemoryRingTest_hpp
+#define msr_AirLibUnitTests_SharedMemoryRingTest_hpp
+
+#include "TestBase.hpp"
+#include "common/common_utils/SharedMemoryRing.hpp"
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace msr { namespace airlib {
+
+class SharedMemoryRingTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        using common_utils::SharedMemoryRing;
+
+        if (!SharedMemoryRing::isSupported())
+            return;
+
+        const std::string name = "/airsim_test_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        SharedMemoryRing writer(name, 4, 1000);
+        SharedMemoryRing reader(name);
+        testAssert(reader.getSlotCount() == 4 && reader.getSlotSize() >= 1000, "reader sees different layout");
+
+        std::vector<float> data = { 1, 2, 3 };
+        SharedMemoryRing::Frame frame = writer.write(data.data(), data.size() * sizeof(float));
+        std::vector<float> result;
+        testAssert(reader.read(frame, result) && result == data, "frame was not read back");
+
+        //frame is lost once ring wraps around to its slot
+        for (unsigned int i = 0; i < 4; ++i)
+            writer.write(data.data(), data.size() * sizeof(float));
+        testAssert(!reader.read(frame, result), "overwritten frame was read");
+
+        std::vector<uint8_t> empty, empty_result(10);
+        testAssert(reader.read(writer.write(empty.data(), 0), empty_result) && empty_result.empty(), "empty frame was not read back");
+        std::vector<uint8_t> large(writer.getSlotSize() + 1);
+        testAssert(writer.write(large.data(), large.size()).slot == -1, "frame larger than slot was written");
+
+        //sizes that overflow are rejected before any memory is committed
+        for (uint64_t slot_size : { std::numeric_limits<uint64_t>::max(), std::numeric_limits<uint64_t>::max() / 1024 }) {
+            bool thrown = false;
+            try {
+                SharedMemoryRing huge(name + "_huge", 0xFFFFFFFFu, slot_size);
+            }
+            catch (const std::length_error&) {
+                thrown = true;
+            }
+            testAssert(thrown, "ring of overflowing size was created");
+        }
+
+        testConcurrentWrites(writer, reader);
+    }
+
+private:
+    //reader must either get frame intact or detect that it was overwritten
+    void testConcurrentWrites(common_utils::SharedMemoryRing& writer, common_utils::SharedMemoryRing& reader)
+    {
+        using common_utils::SharedMemoryRing;
+
+        std::atomic<bool> done(false);
+        std::atomic<uint64_t> last_sequence(0);
+        std::vector<SharedMemoryRing::Frame> frames(1024);
+
+        std::thread writer_thread([&]() {
+            std::vector<uint64_t> payload(120);
+            for (unsigned int i = 0; i < 20000; ++i) {
+                std::fill(payload.begin(), payload.end(), i);
+                SharedMemoryRing::Frame frame = writer.write(payload.data(), payload.size() * sizeof(uint64_t));
+                frames[frame.sequence % frames.size()] = frame;
+                last_sequence.store(frame.sequence, std::memory_order_release);
+            }
+            done = true;
+        });
+
+        std::vector<uint64_t> result;
+        while (!done) {
+            uint64_t sequence = last_sequence.load(std::memory_order_acquire);
+            if (sequence == 0)
+                continue;
+            SharedMemoryRing::Frame frame = frames[sequence % frames.size()];
+            if (frame.sequence == sequence && reader.read(frame, result)) {
+                testAssert(std::all_of(result.begin(), result.end(), [&result](uint64_t v) { return v == result[0]; }),
+                    "torn frame was not detected");
+            }
+        }
+        writer_thread.join();
+    }
+};
+
+}}
+#endif
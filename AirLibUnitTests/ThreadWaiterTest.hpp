@@ -0,0 +1,53 @@
+#ifndef msr_AirLibUnitTests_ThreadWaiterTest_hpp
+#define msr_AirLibUnitTests_ThreadWaiterTest_hpp
+
+#include "TestBase.hpp"
+#include "common/common_utils/ThreadWaiter.hpp"
+
+namespace msr { namespace airlib {
+
+class ThreadWaiterTest : public TestBase {
+public:
+    virtual void run() override
+    {
+        using common_utils::ThreadWaiter;
+
+        for (const char* name : { "Spin", "Sleep", "Hybrid", "TimerFd" }) {
+            ThreadWaiter::Config config;
+            config.strategy = ThreadWaiter::toStrategy(name);
+            ThreadWaiter waiter(config);
+
+            for (unsigned int i = 0; i < kWaitCount; ++i) {
+                uint64_t deadline = ThreadWaiter::nanos() + kDelayNanos;
+                waiter.sleepUntil(deadline);
+                testAssert(ThreadWaiter::nanos() >= deadline, "waiter woke up before deadline");
+            }
+
+            //deadline in the past must return without waiting
+            waiter.sleepUntil(ThreadWaiter::nanos() - kDelayNanos);
+
+            ThreadWaiter::Stats stats = waiter.getStats();
+            testAssert(stats.wait_count == kWaitCount + 1, "wait count is not correct");
+            testAssert(stats.late_mean_nanos <= stats.late_max_nanos, "late stats are not consistent");
+
+            waiter.resetStats();
+            testAssert(waiter.getStats().wait_count == 0, "stats were not reset");
+        }
+
+        bool is_thrown = false;
+        try {
+            ThreadWaiter::toStrategy("Unknown");
+        }
+        catch (const std::invalid_argument&) {
+            is_thrown = true;
+        }
+        testAssert(is_thrown, "unknown strategy was accepted");
+    }
+
+private:
+    static constexpr unsigned int kWaitCount = 20;
+    static constexpr uint64_t kDelayNanos = 500000;
+};
+
+}}
+#endif
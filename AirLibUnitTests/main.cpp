@@ -5,6 +5,20 @@
 #include "WorkerThreadTest.hpp"
 #include "QuaternionTest.hpp"
 #include "CelestialTests.hpp"
+#include "ParallelUpdateTest.hpp"
+#include "PhysicsBodyBatchTest.hpp"
+#include "LockstepClockTest.hpp"
+#include "ThreadWaiterTest.hpp"
+#include "ScheduledExecutorTest.hpp"
+#include "SharedMemoryRingTest.hpp"
+#include "ApiSubscriptionTest.hpp"
+#include "ImageKernelsTest.hpp"
+#include "DatasetWriterTest.hpp"
+#include "DepthWindowQueryTest.hpp"
+#include "OccupancyMapTest.hpp"
+#include "GridSearchTest.hpp"
+#include "ObstacleMapTest.hpp"
+#include "SafetyEvalTest.hpp"
 
 int main()
 {
@@ -14,6 +28,20 @@ int main()
         std::unique_ptr<TestBase>(new QuaternionTest()),
         std::unique_ptr<TestBase>(new CelestialTest()),
         std::unique_ptr<TestBase>(new SettingsTest()),
+        std::unique_ptr<TestBase>(new ParallelUpdateTest()),
+        std::unique_ptr<TestBase>(new PhysicsBodyBatchTest()),
+        std::unique_ptr<TestBase>(new LockstepClockTest()),
+        std::unique_ptr<TestBase>(new ThreadWaiterTest()),
+        std::unique_ptr<TestBase>(new ScheduledExecutorTest()),
+        std::unique_ptr<TestBase>(new SharedMemoryRingTest()),
+        std::unique_ptr<TestBase>(new ApiSubscriptionTest()),
+        std::unique_ptr<TestBase>(new ImageKernelsTest()),
+        std::unique_ptr<TestBase>(new DatasetWriterTest()),
+        std::unique_ptr<TestBase>(new DepthWindowQueryTest()),
+        std::unique_ptr<TestBase>(new OccupancyMapTest()),
+        std::unique_ptr<TestBase>(new GridSearchTest()),
+        std::unique_ptr<TestBase>(new ObstacleMapTest()),
+        std::unique_ptr<TestBase>(new SafetyEvalTest()),
         std::unique_ptr<TestBase>(new SimpleFlightTest())
         //,
         //std::unique_ptr<TestBase>(new PixhawkTest()),
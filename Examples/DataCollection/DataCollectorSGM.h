@@ -8,13 +8,14 @@
 #include "common/Common.hpp"
 #include "common/common_utils/ProsumerQueue.hpp"
 #include "common/common_utils/FileSystem.hpp"
+#include "common/common_utils/ImageKernels.hpp"
+#include "common/common_utils/DatasetWriter.hpp"
 #include "common/ClockFactory.hpp"
 #include "vehicles/multirotor/api/MultirotorRpcLibClient.hpp"
 #include "vehicles/multirotor/api/MultirotorApiBase.hpp"
 #include "RandomPointPoseGeneratorNoRoll.h"
 #include "../../SGM/src/sgmstereo/sgmstereo.h"
 #include "../../SGM/src/stereoPipeline/StateStereo.h"
-#include "writePNG.h"
 STRICT_MODE_OFF
 #ifndef RPCLIB_MSGPACK
 #define RPCLIB_MSGPACK clmdep_msgpack
@@ -32,10 +33,25 @@ private:
     float f = w / (2 * tan(fov/2));
 
 public:
+    struct Settings {
+        //images are encoded and written on the writer's threads, see DatasetWriter
+        common_utils::DatasetWriter::Options writer;
+        //depth as 16 bit PNG in millimeters instead of PFM in meters, 0 where unknown or beyond 65.5m
+        bool depth_png16 = false;
+    };
+
     DataCollectorSGM(std::string storage_dir)
-        : storage_dir_(storage_dir)
+        : DataCollectorSGM(storage_dir, Settings())
+    {
+    }
+
+    DataCollectorSGM(std::string storage_dir, const Settings& settings)
+        : storage_dir_(storage_dir), settings_(settings), writer_(storage_dir, settings.writer)
     {
         FileSystem::ensureFolder(storage_dir);
+        //shards are written to storage_dir
+        if (settings.writer.frames_per_shard > 0)
+            return;
         FileSystem::ensureFolder(FileSystem::combine(storage_dir,"left"));
         FileSystem::ensureFolder(FileSystem::combine(storage_dir,"right"));
         FileSystem::ensureFolder(FileSystem::combine(storage_dir,"depth_gt"));
@@ -52,6 +68,8 @@ public:
         msr::airlib::MultirotorRpcLibClient client;
         client.confirmConnection();
         client.reset();
+        //falls back to RPC if simulator is not on this host
+        client.enableSharedMemory();
 
         std::vector<ImageRequest> request = { 
             ImageRequest("front_left", ImageType::Scene, false, false), 
@@ -92,16 +110,15 @@ public:
 
                 auto start_nanos = clock->nowNanos();
 
-                const std::vector<ImageResponse>& response = client.simGetImages(request);
-                if (response.size() != 4) {
+                ImagesResult result;
+                result.response = client.simGetImages(request);
+                if (result.response.size() != 4) {
                     std::cout << "Images were not received!" << std::endl;
                     start_nanos = clock->nowNanos();
                     continue;
                 }
 
-                ImagesResult result;
                 result.file_list = &file_list;
-                result.response = response;
                 result.sample = sample;
                 result.render_time = clock->elapsedSince(start_nanos);;
                 result.storage_dir_ = storage_dir_;
@@ -118,6 +135,12 @@ public:
             std::cout << t.what() << std::endl;
         }
 
+        writer_.flush();
+        const common_utils::DatasetWriter::Stats stats = writer_.getStats();
+        std::cout << "Wrote " << stats.frames << " samples, " << stats.files << " files, "
+            << stats.bytes / (1024 * 1024) << " MB, encode time " << stats.encode_seconds << " s"
+            << ", waited for writer " << stats.blocked_seconds << " s" << std::endl;
+
         return 0;
     }
 
@@ -135,6 +158,8 @@ private:
     typedef msr::airlib::ImageCaptureBase::ImageType ImageType;
 
     std::string storage_dir_;
+    Settings settings_;
+    common_utils::DatasetWriter writer_;
     bool spawn_ue4 = false;
     SGMOptions params;
     CStateStereo *p_state;
@@ -178,84 +203,63 @@ private:
             auto process_time = clock->nowNanos();
 
             //Initialze file names
+            const char* depth_extension = settings_.depth_png16 ? "png" : "pfm";
             std::string left_file_name = Utils::stringf("left/%06d.png", result->sample);
             std::string right_file_name = Utils::stringf("right/%06d.png", result->sample);
-            std::string depth_gt_file_name  = Utils::stringf("depth_gt/%06d.pfm", result->sample);
+            std::string depth_gt_file_name  = Utils::stringf("depth_gt/%06d.%s", result->sample, depth_extension);
             std::string disparity_gt_file_name  = Utils::stringf("disparity_gt/%06d.pfm", result->sample);
             std::string disparity_gt_viz_file_name  = Utils::stringf("disparity_gt_viz/%06d.png", result->sample);
-            std::string depth_sgm_file_name  = Utils::stringf("depth_sgm/%06d.pfm", result->sample);
+            std::string depth_sgm_file_name  = Utils::stringf("depth_sgm/%06d.%s", result->sample, depth_extension);
             std::string disparity_sgm_file_name  = Utils::stringf("disparity_sgm/%06d.pfm", result->sample);
             std::string disparity_sgm_viz_file_name  = Utils::stringf("disparity_sgm_viz/%06d.png", result->sample);
             std::string confidence_sgm_file_name  = Utils::stringf("confidence_sgm/%06d.png", result->sample);
 
-            //Initialize data containers
-            std::vector<uint8_t> left_img(h*w*3);
-            std::vector<uint8_t> right_img(h*w*3);
-            std::vector<float> gt_depth_data = result->response.at(2).image_data_float;
-            std::vector<float> gt_disparity_data = result->response.at(3).image_data_float;
-            std::vector<float> sgm_depth_data(h*w);
-            std::vector<float> sgm_disparity_data(h*w);
-            std::vector<uint8_t> sgm_confidence_data(h*w);
+            //Initialize data containers, they are moved to the writer which hands them back for reuse once
+            //written, GT images are converted in place
+            const size_t pixels = static_cast<size_t>(h) * w;
+            std::vector<uint8_t> left_img = writer_.getBytes(pixels * 3), right_img = writer_.getBytes(pixels * 3);
+            std::vector<uint8_t> disparity_sgm_viz = writer_.getBytes(pixels * 3), disparity_gt_viz = writer_.getBytes(pixels * 3);
+            std::vector<uint8_t> confidence = writer_.getBytes(pixels);
+            std::vector<float> sgm_depth_data = writer_.getFloats(pixels), sgm_disparity_data = writer_.getFloats(pixels);
+            std::vector<float>& gt_depth_data = result->response.at(2).image_data_float;
+            std::vector<float>& gt_disparity_data = result->response.at(3).image_data_float;
 
             //Remove alpha from RGB images
-            int counter = 0;
-            for (int idx = 0; idx < (h*w*4); idx++) {
-                if ((idx+1) % 4 == 0) {
-                    counter++; 
-                    continue;
-                }
-                left_img[idx-counter] = result->response.at(0).image_data_uint8 [idx];
-                right_img[idx-counter] = result->response.at(1).image_data_uint8 [idx];
-            }
+            common_utils::ImageKernels::rgbaToRgb(result->response.at(0).image_data_uint8.data(), pixels, left_img.data());
+            common_utils::ImageKernels::rgbaToRgb(result->response.at(1).image_data_uint8.data(), pixels, right_img.data());
 
             //Get SGM disparity and confidence
             p_state->ProcessFrameAirSim(result->sample,dtime,left_img, right_img);
 
-            //Get adjust SGM disparity and compute depth
-	        for (int idx = 0; idx < (h*w); idx++)
-	        {
-		        float d = p_state->dispMap[idx];
-		        if (d < FLT_MAX)
-		        {
-                    sgm_depth_data[idx] = -(B*f/d);
-                    sgm_disparity_data[idx] = -d;
-		        }
-                sgm_confidence_data[idx] = p_state->confMap[idx];
-                
-	        }
-
-            //Write files to disk
+            //SGM disparities are negative, depth and disparity are 0 where there is no match
+            common_utils::ImageKernels::disparityToDepth(p_state->dispMap, pixels, f, B, sgm_depth_data.data(), sgm_disparity_data.data());
+            common_utils::ImageKernels::denormalizeDisparity(gt_disparity_data.data(), gt_disparity_data.size(), w);
+
+            //GT and SGM disparity for visulatization
+            common_utils::ImageKernels::colorize(sgm_disparity_data.data(), pixels, 0.05f*w, disparity_sgm_viz.data());
+            common_utils::ImageKernels::colorize(gt_disparity_data.data(), pixels, 0.05f*w, disparity_gt_viz.data());
+
+            //Queue files for the writer
+            common_utils::DatasetWriter::Frame frame;
             //Left and right RGB image
-            FILE *img_l = fopen(FileSystem::combine(result->storage_dir_, left_file_name).c_str(), "wb");
-            svpng(img_l,w,h,reinterpret_cast<const unsigned char*>(left_img.data()),0);
-            fclose(img_l);
-            FILE *img_r = fopen(FileSystem::combine(result->storage_dir_, right_file_name).c_str(), "wb");
-            svpng(img_r,w,h,reinterpret_cast<const unsigned char*>(right_img.data()),0);
-            fclose(img_r);
+            frame.addPng(left_file_name, w, h, 3, std::move(left_img));
+            frame.addPng(right_file_name, w, h, 3, std::move(right_img));
 
             //GT disparity and depth
-            Utils::writePfmFile(gt_depth_data.data(), w, h, FileSystem::combine(result->storage_dir_, depth_gt_file_name));
-            denormalizeDisparity(gt_disparity_data, w);
-            Utils::writePfmFile(gt_disparity_data.data(), w, h, FileSystem::combine(result->storage_dir_, disparity_gt_file_name));
-            
+            addDepth(frame, depth_gt_file_name, gt_depth_data);
+            frame.addPfm(disparity_gt_file_name, w, h, std::move(gt_disparity_data));
+
             //SGM depth disparity and confidence
-            Utils::writePfmFile(sgm_depth_data.data(), w, h, FileSystem::combine(result->storage_dir_, depth_sgm_file_name));
-            Utils::writePfmFile(sgm_disparity_data.data(), w, h, FileSystem::combine(result->storage_dir_, disparity_sgm_file_name));
-            FILE *sgm_c = fopen(FileSystem::combine(result->storage_dir_, confidence_sgm_file_name).c_str(), "wb");
-            svpng(sgm_c,w,h,reinterpret_cast<const unsigned char*>(sgm_confidence_data.data()),0,1);
-            fclose(sgm_c);
+            addDepth(frame, depth_sgm_file_name, sgm_depth_data);
+            frame.addPfm(disparity_sgm_file_name, w, h, std::move(sgm_disparity_data));
+            std::copy(p_state->confMap, p_state->confMap + pixels, confidence.begin());
+            frame.addPng(confidence_sgm_file_name, w, h, 1, std::move(confidence));
 
-            //GT and SGM disparity for visulatization
-            std::vector<uint8_t> sgm_disparity_viz(h*w*3);
-            getColorVisualization(sgm_disparity_data, sgm_disparity_viz, h, w, 0.05f*w);
-            FILE *disparity_sgm = fopen(FileSystem::combine(result->storage_dir_, disparity_sgm_viz_file_name).c_str(), "wb");
-            svpng(disparity_sgm,w,h,reinterpret_cast<const unsigned char*>(sgm_disparity_viz.data()), 0);
-            fclose(disparity_sgm);
-            std::vector<uint8_t> gt_disparity_viz(h*w*3);
-            getColorVisualization(gt_disparity_data, gt_disparity_viz, h, w, 0.05f*w);
-            FILE *disparity_gt = fopen(FileSystem::combine(result->storage_dir_, disparity_gt_viz_file_name).c_str(), "wb");
-            svpng(disparity_gt,w,h,reinterpret_cast<const unsigned char*>(gt_disparity_viz.data()), 0);
-            fclose(disparity_gt);
+            frame.addPng(disparity_sgm_viz_file_name, w, h, 3, std::move(disparity_sgm_viz));
+            frame.addPng(disparity_gt_viz_file_name, w, h, 3, std::move(disparity_gt_viz));
+
+            //blocks if the writer is behind
+            writer_.submit(std::move(frame));
 
             //Add all to file record
             (* result->file_list) << left_file_name << "," << right_file_name << "," << depth_gt_file_name << "," << disparity_gt_file_name << "," << depth_sgm_file_name << "," << disparity_sgm_file_name << "," << confidence_sgm_file_name << std::endl;
@@ -269,49 +273,15 @@ private:
 
     }
 
-    void getcolor(float d, float max_d, float&r, float&g, float&b) {
-    
-        float x = 6.0f;
-        float inc = x / max_d;
-
-        if (d < max_d)
-            x = d * inc;
-        else
-            x = max_d * inc;
-
-        r = 0.0f; g = 0.0f; b = 0.0f;
-        if ((0 <= x && x <= 1) || (5 <= x && x < 6)) r = 1.0f;
-        else if (4 <= x && x < 5) r = x - 4;
-        else if (1 <= x && x < 2) r = 1.0f - (x - 1);
-
-        if (1 <= x && x < 3) g = 1.0f;
-        else if (0 <= x && x < 1) g = x - 0;
-        else if (3 <= x && x < 4) g = 1.0f - (x - 3);
-
-        if (3 <= x && x < 5) b = 1.0f;
-        else if (2 <= x && x < 3) b = x - 2;
-        else if (5 <= x && x < 6) b = 1.0f - (x - 5);
-    }
-
-    template <typename T> 
-    void getColorVisualization(T& img, std::vector<uint8_t>& img_viz, int h, int w, float max_val = 255) {
-	    for (int idx = 0; idx < (h*w); idx++)
-	    {
-		    float r,g,b;
-            getcolor(img[idx],max_val,r,g,b);
-            img_viz[idx*3] = (uint8_t) (r*255);
-            img_viz[idx*3+1] = (uint8_t) (g*255);
-            img_viz[idx*3+2] = (uint8_t) (b*255);
-	    }    
-    }
-
-    template <typename T> 
-    void getGrayVisualization(T& img, std::vector<uint8_t>& img_viz, int h, int w, int invert = 0, float scale = 1) {
-        img_viz.resize(h*w);
-	    for (int idx = 0; idx < (h*w); idx++)
-	    {
-            img_viz[idx] = (uint8_t) (invert ? scale/img[idx] : img[idx]*scale);  
+    void addDepth(common_utils::DatasetWriter::Frame& frame, const std::string& file_name, std::vector<float>& depth)
+    {
+        if (settings_.depth_png16) {
+            std::vector<uint16_t> millimeters = writer_.getSamples16(depth.size());
+            common_utils::ImageKernels::toUInt16(depth.data(), depth.size(), 1000.0f, millimeters.data());
+            frame.addPng(file_name, w, h, std::move(millimeters));
         }
+        else
+            frame.addPfm(file_name, w, h, std::move(depth));
     }
 
     static void saveImageToFile(const std::vector<uint8_t>& image_data, const std::string& file_name)
@@ -321,35 +291,5 @@ private:
         file.close();
     }
 
-    static void convertToPlanDepth(std::vector<float>& image_data, int width, int height, float f_px = 320)
-    {
-        float center_i = width / 2.0f - 1;
-        float center_j = height / 2.0f - 1;
-
-        for (int i = 0; i < width; ++i) {
-            for (int j = 0; j < height; ++j) {
-                float dist = std::sqrt((i - center_i)*(i - center_i) + (j - center_j)*(j - center_j));
-                float denom = (dist / f_px);
-                denom *= denom;
-                denom = std::sqrt(1 + denom);
-                image_data[j * width + i] /= denom;
-            }
-        }
-    }
-
-    static void convertToDisparity(std::vector<float>& image_data, float f_px = 320, float baseline_meters = 1)
-    {
-        for (int i = 0; i < image_data.size(); ++i) {
-            image_data[i] = f_px * baseline_meters * (1.0f / image_data[i]);
-        }
-    }
-
-    static void denormalizeDisparity(std::vector<float>& image_data, int width)
-    {
-        for (int i = 0; i < image_data.size(); ++i) {
-            image_data[i] = image_data[i] * width;
-        }
-    }
-
 };
 
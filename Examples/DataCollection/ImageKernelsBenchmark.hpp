@@ -0,0 +1,192 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include "common/common_utils/ImageKernels.hpp"
+
+//Times the per-frame post-processing of the data collection tools: the loops they used before against
+//common_utils::ImageKernels on buffers of the given resolution. Results are printed in microseconds per frame.
+class ImageKernelsBenchmark {
+public:
+    static void run(int width = 640, int height = 480, int iterations = 200)
+    {
+        typedef common_utils::ImageKernels ImageKernels;
+
+        const size_t count = static_cast<size_t>(width) * height;
+        const float f = width / 2.0f, B = 0.25f;
+
+        std::mt19937 gen(0);
+        std::uniform_real_distribution<float> depth_dist(0.5f, 100.0f);
+        std::vector<float> depth(count), sgm_disparity(count);
+        for (size_t i = 0; i < count; ++i) {
+            depth[i] = depth_dist(gen);
+            //every 10th pixel without SGM match
+            sgm_disparity[i] = i % 10 == 0 ? FLT_MAX : -f * B / depth[i];
+        }
+        std::vector<uint8_t> rgba(count * 4);
+        for (size_t i = 0; i < rgba.size(); ++i)
+            rgba[i] = static_cast<uint8_t>(i);
+
+        std::vector<float> data(count), out(count), out2(count);
+        std::vector<uint8_t> rgb(count * 3), gray(count);
+
+        std::cout << "image kernels, " << width << "x" << height << ", " << iterations << " iterations, "
+            << simdName() << std::endl;
+        std::cout << std::left << std::setw(28) << "kernel" << std::right << std::setw(12) << "before us"
+            << std::setw(12) << "after us" << std::setw(10) << "speedup" << std::endl;
+
+        compare("perspectiveToPlanarDepth", iterations,
+            [&]() { std::vector<float> copy = depth; convertToPlanDepth(copy, width, height, f); },
+            [&]() { std::copy(depth.begin(), depth.end(), data.begin()); ImageKernels::perspectiveToPlanarDepth(data.data(), width, height, f); });
+        compare("depthToDisparity", iterations,
+            [&]() { std::vector<float> copy = depth; convertToDisparity(copy, f, B); },
+            [&]() { std::copy(depth.begin(), depth.end(), data.begin()); ImageKernels::depthToDisparity(data.data(), count, f, B); });
+        compare("disparityToDepth", iterations,
+            [&]() {
+                std::vector<float> sgm_depth(count), disparity(count);
+                for (size_t i = 0; i < count; ++i) {
+                    float d = sgm_disparity[i];
+                    if (d < FLT_MAX) {
+                        sgm_depth[i] = -(B * f / d);
+                        disparity[i] = -d;
+                    }
+                }
+            },
+            [&]() { ImageKernels::disparityToDepth(sgm_disparity.data(), count, f, B, out.data(), out2.data()); });
+        compare("denormalizeDisparity", iterations,
+            [&]() { std::vector<float> copy = depth; denormalizeDisparity(copy, width); },
+            [&]() { std::copy(depth.begin(), depth.end(), data.begin()); ImageKernels::denormalizeDisparity(data.data(), count, width); });
+        compare("colorize", iterations,
+            [&]() { std::vector<uint8_t> viz(count * 3); getColorVisualization(depth, viz, 0.05f * width); },
+            [&]() { ImageKernels::colorize(depth.data(), count, 0.05f * width, rgb.data()); });
+        compare("toGray", iterations,
+            [&]() { std::vector<uint8_t> viz; getGrayVisualization(depth, viz, 1, 50.0f); },
+            [&]() { ImageKernels::toGray(depth.data(), count, gray.data(), true, 50.0f); });
+        compare("rgbaToRgb", iterations,
+            [&]() {
+                std::vector<uint8_t> img(count * 3);
+                int counter = 0;
+                for (size_t idx = 0; idx < count * 4; idx++) {
+                    if ((idx + 1) % 4 == 0) {
+                        counter++;
+                        continue;
+                    }
+                    img[idx - counter] = rgba[idx];
+                }
+            },
+            [&]() { ImageKernels::rgbaToRgb(rgba.data(), count, rgb.data()); });
+    }
+
+private:
+    static const char* simdName()
+    {
+#if defined(COMMON_UTILS_IMAGE_KERNELS_SSSE3)
+        return "SSE2 + SSSE3";
+#elif defined(COMMON_UTILS_IMAGE_KERNELS_SSE2)
+        return "SSE2";
+#elif defined(COMMON_UTILS_IMAGE_KERNELS_NEON)
+        return "NEON";
+#else
+        return "scalar";
+#endif
+    }
+
+    static double timeMicros(int iterations, const std::function<void()>& kernel)
+    {
+        kernel(); //warm up caches and allocator
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            kernel();
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+    }
+
+    static void compare(const char* name, int iterations, const std::function<void()>& before, const std::function<void()>& after)
+    {
+        double before_us = timeMicros(iterations, before);
+        double after_us = timeMicros(iterations, after);
+        std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(12) << before_us << std::setw(12) << after_us << std::setw(9) << before_us / after_us << "x" << std::endl;
+    }
+
+    //loops as DataCollectorSGM and StereoImageGenerator had them, including the copy of each image
+
+    static void convertToPlanDepth(std::vector<float>& image_data, int width, int height, float f_px)
+    {
+        float center_i = width / 2.0f - 1;
+        float center_j = height / 2.0f - 1;
+
+        for (int i = 0; i < width; ++i) {
+            for (int j = 0; j < height; ++j) {
+                float dist = std::sqrt((i - center_i)*(i - center_i) + (j - center_j)*(j - center_j));
+                float denom = (dist / f_px);
+                denom *= denom;
+                denom = std::sqrt(1 + denom);
+                image_data[j * width + i] /= denom;
+            }
+        }
+    }
+
+    static void convertToDisparity(std::vector<float>& image_data, float f_px, float baseline_meters)
+    {
+        for (size_t i = 0; i < image_data.size(); ++i)
+            image_data[i] = f_px * baseline_meters * (1.0f / image_data[i]);
+    }
+
+    static void denormalizeDisparity(std::vector<float>& image_data, int width)
+    {
+        for (size_t i = 0; i < image_data.size(); ++i)
+            image_data[i] = image_data[i] * width;
+    }
+
+    static void getcolor(float d, float max_d, float& r, float& g, float& b)
+    {
+        float x = 6.0f;
+        float inc = x / max_d;
+
+        if (d < max_d)
+            x = d * inc;
+        else
+            x = max_d * inc;
+
+        r = 0.0f; g = 0.0f; b = 0.0f;
+        if ((0 <= x && x <= 1) || (5 <= x && x < 6)) r = 1.0f;
+        else if (4 <= x && x < 5) r = x - 4;
+        else if (1 <= x && x < 2) r = 1.0f - (x - 1);
+
+        if (1 <= x && x < 3) g = 1.0f;
+        else if (0 <= x && x < 1) g = x - 0;
+        else if (3 <= x && x < 4) g = 1.0f - (x - 3);
+
+        if (3 <= x && x < 5) b = 1.0f;
+        else if (2 <= x && x < 3) b = x - 2;
+        else if (5 <= x && x < 6) b = 1.0f - (x - 5);
+    }
+
+    static void getColorVisualization(const std::vector<float>& img, std::vector<uint8_t>& img_viz, float max_val)
+    {
+        for (size_t idx = 0; idx < img.size(); idx++) {
+            float r, g, b;
+            getcolor(img[idx], max_val, r, g, b);
+            img_viz[idx * 3] = static_cast<uint8_t>(r * 255);
+            img_viz[idx * 3 + 1] = static_cast<uint8_t>(g * 255);
+            img_viz[idx * 3 + 2] = static_cast<uint8_t>(b * 255);
+        }
+    }
+
+    static void getGrayVisualization(const std::vector<float>& img, std::vector<uint8_t>& img_viz, int invert, float scale)
+    {
+        img_viz.resize(img.size());
+        for (size_t idx = 0; idx < img.size(); idx++)
+            img_viz[idx] = static_cast<uint8_t>(invert ? scale / img[idx] : img[idx] * scale);
+    }
+};
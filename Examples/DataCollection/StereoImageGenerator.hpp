@@ -6,8 +6,9 @@
 #include <iostream>
 #include <iomanip>
 #include "common/Common.hpp"
-#include "common/common_utils/ProsumerQueue.hpp"
 #include "common/common_utils/FileSystem.hpp"
+#include "common/common_utils/ImageKernels.hpp"
+#include "common/common_utils/DatasetWriter.hpp"
 #include "common/ClockFactory.hpp"
 #include "vehicles/multirotor/api/MultirotorRpcLibClient.hpp"
 #include "vehicles/multirotor/api/MultirotorApiBase.hpp"
@@ -40,8 +41,8 @@ public:
 
         int sample = getImageCount(file_list);
 
-        common_utils::ProsumerQueue<ImagesResult> results;
-        std::thread result_process_thread(processImages, & results);
+        //files are written on the writer's threads while the next images are rendered
+        common_utils::DatasetWriter writer(storage_dir_);
 
         try {
             while(sample < num_samples) {
@@ -65,24 +66,22 @@ public:
                     ImageRequest("1", ImageType::Scene),
                     ImageRequest("1", ImageType::DisparityNormalized, true)
                 };
-                const std::vector<ImageResponse>& response = client.simGetImages(request);
-                if (response.size() != 3) {
+                ImagesResult result;
+                result.response = client.simGetImages(request);
+                if (result.response.size() != 3) {
                     std::cout << "Images were not received!" << std::endl;
                     start_nanos = clock->nowNanos();
                     continue;
                 }
 
-                ImagesResult result;
                 result.file_list = &file_list;
-                result.response = response;
                 result.sample = sample;
                 result.render_time = clock->elapsedSince(start_nanos);;
                 result.storage_dir_ = storage_dir_;
                 result.position = pose_generator.position;
                 result.orientation = pose_generator.orientation;
 
-
-                results.push(result);
+                processImages(writer, result);
 
                 pose_generator.next();
                 client.simSetVehiclePose(Pose(pose_generator.position, pose_generator.orientation), true);
@@ -94,8 +93,7 @@ public:
             std::cout << t.what() << std::endl;
         }
 
-        results.setIsDone(true);
-        result_process_thread.join();
+        writer.close();
         return 0;
     }
 
@@ -141,89 +139,45 @@ private:
         return sample;
     }
 
-    static void processImages(common_utils::ProsumerQueue<ImagesResult>* results)
-    {
-        while (!results->getIsDone()) {
-            msr::airlib::ClockBase* clock = msr::airlib::ClockFactory::get();
-
-            ImagesResult result;
-            if (!results->tryPop(result)) {
-                clock->sleep_for(1);
-                continue;
-            }
-
-            auto process_time = clock->nowNanos();
-
-            std::string left_file_name = Utils::stringf("left_%06d.png", result.sample);
-            std::string right_file_name = Utils::stringf("right_%06d.png", result.sample);
-            std::string disparity_file_name  = Utils::stringf("disparity_%06d.pfm", result.sample);
-            saveImageToFile(result.response.at(0).image_data_uint8, 
-                FileSystem::combine(result.storage_dir_, right_file_name));
-            saveImageToFile(result.response.at(1).image_data_uint8, 
-                FileSystem::combine(result.storage_dir_, left_file_name));
-
-            std::vector<float> disparity_data = result.response.at(2).image_data_float;
-
-            //writeFilePFM(depth_data, response.at(2).width, response.at(2).height,
-            //    FileSystem::combine(storage_dir_, Utils::stringf("depth_%06d.pfm", i)));
-            
-            //below is not needed because we get disparity directly
-            //convertToPlanDepth(depth_data, result.response.at(2).width, result.response.at(2).height);
-            //float f = result.response.at(2).width / 2.0f - 1;
-            //convertToDisparity(depth_data, result.response.at(2).width, result.response.at(2).height, f, 25 / 100.0f);
-
-            denormalizeDisparity(disparity_data, result.response.at(2).width);
-
-            Utils::writePfmFile(disparity_data.data(), result.response.at(2).width, result.response.at(2).height,
-                FileSystem::combine(result.storage_dir_, disparity_file_name));
-
-            (* result.file_list) << left_file_name << "," << right_file_name << "," << disparity_file_name << std::endl;
-
-            std::cout << "Image #" << result.sample 
-                << " pos:" << VectorMath::toString(result.position)
-                << " ori:" << VectorMath::toString(result.orientation)
-                << " render time " << result.render_time * 1E3f << "ms" 
-                << " process time " << clock->elapsedSince(process_time) * 1E3f << " ms"
-                << std::endl;
-
-        }
-    }
-
-    static void saveImageToFile(const std::vector<uint8_t>& image_data, const std::string& file_name)
-    {
-        std::ofstream file(file_name , std::ios::binary);
-        file.write((char*) image_data.data(), image_data.size());
-        file.close();
-    }
-
-    static void convertToPlanDepth(std::vector<float>& image_data, int width, int height, float f = 320)
-    {
-        float center_i = width / 2.0f - 1;
-        float center_j = height / 2.0f - 1;
-
-        for (int i = 0; i < width; ++i) {
-            for (int j = 0; j < height; ++j) {
-                float dist = std::sqrt((i - center_i)*(i - center_i) + (j - center_j)*(j - center_j));
-                float denom = (dist / f);
-                denom *= denom;
-                denom = std::sqrt(1 + denom);
-                image_data[j * width + i] /= denom;
-            }
-        }
-    }
-
-    static void convertToDisparity(std::vector<float>& image_data, int width, int height, float f = 320, float baseline_meters = 1)
-    {
-        for (int i = 0; i < image_data.size(); ++i) {
-            image_data[i] = f * baseline_meters * (1.0f / image_data[i]);
-        }
-    }
-
-    static void denormalizeDisparity(std::vector<float>& image_data, int width)
+    static void processImages(common_utils::DatasetWriter& writer, ImagesResult& result)
     {
-        for (int i = 0; i < image_data.size(); ++i) {
-            image_data[i] = image_data[i] * width;
-        }
+        msr::airlib::ClockBase* clock = msr::airlib::ClockFactory::get();
+        auto process_time = clock->nowNanos();
+
+        std::string left_file_name = Utils::stringf("left_%06d.png", result.sample);
+        std::string right_file_name = Utils::stringf("right_%06d.png", result.sample);
+        std::string disparity_file_name  = Utils::stringf("disparity_%06d.pfm", result.sample);
+
+        //scene images are PNG already and written as they are
+        common_utils::DatasetWriter::Frame frame;
+        frame.addFile(right_file_name, std::move(result.response.at(0).image_data_uint8));
+        frame.addFile(left_file_name, std::move(result.response.at(1).image_data_uint8));
+
+        //converted in place, result is our own copy
+        ImageResponse& disparity = result.response.at(2);
+
+        //writeFilePFM(depth_data, response.at(2).width, response.at(2).height,
+        //    FileSystem::combine(storage_dir_, Utils::stringf("depth_%06d.pfm", i)));
+        
+        //below is not needed because we get disparity directly
+        //float f = result.response.at(2).width / 2.0f - 1;
+        //ImageKernels::perspectiveToPlanarDepth(depth_data.data(), result.response.at(2).width, result.response.at(2).height, f);
+        //ImageKernels::depthToDisparity(depth_data.data(), depth_data.size(), f, 25 / 100.0f);
+
+        common_utils::ImageKernels::denormalizeDisparity(disparity.image_data_float.data(), disparity.image_data_float.size(), disparity.width);
+        frame.addPfm(disparity_file_name, disparity.width, disparity.height, std::move(disparity.image_data_float));
+
+        //blocks if the writer is behind
+        writer.submit(std::move(frame));
+
+        (* result.file_list) << left_file_name << "," << right_file_name << "," << disparity_file_name << std::endl;
+
+        std::cout << "Image #" << result.sample 
+            << " pos:" << VectorMath::toString(result.position)
+            << " ori:" << VectorMath::toString(result.orientation)
+            << " render time " << result.render_time * 1E3f << "ms" 
+            << " process time " << clock->elapsedSince(process_time) * 1E3f << " ms"
+            << std::endl;
     }
 
 };
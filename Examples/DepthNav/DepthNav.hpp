@@ -14,6 +14,8 @@ STRICT_MODE_ON
 
 //includes for vector math and other common types
 #include "common/Common.hpp"
+#include "common/common_utils/DepthWindowQuery.hpp"
+#include "safety/OccupancyMap.hpp"
 #include <exception>
 
 #include "../../SGM/src/sgmstereo/sgmstereo.h"
@@ -51,6 +53,15 @@ public: //types
         real_T control_loop_period = 0.25f*max_allowed_obs_dist; //30.0f / 1000; //sec
         real_T max_linear_speed = 10; // m/s
         real_T max_angular_speed = 6; // rad/s
+
+        //SGM searches disparities around those of the previous frame moved by the camera motion,
+        //needs SGMOptions::pyramidLevels > 0
+        bool sgm_temporal = false;
+
+        //fuse depth images in to a persistent map and don't move in to obstacles remembered there,
+        //also after they left the field of view
+        bool use_occupancy_map = false;
+        OccupancyMap::Params occupancy_map;
 	};
 
     class DepthNavException : public std::runtime_error {
@@ -67,12 +78,22 @@ public:
 		: params_(params)
 	{}
 
+    //nullptr unless Params::use_occupancy_map was set before initialize(). The map only exists in this client process,
+    //SafetyEval runs in the simulator and gets its map through MultirotorApiBase::setOccupancyMap
+    std::shared_ptr<OccupancyMap> getOccupancyMap() const
+    {
+        return occupancy_map_;
+    }
+
     void initialize(RpcLibClientBase& client, const std::vector<ImageCaptureBase::ImageRequest>& request){
         const std::vector<ImageCaptureBase::ImageResponse>& response_init = client.simGetImages(request);
         params_.depth_width = response_init.at(0).width;
         params_.depth_height = response_init.at(0).height;
 		params_.vehicle_height_px = int(ceil(params_.depth_height * params_.vehicle_height / (tan(params_.fov / 2) * params_.max_allowed_obs_dist * 2))); //height
 		params_.vehicle_width_px = int(ceil(params_.depth_width * params_.vehicle_width / (tan(hfov2vfov(params_.fov, params_.depth_height, params_.depth_width) / 2) * params_.max_allowed_obs_dist * 2))); //width    
+
+        if (params_.use_occupancy_map && !occupancy_map_)
+            occupancy_map_ = std::make_shared<OccupancyMap>(params_.occupancy_map);
     }
 
     virtual void gotoGoal(const Pose& goal_pose, RpcLibClientBase& client, const std::vector<ImageCaptureBase::ImageRequest>& request)
@@ -88,8 +109,11 @@ public:
             if (response.size() == 0)
                 throw std::length_error("No images received!");
 
-            const Pose next_pose = getNextPose(response.at(0).image_data_float, goal_pose.position, 
-                current_pose, params_.control_loop_period);
+            if (occupancy_map_)
+                occupancy_map_->integrateDepth(response.at(0), params_.fov);
+
+            const Pose next_pose = avoidMappedObstacles(current_pose, getNextPose(response.at(0).image_data_float, goal_pose.position, 
+                current_pose, params_.control_loop_period));
 
             if (VectorMath::hasNan(next_pose))
                 throw DepthNavException("No further path can be found.");
@@ -143,6 +167,13 @@ public:
 
         std::vector<float> sgm_depth_image(params_.depth_height*params_.depth_width);
 
+        //baseline * focal_length = depth * disparity
+        float f = params_.depth_width / (2 * tan(params_.fov/2));
+        float B = 0.25; 
+        Pose previous_camera_pose;
+        if (params_.sgm_temporal)
+            p_state->SetCamera(f, B);
+
         do {
             const Pose current_pose = client.simGetVehiclePose();
 
@@ -160,11 +191,17 @@ public:
             const std::vector<uint8_t>& left_image = response.at(0).image_data_uint8;
             const std::vector<uint8_t>& right_image = response.at(1).image_data_uint8;
 
-            //baseline * focal_length = depth * disparity
-            float f = params_.depth_width / (2 * tan(params_.fov/2));
-            float B = 0.25; 
-   
-            p_state->ProcessFrameAirSim(counter, dtime, left_image, right_image);
+            if (params_.sgm_temporal) {
+                //motion is not used for the first frame
+                const Pose camera_pose(response.at(0).camera_position, response.at(0).camera_orientation);
+                float motion[12];
+                getCameraMotion(previous_camera_pose, camera_pose, motion);
+                p_state->ProcessFrameTemporal(counter, dtime, left_image, right_image, motion);
+                previous_camera_pose = camera_pose;
+            }
+            else {
+                p_state->ProcessFrameAirSim(counter, dtime, left_image, right_image);
+            }
                                                                      
 	        for (unsigned int idx = 0; idx < (params_.depth_height*params_.depth_width); idx++)
 	        {
@@ -179,8 +216,13 @@ public:
 
             counter++;
 
-            const Pose next_pose = getNextPose(sgm_depth_image, goal_pose.position, 
-                current_pose, params_.control_loop_period);
+            if (occupancy_map_) {
+                occupancy_map_->integrateDepth(sgm_depth_image.data(), params_.depth_width, params_.depth_height, params_.fov, false,
+                    Pose(response.at(0).camera_position, response.at(0).camera_orientation));
+            }
+
+            const Pose next_pose = avoidMappedObstacles(current_pose, getNextPose(sgm_depth_image, goal_pose.position, 
+                current_pose, params_.control_loop_period));
 
             if (VectorMath::hasNan(next_pose))
                 throw DepthNavException("No further path can be found.");
@@ -300,7 +342,7 @@ protected:
 	}
 
 	//Returns index of nearest neighbor
-	unsigned int nearest_neighbor(std::vector<Vector2r> arr, Vector2r query) {
+	unsigned int nearest_neighbor(const std::vector<Vector2r>& arr, const Vector2r& query) {
 		real_T min_dist = static_cast<real_T>(Utils::max<uint16_t>());
 		unsigned int index = 0;
 		for (unsigned int i = 0; i < arr.size(); i++) {
@@ -314,6 +356,23 @@ protected:
 		return index;
 	}
 
+	//transform from previous to current camera frame in image axes (x right, y down, z forward) as row major 3x4 [R | t],
+	//camera poses are NED with x forward, y right, z down
+	static void getCameraMotion(const Pose& previous, const Pose& current, float motion[12])
+	{
+		Quaternionr rotation = current.orientation.conjugate() * previous.orientation;
+		Vector3r translation = VectorMath::rotateVectorReverse(previous.position - current.position, current.orientation, true);
+		Matrix3x3r r = rotation.toRotationMatrix();
+
+		//image axis i is body axis axes[i]
+		const int axes[3] = { 1, 2, 0 };
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++)
+				motion[4 * i + j] = float(r(axes[i], axes[j]));
+			motion[4 * i + 3] = float(translation(axes[i]));
+		}
+	}
+
 	Pose rotateToGoal(Pose current_pose, Vector3r goal) {
 
 		Quaternionr fromQuat = current_pose.orientation;
@@ -355,6 +414,35 @@ protected:
 		return cell_centers;
 	}
 
+	//sums and obstacle counts of cell windows are constant time lookups after this
+	void buildDepthQuery(const std::vector<float>& depth_image)
+	{
+		depth_query_.build(depth_image.data(), params_.depth_width, params_.depth_height, params_.max_allowed_obs_dist);
+	}
+
+	//pixels [x0, x1) x [y0, y1) of the vehicle sized window around a cell center
+	void getCellWindow(const Vector2r& cell_center, int& x0, int& y0, int& x1, int& y1) const
+	{
+		x0 = int(cell_center.x() - params_.vehicle_width_px / 2);
+		x1 = int(cell_center.x() + params_.vehicle_width_px / 2);
+		y0 = int(cell_center.y() - params_.vehicle_height_px / 2);
+		y1 = int(cell_center.y() + params_.vehicle_height_px / 2);
+	}
+
+	//keeps the position if the way to next_pose passes an obstacle in the occupancy map closer than half the vehicle
+	//width, turning in place lets the camera look for another way. Closer than that already, moves that don't get
+	//any closer are allowed.
+	Pose avoidMappedObstacles(const Pose& current_pose, const Pose& next_pose) const
+	{
+		if (!occupancy_map_ || VectorMath::hasNan(next_pose))
+			return next_pose;
+
+		const real_T radius = occupancy_map_->distanceToObstacle(current_pose.position, params_.vehicle_width / 2);
+		if (occupancy_map_->isSegmentFree(current_pose.position, next_pose.position, radius))
+			return next_pose;
+		return Pose(current_pose.position, next_pose.orientation);
+	}
+
 	real_T getDistanceToGoal(Vector3r current_position, Vector3r goal)
 	{
 		Vector3r goalVec = goal - current_position;
@@ -372,6 +460,10 @@ protected:
         real_T angle = VectorMath::angleBetween(VectorMath::front(), goal_body.normalized(), true);
         return std::abs(angle) <= params_.fov;
 	}
+
+protected:
+	common_utils::DepthWindowQuery depth_query_;
+	std::shared_ptr<OccupancyMap> occupancy_map_;
 };
 
 }}
\ No newline at end of file
@@ -42,6 +42,8 @@ protected:
                 unsigned int cell_idx = nearest_neighbor(cell_centers, Vector2r(y_px, z_px));
                 //Get spiral indexes
                 std::vector<int> spiral_idxs = spiralOrder(params_.M, params_.N, cell_idx);
+                //Cell costs are constant time lookups from here
+                buildDepthQuery(depth_image);
                 /*7. Until free space is found
                 For p = -params.req_free_width to +params.req_free_width
                 For q = -params.req_free_height to +params.req_free_height
@@ -58,7 +60,7 @@ protected:
                 float min_cost = FLT_MAX;
                 int min_cost_i = 0;
                 for (int i = 0; i < cell_centers.size(); ++i) {
-                    cost = computeCellCost(depth_image, cell_centers[spiral_idxs[i]], Vector2r(y_px, z_px));
+                    cost = computeCellCost(cell_centers[spiral_idxs[i]], Vector2r(y_px, z_px));
                     if (cost < min_cost) {
                         min_cost = cost;
                         min_cost_i = i;
@@ -93,24 +95,16 @@ protected:
         }
     }
 
-    float computeCellCost(const std::vector<float>& img, Vector2r cell_center, Vector2r goal) {
+    float computeCellCost(Vector2r cell_center, Vector2r goal) {
 
-        unsigned int counter = 0;
-        unsigned int count_min_depth = 0;
-        float depth_sum = 0;
         Vector2r diff = goal - cell_center;
         float dist_to_goal = sqrt(diff.dot(diff));
 
-        for (int i = int(cell_center.y() - params_.vehicle_height_px / 2); i < int(cell_center.y() + params_.vehicle_height_px / 2); i++) {
-            for (int j = int(cell_center.x() - params_.vehicle_width_px / 2); j<int(cell_center.x() + params_.vehicle_width_px / 2); j++) {
-                int idx = i * params_.depth_width + j;
-                counter++;
-                depth_sum += img[idx];
-                if (img[idx] < params_.max_allowed_obs_dist) {
-                    count_min_depth++;
-                }
-            }
-        }
+        int x0, y0, x1, y1;
+        getCellWindow(cell_center, x0, y0, x1, y1);
+        unsigned int counter = depth_query_.pixelCount(x0, y0, x1, y1);
+        float depth_sum = float(depth_query_.depthSum(x0, y0, x1, y1));
+        unsigned int count_min_depth = depth_query_.obstacleCount(x0, y0, x1, y1);
 
         return (counter / depth_sum) * (2 ^ count_min_depth) * dist_to_goal;
 
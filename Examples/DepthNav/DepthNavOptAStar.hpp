@@ -4,6 +4,14 @@
 #include "common/common_utils/FileSystem.hpp"
 #include "common/common_utils/bitmap_image.hpp"
 #include "common/common_utils/ColorUtils.hpp"
+#include "common/common_utils/WorkStealingPool.hpp"
+#include "common/common_utils/GridSearch.hpp"
+#include "safety/OccupancyMap.hpp"
+#include <memory>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEPTHNAV_OPTASTAR_SSE2 1
+#include <emmintrin.h>
+#endif
 
 namespace msr {
 namespace airlib {
@@ -27,6 +35,32 @@ public:
         real_T collision_cost = 1.0E8f;
 
         unsigned int ray_samples_count = 25;
+
+        //sampled rays are evaluated together in chunks of structure of arrays instead of one at a time,
+        //1000 rays take about 30us on one core, so ray_samples_count can be raised to that for better paths
+        bool batch_rays = true;
+        //additional threads evaluating chunks of rays, 0 evaluates them on the calling thread
+        unsigned int ray_threads = 0;
+
+        //depth image of every step is written as bmp
+        bool generate_debug_info = true;
+
+        //fuse depth images in to a persistent map and don't move closer than max_obs_dist to obstacles
+        //remembered there, also after they left the field of view
+        bool use_occupancy_map = false;
+        OccupancyMap::Params occupancy_map;
+
+        //instead of sampling rays, follow a D* Lite path on a grid of cells closer than max_obs_dist plus half a
+        //cell diagonal to obstacles in the occupancy map, which is then always used. The grid covers start and goal
+        //plus margins and is kept while the goal stays the same, so every step only repairs the search for cells
+        //that changed within grid_update_range of the vehicle. Goals needing more than grid_max_cells cells
+        //throw DepthNavException, a cell takes about 30 bytes.
+        bool grid_search = false;
+        real_T grid_resolution = 0.5f;
+        real_T grid_margin = 10;
+        real_T grid_height_margin = 2;
+        real_T grid_update_range = 15;
+        size_t grid_max_cells = 4000000;
         
         real_T d2_panelty = 6;
         real_T turn_panelty = 10;
@@ -64,10 +98,28 @@ private:
     };
     const unsigned int extra_rays = 1;
 
+    //sampled rays of a frame in structure of arrays, cost is computed from the other arrays
+    struct RayBatch {
+        std::vector<unsigned int> pixel_x, pixel_y;
+        std::vector<float> ray_x, ray_y, ray_z, obs_dist, cost;
+
+        void resize(size_t count)
+        {
+            pixel_x.resize(count);
+            pixel_y.resize(count);
+            ray_x.resize(count);
+            ray_y.resize(count);
+            ray_z.resize(count);
+            obs_dist.resize(count);
+            cost.resize(count);
+        }
+    };
+    static constexpr unsigned int ray_chunk_size = 1024;
+
 public:
     DepthNavOptAStar(const Params& params = Params())
         : params_(params),
-        sample_rays(params.ray_samples_count + extra_rays), //add two more rays, for origin and goal
+        sample_rays(params.batch_rays ? extra_rays : params.ray_samples_count + extra_rays), //add two more rays, for origin and goal
         rnd_width_(0, params.env_width - 1), rnd_height_(0, params.env_height - 1)
     {
         params_.aspect = real_T(params_.depth_height) / real_T(params_.depth_width);
@@ -76,11 +128,30 @@ public:
         params_.env_y_oofset = (params_.depth_height - params_.env_height) / 2;
         params_.tan_hfov_by_2 = std::tan(params_.hfov / 2);
         params_.tan_vfov_by_2 = std::tan(params_.vfov / 2);
+        if (params_.env_width > params_.depth_width || params_.env_height > params_.depth_height)
+            throw DepthNavException("Flight envelope is larger than depth image.");
 
         //origin ray
         SampleRay& sample_ray = sample_rays.at(0);
         sample_ray.pixel_x = params_.depth_width / 2;
         sample_ray.pixel_y = params_.depth_height / 2;
+
+        //ray directions are separable, see pixel2ray
+        ray_tan_y_.resize(params_.depth_width);
+        for (unsigned int x = 0; x < params_.depth_width; ++x)
+            ray_tan_y_[x] = std::tan((params_.depth_width / 2.0f - x) * 2 * params_.tan_hfov_by_2 / params_.depth_width);
+        ray_tan_z_.resize(params_.depth_height);
+        for (unsigned int y = 0; y < params_.depth_height; ++y)
+            ray_tan_z_[y] = std::tan((y - params_.depth_height / 2.0f) * 2 * params_.tan_vfov_by_2 / params_.depth_height);
+
+        if (params_.batch_rays) {
+            ray_batch_.resize(params_.ray_samples_count);
+            if (params_.ray_threads > 0)
+                ray_pool_.reset(new common_utils::WorkStealingPool(params_.ray_threads));
+        }
+
+        if (params_.use_occupancy_map || params_.grid_search)
+            occupancy_map_ = std::make_shared<OccupancyMap>(params_.occupancy_map);
     }
 
     virtual void gotoGoal(const Pose& goal_pose, RpcLibClientBase& client)
@@ -103,9 +174,15 @@ public:
             if (response.size() == 0)
                 throw std::length_error("No images received!");
 
+            if (occupancy_map_)
+                occupancy_map_->integrateDepth(response.at(0), params_.hfov);
+
             const Pose current_pose(response.at(0).camera_position, response.at(0).camera_orientation);
-            const Pose next_pose = getNextPose(response.at(0).image_data_float, goal_pose.position,
-                current_pose, params_.control_loop_period);
+            //grid steps keep max_obs_dist to the map already
+            const Pose next_pose = params_.grid_search ?
+                getNextGridPose(goal_pose.position, current_pose, params_.control_loop_period) :
+                avoidMappedObstacles(current_pose, getNextPose(response.at(0).image_data_float, goal_pose.position,
+                    current_pose, params_.control_loop_period));
 
             if (VectorMath::hasNan(next_pose))
                 throw DepthNavException("No further path can be found.");
@@ -143,6 +220,18 @@ public:
         } while (true);
     }
 
+    //cost of the ray chosen by the last step, length of the planned path with grid_search
+    real_T getLastCost() const
+    {
+        return last_cost_;
+    }
+
+    //nullptr unless Params::use_occupancy_map or grid_search, client side only like DepthNav::getOccupancyMap()
+    std::shared_ptr<OccupancyMap> getOccupancyMap() const
+    {
+        return occupancy_map_;
+    }
+
 protected:
     Pose getNextPose(const std::vector<float>& depth_image, const Vector3r& goal, const Pose& current_pose, real_T dt)
     {
@@ -152,23 +241,39 @@ protected:
         SampleRay* min_cost_ray = &sample_rays.at(0);
         setupRay(*min_cost_ray, depth_image, goal_body, goal_dist);
 
-        if (generate_debug_info_) {
+        if (params_.generate_debug_info) {
             const auto& bmp = depth2bmp(depth_image);
             writeToBmpFile(bmp, params_.depth_width, params_.depth_height,
                 common_utils::FileSystem::combine(std::string("d:\\temp\\111\\"), Utils::stringf("disparity_ % 06d.bmp", iteration_index_)));
         }
 
         //sample rays
-        for (unsigned int ray_index = 0; ray_index < params_.ray_samples_count; ++ray_index) {
-            SampleRay& sample_ray = sample_rays.at(ray_index + extra_rays);
-            sample_ray.pixel_x = params_.env_x_oofset + rnd_width_.next();
-            sample_ray.pixel_y = params_.env_y_oofset + rnd_height_.next();
-            setupRay(sample_ray, depth_image, goal_body, goal_dist);
-
-            if (min_cost_ray->cost > sample_ray.cost)
-                min_cost_ray = &sample_ray;
+        if (params_.batch_rays) {
+            size_t best_index = sampleRayBatch(depth_image, goal_body);
+            if (best_index < params_.ray_samples_count && ray_batch_.cost[best_index] < min_cost_ray->cost) {
+                //d1 and d2 vectors only for the winner
+                batch_min_ray_.pixel_x = ray_batch_.pixel_x[best_index];
+                batch_min_ray_.pixel_y = ray_batch_.pixel_y[best_index];
+                batch_min_ray_.index = batch_min_ray_.pixel_y * params_.depth_width + batch_min_ray_.pixel_x;
+                batch_min_ray_.obs_dist = ray_batch_.obs_dist[best_index];
+                batch_min_ray_.ray = Vector3r(ray_batch_.ray_x[best_index], ray_batch_.ray_y[best_index], ray_batch_.ray_z[best_index]);
+                setRayCost(batch_min_ray_, goal_body, goal_dist);
+                min_cost_ray = &batch_min_ray_;
+            }
+        }
+        else {
+            for (unsigned int ray_index = 0; ray_index < params_.ray_samples_count; ++ray_index) {
+                SampleRay& sample_ray = sample_rays.at(ray_index + extra_rays);
+                sample_ray.pixel_x = params_.env_x_oofset + rnd_width_.next();
+                sample_ray.pixel_y = params_.env_y_oofset + rnd_height_.next();
+                setupRay(sample_ray, depth_image, goal_body, goal_dist);
+
+                if (min_cost_ray->cost > sample_ray.cost)
+                    min_cost_ray = &sample_ray;
+            }
         }
 
+        last_cost_ = min_cost_ray->cost;
         Vector3r next_pos = min_cost_ray->d1_v;
         Quaternionr next_q = min_cost_ray->d1_v.isZero(params_.d1_zero_epsilon) ?
             VectorMath::toQuaternion(VectorMath::front(), min_cost_ray->d2_v.normalized()) :
@@ -179,6 +284,149 @@ protected:
         return global_pose;
     }
 
+    //next pose on the D* Lite path from current_pose to goal, nan pose if the goal can't be reached
+    Pose getNextGridPose(const Vector3r& goal, const Pose& current_pose, real_T dt)
+    {
+        const Vector3r& position = current_pose.position;
+        int cell[3];
+        if (grid_goal_ != goal || !toGridCoords(position, cell))
+            resetGrid(position, goal);
+        else {
+            //the map only changes close to the vehicle
+            const int reach = static_cast<int>(std::ceil(params_.grid_update_range / params_.grid_resolution));
+            int lo[3], hi[3];
+            for (int i = 0; i < 3; ++i) {
+                lo[i] = std::max(cell[i] - reach, 0);
+                hi[i] = std::min(cell[i] + reach, grid_size_[i] - 1);
+            }
+            updateGridCells(lo, hi);
+        }
+
+        toGridCoords(position, cell);
+        if (!grid_search_.replan(grid_search_.toCell(cell[0], cell[1], cell[2]), grid_path_))
+            return Pose::nanPose();
+        last_cost_ = grid_search_.getPathCost() * params_.grid_resolution;
+
+        //farthest cell of the path reachable in this step without passing closer than max_obs_dist to the map.
+        //Moves between centers of free neighbouring cells always keep that distance, so an off-center position
+        //that can't reach the next cell goes back to the center of its own cell first. Out of a blocked cell
+        //the path is followed as is.
+        const real_T step = params_.max_linear_speed * dt;
+        size_t next = std::min<size_t>(1, grid_path_.size() - 1);
+        const Vector3r cell_center = gridCellCenter(grid_path_[0]);
+        if (!grid_search_.isBlocked(grid_path_[0]) && !isGridStepFree(position, next)
+            && (cell_center - position).norm() > params_.grid_resolution / 100)
+            next = 0;
+        else {
+            while (next + 1 < grid_path_.size() && (gridCellCenter(grid_path_[next + 1]) - position).norm() <= step
+                && isGridStepFree(position, next + 1))
+                ++next;
+        }
+
+        //look along the path
+        const Vector3r ahead = gridCellCenter(grid_path_[std::min(next + 1, grid_path_.size() - 1)]) - position;
+        const Quaternionr orientation = ahead.isZero(params_.d1_zero_epsilon) ? current_pose.orientation :
+            VectorMath::toQuaternion(VectorMath::front(), ahead.normalized());
+        return Pose(gridCellCenter(grid_path_[next]), orientation);
+    }
+
+    bool isGridStepFree(const Vector3r& position, size_t path_index) const
+    {
+        return occupancy_map_->isSegmentFree(position, gridCellCenter(grid_path_[path_index]), params_.max_obs_dist);
+    }
+
+    //grid over start and goal plus margins with all cells from the map, search starts over towards goal
+    void resetGrid(const Vector3r& start, const Vector3r& goal)
+    {
+        const Vector3r margin(params_.grid_margin, params_.grid_margin, params_.grid_height_margin);
+        const Vector3r origin = start.cwiseMin(goal) - margin;
+        const Vector3r extent = start.cwiseMax(goal) + margin - origin;
+        double cell_count = 1;
+        for (int i = 0; i < 3; ++i)
+            cell_count *= std::ceil(extent[i] / params_.grid_resolution) + 1;
+        if (!(cell_count <= static_cast<double>(params_.grid_max_cells)))
+            throw DepthNavException(Utils::stringf("Goal is too far for grid_search: the grid would need %.0f cells "
+                "but grid_max_cells is %zu, use a closer goal or a coarser grid_resolution.", cell_count, params_.grid_max_cells));
+
+        grid_origin_ = origin;
+        int lo[3], hi[3];
+        for (int i = 0; i < 3; ++i) {
+            grid_size_[i] = static_cast<int>(std::ceil(extent[i] / params_.grid_resolution)) + 1;
+            lo[i] = 0;
+            hi[i] = grid_size_[i] - 1;
+        }
+        grid_search_.resize(grid_size_[0], grid_size_[1], grid_size_[2]);
+        updateGridCells(lo, hi);
+
+        int cell[3];
+        toGridCoords(goal, cell);
+        grid_search_.setGoal(grid_search_.toCell(cell[0], cell[1], cell[2]));
+        grid_goal_ = goal;
+    }
+
+    //blocks cells of [lo, hi] with centers closer than max_obs_dist plus half a cell diagonal to an occupied voxel
+    //and frees the others, so every point of a cell or of a move to a free neighbour keeps max_obs_dist
+    void updateGridCells(const int lo[3], const int hi[3])
+    {
+        const real_T resolution = params_.grid_resolution;
+        const real_T clearance = params_.max_obs_dist + resolution * std::sqrt(3.0f) / 2;
+        const Vector3r extent = Vector3r::Constant(clearance);
+        const Vector3r box_min = grid_origin_ + Vector3r(real_T(lo[0]), real_T(lo[1]), real_T(lo[2])) * resolution;
+        const Vector3r box_max = grid_origin_ + Vector3r(real_T(hi[0]), real_T(hi[1]), real_T(hi[2])) * resolution;
+        occupancy_map_->getOccupiedVoxels(box_min - extent, box_max + extent, grid_voxels_);
+
+        int size[3];
+        for (int i = 0; i < 3; ++i)
+            size[i] = hi[i] - lo[i] + 1;
+        grid_box_.assign(static_cast<size_t>(size[0]) * size[1] * size[2], 0);
+
+        //stamp a ball around every voxel
+        const int reach = static_cast<int>(std::ceil(clearance / resolution));
+        for (const Vector3r& voxel : grid_voxels_) {
+            int from[3], to[3];
+            for (int i = 0; i < 3; ++i) {
+                const int center = static_cast<int>(std::floor((voxel[i] - grid_origin_[i]) / resolution + 0.5f));
+                from[i] = std::max(center - reach, lo[i]);
+                to[i] = std::min(center + reach, hi[i]);
+            }
+            for (int z = from[2]; z <= to[2]; ++z) {
+                for (int y = from[1]; y <= to[1]; ++y) {
+                    for (int x = from[0]; x <= to[0]; ++x) {
+                        const Vector3r center = grid_origin_ + Vector3r(real_T(x), real_T(y), real_T(z)) * resolution;
+                        if ((center - voxel).squaredNorm() < clearance * clearance)
+                            grid_box_[(static_cast<size_t>(z - lo[2]) * size[1] + (y - lo[1])) * size[0] + (x - lo[0])] = 1;
+                    }
+                }
+            }
+        }
+
+        //only cells that changed reach the search
+        size_t index = 0;
+        for (int z = lo[2]; z <= hi[2]; ++z)
+            for (int y = lo[1]; y <= hi[1]; ++y)
+                for (int x = lo[0]; x <= hi[0]; ++x)
+                    grid_search_.setBlocked(grid_search_.toCell(x, y, z), grid_box_[index++] != 0);
+    }
+
+    //cell of point clamped to the grid, false if point is outside
+    bool toGridCoords(const Vector3r& point, int cell[3]) const
+    {
+        bool inside = true;
+        for (int i = 0; i < 3; ++i) {
+            const int c = static_cast<int>(std::floor((point[i] - grid_origin_[i]) / params_.grid_resolution + 0.5f));
+            cell[i] = std::max(0, std::min(c, grid_size_[i] - 1));
+            inside = inside && c == cell[i];
+        }
+        return inside;
+    }
+
+    Vector3r gridCellCenter(size_t cell) const
+    {
+        unsigned int x, y, z;
+        grid_search_.toCoords(cell, x, y, z);
+        return grid_origin_ + Vector3r(real_T(x), real_T(y), real_T(z)) * params_.grid_resolution;
+    }
+
     static std::vector<common_utils::bmp::rgb_t> depth2bmp(const std::vector<float>& depth_image)
     {
         std::vector<common_utils::bmp::rgb_t> r(depth_image.size());
@@ -209,18 +457,149 @@ protected:
 
     void setupRay(SampleRay& sample_ray, const std::vector<float>& depth_image, const Vector3r& goal_body, real_T goal_dist)
     {
-        sample_ray.index = sample_ray.pixel_y * params_.env_width + sample_ray.pixel_x;
+        sample_ray.index = sample_ray.pixel_y * params_.depth_width + sample_ray.pixel_x;
         sample_ray.obs_dist = depth_image.at(sample_ray.index);
         sample_ray.ray = pixel2ray(sample_ray.pixel_x, sample_ray.pixel_y);
         setRayCost(sample_ray, goal_body, goal_dist);
     }
 
+    //samples ray_samples_count rays into ray_batch_ and returns the index of the first one with minimum cost
+    size_t sampleRayBatch(const std::vector<float>& depth_image, const Vector3r& goal_body)
+    {
+        //evaluateRays reads pixels without bounds checks, sampled pixels are within the envelope which is
+        //within depth_width x depth_height
+        if (depth_image.size() < static_cast<size_t>(params_.depth_width) * params_.depth_height)
+            throw DepthNavException(Utils::stringf("Depth image has %u pixels but %u x %u are expected.",
+                static_cast<unsigned int>(depth_image.size()), params_.depth_width, params_.depth_height));
+
+        //same random sequence as sampling rays one at a time
+        const size_t count = params_.ray_samples_count;
+        for (size_t i = 0; i < count; ++i) {
+            ray_batch_.pixel_x[i] = params_.env_x_oofset + rnd_width_.next();
+            ray_batch_.pixel_y[i] = params_.env_y_oofset + rnd_height_.next();
+        }
+
+        const size_t chunk_count = (count + ray_chunk_size - 1) / ray_chunk_size;
+        chunk_min_.resize(chunk_count);
+        auto evaluate_chunk = [&](size_t chunk) {
+            const size_t begin = chunk * ray_chunk_size;
+            chunk_min_[chunk] = evaluateRays(depth_image, goal_body, begin, std::min(count, begin + ray_chunk_size));
+        };
+        if (ray_pool_ && chunk_count > 1)
+            ray_pool_->parallelFor(chunk_count, evaluate_chunk);
+        else {
+            for (size_t chunk = 0; chunk < chunk_count; ++chunk)
+                evaluate_chunk(chunk);
+        }
+
+        //chunks are in order, so ties go to the first ray like in the sequential loop
+        size_t best = count;
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            if (best == count || ray_batch_.cost[chunk_min_[chunk]] < ray_batch_.cost[best])
+                best = chunk_min_[chunk];
+        }
+        return best;
+    }
+
+    //same cost as setupRay for rays [begin, end) of ray_batch_, returns index of the first with minimum cost
+    size_t evaluateRays(const std::vector<float>& depth_image, const Vector3r& goal_body, size_t begin, size_t end)
+    {
+        //gather depth and direction of each pixel
+        for (size_t i = begin; i < end; ++i) {
+            const unsigned int x = ray_batch_.pixel_x[i], y = ray_batch_.pixel_y[i];
+            ray_batch_.obs_dist[i] = depth_image[y * params_.depth_width + x];
+            ray_batch_.ray_y[i] = ray_tan_y_[x];
+            ray_batch_.ray_z[i] = ray_tan_z_[y];
+        }
+
+        //four rays at a time with SSE2, the rest and other targets with the same operations in scalar code.
+        //Compilers don't vectorize the scalar loop themselves because std::sqrt may set errno.
+        const float goal_x = goal_body.x(), goal_y = goal_body.y(), goal_z = goal_body.z();
+        const float d2_panelty = params_.d2_panelty, turn_panelty = params_.turn_panelty, max_obs_dist = params_.max_obs_dist;
+        float* ray_x = ray_batch_.ray_x.data();
+        float* ray_y = ray_batch_.ray_y.data();
+        float* ray_z = ray_batch_.ray_z.data();
+        const float* obs_dist = ray_batch_.obs_dist.data();
+        float* cost = ray_batch_.cost.data();
+        size_t i = begin;
+#ifdef DEPTHNAV_OPTASTAR_SSE2
+        const __m128 one = _mm_set1_ps(1), half = _mm_set1_ps(0.5f), zero = _mm_setzero_ps();
+        const __m128 vgoal_x = _mm_set1_ps(goal_x), vgoal_y = _mm_set1_ps(goal_y), vgoal_z = _mm_set1_ps(goal_z);
+        const __m128 vd2_panelty = _mm_set1_ps(d2_panelty), vturn_panelty = _mm_set1_ps(turn_panelty);
+        const __m128 vmax_obs_dist = _mm_set1_ps(max_obs_dist), collision = _mm_set1_ps(1.0E15f);
+        for (; i + 4 <= end; i += 4) {
+            const __m128 tan_y = _mm_loadu_ps(ray_y + i), tan_z = _mm_loadu_ps(ray_z + i);
+            const __m128 obs = _mm_loadu_ps(obs_dist + i);
+            const __m128 rx = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(one, _mm_mul_ps(tan_y, tan_y)), _mm_mul_ps(tan_z, tan_z))));
+            const __m128 ry = _mm_mul_ps(tan_y, rx), rz = _mm_mul_ps(tan_z, rx);
+            _mm_storeu_ps(ray_x + i, rx);
+            _mm_storeu_ps(ray_y + i, ry);
+            _mm_storeu_ps(ray_z + i, rz);
+
+            //argument order of _mm_min_ps as std::min for NaN
+            const __m128 goal_dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vgoal_x, rx), _mm_mul_ps(vgoal_y, ry)), _mm_mul_ps(vgoal_z, rz));
+            const __m128 goal_on_ray = _mm_min_ps(zero, goal_dot);
+            const __m128 d1 = _mm_min_ps(goal_on_ray, obs);
+            const __m128 d2_x = _mm_sub_ps(vgoal_x, _mm_mul_ps(rx, d1));
+            const __m128 d2_y = _mm_sub_ps(vgoal_y, _mm_mul_ps(ry, d1));
+            const __m128 d2_z = _mm_sub_ps(vgoal_z, _mm_mul_ps(rz, d1));
+            const __m128 d2 = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d2_x, d2_x), _mm_mul_ps(d2_y, d2_y)), _mm_mul_ps(d2_z, d2_z)));
+
+            const __m128 turn_dot1 = _mm_mul_ps(_mm_sub_ps(one, rx), half);
+            const __m128 d2_dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, d2_x), _mm_mul_ps(ry, d2_y)), _mm_mul_ps(rz, d2_z));
+            const __m128 turn_dot2 = _mm_mul_ps(_mm_sub_ps(one, d2_dot), half);
+            __m128 ray_cost = _mm_add_ps(_mm_add_ps(d1, _mm_mul_ps(d2, vd2_panelty)), _mm_mul_ps(vturn_panelty, _mm_add_ps(turn_dot1, turn_dot2)));
+            ray_cost = _mm_add_ps(ray_cost, _mm_and_ps(_mm_cmplt_ps(obs, vmax_obs_dist), collision));
+            _mm_storeu_ps(cost + i, ray_cost);
+        }
+#endif
+        for (; i < end; ++i) {
+            //normalize (1, tan_y, tan_z)
+            const float inv_norm = 1 / std::sqrt(1 + ray_y[i] * ray_y[i] + ray_z[i] * ray_z[i]);
+            const float rx = inv_norm, ry = ray_y[i] * inv_norm, rz = ray_z[i] * inv_norm;
+            ray_x[i] = rx;
+            ray_y[i] = ry;
+            ray_z[i] = rz;
+
+            const float goal_on_ray = std::min(goal_x * rx + goal_y * ry + goal_z * rz, 0.0f);
+            const float d1 = std::min(obs_dist[i], goal_on_ray);
+            const float d2_x = goal_x - rx * d1, d2_y = goal_y - ry * d1, d2_z = goal_z - rz * d1;
+            const float d2 = std::sqrt(d2_x * d2_x + d2_y * d2_y + d2_z * d2_z);
+
+            const float turn_dot1 = (1 - rx) / 2;
+            const float turn_dot2 = (1 - (rx * d2_x + ry * d2_y + rz * d2_z)) / 2;
+            cost[i] = d1 + d2 * d2_panelty + turn_panelty * (turn_dot1 + turn_dot2)
+                + (obs_dist[i] < max_obs_dist ? 1.0E15f : 0.0f);
+        }
+
+        size_t best = begin;
+        for (size_t k = begin + 1; k < end; ++k) {
+            if (cost[k] < cost[best])
+                best = k;
+        }
+        return best;
+    }
+
     real_T getDistanceToGoal(Vector3r current_position, Vector3r goal)
     {
         Vector3r goalVec = goal - current_position;
         return goalVec.norm();
     }
 
+    //keeps the position if the way to next_pose passes an obstacle in the occupancy map closer than max_obs_dist,
+    //turning in place lets the camera look for another way. Closer than that already, moves that don't get any
+    //closer are allowed.
+    Pose avoidMappedObstacles(const Pose& current_pose, const Pose& next_pose) const
+    {
+        if (!occupancy_map_ || VectorMath::hasNan(next_pose))
+            return next_pose;
+
+        const real_T radius = occupancy_map_->distanceToObstacle(current_pose.position, params_.max_obs_dist);
+        if (occupancy_map_->isSegmentFree(current_pose.position, next_pose.position, radius))
+            return next_pose;
+        return Pose(current_pose.position, next_pose.orientation);
+    }
+
     Vector3r pixel2ray(unsigned int x, unsigned y)
     {
         real_T pixel_y_n = params_.depth_width / 2.0f - x;
@@ -257,8 +636,23 @@ private:
     Params params_;
     std::vector<SampleRay> sample_rays;
     common_utils::RandomGeneratorUI rnd_width_, rnd_height_;
-    bool generate_debug_info_ = true;
     unsigned int iteration_index_;
+    real_T last_cost_ = 0;
+
+    std::vector<float> ray_tan_y_, ray_tan_z_;
+    RayBatch ray_batch_;
+    std::vector<size_t> chunk_min_;
+    SampleRay batch_min_ray_;
+    std::unique_ptr<common_utils::WorkStealingPool> ray_pool_;
+    std::shared_ptr<OccupancyMap> occupancy_map_;
+
+    common_utils::GridSearch grid_search_;
+    Vector3r grid_origin_ = Vector3r::Zero();
+    Vector3r grid_goal_ = VectorMath::nanVector();
+    int grid_size_[3] = { 0, 0, 0 };
+    std::vector<size_t> grid_path_;
+    std::vector<Vector3r> grid_voxels_;
+    std::vector<unsigned char> grid_box_;
 };
 
 }
@@ -0,0 +1,99 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include "DepthNavOptAStar.hpp"
+
+//Times DepthNavOptAStar::getNextPose on a synthetic depth image, sampling rays one at a time as before and
+//in batches with increasing sample counts. Reports microseconds per frame and the cost of the chosen ray,
+//lower cost being the better path.
+class DepthNavRayBenchmark {
+public:
+    static void run(int frames = 200)
+    {
+        typedef msr::airlib::DepthNavOptAStar::Params Params;
+
+        Params params;
+        params.generate_debug_info = false;
+        const std::vector<float> depth = makeDepthImage(params.depth_width, params.depth_height);
+
+        std::cout << "DepthNavOptAStar rays, " << params.depth_width << "x" << params.depth_height << ", "
+            << frames << " frames" << std::endl;
+        std::cout << std::left << std::setw(24) << "sampler" << std::right << std::setw(10) << "rays"
+            << std::setw(14) << "us/frame" << std::setw(14) << "mean cost" << std::endl;
+
+        //25 rays was the default before batches
+        params.ray_samples_count = 25;
+        params.batch_rays = false;
+        report("one at a time", params, depth, frames);
+
+        const unsigned int threads = std::thread::hardware_concurrency();
+        for (unsigned int rays : { 25u, 1000u, 4000u, 16000u }) {
+            params.ray_samples_count = rays;
+            params.batch_rays = true;
+            params.ray_threads = 0;
+            report("batch", params, depth, frames);
+            if (threads > 1) {
+                params.ray_threads = threads - 1;
+                report("batch, all threads", params, depth, frames);
+            }
+        }
+    }
+
+private:
+    //exposes getNextPose
+    class Planner : public msr::airlib::DepthNavOptAStar {
+    public:
+        Planner(const Params& params)
+            : msr::airlib::DepthNavOptAStar(params)
+        {
+        }
+
+        using msr::airlib::DepthNavOptAStar::getNextPose;
+    };
+
+    static void report(const char* name, const msr::airlib::DepthNavOptAStar::Params& params, const std::vector<float>& depth, int frames)
+    {
+        using namespace msr::airlib;
+
+        Planner planner(params);
+        const Pose current_pose(Vector3r(0, 0, -1), Quaternionr(1, 0, 0, 0));
+        const Vector3r goal(20, 3, -1);
+
+        double cost_sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; ++frame) {
+            planner.getNextPose(depth, goal, current_pose, params.control_loop_period);
+            cost_sum += planner.getLastCost();
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / frames;
+
+        std::cout << std::left << std::setw(24) << name << std::right << std::setw(10) << params.ray_samples_count
+            << std::fixed << std::setprecision(1) << std::setw(14) << us << std::setw(14) << cost_sum / frames << std::endl;
+    }
+
+    //wall at 6m with an opening right of center, ground below
+    static std::vector<float> makeDepthImage(unsigned int width, unsigned int height)
+    {
+        std::mt19937 gen(0);
+        std::normal_distribution<float> noise(0, 0.05f);
+        std::vector<float> depth(width * height);
+        for (unsigned int y = 0; y < height; ++y) {
+            for (unsigned int x = 0; x < width; ++x) {
+                float d = x > width * 5 / 8 && x < width * 6 / 8 && y > height / 4 && y < height * 3 / 4 ? 40.0f : 6.0f;
+                if (y > height * 3 / 4)
+                    d = std::min(d, 2.0f * height / (y - height / 2.0f));
+                depth[y * width + x] = std::max(0.1f, d + noise(gen));
+            }
+        }
+        return depth;
+    }
+};
@@ -0,0 +1,106 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include "common/common_utils/GridSearch.hpp"
+
+//Times the grid search behind DepthNavOptAStar::Params::grid_search on a field of random pillars. The start
+//follows the path one cell per step while a few cells close to it change, as if newly seen, and every step
+//is planned again with a full A* search and with a D* Lite replan. Reports nodes expanded per step, microseconds
+//per step and nodes expanded per millisecond.
+class GridSearchBenchmark {
+public:
+    static void run(int steps = 200)
+    {
+        std::cout << "GridSearch, " << steps << " steps, 4 cells changed per step" << std::endl;
+        std::cout << std::left << std::setw(24) << "search" << std::right << std::setw(14) << "grid" << std::setw(8) << "steps"
+            << std::setw(14) << "nodes/step" << std::setw(12) << "us/step" << std::setw(14) << "nodes/ms" << std::endl;
+
+        for (unsigned int size_z : { 1u, 16u }) {
+            report("A*", false, 256, 256, size_z, steps);
+            report("D* Lite", true, 256, 256, size_z, steps);
+        }
+    }
+
+private:
+    static void report(const char* name, bool incremental, unsigned int size_x, unsigned int size_y, unsigned int size_z, int steps)
+    {
+        common_utils::GridSearch search(size_x, size_y, size_z);
+        makePillars(search);
+        const unsigned int start_xy = 2, goal_xy = std::min(size_x, size_y) - 3;
+        clearAround(search, start_xy, start_xy);
+        clearAround(search, goal_xy, goal_xy);
+
+        //same changes for both searches
+        std::mt19937 gen(1);
+        std::uniform_int_distribution<int> offset(-6, 6);
+
+        const size_t goal = search.toCell(goal_xy, goal_xy, size_z / 2);
+        size_t start = search.toCell(start_xy, start_xy, size_z / 2);
+        if (incremental)
+            search.setGoal(goal);
+
+        std::vector<size_t> path;
+        size_t expanded = 0;
+        double us = 0;
+        int step = 0;
+        for (; step < steps && start != goal; ++step) {
+            auto begin = std::chrono::steady_clock::now();
+            const bool found = incremental ? search.replan(start, path) : search.findPath(start, goal, path);
+            us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+            expanded += search.getExpandedCount();
+            if (!found)
+                break;
+            start = path.at(1);
+
+            unsigned int x, y, z;
+            search.toCoords(start, x, y, z);
+            for (int k = 0; k < 4; ++k) {
+                const int cx = static_cast<int>(x) + offset(gen), cy = static_cast<int>(y) + offset(gen), cz = static_cast<int>(z) + offset(gen);
+                if (cx < 0 || cy < 0 || cz < 0 || cx >= static_cast<int>(size_x) || cy >= static_cast<int>(size_y) || cz >= static_cast<int>(size_z))
+                    continue;
+                const size_t cell = search.toCell(cx, cy, cz);
+                if (cell != goal && cell != start)
+                    search.setBlocked(cell, !search.isBlocked(cell));
+            }
+        }
+
+        std::ostringstream grid;
+        grid << size_x << "x" << size_y << "x" << size_z;
+        std::cout << std::left << std::setw(24) << name << std::right << std::setw(14) << grid.str() << std::setw(8) << step
+            << std::fixed << std::setprecision(1) << std::setw(14) << double(expanded) / std::max(step, 1)
+            << std::setw(12) << us / std::max(step, 1) << std::setw(14) << expanded / std::max(us / 1000, 1E-9) << std::endl;
+    }
+
+    //square pillars over the full height covering about a fifth of the cells
+    static void makePillars(common_utils::GridSearch& search)
+    {
+        std::mt19937 gen(0);
+        std::uniform_int_distribution<unsigned int> px(0, search.getSizeX() - 1), py(0, search.getSizeY() - 1);
+        const unsigned int pillar_count = search.getSizeX() * search.getSizeY() / 80;
+        for (unsigned int n = 0; n < pillar_count; ++n)
+            setColumns(search, px(gen), py(gen), 4, true);
+    }
+
+    //start and goal in the open
+    static void clearAround(common_utils::GridSearch& search, unsigned int x, unsigned int y)
+    {
+        setColumns(search, x - 2, y - 2, 5, false);
+    }
+
+    static void setColumns(common_utils::GridSearch& search, unsigned int x0, unsigned int y0, unsigned int width, bool blocked)
+    {
+        for (unsigned int y = y0; y < std::min(y0 + width, search.getSizeY()); ++y)
+            for (unsigned int x = x0; x < std::min(x0 + width, search.getSizeX()); ++x)
+                for (unsigned int z = 0; z < search.getSizeZ(); ++z)
+                    search.setBlocked(search.toCell(x, y, z), blocked);
+    }
+};
@@ -2,10 +2,13 @@
 #include "StandAlonePhysics.hpp"
 #include "DataCollection/StereoImageGenerator.hpp"
 #include "DataCollection/DataCollectorSGM.h"                          
+#include "DataCollection/ImageKernelsBenchmark.hpp"
 #include "GaussianMarkovTest.hpp"
 #include "DepthNav/DepthNavCost.hpp"
 #include "DepthNav/DepthNavThreshold.hpp"
 #include "DepthNav/DepthNavOptAStar.hpp"
+#include "DepthNav/DepthNavRayBenchmark.hpp"
+#include "DepthNav/GridSearchBenchmark.hpp"
 #include <iostream>
 #include <string>
 #include <sys/stat.h>
@@ -90,6 +93,30 @@ void runSteroImageGenerator(int argc, const char *argv[])
         : std::string(argv[2]));
 }
 
+void runImageKernelsBenchmark(int argc, const char *argv[])
+{
+    if (argc >= 3)
+        ImageKernelsBenchmark::run(std::stoi(argv[1]), std::stoi(argv[2]));
+    else
+        ImageKernelsBenchmark::run();
+}
+
+void runDepthNavRayBenchmark(int argc, const char *argv[])
+{
+    if (argc >= 2)
+        DepthNavRayBenchmark::run(std::stoi(argv[1]));
+    else
+        DepthNavRayBenchmark::run();
+}
+
+void runGridSearchBenchmark(int argc, const char *argv[])
+{
+    if (argc >= 2)
+        GridSearchBenchmark::run(std::stoi(argv[1]));
+    else
+        GridSearchBenchmark::run();
+}
+
 void runGaussianMarkovTest()
 {
 	using namespace msr::airlib;
@@ -123,6 +150,8 @@ void runDepthNavGT()
     //DepthNavThreshold depthNav;
     DepthNavCost depthNav;
     //DepthNavOptAStar depthNav;
+    //remember obstacles that left the field of view
+    //depthNav.params_.use_occupancy_map = true;
     depthNav.initialize(client, request);
     depthNav.gotoGoal(goalPose, client, request);
 }
@@ -157,6 +186,11 @@ void runDepthNavSGM()
     SGMOptions params;
     CStateStereo * p_state;
 
+    //temporal mode: disparities are searched around those of the previous frame, frames without one
+    //go through a half resolution level
+    params.pyramidLevels = 1;
+    depthNav.params_.sgm_temporal = true;
+
     if (params.maxImageDimensionWidth != (int) depthNav.params_.depth_width)
         printf("WARNING: Width Mismatch between SGM and DepthNav. Overwriting parameters.\n");
         params.maxImageDimensionWidth = depthNav.params_.depth_width;
@@ -175,6 +209,9 @@ int main(int argc, const char *argv[])
 {
     //runDepthNavGT();
     //runDepthNavSGM();
+    //runImageKernelsBenchmark(argc, argv);
+    //runDepthNavRayBenchmark(argc, argv);
+    //runGridSearchBenchmark(argc, argv);
     runDataCollectorSGM(argc, argv);
 
     return 0;
@@ -0,0 +1,137 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef msr_HeadlessSim_HeadlessMultirotor_hpp
+#define msr_HeadlessSim_HeadlessMultirotor_hpp
+
+#include "common/Common.hpp"
+#include "common/ClockFactory.hpp"
+#include "common/AirSimSettings.hpp"
+#include "common/UpdatableObject.hpp"
+#include "physics/Kinematics.hpp"
+#include "physics/Environment.hpp"
+#include "sensors/SensorFactory.hpp"
+#include "vehicles/multirotor/MultiRotor.hpp"
+#include "vehicles/multirotor/MultiRotorParamsFactory.hpp"
+
+namespace msr { namespace airlib {
+
+/*
+    Multirotor vehicle that runs without Unreal. This plays the role of MultirotorPawnSimApi:
+    it owns kinematics, environment, params, firmware API and physics body of one vehicle.
+    Instead of collisions from rendering engine, it uses infinite flat ground plane at ground_z (NED)
+    and treats vehicle body box as its collision shape.
+*/
+class HeadlessMultirotor : public UpdatableObject {
+public:
+    HeadlessMultirotor(const std::string& name, const AirSimSettings::VehicleSetting* vehicle_setting,
+        const Vector3r& start_position, real_T ground_z = 0)
+        : name_(name), ground_z_(ground_z)
+    {
+        //headless mode only has sensors that don't need rendering engine
+        params_ = MultiRotorParamsFactory::createConfig(vehicle_setting, std::make_shared<SensorFactory>());
+        api_ = params_->createMultirotorApi();
+
+        //start resting on the ground
+        ground_offset_ = params_->getParams().body_box.z() / 2;
+        Kinematics::State initial_kinematics = Kinematics::State::zero();
+        initial_kinematics.pose.position = Vector3r(start_position.x(), start_position.y(), ground_z_ - ground_offset_);
+        kinematics_.reset(new Kinematics(initial_kinematics));
+
+        Environment::State initial_environment(initial_kinematics.pose.position,
+            AirSimSettings::singleton().origin_geopoint.home_geo_point);
+        environment_.reset(new Environment(initial_environment));
+
+        vehicle_.reset(new MultiRotor(params_.get(), api_.get(), kinematics_.get(), environment_.get()));
+        api_->setSimulatedGroundTruth(&kinematics_->getState(), environment_.get());
+    }
+
+    //*** Start: UpdatableState implementation ***//
+    virtual void resetImplementation() override
+    {
+        kinematics_->reset();
+        environment_->reset();
+        api_->reset();
+        vehicle_->reset();
+    }
+
+    virtual void update() override
+    {
+        UpdatableObject::update();
+
+        //environment update for current position
+        environment_->setPosition(kinematics_->getPose().position);
+        environment_->update();
+
+        vehicle_->setCollisionInfo(getGroundCollision());
+
+        //update forces on vertices, controller gets updated by physics engine after kinematics
+        vehicle_->update();
+    }
+
+    virtual void reportState(StateReporter& reporter) override
+    {
+        reporter.writeValue("Vehicle", name_);
+        vehicle_->reportState(reporter);
+    }
+
+    virtual UpdatableObject* getPhysicsBody() override
+    {
+        return vehicle_->getPhysicsBody();
+    }
+    //*** End: UpdatableState implementation ***//
+
+    const std::string& getName() const
+    {
+        return name_;
+    }
+
+    MultirotorApiBase* getApi() const
+    {
+        return api_.get();
+    }
+
+    const Kinematics::State& getKinematics() const
+    {
+        return kinematics_->getState();
+    }
+
+    const Vector3r& getStartPosition() const
+    {
+        return kinematics_->getInitialState().pose.position;
+    }
+
+private:
+    CollisionInfo getGroundCollision() const
+    {
+        CollisionInfo collision_info;
+
+        const Vector3r& position = kinematics_->getPose().position;
+        real_T penetration = position.z() + ground_offset_ - ground_z_;
+        if (penetration >= 0) {
+            collision_info.has_collided = true;
+            collision_info.normal = Vector3r(0, 0, -1);
+            collision_info.position = position;
+            collision_info.impact_point = position + Vector3r(0, 0, ground_offset_);
+            collision_info.penetration_depth = penetration;
+            collision_info.time_stamp = ClockFactory::get()->nowNanos();
+            collision_info.object_name = "Ground";
+        }
+
+        return collision_info;
+    }
+
+private:
+    std::string name_;
+    real_T ground_z_;
+    real_T ground_offset_;
+
+    std::unique_ptr<MultiRotorParams> params_;
+    std::unique_ptr<MultirotorApiBase> api_;
+    std::unique_ptr<Kinematics> kinematics_;
+    std::unique_ptr<Environment> environment_;
+    std::unique_ptr<MultiRotor> vehicle_;
+};
+
+}} //namespace
+#endif
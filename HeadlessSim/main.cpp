@@ -0,0 +1,269 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <future>
+#include <algorithm>
+#include "common/Common.hpp"
+#include "common/Settings.hpp"
+#include "common/AirSimSettings.hpp"
+#include "common/ClockFactory.hpp"
+#include "common/LockstepClock.hpp"
+#include "physics/PhysicsWorld.hpp"
+#include "physics/FastPhysicsEngine.hpp"
+#include "HeadlessMultirotor.hpp"
+
+using namespace std;
+using namespace msr::airlib;
+
+/*
+    Runs multirotor episodes without Unreal as fast as CPU allows. Simulated time comes from
+    LockstepClock which advances by physics period on every world update and the physics loop
+    runs with zero period so ScheduledExecutor never sleeps. APIs such as takeoff and moveToPosition
+    wait on the same simulated clock so one episode takes only as much wall time as its computation.
+    Because episode threads are in lockstep with physics, results don't depend on thread scheduling.
+
+    Each episode starts a new clock at the same simulated time, resets the world, takes off all vehicles,
+    flies them to target (relative to their start position) and prints one CSV line per vehicle. The summary
+    gives achieved sim-seconds per wall-second, counting each episode until its last vehicle is done, and
+    episodes per hour which can be used to size controller-tuning batch jobs.
+*/
+
+struct RunnerOptions {
+    std::string settings_filepath;
+    std::string vehicle_name;
+    unsigned int vehicle_count = 1;
+    unsigned int episode_count = 1;
+    float period_ms = 3;
+    Vector3r target = Vector3r(10, 0, -5);
+    float velocity = 5;
+    float timeout_sec = 60;
+    float tolerance = 0.5f;
+    float vehicle_spacing = 10;
+    bool verbose = false;
+};
+
+struct EpisodeResult {
+    bool success = false;
+    float position_error = 0;
+    double sim_seconds = 0;
+};
+
+static void printUsage(const char* program)
+{
+    cout << "Usage: " << program << " [options]" << endl;
+    cout << "\t--settings <path>      settings.json to load (default: built-in SimpleFlight defaults)" << endl;
+    cout << "\t--vehicle <name>       vehicle from settings to instantiate (default: first SimpleFlight vehicle)" << endl;
+    cout << "\t--vehicles <count>     number of vehicles simulated together (default: 1)" << endl;
+    cout << "\t--episodes <count>     number of episodes to run (default: 1)" << endl;
+    cout << "\t--period-ms <ms>       physics step in simulated milliseconds (default: 3)" << endl;
+    cout << "\t--target <x,y,z>       NED target relative to start position (default: 10,0,-5)" << endl;
+    cout << "\t--velocity <m/s>       velocity for moveToPosition (default: 5)" << endl;
+    cout << "\t--timeout <seconds>    simulated timeout for each API call (default: 60)" << endl;
+    cout << "\t--tolerance <m>        final distance from target counted as success (default: 0.5)" << endl;
+    cout << "\t--verbose              print log messages from vehicles and physics" << endl;
+}
+
+static bool parseOptions(int argc, const char* argv[], RunnerOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--verbose") {
+            options.verbose = true;
+            continue;
+        }
+        if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+            return false;
+
+        std::string value = argv[++i];
+        if (arg == "--settings")
+            options.settings_filepath = value;
+        else if (arg == "--vehicle")
+            options.vehicle_name = value;
+        else if (arg == "--vehicles")
+            options.vehicle_count = static_cast<unsigned int>(std::stoul(value));
+        else if (arg == "--episodes")
+            options.episode_count = static_cast<unsigned int>(std::stoul(value));
+        else if (arg == "--period-ms")
+            options.period_ms = std::stof(value);
+        else if (arg == "--velocity")
+            options.velocity = std::stof(value);
+        else if (arg == "--timeout")
+            options.timeout_sec = std::stof(value);
+        else if (arg == "--tolerance")
+            options.tolerance = std::stof(value);
+        else if (arg == "--target") {
+            std::vector<std::string> parts = Utils::split(value, ",", 1);
+            if (parts.size() != 3)
+                return false;
+            options.target = Vector3r(std::stof(parts[0]), std::stof(parts[1]), std::stof(parts[2]));
+        }
+        else
+            return false;
+    }
+
+    return options.vehicle_count > 0 && options.period_ms > 0;
+}
+
+static const AirSimSettings::VehicleSetting* findVehicleSetting(const std::string& vehicle_name)
+{
+    const AirSimSettings& settings = AirSimSettings::singleton();
+    if (vehicle_name != "")
+        return settings.getVehicleSetting(vehicle_name);
+
+    for (const auto& vehicle : settings.vehicles) {
+        if (vehicle.second->vehicle_type == AirSimSettings::kVehicleTypeSimpleFlight)
+            return vehicle.second.get();
+    }
+    throw std::invalid_argument("No SimpleFlight vehicle found in settings");
+}
+
+static std::unique_ptr<PhysicsEngineBase> createPhysicsEngine()
+{
+    Settings fast_phys_settings;
+    if (Settings::singleton().getChild("FastPhysicsEngine", fast_phys_settings)) {
+        return std::unique_ptr<PhysicsEngineBase>(new FastPhysicsEngine(fast_phys_settings.getBool("EnableGroundLock", true),
+            fast_phys_settings.getBool("EnableBatchIntegration", false)));
+    }
+    else
+        return std::unique_ptr<PhysicsEngineBase>(new FastPhysicsEngine());
+}
+
+static std::shared_ptr<LockstepClock> createEpisodeClock(const RunnerOptions& options)
+{
+    auto clock = std::make_shared<LockstepClock>(options.period_ms * 1E-3f, static_cast<TTimePoint>(1E9));
+    ClockFactory::get(clock);
+    return clock;
+}
+
+static EpisodeResult runEpisode(LockstepClock* clock, HeadlessMultirotor* vehicle, const RunnerOptions& options)
+{
+    clock->joinThread();
+    struct LeaveOnExit {
+        LockstepClock* clock;
+        ~LeaveOnExit() { clock->leaveThread(); }
+    } leave_on_exit { clock };
+
+    EpisodeResult result;
+    TTimePoint start_time = clock->nowNanos();
+
+    MultirotorApiBase* api = vehicle->getApi();
+    api->enableApiControl(true);
+    api->armDisarm(true);
+
+    Vector3r target = vehicle->getStartPosition() + options.target;
+    //return values of these APIs only tell if path was completed exactly so we judge success by final error instead
+    api->takeoff(options.timeout_sec);
+    api->moveToPosition(target.x(), target.y(), target.z(), options.velocity, options.timeout_sec,
+        DrivetrainType::MaxDegreeOfFreedom, YawMode(), -1, 1);
+
+    api->armDisarm(false);
+    api->enableApiControl(false);
+
+    result.position_error = (vehicle->getKinematics().pose.position - target).norm();
+    result.success = result.position_error <= options.tolerance;
+    result.sim_seconds = clock->elapsedSince(start_time);
+    return result;
+}
+
+int main(int argc, const char* argv[])
+{
+    RunnerOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    //keep output parsable for batch jobs
+    if (!options.verbose)
+        Utils::getSetMinLogLevel(true, Utils::kLogLevelInfo + 1);
+
+    try {
+        if (options.settings_filepath != "") {
+            Settings& settings = Settings::loadJSonFile(options.settings_filepath);
+            if (!settings.isLoadSuccess()) {
+                cout << "Could not load settings from " << options.settings_filepath << endl;
+                return 3;
+            }
+        }
+        else
+            AirSimSettings::initializeSettings(R"({ "SettingsVersion": 1.2, "SimMode": "Multirotor" })");
+        AirSimSettings::singleton().load([]() { return std::string("Multirotor"); });
+        for (const auto& message : AirSimSettings::singleton().warning_messages)
+            cout << "Settings warning: " << message << endl;
+
+        //clock advances by exactly one physics period on every world update, a fresh one with the same start
+        //time for every episode so results depend neither on wall clock nor on earlier episodes
+        std::shared_ptr<LockstepClock> clock = createEpisodeClock(options);
+
+        const AirSimSettings::VehicleSetting* vehicle_setting = findVehicleSetting(options.vehicle_name);
+
+        std::vector<std::unique_ptr<HeadlessMultirotor>> vehicles;
+        std::vector<UpdatableObject*> members;
+        for (unsigned int i = 0; i < options.vehicle_count; ++i) {
+            vehicles.emplace_back(new HeadlessMultirotor(vehicle_setting->vehicle_name + "_" + std::to_string(i), vehicle_setting,
+                Vector3r(0, i * options.vehicle_spacing, 0)));
+            members.push_back(vehicles.back().get());
+        }
+
+        //zero period means executor runs updates back to back without sleeping
+        std::unique_ptr<PhysicsWorld> physics_world(new PhysicsWorld(createPhysicsEngine(), members, 0, false, false));
+        const auto& parallel_update_setting = AirSimSettings::singleton().parallel_update_setting;
+        if (parallel_update_setting.enabled)
+            physics_world->enableParallelUpdate(parallel_update_setting.thread_count, parallel_update_setting.deterministic);
+
+        cout << "episode,vehicle,success,position_error,sim_seconds" << endl;
+
+        TTimePoint wall_start = Utils::getTimeSinceEpochNanos();
+        double sim_seconds = 0;
+        unsigned int success_count = 0;
+
+        for (unsigned int episode = 0; episode < options.episode_count; ++episode) {
+            //world is already reset when it's created. Physics keeps stepping on its own from when the last
+            //episode thread left the clock until the updator is stopped, so state and time of those steps are
+            //thrown away
+            if (episode > 0) {
+                clock = createEpisodeClock(options);
+                physics_world->reset();
+            }
+
+            //physics doesn't step until all episode threads are waiting on the clock
+            clock->expectThreads(options.vehicle_count);
+            physics_world->startAsyncUpdator();
+
+            std::vector<std::future<EpisodeResult>> results;
+            for (auto& vehicle : vehicles)
+                results.push_back(std::async(std::launch::async, runEpisode, clock.get(), vehicle.get(), std::cref(options)));
+
+            double episode_seconds = 0;
+            for (unsigned int i = 0; i < results.size(); ++i) {
+                EpisodeResult result = results[i].get();
+                if (result.success)
+                    ++success_count;
+                episode_seconds = std::max(episode_seconds, result.sim_seconds);
+                cout << episode << "," << vehicles[i]->getName() << "," << result.success << ","
+                    << result.position_error << "," << result.sim_seconds << endl;
+            }
+
+            physics_world->stopAsyncUpdator();
+            sim_seconds += episode_seconds;
+        }
+
+        double wall_seconds = ClockBase::elapsedBetween(Utils::getTimeSinceEpochNanos(), wall_start);
+        unsigned int total_episodes = options.episode_count * options.vehicle_count;
+
+        cout << endl;
+        cout << "Episodes: " << total_episodes << " (" << success_count << " succeeded)" << endl;
+        cout << "Wall seconds: " << wall_seconds << ", sim seconds: " << sim_seconds << endl;
+        cout << "Sim seconds per wall second: " << sim_seconds / wall_seconds << endl;
+        cout << "Episodes per hour: " << total_episodes * 3600.0 / wall_seconds << endl;
+    }
+    catch (const std::exception& ex) {
+        cout << "Error: " << ex.what() << endl;
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,604 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+// Runs SGMStereo over stereo pairs collected by DataCollectorSGM and reports time spent in each stage.
+//
+// usage: sgmbenchmark <dataset dir> [options]
+//   -n <pairs>       process at most this many pairs
+//   -r <runs>        timed runs per pair after one warm up run (default 3)
+//   -m <disparity>   min disparity (default from SGMOptions)
+//   -d <disparity>   max disparity (default from SGMOptions)
+//   -p <directions>  4, 8 or 16 aggregation directions
+//   -w <size>        NCC matching window size, odd from 3 to 11 (default from SGMOptions)
+//   -s               aggregate on one thread
+//   -l               low memory mode, single pass with row buffers
+//   -y <levels>      coarse to fine with this many half resolution levels, 0 to 3
+//   -b <disparities> disparities searched per pixel below the coarsest level (default from SGMOptions)
+//   -t               temporal prior: timed runs get the disparities of the run before as prior, as for a
+//                    static camera (with -y)
+//   -k <kernels>     force kernel implementation, e.g. scalar, sse2, avx2, avx512, neon
+//
+// Pairs are read from files_list.txt in the dataset dir (left, right, depth_gt, disparity_gt, ... per line),
+// or left/%06d and right/%06d numbered from 1 if there is no list. Images can be PNG or PFM. If ground truth
+// disparity is listed it is used to report accuracy.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+
+#ifdef SGM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "sgmstereo.h"
+#include "SGMOptions.h"
+
+struct GrayImage
+{
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> pixels;
+};
+
+struct FloatImage
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<float> pixels;
+};
+
+struct StereoPair
+{
+	std::string left;
+	std::string right;
+	std::string disparityGt;
+};
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& data)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file)
+		return false;
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+static bool fileExists(const std::string& path)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	return file.good();
+}
+
+static bool endsWith(const std::string& s, const char* suffix)
+{
+	size_t n = strlen(suffix);
+	return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static uint32_t readBigEndian32(const unsigned char* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+// zlib stream to raw bytes, without zlib only uncompressed deflate blocks as written by svpng are supported
+static bool inflateZlib(const std::vector<unsigned char>& in, std::vector<unsigned char>& out, std::string& error)
+{
+#ifdef SGM_HAVE_ZLIB
+	uLongf size = (uLongf)out.size();
+	if (uncompress(out.data(), &size, in.data(), (uLong)in.size()) != Z_OK || size != out.size())
+	{
+		error = "corrupt image data";
+		return false;
+	}
+	return true;
+#else
+	size_t pos = 2, written = 0;
+	bool last = false;
+	while (!last)
+	{
+		if (pos + 5 > in.size())
+		{
+			error = "truncated image data";
+			return false;
+		}
+		last = (in[pos] & 1) != 0;
+		if (((in[pos] >> 1) & 3) != 0)
+		{
+			error = "compressed PNG needs zlib, rebuild with zlib or use PFM";
+			return false;
+		}
+		size_t len = in[pos + 1] | (in[pos + 2] << 8);
+		pos += 5;
+		if (pos + len > in.size() || written + len > out.size())
+		{
+			error = "corrupt image data";
+			return false;
+		}
+		memcpy(&out[written], &in[pos], len);
+		pos += len;
+		written += len;
+	}
+	if (written != out.size())
+	{
+		error = "truncated image data";
+		return false;
+	}
+	return true;
+#endif
+}
+
+static int paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return a;
+	return pb <= pc ? b : c;
+}
+
+// 8 bit gray, gray+alpha, RGB or RGBA PNG converted to gray the same way as CStateStereo does
+static bool readPng(const std::vector<unsigned char>& data, GrayImage& image, std::string& error)
+{
+	static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	if (data.size() < 8 || memcmp(data.data(), signature, 8) != 0)
+	{
+		error = "not a PNG file";
+		return false;
+	}
+
+	int width = 0, height = 0, channels = 0;
+	std::vector<unsigned char> compressed;
+	for (size_t pos = 8; pos + 12 <= data.size();)
+	{
+		uint32_t len = readBigEndian32(&data[pos]);
+		const unsigned char* type = &data[pos + 4];
+		const unsigned char* chunk = &data[pos + 8];
+		if (pos + 12 + len > data.size())
+			break;
+
+		if (memcmp(type, "IHDR", 4) == 0)
+		{
+			width = (int)readBigEndian32(chunk);
+			height = (int)readBigEndian32(chunk + 4);
+			int depth = chunk[8], color = chunk[9], interlace = chunk[12];
+			channels = color == 0 ? 1 : color == 2 ? 3 : color == 4 ? 2 : color == 6 ? 4 : 0;
+			if (depth != 8 || channels == 0 || interlace != 0)
+			{
+				error = "only 8 bit non-interlaced gray or RGB PNG is supported";
+				return false;
+			}
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+			compressed.insert(compressed.end(), chunk, chunk + len);
+		else if (memcmp(type, "IEND", 4) == 0)
+			break;
+
+		pos += 12 + len;
+	}
+	if (width <= 0 || height <= 0 || compressed.empty())
+	{
+		error = "missing PNG header or data";
+		return false;
+	}
+
+	size_t stride = (size_t)width * channels;
+	std::vector<unsigned char> raw((stride + 1) * height);
+	if (!inflateZlib(compressed, raw, error))
+		return false;
+
+	// undo per row filters in place, bytes of previous pixel are channels apart
+	for (int y = 0; y < height; y++)
+	{
+		unsigned char filter = raw[y * (stride + 1)];
+		unsigned char* row = &raw[y * (stride + 1) + 1];
+		const unsigned char* prev = y > 0 ? &raw[(y - 1) * (stride + 1) + 1] : NULL;
+		for (size_t i = 0; i < stride; i++)
+		{
+			int a = i >= (size_t)channels ? row[i - channels] : 0;
+			int b = prev ? prev[i] : 0;
+			int c = prev && i >= (size_t)channels ? prev[i - channels] : 0;
+			int predictor = 0;
+			switch (filter)
+			{
+			case 0: predictor = 0; break;
+			case 1: predictor = a; break;
+			case 2: predictor = b; break;
+			case 3: predictor = (a + b) / 2; break;
+			case 4: predictor = paeth(a, b, c); break;
+			default:
+				error = "unknown PNG filter";
+				return false;
+			}
+			row[i] = (unsigned char)(row[i] + predictor);
+		}
+	}
+
+	image.width = width;
+	image.height = height;
+	image.pixels.resize((size_t)width * height);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* row = &raw[y * (stride + 1) + 1];
+		for (int x = 0; x < width; x++)
+		{
+			const unsigned char* p = row + x * channels;
+			image.pixels[y * width + x] = channels >= 3 ? (unsigned char)((p[0] + p[1] + p[2]) / 3) : p[0];
+		}
+	}
+	return true;
+}
+
+// PFM as written by Utils::writePfmFile, which stores the top row first
+static bool readPfm(const std::vector<unsigned char>& data, FloatImage& image, std::string& error)
+{
+	std::string header(data.begin(), data.begin() + std::min<size_t>(data.size(), 256));
+	std::istringstream ss(header);
+	std::string bands;
+	float scale = 0;
+	ss >> bands >> image.width >> image.height >> scale;
+	if (!ss || (bands != "Pf" && bands != "PF") || image.width <= 0 || image.height <= 0)
+	{
+		error = "not a PFM file";
+		return false;
+	}
+	image.channels = bands == "PF" ? 3 : 1;
+
+	// single whitespace separates header from data
+	size_t offset = (size_t)ss.tellg() + 1;
+	size_t count = (size_t)image.width * image.height * image.channels;
+	if (offset + count * sizeof(float) > data.size())
+	{
+		error = "truncated PFM file";
+		return false;
+	}
+	image.pixels.resize(count);
+	memcpy(image.pixels.data(), &data[offset], count * sizeof(float));
+
+	uint16_t one = 1;
+	bool littleEndian = *(unsigned char*)&one == 1;
+	if ((scale < 0) != littleEndian)
+	{
+		for (float& value : image.pixels)
+		{
+			unsigned char* b = (unsigned char*)&value;
+			std::swap(b[0], b[3]);
+			std::swap(b[1], b[2]);
+		}
+	}
+	return true;
+}
+
+static bool readGrayImage(const std::string& path, GrayImage& image, std::string& error)
+{
+	std::vector<unsigned char> data;
+	if (!readFile(path, data))
+	{
+		error = "cannot read file";
+		return false;
+	}
+	if (!endsWith(path, ".pfm"))
+		return readPng(data, image, error);
+
+	// intensities in [0, 1] or [0, 255]
+	FloatImage pfm;
+	if (!readPfm(data, pfm, error))
+		return false;
+	float maxValue = 0;
+	for (float value : pfm.pixels)
+		maxValue = std::max(maxValue, value);
+	float scale = maxValue <= 1.0f ? 255.0f : 1.0f;
+
+	image.width = pfm.width;
+	image.height = pfm.height;
+	image.pixels.resize((size_t)pfm.width * pfm.height);
+	for (size_t i = 0; i < image.pixels.size(); i++)
+	{
+		float sum = 0;
+		for (int c = 0; c < pfm.channels; c++)
+			sum += pfm.pixels[i * pfm.channels + c];
+		float value = sum / pfm.channels * scale;
+		image.pixels[i] = (unsigned char)std::min(std::max(value + 0.5f, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+static std::string combine(const std::string& dir, const std::string& file)
+{
+	if (dir.empty() || dir.back() == '/' || dir.back() == '\\')
+		return dir + file;
+	return dir + "/" + file;
+}
+
+static std::vector<StereoPair> findPairs(const std::string& dir)
+{
+	std::vector<StereoPair> pairs;
+
+	std::ifstream list(combine(dir, "files_list.txt").c_str());
+	std::string line;
+	while (std::getline(list, line))
+	{
+		std::vector<std::string> fields;
+		std::istringstream ss(line);
+		std::string field;
+		while (std::getline(ss, field, ','))
+			fields.push_back(field);
+		if (fields.size() < 2)
+			continue;
+
+		StereoPair pair;
+		pair.left = combine(dir, fields[0]);
+		pair.right = combine(dir, fields[1]);
+		if (fields.size() >= 4)
+			pair.disparityGt = combine(dir, fields[3]);
+		pairs.push_back(pair);
+	}
+	if (!pairs.empty())
+		return pairs;
+
+	for (int i = 1;; i++)
+	{
+		char name[32];
+		StereoPair pair;
+		for (const char* ext : { "png", "pfm" })
+		{
+			snprintf(name, sizeof(name), "%06d.%s", i, ext);
+			if (fileExists(combine(combine(dir, "left"), name)))
+			{
+				pair.left = combine(combine(dir, "left"), name);
+				pair.right = combine(combine(dir, "right"), name);
+				break;
+			}
+		}
+		if (pair.left.empty())
+			break;
+		snprintf(name, sizeof(name), "%06d.pfm", i);
+		if (fileExists(combine(combine(dir, "disparity_gt"), name)))
+			pair.disparityGt = combine(combine(dir, "disparity_gt"), name);
+		pairs.push_back(pair);
+	}
+	return pairs;
+}
+
+static void setKernels(const char* name)
+{
+#ifdef _WIN32
+	_putenv_s("SGM_KERNELS", name);
+#else
+	setenv("SGM_KERNELS", name, 1);
+#endif
+}
+
+struct Accuracy
+{
+	long long valid = 0;
+	long long total = 0;
+	long long bad = 0;
+	double absError = 0;
+};
+
+// disparity map of SGMStereo is minDisparity - disparity like in StateStereo, ground truth from DataCollectorSGM
+// is the disparity itself
+static void addAccuracy(const float* dispMap, int minDisparity, const FloatImage& gt, Accuracy& accuracy)
+{
+	for (size_t i = 0; i < (size_t)gt.width * gt.height; i++)
+	{
+		float expected = gt.pixels[i];
+		if (!(expected > 0) || expected == FLT_MAX)
+			continue;
+		accuracy.total++;
+		if (dispMap[i] == FLT_MAX)
+			continue;
+
+		float error = fabs(minDisparity - dispMap[i] - expected);
+		accuracy.valid++;
+		accuracy.absError += error;
+		if (error > 1.0f)
+			accuracy.bad++;
+	}
+}
+
+static void usage()
+{
+	printf("usage: sgmbenchmark <dataset dir> [-n pairs] [-r runs] [-m min disparity] [-d max disparity] [-p 4|8|16] [-w window] [-s] [-l] [-y levels] [-b band] [-t] [-k kernels]\n");
+}
+
+int main(int argc, char** argv)
+{
+	SGMOptions params;
+	std::string dir;
+	int maxPairs = -1;
+	int runs = 3;
+	bool temporal = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "-n" && hasValue)
+			maxPairs = atoi(argv[++i]);
+		else if (arg == "-r" && hasValue)
+			runs = std::max(1, atoi(argv[++i]));
+		else if (arg == "-m" && hasValue)
+			params.minDisparity = atoi(argv[++i]);
+		else if (arg == "-d" && hasValue)
+			params.maxDisparity = atoi(argv[++i]);
+		else if (arg == "-p" && hasValue)
+			params.numDirections = atoi(argv[++i]);
+		else if (arg == "-w" && hasValue)
+			params.windowSize = atoi(argv[++i]);
+		else if (arg == "-s")
+			params.doSequential = 1;
+		else if (arg == "-l")
+			params.lowMemory = 1;
+		else if (arg == "-y" && hasValue)
+			params.pyramidLevels = atoi(argv[++i]);
+		else if (arg == "-b" && hasValue)
+			params.pyramidBand = atoi(argv[++i]);
+		else if (arg == "-t")
+			temporal = true;
+		else if (arg == "-k" && hasValue)
+			setKernels(argv[++i]);
+		else if (arg[0] != '-' && dir.empty())
+			dir = arg;
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (dir.empty())
+	{
+		usage();
+		return 1;
+	}
+	std::vector<StereoPair> pairs = findPairs(dir);
+	if (maxPairs >= 0 && (int)pairs.size() > maxPairs)
+		pairs.resize(maxPairs);
+	if (pairs.empty())
+	{
+		printf("[ERROR] no stereo pairs found in %s\n", dir.c_str());
+		return 1;
+	}
+
+	// same disparity range rounding as CStateStereo
+	int ndisps = params.maxDisparity - params.minDisparity;
+	if (ndisps <= 0)
+	{
+		printf("[ERROR] Invalid Disparity Range [%d -- %d] ...\n", params.minDisparity, params.maxDisparity);
+		return 1;
+	}
+	ndisps = (ndisps + 7) / 8 * 8;
+	int maxDisp = params.minDisparity + ndisps;
+
+	SGMStereo* sgmStereo = NULL;
+	int width = 0, height = 0;
+	std::vector<float> dispMap;
+	std::vector<unsigned char> confMap;
+	std::vector<float> priorMap;
+	int priorRuns = 0;
+
+	SGMTimings sum;
+	memset(&sum, 0, sizeof(sum));
+	double best = DBL_MAX;
+	int timedRuns = 0;
+	Accuracy accuracy;
+
+	for (size_t p = 0; p < pairs.size(); p++)
+	{
+		GrayImage left, right;
+		std::string error;
+		if (!readGrayImage(pairs[p].left, left, error) || !readGrayImage(pairs[p].right, right, error))
+		{
+			printf("[WARNING] skipping %s: %s\n", pairs[p].left.c_str(), error.c_str());
+			continue;
+		}
+		if (left.width != right.width || left.height != right.height)
+		{
+			printf("[WARNING] skipping %s: left and right sizes differ\n", pairs[p].left.c_str());
+			continue;
+		}
+
+		if (sgmStereo == NULL || left.width != width || left.height != height)
+		{
+			if (sgmStereo != NULL)
+			{
+				sgmStereo->free();
+				delete sgmStereo;
+			}
+			width = left.width;
+			height = left.height;
+			sgmStereo = new SGMStereo(width, height, -maxDisp, -params.minDisparity, params.numDirections, params.sgmConfidenceThreshold,
+				params.doSubPixRefinement, params.smoothness, params.penalty1, params.penalty2, params.alpha, params.doSequential,
+				params.windowSize, params.lowMemory, params.pyramidLevels, params.pyramidBand);
+			dispMap.resize((size_t)width * height);
+			confMap.resize((size_t)width * height);
+			printf("%d x %d, %d disparities, %dx%d window, %d directions, %s aggregation, %s kernels\n", width, height, ndisps,
+				params.windowSize, params.windowSize, params.numDirections,
+				params.lowMemory ? "low memory" : (params.doSequential ? "single threaded" : "parallel"), sgmStereo->getKernelsName());
+			if (params.pyramidLevels > 0)
+				printf("%d pyramid levels, %d disparities per pixel\n", params.pyramidLevels, params.pyramidBand);
+			printf("%.1f MB of costs, messages and buffers\n", sgmStereo->getMemorySize() / (1024.0 * 1024.0));
+		}
+
+		// warm up run is not counted
+		sgmStereo->Run(left.pixels.data(), right.pixels.data(), dispMap.data(), confMap.data());
+		double pairTotal = 0;
+		for (int r = 0; r < runs; r++)
+		{
+			if (temporal)
+				priorMap = dispMap;
+			sgmStereo->Run(left.pixels.data(), right.pixels.data(), dispMap.data(), confMap.data(), temporal ? priorMap.data() : NULL);
+			priorRuns += sgmStereo->getPriorUsed();
+			const SGMTimings& t = sgmStereo->getTimings();
+			sum.coarse += t.coarse;
+			sum.dsi += t.dsi;
+			sum.aggregationHor += t.aggregationHor;
+			sum.aggregationVert += t.aggregationVert;
+			sum.aggregationDiag += t.aggregationDiag;
+			sum.disparity += t.disparity;
+			sum.total += t.total;
+			best = std::min(best, t.total);
+			pairTotal += t.total;
+			timedRuns++;
+		}
+		printf("%s: %.1f ms\n", pairs[p].left.c_str(), pairTotal / runs * 1e3);
+
+		if (!pairs[p].disparityGt.empty())
+		{
+			std::vector<unsigned char> data;
+			FloatImage gt;
+			if (readFile(pairs[p].disparityGt, data) && readPfm(data, gt, error) && gt.width == width && gt.height == height && gt.channels == 1)
+				addAccuracy(dispMap.data(), params.minDisparity, gt, accuracy);
+		}
+	}
+
+	if (timedRuns == 0)
+	{
+		printf("[ERROR] no stereo pair could be read\n");
+		return 1;
+	}
+
+	double n = timedRuns;
+	double total = sum.total / n;
+	printf("\n%d runs\n", timedRuns);
+	if (temporal)
+		printf("  %d with prior\n", priorRuns);
+	if (params.pyramidLevels > 0)
+		printf("  %s %8.2f ms\n", temporal ? "coarse levels or prior" : "coarse levels         ", sum.coarse / n * 1e3);
+	printf("  dsi                    %8.2f ms\n", sum.dsi / n * 1e3);
+	printf("  horizontal aggregation %8.2f ms\n", sum.aggregationHor / n * 1e3);
+	printf("  vertical aggregation   %8.2f ms\n", sum.aggregationVert / n * 1e3);
+	if (params.numDirections >= 8)
+		printf("  diagonal aggregation   %8.2f ms\n", sum.aggregationDiag / n * 1e3);
+	printf("  disparity extraction   %8.2f ms\n", sum.disparity / n * 1e3);
+	printf("  total                  %8.2f ms (best %.2f ms, %.1f fps)\n", total * 1e3, best * 1e3, 1.0 / total);
+	printf("  throughput             %8.1f Mpixel-disparities/s\n", (double)width * height * ndisps / total / 1e6);
+
+	if (accuracy.total > 0)
+	{
+		printf("  density                %8.1f %%\n", 100.0 * accuracy.valid / accuracy.total);
+		if (accuracy.valid > 0)
+		{
+			printf("  bad pixels (> 1 px)    %8.1f %%\n", 100.0 * accuracy.bad / accuracy.valid);
+			printf("  mean abs error         %8.2f px\n", accuracy.absError / accuracy.valid);
+		}
+	}
+
+	if (sgmStereo != NULL)
+	{
+		sgmStereo->free();
+		delete sgmStereo;
+	}
+	return 0;
+}
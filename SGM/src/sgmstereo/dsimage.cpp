@@ -86,7 +86,7 @@ void getDispMap2(DSI &dv1, DSI &dv2, int confThreshold, float * dispMap, unsigne
 			}
 
 			float distinctiveness1 = float(minval) / float(secondminval + 1e-9f);
-			float conf = (float) __min(__max(20.0f * log(1.0f / (distinctiveness1*distinctiveness1)), 0.0f), 255.0f);
+			float conf = std::min(std::max(20.0f * (float)log(1.0f / (distinctiveness1*distinctiveness1)), 0.0f), 255.0f);
 			int Dim = (int)planes;
 			if (conf >= confThreshold)
 			{
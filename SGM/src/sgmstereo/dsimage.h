@@ -13,12 +13,17 @@
 #include <stdint.h>
 #include <string.h>
 #include <math.h>
+#include <algorithm>
 
+#include "sgmplatform.h"
 
-class DSI
+
+// disparity space image, cost of each disparity plane is innermost
+template <typename T>
+class DSImage
 {
 public:
-	DSI()
+	DSImage()
 	{
 		m_cols = 0;
 		m_rows = 0;
@@ -33,7 +38,7 @@ public:
 		m_planes = planes;
 
 		uint64_t pixelCount = m_cols * m_rows * m_planes;
-		m_data = (short*)_aligned_malloc(pixelCount * sizeof(short), 16);
+		m_data = (T*)sgmAlignedMalloc(pixelCount * sizeof(T), 16);
 		if (!m_data)
 		{
 			printf("[ERROR] not enough memory!\n");
@@ -44,137 +49,138 @@ public:
 	void setzero()
 	{
 		uint64_t pixelCount = m_cols * m_rows * m_planes;
-		memset(m_data, 0, pixelCount*sizeof(short));
+		memset(m_data, 0, pixelCount*sizeof(T));
+	}
+
+	void fill(T value)
+	{
+		uint64_t pixelCount = m_cols * m_rows * m_planes;
+		for (uint64_t i = 0; i < pixelCount; i++)
+			m_data[i] = value;
+	}
+
+	// bytes allocated
+	uint64_t size() const
+	{
+		return m_data != NULL ? m_cols * m_rows * m_planes * sizeof(T) : 0;
 	}
 
-	short operator()(uint64_t x, uint64_t y, uint64_t z) const
+	T operator()(uint64_t x, uint64_t y, uint64_t z) const
 	{
 		return m_data[(x + y * m_cols)*m_planes + z];
 	}
 
-	short& operator()(uint64_t x, uint64_t y, uint64_t z)
+	T& operator()(uint64_t x, uint64_t y, uint64_t z)
 	{
 		return m_data[(x + y * m_cols)*m_planes + z];
 	}
 
-	short* operator()(uint64_t x, uint64_t y) const
+	T* operator()(uint64_t x, uint64_t y) const
 	{
 		return &(m_data[(x + y * m_cols)*m_planes]);
 	}
 
 	void getDispMap(int confThreshold, int doSubPixRefinement, float * dispMap, unsigned char * confMap)
 	{
-		// first row
+		for (int y = 0; y < m_rows; y++)
 		{
-			uint64_t offset = 0;
+			uint64_t offset = y * m_cols;
 			float *pDisp = &(dispMap[offset]);
 			unsigned char *pConf = &(confMap[offset]);
-			for (int x = 0; x < m_cols; x++)
-			{
-				pDisp[x] = FLT_MAX;
-				pConf[x] = 0;
-			}
-		}
 
-		// last row
-		{
-			uint64_t offset = (m_rows-1) * m_cols;
-			float *pDisp = &(dispMap[offset]);
-			unsigned char *pConf = &(confMap[offset]);
-			for (int x = 0; x < m_cols; x++)
-			{
-				pDisp[x] = FLT_MAX;
-				pConf[x] = 0;
-			}
+			// first and last row have no disparity
+			if (y == 0 || y == m_rows - 1)
+				clearDispRow((int)m_cols, pDisp, pConf);
+			else
+				getDispRow((*this)(0, y), (int)m_cols, (int)m_planes, confThreshold, doSubPixRefinement, true, pDisp, pConf);
 		}
+	}
 
-		for (int y = 0; y < m_rows; y++)
+	static void clearDispRow(int cols, float * pDisp, unsigned char * pConf)
+	{
+		for (int x = 0; x < cols; x++)
 		{
-			uint64_t offset = y * m_cols;
-			float *pDisp = &(dispMap[offset]);
-			unsigned char *pConf = &(confMap[offset]);
-			{
-				pDisp[0] = FLT_MAX;
-				pConf[0] = 0;
-				pDisp[m_cols - 1] = FLT_MAX;
-				pConf[m_cols - 1] = 0;
-			}
+			pDisp[x] = FLT_MAX;
+			pConf[x] = 0;
 		}
-		
-		for (int y = 1; y < m_rows-1; y++)
-		{
-			uint64_t offset = y * m_cols;
-			float *pDisp = &(dispMap[offset]);
-			unsigned char *pConf = &(confMap[offset]);
+	}
 
-#pragma omp parallel for schedule(dynamic,1)
+	// disparity and confidence of one row from its aggregated costs, first and last pixel have none
+	static void getDispRow(const short * pRow, int cols, int planes, int confThreshold, int doSubPixRefinement, bool parallel,
+		float * pDisp, unsigned char * pConf)
+	{
+		pDisp[0] = FLT_MAX;
+		pConf[0] = 0;
+		pDisp[cols - 1] = FLT_MAX;
+		pConf[cols - 1] = 0;
+
+#pragma omp parallel for schedule(dynamic,1) if(parallel)
 
-			for (int x = 1; x < m_cols-1; x++)
+		for (int x = 1; x < cols-1; x++)
+		{
+			int bestplane = planes - 1;
+			short minval = SHRT_MAX;
+			short secondminval = SHRT_MAX;
+			const short * pV = pRow + (uint64_t)x * planes;
+			for (int d = 0; d < planes; d++)
 			{
-				int bestplane = (int)m_planes - 1;
-				short minval = SHRT_MAX;
-				short secondminval = SHRT_MAX;
-				short * pV = (*this)(x, y);
-				for (int d = 0; d < m_planes; d++)
+				short val = pV[d];
+				if (val < minval)
 				{
-					short val = pV[d];
-					if (val < minval)
-					{
-						minval = val;
-						bestplane = d;
-					}
+					minval = val;
+					bestplane = d;
 				}
+			}
 
-				for (int d = 0; d < m_planes; d++)
+			for (int d = 0; d < planes; d++)
+			{
+				if (abs(d - bestplane) > 2)
 				{
-					if (abs(d - bestplane) > 2)
+					short val = pV[d];
+					if (val < secondminval)
 					{
-						short val = pV[d];
-						if (val < secondminval)
-						{
-							secondminval = val;
-						}
+						secondminval = val;
 					}
 				}
+			}
 
-				float distinctiveness1 = float(minval) / float(secondminval + 1e-9f);
-				float conf = (float) __min(__max(20.0f * log(1.0f / (distinctiveness1*distinctiveness1)), 0.0f), 255.0f);
-				int Dim = (int)m_planes;
-				if (conf >= confThreshold)
+			float distinctiveness1 = float(minval) / float(secondminval + 1e-9f);
+			float conf = std::min(std::max(20.0f * (float)log(1.0f / (distinctiveness1*distinctiveness1)), 0.0f), 255.0f);
+			int Dim = planes;
+			if (conf >= confThreshold)
+			{
+				// Local quadratic fit of cost and subpixel refinement.
+				double rDisp = bestplane;
+				double rCost = minval;
+				if (doSubPixRefinement)
 				{
-					// Local quadratic fit of cost and subpixel refinement.
-					double rDisp = bestplane;
-					double rCost = minval;
-					if (doSubPixRefinement)
+					if (bestplane >= 1 && bestplane < planes - 1)
 					{
-						if (bestplane >= 1 && bestplane < m_planes - 1)
+						double yl = pV[bestplane - 1];
+						double xc = bestplane;
+						double yc = minval;
+						double yu = pV[bestplane + 1];
+						double d2 = yu - yc + yl - yc;
+						double d1 = 0.5 * (yu - yl);
+						if (fabs(d2) > fabs(d1))
 						{
-							double yl = pV[bestplane - 1];
-							double xc = bestplane;
-							double yc = minval;
-							double yu = pV[bestplane + 1];
-							double d2 = yu - yc + yl - yc;
-							double d1 = 0.5 * (yu - yl);
-							if (fabs(d2) > fabs(d1))
-							{
-								rDisp = xc - d1 / d2;
-								rCost = yc + 0.5 * d1 * (rDisp - xc);
-							}
+							rDisp = xc - d1 / d2;
+							rCost = yc + 0.5 * d1 * (rDisp - xc);
 						}
 					}
-					pDisp[x] = (float)(rDisp - Dim);
-					pConf[x] = (unsigned char)conf;
-				}
-				else
-				{
-					pDisp[x] = FLT_MAX;
-					pConf[x] = 0;
 				}
+				pDisp[x] = (float)(rDisp - Dim);
+				pConf[x] = (unsigned char)conf;
+			}
+			else
+			{
+				pDisp[x] = FLT_MAX;
+				pConf[x] = 0;
 			}
 		}
 	}
 
-	~DSI()
+	~DSImage()
 	{
 		free();
 	}
@@ -182,16 +188,21 @@ public:
 	void free()
 	{
 		if (m_data != NULL)
-			_aligned_free(m_data);
+			sgmAlignedFree(m_data);
 		m_data = NULL;
 	}
 
 	uint64_t m_cols;
 	uint64_t m_rows;
 	uint64_t m_planes;
-	short *m_data;
+	T *m_data;
 };
 
+// aggregated costs
+typedef DSImage<short> DSI;
+// matching costs, NCC costs are in [0, 255]
+typedef DSImage<unsigned char> DSI8;
+
 void getDispMap2(DSI &dv1, DSI &dv2, int confThreshold, float * dispMap, unsigned char * confMap);
 
 #endif
@@ -0,0 +1,169 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "sgmkernels_common.h"
+
+#if defined(SGM_KERNELS_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static void accumulateProductsScalar(const unsigned char* L, const unsigned char* R, int cols, int minDisparity,
+	int planes, int weight, int* pColumns)
+{
+	for (int x = 0; x < cols; x++)
+	{
+		int begin, end;
+		sgmProductRange(x, cols, minDisparity, planes, begin, end);
+		sgmAccumulateProductsTail(L, R, x, minDisparity, planes, weight, begin, end, pColumns);
+	}
+}
+
+static void nccCostScalar(const int* pSumLR, int sumL, int sumLL, const int* pSumR, const int* pSumRR,
+	int count, int n, unsigned char* pDSI)
+{
+	sgmNccCostTail(pSumLR, sumL, sumLL, pSumR, pSumRR, 0, count, n, pDSI);
+}
+
+static void toGrayScalar(const unsigned char* pSrc, int channels, int count, unsigned char* pDst)
+{
+	sgmToGrayTail(pSrc, channels, 0, count, pDst);
+}
+
+static void messagePassingScalar(const unsigned char* pData, short* pBuffer, short* pScratch, short* pDMessage,
+	int size, short pen1, short pen2)
+{
+	short minval = pBuffer[0];
+	for (int i = 1; i < size; i++)
+		minval = pBuffer[i] < minval ? pBuffer[i] : minval;
+
+	pScratch[0] = SGM_BORDER_COST;
+	pScratch[size + 1] = SGM_BORDER_COST;
+	for (int i = 0; i < size; i++)
+		pScratch[i + 1] = (short)(pBuffer[i] - minval);
+
+	sgmMessagePassingTail(pData, pBuffer, pScratch, pDMessage, 0, size, pen1, pen2);
+}
+
+const SGMKernels sgmKernelsScalar = { "scalar", accumulateProductsScalar, nccCostScalar, toGrayScalar, messagePassingScalar };
+
+#ifdef SGM_KERNELS_X86
+enum CpuLevel { kCpuSSE2, kCpuAVX2, kCpuAVX512 };
+
+static CpuLevel getCpuLevel()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	if (maxLeaf < 7)
+		return kCpuSSE2;
+
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx)
+		return kCpuSSE2;
+
+	// OS must save upper halves of the registers on context switch
+	unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+	bool avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+	bool avx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0 && (info[1] & (1 << 31)) != 0
+		&& (xcr0 & 0xe6) == 0xe6;
+
+	return avx2 && avx512 ? kCpuAVX512 : (avx2 ? kCpuAVX2 : kCpuSSE2);
+#else
+	__builtin_cpu_init();
+	bool avx2 = __builtin_cpu_supports("avx2") != 0;
+	bool avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl");
+
+	return avx2 && avx512 ? kCpuAVX512 : (avx2 ? kCpuAVX2 : kCpuSSE2);
+#endif
+}
+#endif
+
+const SGMKernels* const* getSupportedSGMKernels()
+{
+	// best first
+	static const SGMKernels* const* supported = []() {
+		static const SGMKernels* list[8];
+		int count = 0;
+#ifdef SGM_KERNELS_X86
+		CpuLevel level = getCpuLevel();
+		if (level >= kCpuAVX512)
+			list[count++] = &sgmKernelsAVX512;
+		if (level >= kCpuAVX2)
+			list[count++] = &sgmKernelsAVX2;
+		list[count++] = &sgmKernelsSSE2;
+#endif
+#ifdef SGM_KERNELS_AARCH64
+		list[count++] = &sgmKernelsNEON;
+#endif
+		list[count++] = &sgmKernelsScalar;
+		list[count] = NULL;
+		return list;
+	}();
+
+	return supported;
+}
+
+const SGMKernels* findSGMKernels(const char* name)
+{
+	for (const SGMKernels* const* kernels = getSupportedSGMKernels(); *kernels != NULL; kernels++)
+	{
+		if (strcmp((*kernels)->name, name) == 0)
+			return *kernels;
+	}
+	return NULL;
+}
+
+static std::string getKernelsOverride()
+{
+	std::string name;
+#ifdef _MSC_VER
+	char* value = NULL;
+	size_t len = 0;
+	if (_dupenv_s(&value, &len, "SGM_KERNELS") == 0 && value != NULL)
+	{
+		name = value;
+		free(value);
+	}
+#else
+	const char* value = getenv("SGM_KERNELS");
+	if (value != NULL)
+		name = value;
+#endif
+	return name;
+}
+
+const SGMKernels& getSGMKernels()
+{
+	static const SGMKernels* selected = []() {
+		const SGMKernels* kernels = getSupportedSGMKernels()[0];
+
+		std::string name = getKernelsOverride();
+		if (!name.empty())
+		{
+			const SGMKernels* requested = findSGMKernels(name.c_str());
+			if (requested != NULL)
+				kernels = requested;
+			else
+				printf("[WARNING] SGM_KERNELS=%s is not supported, using %s\n", name.c_str(), kernels->name);
+		}
+		return kernels;
+	}();
+
+	return *selected;
+}
+
+int getSGMScratchSize(int planes)
+{
+	// one sentinel on each side
+	return planes + 2;
+}
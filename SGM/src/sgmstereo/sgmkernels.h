@@ -0,0 +1,49 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef sgm_kernels_h
+#define sgm_kernels_h
+
+// Inner loops of SGMStereo implemented for several instruction sets. Implementation for the
+// current CPU is picked at run time. All implementations give bit-identical results, the scalar
+// one is the reference used to check the others.
+struct SGMKernels
+{
+	const char* name;
+
+	// Adds (weight 1) or subtracts (weight -1) L[x] * R[x + minDisparity + k] to pColumns[x * planes + k]
+	// for all pixels x of one image row and disparities k in [0, planes) where x + minDisparity + k is
+	// inside the row.
+	void (*accumulateProducts)(const unsigned char* L, const unsigned char* R, int cols, int minDisparity,
+		int planes, int weight, int* pColumns);
+
+	// NCC matching cost of count consecutive disparities of one pixel from sums over its window of
+	// n pixels: sumL and sumLL of left pixels and their squares, pSumR[i] and pSumRR[i] of right
+	// pixels and their squares and pSumLR[i] of their products with the left pixels. Costs are
+	// in [0, 255] so they are stored in 8 bits without loss.
+	void (*nccCost)(const int* pSumLR, int sumL, int sumLL, const int* pSumR, const int* pSumRR,
+		int count, int n, unsigned char* pDSI);
+
+	// Gray value (r + g + b) / 3 of count pixels with channels bytes each, channels >= 3.
+	void (*toGray)(const unsigned char* pSrc, int channels, int count, unsigned char* pDst);
+
+	// One step of path aggregation: pBuffer holds path cost of previous pixel on the path and is
+	// replaced by the cost of current pixel which is also added to pDMessage, saturating so that
+	// many paths can add up in 16 bits. pScratch must have room for getSGMScratchSize(size) shorts.
+	void (*messagePassing)(const unsigned char* pData, short* pBuffer, short* pScratch, short* pDMessage,
+		int size, short pen1, short pen2);
+};
+
+// best implementation for this CPU, can be overridden with SGM_KERNELS environment variable
+const SGMKernels& getSGMKernels();
+
+// implementation with given name ("scalar", "sse2", "avx2", "avx512", "neon") or NULL if it
+// is not supported by this build or CPU
+const SGMKernels* findSGMKernels(const char* name);
+
+// all implementations supported by this build and CPU, terminated by NULL
+const SGMKernels* const* getSupportedSGMKernels();
+
+int getSGMScratchSize(int planes);
+
+#endif
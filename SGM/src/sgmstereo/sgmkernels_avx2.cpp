@@ -0,0 +1,167 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "sgmkernels_common.h"
+
+#ifdef SGM_KERNELS_X86
+
+#include <immintrin.h>
+
+// only called after checking the CPU, so AVX2 is enabled for this file alone (FMA is left out on purpose,
+// fused multiply-add would round differently from the other implementations)
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+static void accumulateProductsAVX2(const unsigned char* L, const unsigned char* R, int cols, int minDisparity,
+	int planes, int weight, int* pColumns)
+{
+	int vsize = planes / 8 * 8;
+
+	for (int x = 0; x < cols; x++)
+	{
+		int begin, end;
+		sgmProductRange(x, cols, minDisparity, planes, begin, end);
+		if (begin > 0 || end < planes)
+		{
+			// near the borders
+			sgmAccumulateProductsTail(L, R, x, minDisparity, planes, weight, begin, end, pColumns);
+			continue;
+		}
+
+		__m256i l = _mm256_set1_epi32(weight * L[x]);
+		const unsigned char* pR = R + x + minDisparity;
+		int* pCol = pColumns + (size_t)x * planes;
+		for (int k = 0; k < vsize; k += 8)
+		{
+			__m256i r = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(pR + k)));
+			__m256i c = _mm256_loadu_si256((const __m256i*)(pCol + k));
+			_mm256_storeu_si256((__m256i*)(pCol + k), _mm256_add_epi32(c, _mm256_mullo_epi32(l, r)));
+		}
+		sgmAccumulateProductsTail(L, R, x, minDisparity, planes, weight, vsize, planes, pColumns);
+	}
+}
+
+static void nccCostAVX2(const int* pSumLR, int sumL, int sumLL, const int* pSumR, const int* pSumRR,
+	int count, int n, unsigned char* pDSI)
+{
+	int vsize = count / 8 * 8;
+
+	__m256i vn = _mm256_set1_epi32(n);
+	__m256i vsumL = _mm256_set1_epi32(sumL);
+	__m256 varL = _mm256_set1_ps((float)(n * sumLL - sumL * sumL));
+	__m256 eps = _mm256_set1_ps(sgmNccEps(n));
+	for (int i = 0; i < vsize; i += 8)
+	{
+		__m256i sumR = _mm256_loadu_si256((const __m256i*)(pSumR + i));
+		__m256i sumRR = _mm256_loadu_si256((const __m256i*)(pSumRR + i));
+		__m256i sumLR = _mm256_loadu_si256((const __m256i*)(pSumLR + i));
+		__m256 cov = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_mullo_epi32(vn, sumLR), _mm256_mullo_epi32(vsumL, sumR)));
+		__m256 varR = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_mullo_epi32(vn, sumRR), _mm256_mullo_epi32(sumR, sumR)));
+
+		__m256 ncc = _mm256_div_ps(cov, _mm256_sqrt_ps(_mm256_max_ps(_mm256_mul_ps(varL, varR), eps)));
+		__m256 score = _mm256_min_ps(_mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), ncc), _mm256_set1_ps(255.0f)), _mm256_set1_ps(255.0f));
+
+		__m256i cost = _mm256_cvttps_epi32(score);
+		__m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(cost), _mm256_extracti128_si256(cost, 1));
+		_mm_storel_epi64((__m128i*)(pDSI + i), _mm_packus_epi16(packed, packed));
+	}
+	sgmNccCostTail(pSumLR, sumL, sumLL, pSumR, pSumRR, vsize, count, n, pDSI);
+}
+
+static void toGrayAVX2(const unsigned char* pSrc, int channels, int count, unsigned char* pDst)
+{
+	int i = 0;
+	if (channels == 3 || channels == 4)
+	{
+		// r + g + b of each pixel from two multiply-adds with weights 1, 1, 1, 0
+		__m256i weights = _mm256_set1_epi32(0x00010101);
+		__m256i ones = _mm256_set1_epi16(1);
+		__m256i scale = _mm256_set1_epi16(SGM_GRAY_SCALE);
+		// RGB: 4 pixels of each 128 bit lane are spread to 32 bits
+		__m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+			0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		// RGB reads 4 bytes past the last pixel
+		int end = channels == 3 ? count - 2 : count;
+		for (; i + 16 <= end; i += 16)
+		{
+			__m256i sum[2];
+			for (int j = 0; j < 2; j++)
+			{
+				const unsigned char* p = pSrc + (size_t)channels * (i + 8 * j);
+				__m256i v;
+				if (channels == 4)
+				{
+					v = _mm256_loadu_si256((const __m256i*)p);
+				}
+				else
+				{
+					v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)), _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+					v = _mm256_shuffle_epi8(v, spread);
+				}
+				sum[j] = _mm256_madd_epi16(_mm256_maddubs_epi16(v, weights), ones);
+			}
+			// packing works within 128 bit lanes, permute puts the pixels back in order
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum[0], sum[1]), _MM_SHUFFLE(3, 1, 2, 0));
+			__m256i gray = _mm256_mulhi_epu16(packed, scale);
+			_mm_storeu_si128((__m128i*)(pDst + i), _mm_packus_epi16(_mm256_castsi256_si128(gray), _mm256_extracti128_si256(gray, 1)));
+		}
+	}
+	sgmToGrayTail(pSrc, channels, i, count, pDst);
+}
+
+static void messagePassingAVX2(const unsigned char* pData, short* pBuffer, short* pScratch, short* pDMessage,
+	int size, short pen1, short pen2)
+{
+	int vsize = size / 16 * 16;
+
+	short minval = pBuffer[0];
+	if (vsize > 0)
+	{
+		__m256i m = _mm256_loadu_si256((const __m256i*)pBuffer);
+		for (int i = 16; i < vsize; i += 16)
+			m = _mm256_min_epi16(m, _mm256_loadu_si256((const __m256i*)(pBuffer + i)));
+		__m128i h = _mm_min_epi16(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+		// minpos works on unsigned values, flipping the sign bit maps signed order onto it
+		__m128i sign = _mm_set1_epi16(-32768);
+		minval = (short)(_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(h, sign))) ^ 0x8000);
+	}
+	for (int i = vsize; i < size; i++)
+		minval = pBuffer[i] < minval ? pBuffer[i] : minval;
+
+	pScratch[0] = SGM_BORDER_COST;
+	pScratch[size + 1] = SGM_BORDER_COST;
+	__m256i vmin = _mm256_set1_epi16(minval);
+	for (int i = 0; i < vsize; i += 16)
+		_mm256_storeu_si256((__m256i*)(pScratch + i + 1), _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)(pBuffer + i)), vmin));
+	for (int i = vsize; i < size; i++)
+		pScratch[i + 1] = (short)(pBuffer[i] - minval);
+
+	__m256i penalty1 = _mm256_set1_epi16(pen1);
+	__m256i penalty2 = _mm256_set1_epi16(pen2);
+	for (int i = 0; i < vsize; i += 16)
+	{
+		__m256i prev = _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)(pScratch + i)), penalty1);
+		__m256i next = _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)(pScratch + i + 2)), penalty1);
+		__m256i cur = _mm256_min_epi16(_mm256_loadu_si256((const __m256i*)(pScratch + i + 1)), penalty2);
+		__m256i val = _mm256_add_epi16(_mm256_min_epi16(_mm256_min_epi16(prev, next), cur), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(pData + i))));
+
+		_mm256_storeu_si256((__m256i*)(pBuffer + i), val);
+		__m256i msg = _mm256_loadu_si256((const __m256i*)(pDMessage + i));
+		_mm256_storeu_si256((__m256i*)(pDMessage + i), _mm256_adds_epi16(msg, val));
+	}
+	sgmMessagePassingTail(pData, pBuffer, pScratch, pDMessage, vsize, size, pen1, pen2);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+const SGMKernels sgmKernelsAVX2 = { "avx2", accumulateProductsAVX2, nccCostAVX2, toGrayAVX2, messagePassingAVX2 };
+
+#endif
@@ -0,0 +1,159 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "sgmkernels_common.h"
+
+#ifdef SGM_KERNELS_X86
+
+#include <immintrin.h>
+
+// only called after checking the CPU, so AVX-512 is enabled for this file alone. It brings FMA with it,
+// contracting multiply and add would round differently from the other implementations.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,avx512f,avx512bw,avx512vl"))), apply_to = function)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,avx512f,avx512bw,avx512vl")
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// first lanes lanes of a vector of 16
+static inline __mmask16 firstLanes(int lanes)
+{
+	return lanes < 16 ? (__mmask16)((1u << lanes) - 1) : (__mmask16)0xffff;
+}
+
+static void accumulateProductsAVX512(const unsigned char* L, const unsigned char* R, int cols, int minDisparity,
+	int planes, int weight, int* pColumns)
+{
+	for (int x = 0; x < cols; x++)
+	{
+		// masked loads and stores also cover the borders
+		int begin, end;
+		sgmProductRange(x, cols, minDisparity, planes, begin, end);
+
+		__m512i l = _mm512_set1_epi32(weight * L[x]);
+		const unsigned char* pR = R + x + minDisparity;
+		int* pCol = pColumns + (size_t)x * planes;
+		for (int k = begin; k < end; k += 16)
+		{
+			__mmask16 mask = firstLanes(end - k);
+			__m512i r = _mm512_cvtepu8_epi32(_mm_maskz_loadu_epi8(mask, pR + k));
+			__m512i c = _mm512_maskz_loadu_epi32(mask, pCol + k);
+			_mm512_mask_storeu_epi32(pCol + k, mask, _mm512_add_epi32(c, _mm512_mullo_epi32(l, r)));
+		}
+	}
+}
+
+static void nccCostAVX512(const int* pSumLR, int sumL, int sumLL, const int* pSumR, const int* pSumRR,
+	int count, int n, unsigned char* pDSI)
+{
+	__m512i vn = _mm512_set1_epi32(n);
+	__m512i vsumL = _mm512_set1_epi32(sumL);
+	__m512 varL = _mm512_set1_ps((float)(n * sumLL - sumL * sumL));
+	__m512 eps = _mm512_set1_ps(sgmNccEps(n));
+	for (int i = 0; i < count; i += 16)
+	{
+		// lanes past count are zero, their cost is computed but not stored
+		__mmask16 mask = firstLanes(count - i);
+		__m512i sumR = _mm512_maskz_loadu_epi32(mask, pSumR + i);
+		__m512i sumRR = _mm512_maskz_loadu_epi32(mask, pSumRR + i);
+		__m512i sumLR = _mm512_maskz_loadu_epi32(mask, pSumLR + i);
+		__m512 cov = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_mullo_epi32(vn, sumLR), _mm512_mullo_epi32(vsumL, sumR)));
+		__m512 varR = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_mullo_epi32(vn, sumRR), _mm512_mullo_epi32(sumR, sumR)));
+
+		__m512 ncc = _mm512_div_ps(cov, _mm512_sqrt_ps(_mm512_max_ps(_mm512_mul_ps(varL, varR), eps)));
+		__m512 score = _mm512_min_ps(_mm512_mul_ps(_mm512_sub_ps(_mm512_set1_ps(1.0f), ncc), _mm512_set1_ps(255.0f)), _mm512_set1_ps(255.0f));
+
+		__m128i cost = _mm512_cvtepi32_epi8(_mm512_cvttps_epi32(score));
+		_mm_mask_storeu_epi8(pDSI + i, mask, cost);
+	}
+}
+
+static void toGrayAVX512(const unsigned char* pSrc, int channels, int count, unsigned char* pDst)
+{
+	int i = 0;
+	if (channels == 3 || channels == 4)
+	{
+		// r + g + b of each pixel from two multiply-adds with weights 1, 1, 1, 0
+		__m512i weights = _mm512_set1_epi32(0x00010101);
+		__m512i ones = _mm512_set1_epi16(1);
+		__m512i scale = _mm512_set1_epi32(SGM_GRAY_SCALE);
+		// RGB: 4 pixels of each 128 bit lane are spread to 32 bits
+		__m512i spread = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+		// RGB reads 4 bytes past the last pixel
+		int end = channels == 3 ? count - 2 : count;
+		for (; i + 16 <= end; i += 16)
+		{
+			const unsigned char* p = pSrc + (size_t)channels * i;
+			__m512i v;
+			if (channels == 4)
+			{
+				v = _mm512_loadu_si512(p);
+			}
+			else
+			{
+				v = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*)p));
+				v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+				v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(p + 24)), 2);
+				v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i*)(p + 36)), 3);
+				v = _mm512_shuffle_epi8(v, spread);
+			}
+			__m512i sum = _mm512_madd_epi16(_mm512_maddubs_epi16(v, weights), ones);
+			__m512i gray = _mm512_srli_epi32(_mm512_mullo_epi32(sum, scale), 16);
+			_mm_storeu_si128((__m128i*)(pDst + i), _mm512_cvtepi32_epi8(gray));
+		}
+	}
+	sgmToGrayTail(pSrc, channels, i, count, pDst);
+}
+
+static void messagePassingAVX512(const unsigned char* pData, short* pBuffer, short* pScratch, short* pDMessage,
+	int size, short pen1, short pen2)
+{
+	__m512i m = _mm512_set1_epi16(SHRT_MAX);
+	for (int i = 0; i < size; i += 32)
+	{
+		__mmask32 mask = size - i < 32 ? (__mmask32)((1u << (size - i)) - 1) : (__mmask32)0xffffffffu;
+		m = _mm512_mask_min_epi16(m, mask, m, _mm512_maskz_loadu_epi16(mask, pBuffer + i));
+	}
+	__m256i h = _mm256_min_epi16(_mm512_castsi512_si256(m), _mm512_extracti64x4_epi64(m, 1));
+	__m128i q = _mm_min_epi16(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+	// minpos works on unsigned values, flipping the sign bit maps signed order onto it
+	__m128i sign = _mm_set1_epi16(-32768);
+	short minval = (short)(_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(q, sign))) ^ 0x8000);
+
+	pScratch[0] = SGM_BORDER_COST;
+	pScratch[size + 1] = SGM_BORDER_COST;
+	__m512i vmin = _mm512_set1_epi16(minval);
+	for (int i = 0; i < size; i += 32)
+	{
+		__mmask32 mask = size - i < 32 ? (__mmask32)((1u << (size - i)) - 1) : (__mmask32)0xffffffffu;
+		_mm512_mask_storeu_epi16(pScratch + i + 1, mask, _mm512_sub_epi16(_mm512_maskz_loadu_epi16(mask, pBuffer + i), vmin));
+	}
+
+	__m512i penalty1 = _mm512_set1_epi16(pen1);
+	__m512i penalty2 = _mm512_set1_epi16(pen2);
+	for (int i = 0; i < size; i += 32)
+	{
+		__mmask32 mask = size - i < 32 ? (__mmask32)((1u << (size - i)) - 1) : (__mmask32)0xffffffffu;
+		__m512i prev = _mm512_add_epi16(_mm512_maskz_loadu_epi16(mask, pScratch + i), penalty1);
+		__m512i next = _mm512_add_epi16(_mm512_maskz_loadu_epi16(mask, pScratch + i + 2), penalty1);
+		__m512i cur = _mm512_min_epi16(_mm512_maskz_loadu_epi16(mask, pScratch + i + 1), penalty2);
+		__m512i val = _mm512_add_epi16(_mm512_min_epi16(_mm512_min_epi16(prev, next), cur), _mm512_cvtepu8_epi16(_mm256_maskz_loadu_epi8(mask, pData + i)));
+
+		_mm512_mask_storeu_epi16(pBuffer + i, mask, val);
+		__m512i msg = _mm512_maskz_loadu_epi16(mask, pDMessage + i);
+		_mm512_mask_storeu_epi16(pDMessage + i, mask, _mm512_adds_epi16(msg, val));
+	}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+const SGMKernels sgmKernelsAVX512 = { "avx512", accumulateProductsAVX512, nccCostAVX512, toGrayAVX512, messagePassingAVX512 };
+
+#endif
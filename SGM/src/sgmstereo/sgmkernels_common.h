@@ -0,0 +1,110 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef sgm_kernels_common_h
+#define sgm_kernels_common_h
+
+// shared by SGMKernels implementations, not meant to be included elsewhere
+
+#include <stddef.h>
+#include <limits.h>
+#include <math.h>
+#include "sgmkernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SGM_KERNELS_X86 1
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define SGM_KERNELS_AARCH64 1
+#endif
+
+// cost of going outside of disparity range in messagePassing
+#define SGM_BORDER_COST (255 * 64)
+extern const SGMKernels sgmKernelsScalar;
+#ifdef SGM_KERNELS_X86
+extern const SGMKernels sgmKernelsSSE2;
+extern const SGMKernels sgmKernelsAVX2;
+extern const SGMKernels sgmKernelsAVX512;
+#endif
+#ifdef SGM_KERNELS_AARCH64
+extern const SGMKernels sgmKernelsNEON;
+#endif
+
+// window sums are exact integers, float math starts from the covariance and variances, both
+// scaled by n * n which is compensated for in eps
+static inline float sgmNccEps(int n)
+{
+	return 0.01f * (float)(n * n);
+}
+
+// Reference NCC cost. Vectorized versions must do the same float operations in the same order to
+// give identical results.
+static inline unsigned char sgmNccCost(int cov, int varL, int varR, float eps)
+{
+	float prod = (float)varL * (float)varR;
+	float ncc = (float)cov / sqrtf(prod > eps ? prod : eps);
+	float score = (1.0f - ncc) * 255.0f;
+	// cov^2 <= varL * varR, score can only go below 0 by rounding and is truncated to 0 then
+	return (unsigned char)(score < 255.0f ? score : 255.0f);
+}
+
+// reference costs for disparities [begin, count), see SGMKernels::nccCost
+static inline void sgmNccCostTail(const int* pSumLR, int sumL, int sumLL, const int* pSumR, const int* pSumRR,
+	int begin, int count, int n, unsigned char* pDSI)
+{
+	int varL = n * sumLL - sumL * sumL;
+	float eps = sgmNccEps(n);
+	for (int i = begin; i < count; i++)
+		pDSI[i] = sgmNccCost(n * pSumLR[i] - sumL * pSumR[i], varL, n * pSumRR[i] - pSumR[i] * pSumR[i], eps);
+}
+
+// range [begin, end) of disparities k for which pixel x + minDisparity + k is inside the row
+static inline void sgmProductRange(int x, int cols, int minDisparity, int planes, int& begin, int& end)
+{
+	begin = -minDisparity - x > 0 ? -minDisparity - x : 0;
+	end = cols - x - minDisparity < planes ? cols - x - minDisparity : planes;
+}
+
+// reference products for disparities [begin, end) of pixel x
+static inline void sgmAccumulateProductsTail(const unsigned char* L, const unsigned char* R, int x, int minDisparity,
+	int planes, int weight, int begin, int end, int* pColumns)
+{
+	int l = weight * L[x];
+	const unsigned char* pR = R + x + minDisparity;
+	int* pCol = pColumns + (size_t)x * planes;
+	for (int k = begin; k < end; k++)
+		pCol[k] += l * pR[k];
+}
+
+// (r + g + b) / 3 as (sum * SGM_GRAY_SCALE) >> 16, exact for all sums up to 3 * 255
+#define SGM_GRAY_SCALE 21846
+
+// reference gray values for pixels [begin, count)
+static inline void sgmToGrayTail(const unsigned char* pSrc, int channels, int begin, int count, unsigned char* pDst)
+{
+	for (int i = begin; i < count; i++)
+	{
+		const unsigned char* p = pSrc + (size_t)channels * i;
+		pDst[i] = (unsigned char)((p[0] + p[1] + p[2]) / 3);
+	}
+}
+
+// reference path cost update for elements [begin, size) after pScratch has been filled
+static inline void sgmMessagePassingTail(const unsigned char* pData, short* pBuffer, const short* pScratch, short* pDMessage,
+	int begin, int size, short pen1, short pen2)
+{
+	const short* pB = pScratch + 1;
+	for (int i = begin; i < size; i++)
+	{
+		short neighbor = pB[i - 1] < pB[i + 1] ? pB[i - 1] : pB[i + 1];
+		neighbor = (short)(neighbor + pen1);
+		short jump = pB[i] < pen2 ? pB[i] : pen2;
+		short val = (short)((neighbor < jump ? neighbor : jump) + pData[i]);
+		pBuffer[i] = val;
+		int sum = pDMessage[i] + val;
+		pDMessage[i] = (short)(sum > SHRT_MAX ? SHRT_MAX : (sum < SHRT_MIN ? SHRT_MIN : sum));
+	}
+}
+
+#endif
@@ -0,0 +1,163 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include "sgmkernels_common.h"
+
+// vdivq_f32, vsqrtq_f32 and vminvq_s16 are only available on AArch64
+#ifdef SGM_KERNELS_AARCH64
+
+#include <arm_neon.h>
+
+static void accumulateProductsNEON(const unsigned char* L, const unsigned char* R, int cols, int minDisparity,
+	int planes, int weight, int* pColumns)
+{
+	int vsize = planes / 8 * 8;
+
+	for (int x = 0; x < cols; x++)
+	{
+		int begin, end;
+		sgmProductRange(x, cols, minDisparity, planes, begin, end);
+		if (begin > 0 || end < planes)
+		{
+			// near the borders
+			sgmAccumulateProductsTail(L, R, x, minDisparity, planes, weight, begin, end, pColumns);
+			continue;
+		}
+
+		uint16x4_t l = vdup_n_u16(L[x]);
+		const unsigned char* pR = R + x + minDisparity;
+		int* pCol = pColumns + (size_t)x * planes;
+		for (int k = 0; k < vsize; k += 8)
+		{
+			uint16x8_t r = vmovl_u8(vld1_u8(pR + k));
+			int32x4_t p0 = vreinterpretq_s32_u32(vmull_u16(vget_low_u16(r), l));
+			int32x4_t p1 = vreinterpretq_s32_u32(vmull_u16(vget_high_u16(r), l));
+			int32x4_t c0 = vld1q_s32(pCol + k);
+			int32x4_t c1 = vld1q_s32(pCol + k + 4);
+			if (weight > 0)
+			{
+				c0 = vaddq_s32(c0, p0);
+				c1 = vaddq_s32(c1, p1);
+			}
+			else
+			{
+				c0 = vsubq_s32(c0, p0);
+				c1 = vsubq_s32(c1, p1);
+			}
+			vst1q_s32(pCol + k, c0);
+			vst1q_s32(pCol + k + 4, c1);
+		}
+		sgmAccumulateProductsTail(L, R, x, minDisparity, planes, weight, vsize, planes, pColumns);
+	}
+}
+
+static void nccCostNEON(const int* pSumLR, int sumL, int sumLL, const int* pSumR, const int* pSumRR,
+	int count, int n, unsigned char* pDSI)
+{
+	int vsize = count / 4 * 4;
+
+	int32x4_t vn = vdupq_n_s32(n);
+	int32x4_t vsumL = vdupq_n_s32(sumL);
+	float32x4_t varL = vdupq_n_f32((float)(n * sumLL - sumL * sumL));
+	float32x4_t eps = vdupq_n_f32(sgmNccEps(n));
+	for (int i = 0; i < vsize; i += 4)
+	{
+		int32x4_t sumR = vld1q_s32(pSumR + i);
+		int32x4_t sumRR = vld1q_s32(pSumRR + i);
+		int32x4_t sumLR = vld1q_s32(pSumLR + i);
+		float32x4_t cov = vcvtq_f32_s32(vsubq_s32(vmulq_s32(vn, sumLR), vmulq_s32(vsumL, sumR)));
+		float32x4_t varR = vcvtq_f32_s32(vsubq_s32(vmulq_s32(vn, sumRR), vmulq_s32(sumR, sumR)));
+
+		float32x4_t ncc = vdivq_f32(cov, vsqrtq_f32(vmaxq_f32(vmulq_f32(varL, varR), eps)));
+		// separate multiply and subtract, fused vfmsq_f32 would round differently from the other implementations
+		float32x4_t score = vminq_f32(vmulq_f32(vsubq_f32(vdupq_n_f32(1.0f), ncc), vdupq_n_f32(255.0f)), vdupq_n_f32(255.0f));
+
+		int16x4_t cost = vmovn_s32(vcvtq_s32_f32(score));
+		uint8x8_t bytes = vqmovun_s16(vcombine_s16(cost, cost));
+		vst1_lane_u32((uint32_t*)(pDSI + i), vreinterpret_u32_u8(bytes), 0);
+	}
+	sgmNccCostTail(pSumLR, sumL, sumLL, pSumR, pSumRR, vsize, count, n, pDSI);
+}
+
+// (sum * SGM_GRAY_SCALE) >> 16 of 8 sums
+static inline uint8x8_t divideBy3(uint16x8_t sum)
+{
+	uint16x4_t scale = vdup_n_u16(SGM_GRAY_SCALE);
+	uint16x4_t lo = vshrn_n_u32(vmull_u16(vget_low_u16(sum), scale), 16);
+	uint16x4_t hi = vshrn_n_u32(vmull_u16(vget_high_u16(sum), scale), 16);
+	return vmovn_u16(vcombine_u16(lo, hi));
+}
+
+static void toGrayNEON(const unsigned char* pSrc, int channels, int count, unsigned char* pDst)
+{
+	int i = 0;
+	if (channels == 3 || channels == 4)
+	{
+		for (; i + 16 <= count; i += 16)
+		{
+			const unsigned char* p = pSrc + (size_t)channels * i;
+			uint8x16_t r, g, b;
+			if (channels == 4)
+			{
+				uint8x16x4_t v = vld4q_u8(p);
+				r = v.val[0];
+				g = v.val[1];
+				b = v.val[2];
+			}
+			else
+			{
+				uint8x16x3_t v = vld3q_u8(p);
+				r = v.val[0];
+				g = v.val[1];
+				b = v.val[2];
+			}
+			uint16x8_t lo = vaddw_u8(vaddl_u8(vget_low_u8(r), vget_low_u8(g)), vget_low_u8(b));
+			uint16x8_t hi = vaddw_u8(vaddl_u8(vget_high_u8(r), vget_high_u8(g)), vget_high_u8(b));
+			vst1q_u8(pDst + i, vcombine_u8(divideBy3(lo), divideBy3(hi)));
+		}
+	}
+	sgmToGrayTail(pSrc, channels, i, count, pDst);
+}
+
+static void messagePassingNEON(const unsigned char* pData, short* pBuffer, short* pScratch, short* pDMessage,
+	int size, short pen1, short pen2)
+{
+	int vsize = size / 8 * 8;
+
+	short minval = pBuffer[0];
+	if (vsize > 0)
+	{
+		int16x8_t m = vld1q_s16(pBuffer);
+		for (int i = 8; i < vsize; i += 8)
+			m = vminq_s16(m, vld1q_s16(pBuffer + i));
+		minval = vminvq_s16(m);
+	}
+	for (int i = vsize; i < size; i++)
+		minval = pBuffer[i] < minval ? pBuffer[i] : minval;
+
+	pScratch[0] = SGM_BORDER_COST;
+	pScratch[size + 1] = SGM_BORDER_COST;
+	int16x8_t vmin = vdupq_n_s16(minval);
+	for (int i = 0; i < vsize; i += 8)
+		vst1q_s16(pScratch + i + 1, vsubq_s16(vld1q_s16(pBuffer + i), vmin));
+	for (int i = vsize; i < size; i++)
+		pScratch[i + 1] = (short)(pBuffer[i] - minval);
+
+	int16x8_t penalty1 = vdupq_n_s16(pen1);
+	int16x8_t penalty2 = vdupq_n_s16(pen2);
+	for (int i = 0; i < vsize; i += 8)
+	{
+		int16x8_t prev = vaddq_s16(vld1q_s16(pScratch + i), penalty1);
+		int16x8_t next = vaddq_s16(vld1q_s16(pScratch + i + 2), penalty1);
+		int16x8_t cur = vminq_s16(vld1q_s16(pScratch + i + 1), penalty2);
+		int16x8_t val = vaddq_s16(vminq_s16(vminq_s16(prev, next), cur), vreinterpretq_s16_u16(vmovl_u8(vld1_u8(pData + i))));
+
+		vst1q_s16(pBuffer + i, val);
+		vst1q_s16(pDMessage + i, vqaddq_s16(vld1q_s16(pDMessage + i), val));
+	}
+	sgmMessagePassingTail(pData, pBuffer, pScratch, pDMessage, vsize, size, pen1, pen2);
+}
+
+const SGMKernels sgmKernelsNEON = { "neon", accumulateProductsNEON, nccCostNEON, toGrayNEON, messagePassingNEON };
+
+#endif
@@ -0,0 +1,166 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#include <string.h>
+#include "sgmkernels_common.h"
+
+#ifdef SGM_KERNELS_X86
+
+#include <emmintrin.h>
+
+// low 32 bits of products of 32 bit lanes, SSE2 has no _mm_mullo_epi32
+static inline __m128i mullo32(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static void accumulateProductsSSE2(const unsigned char* L, const unsigned char* R, int cols, int minDisparity,
+	int planes, int weight, int* pColumns)
+{
+	int vsize = planes / 8 * 8;
+	__m128i zero = _mm_setzero_si128();
+
+	for (int x = 0; x < cols; x++)
+	{
+		int begin, end;
+		sgmProductRange(x, cols, minDisparity, planes, begin, end);
+		if (begin > 0 || end < planes)
+		{
+			// near the borders
+			sgmAccumulateProductsTail(L, R, x, minDisparity, planes, weight, begin, end, pColumns);
+			continue;
+		}
+
+		// products of 8 bit pixels need 32 bits, they are put together from low and high 16 bits
+		__m128i l = _mm_set1_epi16((short)L[x]);
+		const unsigned char* pR = R + x + minDisparity;
+		int* pCol = pColumns + (size_t)x * planes;
+		for (int k = 0; k < vsize; k += 8)
+		{
+			__m128i r = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pR + k)), zero);
+			__m128i lo = _mm_mullo_epi16(r, l);
+			__m128i hi = _mm_mulhi_epu16(r, l);
+			__m128i p0 = _mm_unpacklo_epi16(lo, hi);
+			__m128i p1 = _mm_unpackhi_epi16(lo, hi);
+			__m128i c0 = _mm_loadu_si128((const __m128i*)(pCol + k));
+			__m128i c1 = _mm_loadu_si128((const __m128i*)(pCol + k + 4));
+			if (weight > 0)
+			{
+				c0 = _mm_add_epi32(c0, p0);
+				c1 = _mm_add_epi32(c1, p1);
+			}
+			else
+			{
+				c0 = _mm_sub_epi32(c0, p0);
+				c1 = _mm_sub_epi32(c1, p1);
+			}
+			_mm_storeu_si128((__m128i*)(pCol + k), c0);
+			_mm_storeu_si128((__m128i*)(pCol + k + 4), c1);
+		}
+		sgmAccumulateProductsTail(L, R, x, minDisparity, planes, weight, vsize, planes, pColumns);
+	}
+}
+
+static void nccCostSSE2(const int* pSumLR, int sumL, int sumLL, const int* pSumR, const int* pSumRR,
+	int count, int n, unsigned char* pDSI)
+{
+	int vsize = count / 4 * 4;
+
+	__m128i vn = _mm_set1_epi32(n);
+	__m128i vsumL = _mm_set1_epi32(sumL);
+	__m128 varL = _mm_set1_ps((float)(n * sumLL - sumL * sumL));
+	__m128 eps = _mm_set1_ps(sgmNccEps(n));
+	for (int i = 0; i < vsize; i += 4)
+	{
+		__m128i sumR = _mm_loadu_si128((const __m128i*)(pSumR + i));
+		__m128i sumRR = _mm_loadu_si128((const __m128i*)(pSumRR + i));
+		__m128i sumLR = _mm_loadu_si128((const __m128i*)(pSumLR + i));
+		__m128 cov = _mm_cvtepi32_ps(_mm_sub_epi32(mullo32(vn, sumLR), mullo32(vsumL, sumR)));
+		__m128 varR = _mm_cvtepi32_ps(_mm_sub_epi32(mullo32(vn, sumRR), mullo32(sumR, sumR)));
+
+		__m128 ncc = _mm_div_ps(cov, _mm_sqrt_ps(_mm_max_ps(_mm_mul_ps(varL, varR), eps)));
+		__m128 score = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), ncc), _mm_set1_ps(255.0f)), _mm_set1_ps(255.0f));
+
+		__m128i cost = _mm_cvttps_epi32(score);
+		cost = _mm_packs_epi32(cost, cost);
+		int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(cost, cost));
+		memcpy(pDSI + i, &bytes, sizeof(bytes));
+	}
+	sgmNccCostTail(pSumLR, sumL, sumLL, pSumR, pSumRR, vsize, count, n, pDSI);
+}
+
+static void toGraySSE2(const unsigned char* pSrc, int channels, int count, unsigned char* pDst)
+{
+	int i = 0;
+	// RGB needs byte shuffles which SSE2 does not have and is left to the reference
+	if (channels == 4)
+	{
+		__m128i mask = _mm_set1_epi32(0xff);
+		__m128i scale = _mm_set1_epi16(SGM_GRAY_SCALE);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i sum[2];
+			for (int j = 0; j < 2; j++)
+			{
+				__m128i p = _mm_loadu_si128((const __m128i*)(pSrc + 4 * (i + 4 * j)));
+				__m128i r = _mm_and_si128(p, mask);
+				__m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), mask);
+				__m128i b = _mm_and_si128(_mm_srli_epi32(p, 16), mask);
+				sum[j] = _mm_add_epi32(_mm_add_epi32(r, g), b);
+			}
+			__m128i gray = _mm_mulhi_epu16(_mm_packs_epi32(sum[0], sum[1]), scale);
+			_mm_storel_epi64((__m128i*)(pDst + i), _mm_packus_epi16(gray, gray));
+		}
+	}
+	sgmToGrayTail(pSrc, channels, i, count, pDst);
+}
+
+static void messagePassingSSE2(const unsigned char* pData, short* pBuffer, short* pScratch, short* pDMessage,
+	int size, short pen1, short pen2)
+{
+	int vsize = size / 8 * 8;
+
+	short minval = pBuffer[0];
+	if (vsize > 0)
+	{
+		__m128i m = _mm_loadu_si128((const __m128i*)pBuffer);
+		for (int i = 8; i < vsize; i += 8)
+			m = _mm_min_epi16(m, _mm_loadu_si128((const __m128i*)(pBuffer + i)));
+		m = _mm_min_epi16(m, _mm_srli_si128(m, 8));
+		m = _mm_min_epi16(m, _mm_srli_si128(m, 4));
+		m = _mm_min_epi16(m, _mm_srli_si128(m, 2));
+		minval = (short)_mm_cvtsi128_si32(m);
+	}
+	for (int i = vsize; i < size; i++)
+		minval = pBuffer[i] < minval ? pBuffer[i] : minval;
+
+	pScratch[0] = SGM_BORDER_COST;
+	pScratch[size + 1] = SGM_BORDER_COST;
+	__m128i vmin = _mm_set1_epi16(minval);
+	for (int i = 0; i < vsize; i += 8)
+		_mm_storeu_si128((__m128i*)(pScratch + i + 1), _mm_sub_epi16(_mm_loadu_si128((const __m128i*)(pBuffer + i)), vmin));
+	for (int i = vsize; i < size; i++)
+		pScratch[i + 1] = (short)(pBuffer[i] - minval);
+
+	__m128i penalty1 = _mm_set1_epi16(pen1);
+	__m128i penalty2 = _mm_set1_epi16(pen2);
+	__m128i zero = _mm_setzero_si128();
+	for (int i = 0; i < vsize; i += 8)
+	{
+		__m128i prev = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(pScratch + i)), penalty1);
+		__m128i next = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(pScratch + i + 2)), penalty1);
+		__m128i cur = _mm_min_epi16(_mm_loadu_si128((const __m128i*)(pScratch + i + 1)), penalty2);
+		__m128i val = _mm_add_epi16(_mm_min_epi16(_mm_min_epi16(prev, next), cur), _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(pData + i)), zero));
+
+		_mm_storeu_si128((__m128i*)(pBuffer + i), val);
+		__m128i msg = _mm_loadu_si128((const __m128i*)(pDMessage + i));
+		_mm_storeu_si128((__m128i*)(pDMessage + i), _mm_adds_epi16(msg, val));
+	}
+	sgmMessagePassingTail(pData, pBuffer, pScratch, pDMessage, vsize, size, pen1, pen2);
+}
+
+const SGMKernels sgmKernelsSSE2 = { "sse2", accumulateProductsSSE2, nccCostSSE2, toGraySSE2, messagePassingSSE2 };
+
+#endif
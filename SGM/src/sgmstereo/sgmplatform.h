@@ -0,0 +1,35 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+
+#ifndef sgm_platform_h
+#define sgm_platform_h
+
+// portable replacements for MSVC CRT functions so SGM also builds with gcc and clang
+
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+inline void* sgmAlignedMalloc(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	void* p = NULL;
+	if (posix_memalign(&p, alignment, size) != 0)
+		return NULL;
+	return p;
+#endif
+}
+
+inline void sgmAlignedFree(void* p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+#endif
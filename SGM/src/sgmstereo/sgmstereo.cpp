@@ -5,17 +5,24 @@
 
 #include <stdint.h>
 #include <vector>
+#include <chrono>
+#include <algorithm>
 
 #include "sgmstereo.h"
 #include "dsimage.h"
-#include "emmintrin.h"
+#include "sgmkernels.h"
+#include "sgmkernels_common.h"
 
 SGMStereo::SGMStereo(int _w, int _h, int minDisparity, int maxDisparity, int numDirections, int sgmConfidenceThreshold, int doSubPixRefinement,
 	float smoothness,
 	float penalty1,
 	float penalty2,
 	float alpha,
-	int doSequential)
+	int doSequential,
+	int windowSize,
+	int lowMemory,
+	int pyramidLevels,
+	int bandPlanes)
 {
 	m_w = _w;
 	m_h = _h;
@@ -29,6 +36,15 @@ SGMStereo::SGMStereo(int _w, int _h, int minDisparity, int maxDisparity, int num
 	m_sgmConfidenceThreshold = sgmConfidenceThreshold;
     m_doSubPixRefinement = doSubPixRefinement;
 	m_doSequential = doSequential;
+	m_windowSize = windowSize;
+	m_lowMemory = lowMemory;
+	m_pyramidLevels = pyramidLevels;
+	m_bandPlanes = bandPlanes;
+	m_coarse = NULL;
+	m_minPriorCoverage = 0.9f;
+	m_priorUsed = false;
+	m_kernels = &getSGMKernels();
+	memset(&m_timings, 0, sizeof(m_timings));
 
 	if (minDisparity >= maxDisparity)
 	{
@@ -36,19 +52,82 @@ SGMStereo::SGMStereo(int _w, int _h, int minDisparity, int maxDisparity, int num
 		exit(1);
 	}
 
+	if (numDirections != 4 && numDirections != 8 && numDirections != 16)
+	{
+		printf("[ERROR] Invalid Number of Directions %d, must be 4, 8 or 16 ...\n", numDirections);
+		exit(1);
+	}
+
+	if (windowSize < 3 || windowSize > 11 || windowSize % 2 == 0 || windowSize > _w || windowSize > _h)
+	{
+		printf("[ERROR] Invalid NCC Window Size %d, must be odd between 3 and 11 ...\n", windowSize);
+		exit(1);
+	}
+
+	if (pyramidLevels < 0 || pyramidLevels > 3 || (pyramidLevels > 0 && (lowMemory || bandPlanes < 4)))
+	{
+		printf("[ERROR] Invalid Pyramid Levels %d with %d disparities per pixel, must be 0 to 3, at least 4 disparities and not in low memory mode ...\n",
+			pyramidLevels, bandPlanes);
+		exit(1);
+	}
 
 	int dispRange = maxDisparity - minDisparity;
-	
-	m_dsi.create(_w, _h, dispRange);
 
-	if (m_doSequential)
+	// nothing to gain once the band covers the whole range
+	if (bandPlanes >= dispRange)
+		m_pyramidLevels = 0;
+
+	if (m_pyramidLevels > 0)
+	{
+		// half resolution and half the disparities, rounded outwards
+		int coarseW = _w / 2;
+		int coarseH = _h / 2;
+		int coarseMin = minDisparity >= 0 ? minDisparity / 2 : -((1 - minDisparity) / 2);
+		int coarseMax = maxDisparity >= 0 ? (maxDisparity + 1) / 2 : -(-maxDisparity / 2);
+		m_coarse = new SGMStereo(coarseW, coarseH, coarseMin, coarseMax, numDirections, sgmConfidenceThreshold, doSubPixRefinement,
+			smoothness, penalty1, penalty2, alpha, doSequential, windowSize, 0, m_pyramidLevels - 1, bandPlanes);
+
+		size_t coarsePixels = (size_t)coarseW * coarseH;
+		m_coarseLeft.assign(coarsePixels, 0);
+		m_coarseRight.assign(coarsePixels, 0);
+		m_coarseDisp.assign(coarsePixels, 0);
+		m_coarseConf.assign(coarsePixels, 0);
+		// guide is the coarser level or a full resolution prior
+		m_guideLow.assign((size_t)_w * _h, 0);
+		m_guideHigh.assign((size_t)_w * _h, 0);
+		m_guideCenter.assign((size_t)_w * _h, 0);
+		m_bandOffset.assign((size_t)_w * _h, 0);
+	}
+
+	if (m_lowMemory)
 	{
-		messages.create(_w, _h, dispRange);
+		size_t rowSize = (size_t)_w * dispRange;
+		createWindowSums(m_windowSums);
+		m_costRow.assign(rowSize, 255);
+		m_messageRow.assign(rowSize, 0);
+		m_pathBuffer.assign(dispRange, 0);
+		m_scratch.assign(getSGMScratchSize(dispRange), 0);
+
+		// downward paths only, horizontal paths need no rows
+		static const int pathDirections[][2] = { { 0, 1 }, { 1, 1 }, { -1, 1 }, { 2, 1 }, { -2, 1 }, { 1, 2 }, { -1, 2 } };
+		int paths = numDirections == 4 ? 1 : (numDirections == 8 ? 3 : 7);
+		m_pathRows.resize(paths);
+		for (int i = 0; i < paths; i++)
+		{
+			m_pathRows[i].dx = pathDirections[i][0];
+			m_pathRows[i].dy = pathDirections[i][1];
+			m_pathRows[i].rows.assign((m_pathRows[i].dy + 1) * rowSize, 0);
+		}
 	}
 	else
 	{
-		messages_hor.create(_w, _h, dispRange);
-		messages_ver.create(_w, _h, dispRange);
+		int planes = m_pyramidLevels > 0 ? bandPlanes : dispRange;
+		m_dsi.create(_w, _h, planes);
+		// calculateDSI skips the image border and disparities where the right window is outside of the
+		// image, their cost would otherwise be whatever the allocator returned
+		m_dsi.fill(255);
+
+		messages.create(_w, _h, planes);
 	}
 
 	float rec_penalty2 = 1.0f / m_penalty2;
@@ -60,401 +139,636 @@ SGMStereo::SGMStereo(int _w, int _h, int minDisparity, int maxDisparity, int num
 }
 
 
-void SGMStereo::calculateDSI_sse(unsigned char *L, unsigned char * R)
+// NCC costs are computed incrementally from window sums: sums of pixels and their squares come from
+// running column sums, products of left and right pixels from running column sums per disparity which
+// slide down the image and across each row. Work per cost does not depend on the window size.
+void SGMStereo::createWindowSums(NCCWindowSums& sums)
 {
 	int cols = m_w;
-	int rows = m_h;
-
-#pragma omp parallel for schedule(dynamic,1)
-	
-	for (int y = 1; y < rows - 1; y++)
-	{
-		int off1 = cols * y;
-		int off0 = off1 - cols;
-		int off2 = off1 + cols;
-		for (int x = 1; x < cols - 1; x++)
-		{
-			float u_00 = (float)L[off0 + x - 1];
-			float u_10 = (float)L[off0 + x];
-			float u_20 = (float)L[off0 + x + 1];
-			float u_01 = (float)L[off1 + x - 1];
-			float u_11 = (float)L[off1 + x];
-			float u_21 = (float)L[off1 + x + 1];
-			float u_02 = (float)L[off2 + x - 1];
-			float u_12 = (float)L[off2 + x];
-			float u_22 = (float)L[off2 + x + 1];
-
-			for (int disp = m_minDisparity; disp < m_maxDisparity; disp += 4)
-			{
-				if (x + disp - 1 >= 0 && x + disp + 5 < m_w)
-				{
-					float a[6], b[6], c[6];
-					for (int k = -1; k < 5; k++)
-					{
-						a[k + 1] = (float)R[off0 + x + disp + k];
-						b[k + 1] = (float)R[off1 + x + disp + k];
-						c[k + 1] = (float)R[off2 + x + disp + k];
-					}
-					
-					__m128 v_00 = _mm_set_ps(a[0], a[1], a[2], a[3]);
-					__m128 v_10 = _mm_set_ps(a[1], a[2], a[3], a[4]);
-					__m128 v_20 = _mm_set_ps(a[2], a[3], a[4], a[5]);
-					__m128 v_01 = _mm_set_ps(b[0], b[1], b[2], b[3]);
-					__m128 v_11 = _mm_set_ps(b[1], b[2], b[3], b[4]);
-					__m128 v_21 = _mm_set_ps(b[2], b[3], b[4], b[5]);
-					__m128 v_02 = _mm_set_ps(c[0], c[1], c[2], c[3]);
-					__m128 v_12 = _mm_set_ps(c[1], c[2], c[3], c[4]);
-					__m128 v_22 = _mm_set_ps(c[2], c[3], c[4], c[5]);
-					
-					float sum_1 = (u_00 + u_10 + u_20 + u_01 + u_11 + u_21 + u_02 + u_12 + u_22) / 9.0f;
-					__m128 sum_2 = _mm_div_ps(_mm_add_ps(v_00, _mm_add_ps(v_10, _mm_add_ps(v_20, _mm_add_ps(v_01, _mm_add_ps(v_11, _mm_add_ps(v_21, _mm_add_ps(v_02, _mm_add_ps(v_12, v_22)))))))), _mm_set1_ps(9.0f));
-					__m128 val_1, val_2, sum_v1_x_v1, sum_v2_x_v2, sum_v1_x_v2;
-
-					val_1 = _mm_set1_ps(u_00 - sum_1);
-					val_2 = _mm_sub_ps(v_00, sum_2);
-					sum_v1_x_v1 = _mm_mul_ps(val_1, val_1);
-					sum_v2_x_v2 = _mm_mul_ps(val_2, val_2);
-					sum_v1_x_v2 = _mm_mul_ps(val_1, val_2);
-
-					val_1 = _mm_set1_ps(u_10 - sum_1);
-					val_2 = _mm_sub_ps(v_10, sum_2);
-					sum_v1_x_v1 = _mm_add_ps(sum_v1_x_v1, _mm_mul_ps(val_1, val_1));
-					sum_v2_x_v2 = _mm_add_ps(sum_v2_x_v2, _mm_mul_ps(val_2, val_2));
-					sum_v1_x_v2 = _mm_add_ps(sum_v1_x_v2, _mm_mul_ps(val_1, val_2));
-
-					val_1 = _mm_set1_ps(u_20 - sum_1);
-					val_2 = _mm_sub_ps(v_20, sum_2);
-					sum_v1_x_v1 = _mm_add_ps(sum_v1_x_v1, _mm_mul_ps(val_1, val_1));
-					sum_v2_x_v2 = _mm_add_ps(sum_v2_x_v2, _mm_mul_ps(val_2, val_2));
-					sum_v1_x_v2 = _mm_add_ps(sum_v1_x_v2, _mm_mul_ps(val_1, val_2));
-
-					val_1 = _mm_set1_ps(u_01 - sum_1);
-					val_2 = _mm_sub_ps(v_01, sum_2);
-					sum_v1_x_v1 = _mm_add_ps(sum_v1_x_v1, _mm_mul_ps(val_1, val_1));
-					sum_v2_x_v2 = _mm_add_ps(sum_v2_x_v2, _mm_mul_ps(val_2, val_2));
-					sum_v1_x_v2 = _mm_add_ps(sum_v1_x_v2, _mm_mul_ps(val_1, val_2));
-
-					val_1 = _mm_set1_ps(u_11 - sum_1);
-					val_2 = _mm_sub_ps(v_11, sum_2);
-					sum_v1_x_v1 = _mm_add_ps(sum_v1_x_v1, _mm_mul_ps(val_1, val_1));
-					sum_v2_x_v2 = _mm_add_ps(sum_v2_x_v2, _mm_mul_ps(val_2, val_2));
-					sum_v1_x_v2 = _mm_add_ps(sum_v1_x_v2, _mm_mul_ps(val_1, val_2));
-
-					val_1 = _mm_set1_ps(u_21 - sum_1);
-					val_2 = _mm_sub_ps(v_21, sum_2);
-					sum_v1_x_v1 = _mm_add_ps(sum_v1_x_v1, _mm_mul_ps(val_1, val_1));
-					sum_v2_x_v2 = _mm_add_ps(sum_v2_x_v2, _mm_mul_ps(val_2, val_2));
-					sum_v1_x_v2 = _mm_add_ps(sum_v1_x_v2, _mm_mul_ps(val_1, val_2));
-
-					val_1 = _mm_set1_ps(u_02 - sum_1);
-					val_2 = _mm_sub_ps(v_02, sum_2);
-					sum_v1_x_v1 = _mm_add_ps(sum_v1_x_v1, _mm_mul_ps(val_1, val_1));
-					sum_v2_x_v2 = _mm_add_ps(sum_v2_x_v2, _mm_mul_ps(val_2, val_2));
-					sum_v1_x_v2 = _mm_add_ps(sum_v1_x_v2, _mm_mul_ps(val_1, val_2));
-
-					val_1 = _mm_set1_ps(u_12 - sum_1);
-					val_2 = _mm_sub_ps(v_12, sum_2);
-					sum_v1_x_v1 = _mm_add_ps(sum_v1_x_v1, _mm_mul_ps(val_1, val_1));
-					sum_v2_x_v2 = _mm_add_ps(sum_v2_x_v2, _mm_mul_ps(val_2, val_2));
-					sum_v1_x_v2 = _mm_add_ps(sum_v1_x_v2, _mm_mul_ps(val_1, val_2));
-
-					val_1 = _mm_set1_ps(u_22 - sum_1);
-					val_2 = _mm_sub_ps(v_22, sum_2);
-					sum_v1_x_v1 = _mm_add_ps(sum_v1_x_v1, _mm_mul_ps(val_1, val_1));
-					sum_v2_x_v2 = _mm_add_ps(sum_v2_x_v2, _mm_mul_ps(val_2, val_2));
-					sum_v1_x_v2 = _mm_add_ps(sum_v1_x_v2, _mm_mul_ps(val_1, val_2));
-
-					__m128 ncc1 = _mm_div_ps(sum_v1_x_v2, _mm_sqrt_ps(_mm_max_ps(_mm_mul_ps(sum_v1_x_v1, sum_v2_x_v2), _mm_set1_ps(0.01f))));
-					__m128 score = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), ncc1), _mm_set1_ps(255.0f)), _mm_set1_ps(255.0f));
-					float scores[4];
-					_mm_storeu_ps(scores, score);
-					short *pDSI = m_dsi(x, y);
-					int indexDisp = disp - m_minDisparity;
-					pDSI[indexDisp + 3] = (short)scores[0];
-					pDSI[indexDisp + 2] = (short)scores[1];
-					pDSI[indexDisp + 1] = (short)scores[2];
-					pDSI[indexDisp] = (short)scores[3];
-				}
-				else
-				{
-					short *pDSI = m_dsi(x, y);
-					int indexDisp = disp - m_minDisparity;
-					pDSI[indexDisp + 3] = (short)255;
-					pDSI[indexDisp + 2] = (short)255;
-					pDSI[indexDisp + 1] = (short)255;
-					pDSI[indexDisp] = (short)255;
-				}
-			}
-		}
-	}
+	int planes = m_maxDisparity - m_minDisparity;
+
+	sums.row = -1;
+	sums.colL.assign(cols, 0);
+	sums.colLL.assign(cols, 0);
+	sums.colR.assign(cols, 0);
+	sums.colRR.assign(cols, 0);
+	sums.colLR.assign((size_t)cols * planes, 0);
+	sums.sumR.assign(cols, 0);
+	sums.sumRR.assign(cols, 0);
+	sums.sumLR.assign(planes, 0);
 }
 
 
-
-void subtractMinVal(short *pMessage, int size)
+// centers the window on row y, sliding it down by one row if possible
+void SGMStereo::moveWindow(const unsigned char *L, const unsigned char *R, int y, NCCWindowSums& sums)
 {
-	__m128i* pM = (__m128i*)pMessage;
-	__m128i  minval = *pM;
-	for (int i = 1; i < size / 8; i++)
+	int r = m_windowSize / 2;
+
+	if (sums.row == y - 1)
 	{
-		pM++;
-		minval = _mm_min_epi16(*pM, minval);
+		// add row entering the window, remove row leaving it
+		addWindowRow(L, R, y + r, 1, sums);
+		addWindowRow(L, R, y - r - 1, -1, sums);
 	}
-
-	union u
+	else
 	{
-		__m128i m;
-		short s[8];
-	} x;
+		std::fill(sums.colL.begin(), sums.colL.end(), 0);
+		std::fill(sums.colLL.begin(), sums.colLL.end(), 0);
+		std::fill(sums.colR.begin(), sums.colR.end(), 0);
+		std::fill(sums.colRR.begin(), sums.colRR.end(), 0);
+		std::fill(sums.colLR.begin(), sums.colLR.end(), 0);
+		for (int i = y - r; i <= y + r; i++)
+			addWindowRow(L, R, i, 1, sums);
+	}
+	sums.row = y;
+}
 
-	x.m = minval;
-	short val = __min(__min(__min(x.s[0], x.s[1]), __min(x.s[2], x.s[3])), __min(__min(x.s[4], x.s[5]), __min(x.s[6], x.s[7])));
 
-	minval = _mm_set1_epi16(val);
+void SGMStereo::addWindowRow(const unsigned char *L, const unsigned char *R, int y, int weight, NCCWindowSums& sums)
+{
+	int cols = m_w;
+	int planes = m_maxDisparity - m_minDisparity;
+	const unsigned char* pL = L + (size_t)y * cols;
+	const unsigned char* pR = R + (size_t)y * cols;
 
-	for (int i = 0; i < size / 8; i++)
+	for (int x = 0; x < cols; x++)
 	{
-		*pM = _mm_sub_epi16(*pM, minval);
-		pM--;
+		int l = pL[x];
+		int r = pR[x];
+		sums.colL[x] += weight * l;
+		sums.colLL[x] += weight * l * l;
+		sums.colR[x] += weight * r;
+		sums.colRR[x] += weight * r * r;
 	}
+
+	m_kernels->accumulateProducts(pL, pR, cols, m_minDisparity, planes, weight, &sums.colLR[0]);
 }
 
 
-void SGMStereo::messagePassing(short *pData, short *pBuffer1, short *pDMessage, int size, float weight, short smoothness)
+// costs of row sums.row, disparities whose right window is outside of the image are not written. With
+// pOffsets only the band of m_bandPlanes disparities starting at pOffsets[x] is computed for pixel x.
+void SGMStereo::calculateCostRow(NCCWindowSums& sums, const short *pOffsets, unsigned char *pRow)
 {
-	short pen1 = smoothness;
-	short pen2 = (short)(smoothness*weight);
+	int cols = m_w;
+	int planes = m_maxDisparity - m_minDisparity;
+	int r = m_windowSize / 2;
+	int n = m_windowSize * m_windowSize;
+	int rowPlanes = pOffsets != NULL ? m_bandPlanes : planes;
 
-#if 1
-	__m128i* pB1 = (__m128i*)pBuffer1;
-	__m128i* pDM = (__m128i*)pDMessage;
-	__m128i* pD = (__m128i*)pData;
-	__m128i penalty1 = _mm_set1_epi16(pen1);
-	__m128i penalty2 = _mm_set1_epi16(pen2);
-	__m128i buffer1, buffer2, buffer3;
+	// bands move from frame to frame, so the costs which are not written have to be reset each time
+	if (pOffsets != NULL)
+		memset(pRow, 255, (size_t)cols * rowPlanes);
+
+	int sR = 0, sRR = 0;
+	for (int i = 0; i < m_windowSize; i++)
+	{
+		sR += sums.colR[i];
+		sRR += sums.colRR[i];
+	}
+	for (int x = r; x < cols - r; x++)
+	{
+		sums.sumR[x] = sR;
+		sums.sumRR[x] = sRR;
+		if (x + r + 1 < cols)
+		{
+			sR += sums.colR[x + r + 1] - sums.colR[x - r];
+			sRR += sums.colRR[x + r + 1] - sums.colRR[x - r];
+		}
+	}
 
-	subtractMinVal(pBuffer1, size);
+	int sL = 0, sLL = 0;
+	int* sumLR = &sums.sumLR[0];
+	for (int k = 0; k < planes; k++)
+		sumLR[k] = 0;
+	for (int i = 0; i < m_windowSize; i++)
+	{
+		sL += sums.colL[i];
+		sLL += sums.colLL[i];
+		const int* pCol = &sums.colLR[(size_t)i * planes];
+		for (int k = 0; k < planes; k++)
+			sumLR[k] += pCol[k];
+	}
 
-	short newval(255*64), newval2(255*64);
-	for (int i = 0; i < size/8; i++)
+	for (int x = r; x < cols - r; x++)
 	{
-		buffer1 = _mm_slli_si128(*pB1, 2);
-		buffer3 = _mm_insert_epi16(buffer1, newval, 0);
-		buffer1 = _mm_add_epi16(buffer3,penalty1);
+		int kBegin = std::max(0, r - x - m_minDisparity);
+		int kEnd = std::min(planes, cols - r - x - m_minDisparity);
+		int offset = 0;
+		if (pOffsets != NULL)
+		{
+			offset = pOffsets[x];
+			kBegin = std::max(kBegin, offset);
+			kEnd = std::min(kEnd, offset + rowPlanes);
+		}
+		if (kBegin < kEnd)
+		{
+			int xr = x + m_minDisparity + kBegin;
+			m_kernels->nccCost(sumLR + kBegin, sL, sLL, &sums.sumR[xr], &sums.sumRR[xr], kEnd - kBegin, n,
+				pRow + (size_t)x * rowPlanes + kBegin - offset);
+		}
 
-		buffer2 = _mm_srli_si128(*pB1, 2);
-		if (i*8+8 < size)
+		if (x + r + 1 < cols)
 		{
-			newval  = pBuffer1[i*8+7];
-			newval2 = pBuffer1[i*8+8];
+			const int* pAdd = &sums.colLR[(size_t)(x + r + 1) * planes];
+			const int* pSub = &sums.colLR[(size_t)(x - r) * planes];
+			for (int k = 0; k < planes; k++)
+				sumLR[k] += pAdd[k] - pSub[k];
+			sL += sums.colL[x + r + 1] - sums.colL[x - r];
+			sLL += sums.colLL[x + r + 1] - sums.colLL[x - r];
 		}
-		else
-			newval2 = 255*64;
+	}
+}
 
-		buffer3 = _mm_insert_epi16(buffer2, newval2, 7);
-		buffer2 = _mm_add_epi16(buffer3,penalty1);
-		buffer3 = _mm_min_epi16(buffer1, _mm_min_epi16(buffer2, _mm_min_epi16(*pB1, penalty2)));
 
-		*pB1 = _mm_add_epi16(buffer3, *pD);
-		*pDM = _mm_add_epi16(*pDM, *pB1);
+void SGMStereo::calculateDSIBand(const unsigned char *L, const unsigned char *R, int yBegin, int yEnd)
+{
+	NCCWindowSums sums;
+	createWindowSums(sums);
 
-		pB1++;
-		pDM++;
-		pD++;
-	}
-#else
-    int limit = 32768;
-	short mem[2048];
-	short minval = limit - 1;
-	
-	for (int i = 0; i < size; i++)
+	for (int y = yBegin; y < yEnd; y++)
 	{
-		minval = __min(minval, pBuffer1[i]);
+		moveWindow(L, R, y, sums);
+		calculateCostRow(sums, m_bandOffset.empty() ? NULL : &m_bandOffset[(size_t)y * m_w], m_dsi(0, y));
 	}
+}
+
 
-	for (int i = 0; i < size; i++)
+void SGMStereo::calculateDSI(unsigned char *L, unsigned char * R)
+{
+	int rows = m_h;
+	int r = m_windowSize / 2;
+	// rows are split into bands which are computed independently, each one starts by summing up a full window
+	const int bandRows = 32;
+	int bands = (rows - 2 * r + bandRows - 1) / bandRows;
+
+#pragma omp parallel for schedule(dynamic,1)
+
+	for (int band = 0; band < bands; band++)
 	{
-		pBuffer1[i] -= minval;
+		int yBegin = r + band * bandRows;
+		int yEnd = std::min(yBegin + bandRows, rows - r);
+		calculateDSIBand(L, R, yBegin, yEnd);
 	}
+}
+
+
+void SGMStereo::messagePassing(const unsigned char *pData, short *pBuffer1, short *pScratch, short *pDMessage, int size, float weight, short smoothness)
+{
+	short pen1 = smoothness;
+	short pen2 = (short)(smoothness*weight);
+
+	m_kernels->messagePassing(pData, pBuffer1, pScratch, pDMessage, size, pen1, pen2);
+}
+
 
-	for (int i = 0; i < size; i++)
+// In pyramid mode path costs of the previous pixel are moved to the disparity band of the current one,
+// shift = current - previous offset. Disparities the previous band did not cover cost as much as going
+// outside of the disparity range, so they are only reached through the large penalty.
+static void shiftPathCosts(short *pBuffer, int shift, int planes)
+{
+	if (shift == 0)
+		return;
+
+	int kept = planes - abs(shift);
+	if (kept <= 0)
 	{
-		short minval1 = __min(pBuffer1[__max(i - 1, 0)], pBuffer1[__min(i + 1, size - 1)]) + pen1;
-		short minval2 = __min(pBuffer1[i], pen2);
-		mem[i] = __min(minval1, minval2);
+		std::fill(pBuffer, pBuffer + planes, (short)SGM_BORDER_COST);
 	}
-
-	for (int i = 0; i < size; i++)
+	else if (shift > 0)
 	{
-		short val = mem[i] + pData[i];
-		if (val + pDMessage[i] >= limit)
-		{
-			pDMessage[i] = limit - 1;
-		}
-		else
-		{
-			pDMessage[i] += val;
-		}
-		pBuffer1[i] = val;
+		memmove(pBuffer, pBuffer + shift, kept * sizeof(short));
+		std::fill(pBuffer + kept, pBuffer + planes, (short)SGM_BORDER_COST);
+	}
+	else
+	{
+		memmove(pBuffer - shift, pBuffer, kept * sizeof(short));
+		std::fill(pBuffer, pBuffer - shift, (short)SGM_BORDER_COST);
 	}
-#endif
-
 }
 
 
-void SGMStereo::scanlineOptimization(DSI &dv, DSI &msgs, unsigned char* img, float *lut, int dx_, int dy_)
+// Paths in direction (dx, dy) and (-dx, -dy), dy > 0. Each path visits every dy-th row, where pixel x of
+// path s in row y = c + dy * q (c < dy) is x = s + dx * q. Bundles of adjacent paths are walked row by row,
+// so each step touches pixels next to each other in memory. Bundles are independent and run in parallel.
+void SGMStereo::scanlineOptimization(DSI8 &dv, DSI &msgs, unsigned char* img, float *lut, int dx_, int dy_)
 {
 	int cols = (int)dv.m_cols;
 	int rows = (int)dv.m_rows;
 	int planes = (int)dv.m_planes;
+	const int bundleSize = 16;
 
-	std::vector<float> startx;
-	std::vector<float> starty;
-	startx.reserve(2 * rows + 2 * cols);
-	starty.reserve(2 * rows + 2 * cols);
+	short smoothness = (short)(m_smoothness / sqrt((float)(dx_*dx_ + dy_*dy_)));
+	const short* offsets = m_bandOffset.empty() ? NULL : &m_bandOffset[0];
 
-	for (int ys = 0; ys < rows; ys++)
+	// bundles of all row classes c, paths s of class c are [sBegin, sEnd)
+	std::vector<int> bundleClass, bundleStart;
+	for (int c = 0; c < dy_; c++)
 	{
-		for (int xs = 0; xs < cols; xs++)
+		int steps = (rows - c + dy_ - 1) / dy_;
+		int sBegin = dx_ > 0 ? -dx_ * (steps - 1) : 0;
+		int sEnd = dx_ < 0 ? cols - dx_ * (steps - 1) : cols;
+		for (int s = sBegin; s < sEnd; s += bundleSize)
 		{
-			if ((xs == 0 && dx_ == 1) || (ys == 0 && dy_ == 1) || (ys == rows-1 && dy_ == -1) || (xs == cols-1 && dx_ == -1))
-			{
-				startx.push_back(float(xs));
-				starty.push_back(float(ys));
-			}
+			bundleClass.push_back(c);
+			bundleStart.push_back(s);
 		}
 	}
+	int bundles = (int)bundleClass.size();
 
-	short * buffervec = (short*)_aligned_malloc(planes * sizeof(short), 16);
-
-	float dist = sqrt((float)(dx_*dx_+dy_*dy_));
-
-	for (int j = 0; j < (int)startx.size(); j++)
+#pragma omp parallel if(!m_doSequential)
 	{
-		int x = (int)startx[j];
-		int y = (int)starty[j];
-		//uint64_t x64 = (uint64_t)x;
-		//uint64_t y64 = (uint64_t)y;
+		short * buffers = (short*)sgmAlignedMalloc(bundleSize * planes * sizeof(short), 16);
+		short * scratch = (short*)sgmAlignedMalloc(getSGMScratchSize(planes) * sizeof(short), 16);
+		int oldIntensity[bundleSize];
+		int oldOffset[bundleSize];
 
-		int dx = dx_;
-		int dy = dy_;
-		
-		for (int i = 0; i < planes; i++) 
-		{
-			buffervec[i] = 0;
-		}
-
-		short smoothness = (short)(m_smoothness / dist); 
-		bool forward = true;
+#pragma omp for schedule(dynamic,1)
 
-		int oldColor = 0;
-		do
+		for (int bundle = 0; bundle < bundles; bundle++)
 		{
-			int newIntensity = img[y*cols + x];
-			int diff = abs(newIntensity - oldColor);
-			oldColor = newIntensity;
-			float weight = lut[diff];
-				
-			messagePassing(dv(x,y), buffervec, msgs(x,y), planes, weight, smoothness);
-
-			y+=dy;
-			x+=dx;
+			int c = bundleClass[bundle];
+			int s0 = bundleStart[bundle];
+			int steps = (rows - c + dy_ - 1) / dy_;
 
-			if (forward && (y == rows || x == cols || y < 0))
+			for (int pass = 0; pass < 2; pass++)
 			{
-				dx*=-1;
-				dy*=-1;
-				y+=dy;
-				x+=dx;
-				for (int i = 0; i < planes; i++) 
-					buffervec[i] = 0;
-				forward = false;
+				// forward pass goes down, backward pass up
+				int dx = pass == 0 ? dx_ : -dx_;
+				int dy = pass == 0 ? dy_ : -dy_;
+
+				for (int step = 0; step < steps; step++)
+				{
+					int q = pass == 0 ? step : steps - 1 - step;
+					int y = c + dy_ * q;
+					// paths of the bundle which are inside the image in this row
+					int iBegin = std::max(0, -s0 - dx_ * q);
+					int iEnd = std::min(bundleSize, cols - s0 - dx_ * q);
+
+					for (int i = iBegin; i < iEnd; i++)
+					{
+						int x = s0 + i + dx_ * q;
+						short* buffer = buffers + i * planes;
+
+						// path starts where previous pixel is outside
+						int px = x - dx;
+						int py = y - dy;
+						if (px < 0 || px >= cols || py < 0 || py >= rows)
+						{
+							memset(buffer, 0, planes * sizeof(short));
+							oldIntensity[i] = 0;
+							oldOffset[i] = offsets != NULL ? offsets[y*cols + x] : 0;
+						}
+						if (offsets != NULL)
+						{
+							shiftPathCosts(buffer, offsets[y*cols + x] - oldOffset[i], planes);
+							oldOffset[i] = offsets[y*cols + x];
+						}
+
+						int newIntensity = img[y*cols + x];
+						int diff = abs(newIntensity - oldIntensity[i]);
+						oldIntensity[i] = newIntensity;
+						float weight = lut[diff];
+
+						messagePassing(dv(x, y), buffer, scratch, msgs(x, y), planes, weight, smoothness);
+					}
+				}
 			}
-		} 
-		while (forward || (y >= 0 && x >= 0 && y < rows && x < cols));
+		}
 
-		dx*=-1;
-		dy*=-1;
+		sgmAlignedFree(buffers);
+		sgmAlignedFree(scratch);
 	}
-
-	_aligned_free(buffervec);
 }
 
 
 
-void SGMStereo::scanlineOptimization_hor(DSI &dv, DSI &msgs, unsigned char *img, float *lut)
+// rows are independent and run in parallel, each one in both directions
+void SGMStereo::scanlineOptimization_hor(DSI8 &dv, DSI &msgs, unsigned char *img, float *lut)
 {
 	int cols = (int)dv.m_cols;
 	int rows = (int)dv.m_rows;
 	int planes = (int)dv.m_planes;
 	int bufsize = planes * sizeof(short);
-	short * buf = (short*)_aligned_malloc(bufsize, 16);
 	short smoothness = (short)(m_smoothness);
-	
+	const short* offsets = m_bandOffset.empty() ? NULL : &m_bandOffset[0];
+
+#pragma omp parallel if(!m_doSequential)
+	{
+		short * buf = (short*)sgmAlignedMalloc(bufsize, 16);
+		short * scratch = (short*)sgmAlignedMalloc(getSGMScratchSize(planes) * sizeof(short), 16);
+
+#pragma omp for schedule(dynamic,1)
+
+		for (int y = 0; y < rows; y++)
+		{
+			int offset = y * cols;
+			int oldIntensity = 0;
+			int oldOffset = offsets != NULL ? offsets[offset] : 0;
+			memset(buf, 0, bufsize);
+			for (int x = 0; x < cols; x++)
+			{
+				if (offsets != NULL)
+				{
+					shiftPathCosts(buf, offsets[offset + x] - oldOffset, planes);
+					oldOffset = offsets[offset + x];
+				}
+				int newIntensity = img[offset + x];
+				int diff = abs(newIntensity - oldIntensity);
+				oldIntensity = newIntensity;
+				float weight = lut[diff];
+				messagePassing(dv(x, y), buf, scratch, msgs(x, y), int(planes), weight, smoothness);
+			}
+			oldIntensity = 0;
+			oldOffset = offsets != NULL ? offsets[offset + cols - 1] : 0;
+			memset(buf, 0, bufsize);
+			for (int x = cols-1; x >= 0; x--)
+			{
+				if (offsets != NULL)
+				{
+					shiftPathCosts(buf, offsets[offset + x] - oldOffset, planes);
+					oldOffset = offsets[offset + x];
+				}
+				int newIntensity = img[offset + x];
+				int diff = abs(newIntensity - oldIntensity);
+				oldIntensity = newIntensity;
+				float weight = lut[diff];
+				messagePassing(dv(x, y), buf, scratch, msgs(x, y), planes, weight, smoothness);
+			}
+		}
+
+		sgmAlignedFree(buf);
+		sgmAlignedFree(scratch);
+	}
+}
+
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Low memory mode: a single pass down the image computes the costs of one row at a time and aggregates
+// them right away, so only paths coming from the left, the right or from rows above can be followed:
+// horizontal paths both ways and the downward half of the other directions. Results differ from the
+// full mode. Memory is a few rows of costs and path costs instead of cost and message volumes. Runs on
+// the calling thread, meant for several instances running side by side.
+void SGMStereo::runLowMemory(unsigned char * iLeft, unsigned char * iRight, float* dispMap, unsigned char* confMap)
+{
+	typedef std::chrono::steady_clock Clock;
+	int cols = m_w;
+	int rows = m_h;
+	int planes = m_maxDisparity - m_minDisparity;
+	int r = m_windowSize / 2;
+	size_t rowSize = (size_t)cols * planes;
+	short smoothness = (short)(m_smoothness);
+	const unsigned char* pCost = &m_costRow[0];
+	short* pMsg = &m_messageRow[0];
+	short* buf = &m_pathBuffer[0];
+	short* scratch = &m_scratch[0];
+
+	m_windowSums.row = -1;
 	for (int y = 0; y < rows; y++)
 	{
-		int offset = y * cols;
+		// disparities which are not written keep the invalid cost of the border rows
+		Clock::time_point start = Clock::now();
+		if (y >= r && y < rows - r)
+		{
+			moveWindow(iLeft, iRight, y, m_windowSums);
+			calculateCostRow(m_windowSums, NULL, &m_costRow[0]);
+		}
+		else
+		{
+			std::fill(m_costRow.begin(), m_costRow.end(), (unsigned char)255);
+		}
+		m_timings.dsi += secondsSince(start);
+
+		start = Clock::now();
+		const unsigned char* img = iLeft + (size_t)y * cols;
+		memset(pMsg, 0, rowSize * sizeof(short));
 		int oldIntensity = 0;
-		memset(buf, 0, bufsize);
+		memset(buf, 0, planes * sizeof(short));
 		for (int x = 0; x < cols; x++)
 		{
-			int newIntensity = img[offset + x];
-			int diff = abs(newIntensity - oldIntensity);
-			oldIntensity = newIntensity;
-			float weight = lut[diff];
-			messagePassing(dv(x, y), buf, msgs(x, y), int(planes), weight, smoothness);
+			int diff = abs(img[x] - oldIntensity);
+			oldIntensity = img[x];
+			messagePassing(pCost + (size_t)x * planes, buf, scratch, pMsg + (size_t)x * planes, planes, wLUT[diff], smoothness);
 		}
 		oldIntensity = 0;
-		memset(buf, 0, bufsize);
-		for (int x = cols-1; x >= 0; x--)
+		memset(buf, 0, planes * sizeof(short));
+		for (int x = cols - 1; x >= 0; x--)
 		{
-			int newIntensity = img[offset + x];
-			int diff = abs(newIntensity - oldIntensity);
-			oldIntensity = newIntensity;
-			float weight = lut[diff];
-			messagePassing(dv(x, y), buf, msgs(x, y), planes, weight, smoothness);
+			int diff = abs(img[x] - oldIntensity);
+			oldIntensity = img[x];
+			messagePassing(pCost + (size_t)x * planes, buf, scratch, pMsg + (size_t)x * planes, planes, wLUT[diff], smoothness);
 		}
+		m_timings.aggregationHor += secondsSince(start);
+
+		for (size_t i = 0; i < m_pathRows.size(); i++)
+		{
+			start = Clock::now();
+			SGMPathRows& path = m_pathRows[i];
+			short pathSmoothness = (short)(m_smoothness / sqrt((float)(path.dx*path.dx + path.dy*path.dy)));
+			// (y - dy) % (dy + 1) without going negative
+			short* pCur = &path.rows[(size_t)(y % (path.dy + 1)) * rowSize];
+			const short* pPrev = &path.rows[(size_t)((y + 1) % (path.dy + 1)) * rowSize];
+			int py = y - path.dy;
+
+			for (int x = 0; x < cols; x++)
+			{
+				short* pBuffer = pCur + (size_t)x * planes;
+				int px = x - path.dx;
+				int previousIntensity = 0;
+				if (py >= 0 && px >= 0 && px < cols)
+				{
+					memcpy(pBuffer, pPrev + (size_t)px * planes, planes * sizeof(short));
+					previousIntensity = iLeft[(size_t)py * cols + px];
+				}
+				else
+				{
+					// path starts here
+					memset(pBuffer, 0, planes * sizeof(short));
+				}
+				int diff = abs(img[x] - previousIntensity);
+				messagePassing(pCost + (size_t)x * planes, pBuffer, scratch, pMsg + (size_t)x * planes, planes, wLUT[diff], pathSmoothness);
+			}
+
+			if (i == 0)
+				m_timings.aggregationVert += secondsSince(start);
+			else
+				m_timings.aggregationDiag += secondsSince(start);
+		}
+
+		start = Clock::now();
+		float* pDisp = dispMap + (size_t)y * cols;
+		unsigned char* pConf = confMap + (size_t)y * cols;
+		if (y == 0 || y == rows - 1)
+			DSI::clearDispRow(cols, pDisp, pConf);
+		else
+			DSI::getDispRow(pMsg, cols, planes, m_sgmConfidenceThreshold, m_doSubPixRefinement, false, pDisp, pConf);
+		m_timings.disparity += secondsSince(start);
 	}
-	_aligned_free(buf);
 }
 
-void SGMStereo::scanlineOptimization_vert(DSI &dv, DSI &msgs, unsigned char *img, float *lut)
+
+// Coarse to fine: the next coarser level runs on the images at half resolution (itself in pyramid mode if
+// there are more levels) and its disparities restrict the search at this level to a band of m_bandPlanes
+// disparities per pixel, so costs, messages and aggregation shrink to the band.
+void SGMStereo::runCoarse(unsigned char * iLeft, unsigned char * iRight)
 {
-	int cols = (int)dv.m_cols;
-	int rows = (int)dv.m_rows;
-	int planes = (int)dv.m_planes;
-	int bufsize = planes * sizeof(short);
-	short * buf = (short*)_aligned_malloc(bufsize, 16);
-	short smoothness = (short)(m_smoothness);
-	for (int x = 0; x < cols; x++)
+	int cols = m_w;
+	int coarseCols = m_w / 2;
+	int coarseRows = m_h / 2;
+
+#pragma omp parallel for schedule(static)
+
+	for (int yc = 0; yc < coarseRows; yc++)
 	{
-		int offset = x;
-		int oldIntensity = 0;
-		memset(buf, 0, bufsize);
-		for (int y = 0; y < rows; y++)
+		const unsigned char* pL = iLeft + (size_t)(2 * yc) * cols;
+		const unsigned char* pR = iRight + (size_t)(2 * yc) * cols;
+		unsigned char* pCoarseL = &m_coarseLeft[(size_t)yc * coarseCols];
+		unsigned char* pCoarseR = &m_coarseRight[(size_t)yc * coarseCols];
+		for (int xc = 0; xc < coarseCols; xc++)
 		{
-			int newIntensity = img[offset];
-			int diff = abs(newIntensity - oldIntensity);
-			oldIntensity = newIntensity;
-			float weight = lut[diff];
-			messagePassing(dv(x, y), buf, msgs(x, y), planes, weight, smoothness);
-			offset += cols;
+			int x = 2 * xc;
+			pCoarseL[xc] = (unsigned char)((pL[x] + pL[x + 1] + pL[cols + x] + pL[cols + x + 1] + 2) / 4);
+			pCoarseR[xc] = (unsigned char)((pR[x] + pR[x + 1] + pR[cols + x] + pR[cols + x + 1] + 2) / 4);
 		}
+	}
 
-		offset = cols * (rows - 1) + x;
-		oldIntensity = 0;
-		memset(buf, 0, bufsize);
-		for (int y = rows - 1; y > 0; y--)
+	m_coarse->Run(&m_coarseLeft[0], &m_coarseRight[0], &m_coarseDisp[0], &m_coarseConf[0]);
+	calculateBandOffsets(&m_coarseDisp[0], coarseCols, coarseRows, 2, m_coarse->m_maxDisparity);
+}
+
+
+// Bands from a guide disparity map of guideCols x guideRows pixels, each one covering scale x scale pixels of
+// this level, with disparities in the convention of getDispRow for a maximum disparity of guideMax. A guide
+// pixel without disparity takes the range between the nearest valid ones left and right of it in its row, or
+// the whole range if there are none. The band of a pixel then covers the range of the 3x3 guide pixels around
+// it plus a margin. At depth edges, where that does not fit in the band, it is centered on the guide pixel.
+void SGMStereo::calculateBandOffsets(const float *pGuide, int guideCols, int guideRows, int scale, int guideMax)
+{
+	int cols = m_w;
+	int rows = m_h;
+	int planes = m_maxDisparity - m_minDisparity;
+	const int margin = 2;
+
+#pragma omp parallel for schedule(static)
+
+	for (int yg = 0; yg < guideRows; yg++)
+	{
+		const float* pDisp = pGuide + (size_t)yg * guideCols;
+		short* pLow = &m_guideLow[(size_t)yg * guideCols];
+		short* pHigh = &m_guideHigh[(size_t)yg * guideCols];
+
+		// d + guideMax is the disparity at the guide's resolution, scale times that the one at this level.
+		// Nearest valid plane to the left, then merged with the nearest one to the right, no valid pixel
+		// on a side is the empty range [SHRT_MAX, -1]. Written without branches on validity, which can
+		// change from pixel to pixel.
+		short lastLow = SHRT_MAX, lastHigh = -1;
+		for (int xg = 0; xg < guideCols; xg++)
+		{
+			bool valid = pDisp[xg] < FLT_MAX;
+			// truncating is rounding for all planes inside the range, the others are clamped
+			int plane = (int)(scale * ((valid ? pDisp[xg] : 0.0f) + guideMax) - m_minDisparity + 0.5f);
+			plane = std::min(std::max(plane, 0), planes - 1);
+			lastLow = valid ? (short)plane : lastLow;
+			lastHigh = valid ? (short)plane : lastHigh;
+			pLow[xg] = lastLow;
+			pHigh[xg] = lastHigh;
+		}
+		lastLow = SHRT_MAX, lastHigh = -1;
+		for (int xg = guideCols - 1; xg >= 0; xg--)
+		{
+			bool valid = pDisp[xg] < FLT_MAX;
+			lastLow = valid ? pLow[xg] : lastLow;
+			lastHigh = valid ? pHigh[xg] : lastHigh;
+			short low = std::min(pLow[xg], lastLow);
+			short high = std::max(pHigh[xg], lastHigh);
+			bool none = low > high;
+			pLow[xg] = none ? (short)0 : low;
+			pHigh[xg] = none ? (short)(planes - 1) : high;
+		}
+
+		// range of the pixel itself for the edges, then min and max over 3 pixels of the row in place,
+		// the other rows are taken in below
+		short* pCenter = &m_guideCenter[(size_t)yg * guideCols];
+		short prevLow = pLow[0], prevHigh = pHigh[0];
+		for (int xg = 0; xg < guideCols; xg++)
 		{
-			int newIntensity = img[offset];
-			int diff = abs(newIntensity - oldIntensity);
-			oldIntensity = newIntensity;
-			float weight = lut[diff];
-			messagePassing(dv(x, y), buf, msgs(x, y), planes, weight, smoothness);
-			offset -= cols;
+			short low = pLow[xg], high = pHigh[xg];
+			pCenter[xg] = (short)((low + high + 1) / 2);
+			int next = std::min(xg + 1, guideCols - 1);
+			pLow[xg] = std::min(std::min(prevLow, low), pLow[next]);
+			pHigh[xg] = std::max(std::max(prevHigh, high), pHigh[next]);
+			prevLow = low;
+			prevHigh = high;
 		}
 	}
-	_aligned_free(buf);
+
+#pragma omp parallel for schedule(static)
+
+	for (int yg = 0; yg < guideRows; yg++)
+	{
+		const short* pLow[3] = { &m_guideLow[(size_t)std::max(yg - 1, 0) * guideCols], &m_guideLow[(size_t)yg * guideCols],
+			&m_guideLow[(size_t)std::min(yg + 1, guideRows - 1) * guideCols] };
+		const short* pHigh[3] = { &m_guideHigh[(size_t)std::max(yg - 1, 0) * guideCols], &m_guideHigh[(size_t)yg * guideCols],
+			&m_guideHigh[(size_t)std::min(yg + 1, guideRows - 1) * guideCols] };
+		const short* pCenter = &m_guideCenter[(size_t)yg * guideCols];
+		// the last guide row and column also cover rows and columns left over at this level
+		int fineRowEnd = yg == guideRows - 1 ? rows : scale * (yg + 1);
+
+		for (int xg = 0; xg < guideCols; xg++)
+		{
+			int low = std::min(std::min(pLow[0][xg], pLow[1][xg]), pLow[2][xg]) - margin;
+			int high = std::max(std::max(pHigh[0][xg], pHigh[1][xg]), pHigh[2][xg]) + margin;
+			int center = high - low + 1 <= m_bandPlanes ? (low + high + 1) / 2 : pCenter[xg];
+			short offset = (short)std::min(std::max(center - m_bandPlanes / 2, 0), planes - m_bandPlanes);
+
+			int fineColEnd = xg == guideCols - 1 ? cols : scale * (xg + 1);
+			for (int y = scale * yg; y < fineRowEnd; y++)
+				for (int x = scale * xg; x < fineColEnd; x++)
+					m_bandOffset[(size_t)y * cols + x] = offset;
+		}
+	}
+}
+
+
+// Temporal prior: bands come from the disparities of the previous frame moved to the current one instead
+// of a coarser level, as long as enough pixels have one. Otherwise the coarser level is run as usual.
+bool SGMStereo::usePrior(const float *pPrior)
+{
+	int pixels = m_w * m_h;
+	int valid = 0;
+	for (int i = 0; i < pixels; i++)
+		valid += pPrior[i] < FLT_MAX;
+	if (valid < m_minPriorCoverage * pixels)
+		return false;
+
+	calculateBandOffsets(pPrior, m_w, m_h, 1, m_maxDisparity);
+	return true;
+}
+
+
+size_t SGMStereo::getMemorySize() const
+{
+	size_t bytes = (size_t)(m_dsi.size() + messages.size());
+
+	const NCCWindowSums& sums = m_windowSums;
+	bytes += sizeof(int) * (sums.colL.size() + sums.colLL.size() + sums.colR.size() + sums.colRR.size() + sums.colLR.size()
+		+ sums.sumR.size() + sums.sumRR.size() + sums.sumLR.size());
+	bytes += m_costRow.size() + sizeof(short) * (m_messageRow.size() + m_pathBuffer.size() + m_scratch.size());
+	for (size_t i = 0; i < m_pathRows.size(); i++)
+		bytes += sizeof(short) * m_pathRows[i].rows.size();
+
+	if (m_coarse != NULL)
+	{
+		bytes += m_coarse->getMemorySize();
+		bytes += m_coarseLeft.size() + m_coarseRight.size() + m_coarseConf.size() + sizeof(float) * m_coarseDisp.size();
+		bytes += sizeof(short) * (m_guideLow.size() + m_guideHigh.size() + m_guideCenter.size() + m_bandOffset.size());
+	}
+
+	return bytes;
 }
 
 
@@ -462,53 +776,102 @@ void SGMStereo::Run(
 	unsigned char * iLeft,
 	unsigned char * iRight,
 	float* dispMap, 
-	unsigned char* confMap)
+	unsigned char* confMap,
+	const float* priorDisp)
 {
-	calculateDSI_sse(iLeft, iRight);
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point runStart = Clock::now();
+	memset(&m_timings, 0, sizeof(m_timings));
+	m_priorUsed = false;
 
-	if (m_doSequential)
+	if (m_lowMemory)
 	{
-		messages.setzero();
-		scanlineOptimization_hor(m_dsi, messages, iLeft, wLUT);
-		scanlineOptimization_vert(m_dsi, messages, iLeft, wLUT);
-		if (m_numDirections == 8)
+		runLowMemory(iLeft, iRight, dispMap, confMap);
+		m_timings.total = secondsSince(runStart);
+		return;
+	}
+
+	Clock::time_point start;
+	if (m_coarse != NULL)
+	{
+		start = Clock::now();
+		m_priorUsed = priorDisp != NULL && usePrior(priorDisp);
+		if (!m_priorUsed)
+			runCoarse(iLeft, iRight);
+		m_timings.coarse = secondsSince(start);
+	}
+
+	start = Clock::now();
+	calculateDSI(iLeft, iRight);
+	m_timings.dsi = secondsSince(start);
+
+	// all directions add up in one volume, each direction runs in parallel over its paths
+	messages.setzero();
+	start = Clock::now();
+	scanlineOptimization_hor(m_dsi, messages, iLeft, wLUT);
+	m_timings.aggregationHor = secondsSince(start);
+	start = Clock::now();
+	scanlineOptimization(m_dsi, messages, iLeft, wLUT, 0, 1);
+	m_timings.aggregationVert = secondsSince(start);
+	if (m_numDirections >= 8)
+	{
+		start = Clock::now();
+		scanlineOptimization(m_dsi, messages, iLeft, wLUT, 1, 1);
+		scanlineOptimization(m_dsi, messages, iLeft, wLUT, -1, 1);
+		if (m_numDirections == 16)
 		{
-			scanlineOptimization(m_dsi, messages, iLeft, wLUT, 1, 1);
-			scanlineOptimization(m_dsi, messages, iLeft, wLUT, 1, -1);
+			scanlineOptimization(m_dsi, messages, iLeft, wLUT, 2, 1);
+			scanlineOptimization(m_dsi, messages, iLeft, wLUT, -2, 1);
+			scanlineOptimization(m_dsi, messages, iLeft, wLUT, 1, 2);
+			scanlineOptimization(m_dsi, messages, iLeft, wLUT, -1, 2);
 		}
-		messages.getDispMap(m_sgmConfidenceThreshold, m_doSubPixRefinement, dispMap, confMap);
+		m_timings.aggregationDiag = secondsSince(start);
 	}
-	else
+	start = Clock::now();
+	messages.getDispMap(m_sgmConfidenceThreshold, m_doSubPixRefinement, dispMap, confMap);
+	if (m_coarse != NULL)
 	{
-		messages_hor.setzero();
-		messages_ver.setzero();
-		
-#pragma omp parallel for
-		for (int k = 0; k < 2; k++)
+		// disparities were found within the bands
+		int shift = m_bandPlanes - (m_maxDisparity - m_minDisparity);
+		int pixels = m_w * m_h;
+		for (int i = 0; i < pixels; i++)
 		{
-			if (k==0)
-				scanlineOptimization_hor(m_dsi, messages_hor, iLeft, wLUT);
-			if (k==1)
-				scanlineOptimization_vert(m_dsi, messages_ver, iLeft, wLUT);
+			if (dispMap[i] < FLT_MAX)
+				dispMap[i] += m_bandOffset[i] + shift;
 		}
-		getDispMap2(messages_hor, messages_ver, m_sgmConfidenceThreshold, dispMap, confMap);
 	}
+	m_timings.disparity = secondsSince(start);
+
+	m_timings.total = secondsSince(runStart);
 }
 
 
 void SGMStereo::free()
 {
 	m_dsi.free();
-	
-	if (m_doSequential)
-	{
-		messages.free();
-	}
-	else
+	messages.free();
+
+	m_windowSums = NCCWindowSums();
+	std::vector<unsigned char>().swap(m_costRow);
+	std::vector<short>().swap(m_messageRow);
+	std::vector<short>().swap(m_pathBuffer);
+	std::vector<short>().swap(m_scratch);
+	std::vector<SGMPathRows>().swap(m_pathRows);
+
+	if (m_coarse != NULL)
 	{
-		messages_hor.free();
-		messages_ver.free();
+		m_coarse->free();
+		delete m_coarse;
+		m_coarse = NULL;
 	}
+	std::vector<unsigned char>().swap(m_coarseLeft);
+	std::vector<unsigned char>().swap(m_coarseRight);
+	std::vector<unsigned char>().swap(m_coarseConf);
+	std::vector<float>().swap(m_coarseDisp);
+	std::vector<short>().swap(m_guideLow);
+	std::vector<short>().swap(m_guideHigh);
+	std::vector<short>().swap(m_guideCenter);
+	std::vector<short>().swap(m_bandOffset);
 
 	delete[] wLUT;
 }
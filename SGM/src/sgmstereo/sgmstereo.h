@@ -6,20 +6,76 @@
 #ifndef sgm_stereo_h
 #define sgm_stereo_h
 
+#include <vector>
+
 #include "dsimage.h"
+#include "sgmkernels.h"
+
+// wall clock time in seconds spent in each stage of the last SGMStereo::Run
+struct SGMTimings
+{
+	double coarse;				// coarser pyramid levels or temporal prior and disparity bands, only in pyramid mode
+	double dsi;
+	double aggregationHor;
+	double aggregationVert;
+	double aggregationDiag;		// all other directions, only with 8 or 16 directions
+	double disparity;
+	double total;
+};
+
+// running column and window sums of the incremental NCC cost computation
+struct NCCWindowSums
+{
+	int row;								// center row of the window, -1 before the first one
+	std::vector<int> colL, colLL, colR, colRR;	// per column: left and right pixels and their squares
+	std::vector<int> colLR;					// per column and disparity: products of left and right pixels
+	std::vector<int> sumR, sumRR, sumLR;	// window sums of current row: right pixels and squares, products of current pixel
+};
+
+// path costs of one direction in low memory mode, row y of the last dy + 1 rows is at y % (dy + 1)
+struct SGMPathRows
+{
+	int dx, dy;
+	std::vector<short> rows;
+};
 
 class SGMStereo
 {
 private:
-	void calculateDSI_sse(unsigned char *refImage, unsigned char * nbrImage);
-	void messagePassing(short *pData, short *pBuffer1, short *pDMessage, int size, float weight, short smoothness);
-	void scanlineOptimization(DSI &dv, DSI &messages, unsigned char * img, float *lut, int dx_, int dy_);
-	void scanlineOptimization_hor(DSI &dv, DSI &messages, unsigned char *img, float *lut);
-	void scanlineOptimization_vert(DSI &dv, DSI &messages, unsigned char *img, float *lut);
+	void calculateDSI(unsigned char *refImage, unsigned char * nbrImage);
+	void calculateDSIBand(const unsigned char *L, const unsigned char *R, int yBegin, int yEnd);
+	void createWindowSums(NCCWindowSums& sums);
+	void moveWindow(const unsigned char *L, const unsigned char *R, int y, NCCWindowSums& sums);
+	void addWindowRow(const unsigned char *L, const unsigned char *R, int y, int weight, NCCWindowSums& sums);
+	void calculateCostRow(NCCWindowSums& sums, const short *pOffsets, unsigned char *pRow);
+	void messagePassing(const unsigned char *pData, short *pBuffer1, short *pScratch, short *pDMessage, int size, float weight, short smoothness);
+	void scanlineOptimization(DSI8 &dv, DSI &messages, unsigned char * img, float *lut, int dx_, int dy_);
+	void scanlineOptimization_hor(DSI8 &dv, DSI &messages, unsigned char *img, float *lut);
+	void runLowMemory(unsigned char * iLeft, unsigned char * iRight, float* dispMap, unsigned char* confMap);
+	void runCoarse(unsigned char * iLeft, unsigned char * iRight);
+	void calculateBandOffsets(const float *pGuide, int guideCols, int guideRows, int scale, int guideMax);
+	bool usePrior(const float *pPrior);
 
-	DSI m_dsi, messages;
+	DSI8 m_dsi;
+	DSI messages;
 
-	DSI messages_hor, messages_ver;
+	// low memory mode keeps rows instead of m_dsi and messages
+	NCCWindowSums m_windowSums;
+	std::vector<unsigned char> m_costRow;
+	std::vector<short> m_messageRow;
+	std::vector<short> m_pathBuffer;
+	std::vector<short> m_scratch;
+	std::vector<SGMPathRows> m_pathRows;
+
+	// pyramid mode: disparities of the next coarser level or a temporal prior narrow the search of each
+	// pixel down to m_bandPlanes planes starting at m_bandOffset, m_dsi and messages only hold those
+	SGMStereo * m_coarse;
+	std::vector<unsigned char> m_coarseLeft, m_coarseRight, m_coarseConf;
+	std::vector<float> m_coarseDisp;
+	std::vector<short> m_guideLow, m_guideHigh, m_guideCenter;
+	std::vector<short> m_bandOffset;
+	float m_minPriorCoverage;	// share of pixels with a prior below which the coarser level is run instead
+	bool m_priorUsed;
 
 	float * wLUT;
 
@@ -34,7 +90,14 @@ private:
 	int		m_numDirections;
 	int		m_sgmConfidenceThreshold;
 	int     m_doSubPixRefinement;
-	int     m_doSequential;
+	int     m_doSequential;		// aggregate on one thread
+	int		m_windowSize;	// odd size of NCC matching window
+	int		m_lowMemory;	// single pass over rows with small buffers, see runLowMemory
+	int		m_pyramidLevels;	// coarser levels at half resolution each, 0 searches all disparities
+	int		m_bandPlanes;	// disparities searched per pixel in pyramid mode
+
+	const SGMKernels* m_kernels;
+	SGMTimings m_timings;
 	
 public:
 	SGMStereo(int _w, int _h, int minDisparity, int maxDisparity, int numDirections, int sgmConfidenceThreshold, int doSubPixRefinement,
@@ -42,10 +105,24 @@ public:
 		float penalty1,
 		float penalty2,
 		float alpha,
-		int doSequential);
+		int doSequential,
+		int windowSize = 3,
+		int lowMemory = 0,
+		int pyramidLevels = 0,
+		int bandPlanes = 16);
 
-	void Run(unsigned char * iLeft, unsigned char * iRight, float* dispMap, unsigned char* confMap);
+	// priorDisp, if given, is a disparity map expected for this frame, e.g. the previous one moved by the
+	// camera motion, with FLT_MAX where unknown. In pyramid mode it replaces the coarser levels when it
+	// covers enough of the image, otherwise it is ignored.
+	void Run(unsigned char * iLeft, unsigned char * iRight, float* dispMap, unsigned char* confMap, const float* priorDisp = NULL);
 
 	void free();
+
+	const char* getKernelsName() const { return m_kernels->name; }
+	const SGMTimings& getTimings() const { return m_timings; }
+	// whether the last Run took its disparity bands from the prior
+	bool getPriorUsed() const { return m_priorUsed; }
+	// bytes allocated for costs, messages and buffers
+	size_t getMemorySize() const;
 };
 #endif
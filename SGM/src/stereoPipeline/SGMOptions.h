@@ -18,8 +18,8 @@ struct SGMOptions
 	int maxImageDimensionWidth;
     int minDisparity;
     int maxDisparity;
-	int numDirections;				// 4 or 8
-	int doSequential;               // do sequential message passing (or horizontal and vertical in parallel).
+	int numDirections;				// 4, 8 or 16
+	int doSequential;               // do message passing on one thread (or paths of each direction in parallel).
 	int doVis;						// if 1, then output visualization.
 	int doOut;						// if 1, then write output
 	float smoothness;
@@ -27,6 +27,10 @@ struct SGMOptions
 	float penalty2;
 	float alpha;
 	int doSubPixRefinement;
+	int windowSize;					// odd size of NCC matching window, 3 to 11
+	int lowMemory;					// if 1, single pass with row buffers instead of cost and message volumes (downward paths only)
+	int pyramidLevels;				// coarse to fine: levels at half resolution each narrowing the disparity search, 0 to 3
+	int pyramidBand;				// disparities searched per pixel below the coarsest level
 
 	SGMOptions()
     {
@@ -46,25 +50,33 @@ struct SGMOptions
 		alpha = 10.0;
 		onlyStereo = 0;
 		doSubPixRefinement = 1;
+		windowSize = 3;
+		lowMemory = 0;
+		pyramidLevels = 0;
+		pyramidBand = 16;
 	}
 
     void Print()
     {
 		printf("\n\n****************** Parameter List *********************\n");
-		wprintf(L"   sgmConfidenceThreshold = %d\n", sgmConfidenceThreshold);
-		wprintf(L"   maxImageDimensionWidth = %d\n", maxImageDimensionWidth);
-		wprintf(L"   minDisparity = %d\n", minDisparity);
-        wprintf(L"   maxDisparity = %d\n", maxDisparity);
-		wprintf(L"   numDirections = %d\n", numDirections);
-		wprintf(L"   smoothness = %f\n", smoothness);
-		wprintf(L"   penalty1 = %f\n", penalty1);
-		wprintf(L"   penalty2 = %f\n", penalty2);
-		wprintf(L"   alpha = %f\n", alpha);
-		wprintf(L"   doSequential = %d\n", doSequential);
-		wprintf(L"   doVis = %d\n", doVis);
-		wprintf(L"   doOut = %d\n", doOut);
-		wprintf(L"   onlyStereo = %d\n", onlyStereo);
-		wprintf(L"   doSubPixRefinement = %d\n", doSubPixRefinement);
+		printf("   sgmConfidenceThreshold = %d\n", sgmConfidenceThreshold);
+		printf("   maxImageDimensionWidth = %d\n", maxImageDimensionWidth);
+		printf("   minDisparity = %d\n", minDisparity);
+        printf("   maxDisparity = %d\n", maxDisparity);
+		printf("   numDirections = %d\n", numDirections);
+		printf("   smoothness = %f\n", smoothness);
+		printf("   penalty1 = %f\n", penalty1);
+		printf("   penalty2 = %f\n", penalty2);
+		printf("   alpha = %f\n", alpha);
+		printf("   doSequential = %d\n", doSequential);
+		printf("   doVis = %d\n", doVis);
+		printf("   doOut = %d\n", doOut);
+		printf("   onlyStereo = %d\n", onlyStereo);
+		printf("   doSubPixRefinement = %d\n", doSubPixRefinement);
+		printf("   windowSize = %d\n", windowSize);
+		printf("   lowMemory = %d\n", lowMemory);
+		printf("   pyramidLevels = %d\n", pyramidLevels);
+		printf("   pyramidBand = %d\n", pyramidBand);
 		printf("*********************************************************\n\n\n");
     }
 
@@ -5,15 +5,55 @@
 
 #include "StateStereo.h"
 #include "sgmstereo.h"
+#include "sgmkernels.h"
 #include <stdio.h>      /* printf */
-#include <ctime>       /* clock_t, clock, CLOCKS_PER_SEC */
+#include <chrono>
+#include <algorithm>
+
+void StereoFrameQueue::Reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	frames.clear();
+	closed = false;
+}
+
+void StereoFrameQueue::Push(StereoFrame* frame)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		frames.push_back(frame);
+	}
+	available.notify_one();
+}
+
+StereoFrame* StereoFrameQueue::Pop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	available.wait(lock, [this] { return !frames.empty() || closed; });
+	if (frames.empty())
+		return NULL;
+	StereoFrame* frame = frames.front();
+	frames.pop_front();
+	return frame;
+}
+
+void StereoFrameQueue::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+	}
+	available.notify_all();
+}
 
 CStateStereo::CStateStereo()
+	: sgmStereo(NULL), focalLength(0), baseline(0), hasPrevious(false), framesSincePrior(0), pipelineRunning(false), dispMap(NULL), confMap(NULL)
 {
 }
 
 CStateStereo::~CStateStereo()
 {
+	StopPipeline();
 }
 
 void CStateStereo::Initialize(SGMOptions& params, int m, int n)
@@ -60,54 +100,295 @@ void CStateStereo::Initialize(SGMOptions& params, int m, int n)
 		params.penalty1,
 		params.penalty2,
 		params.alpha,
-		params.doSequential);
+		params.doSequential,
+		params.windowSize,
+		params.lowMemory,
+		params.pyramidLevels,
+		params.pyramidBand);
+
+	printf("sgm kernels: %s\n", sgmStereo->getKernelsName());
+
+	grayL.resize(processingFrameWidth * processingFrameHeight);
+	grayR.resize(processingFrameWidth * processingFrameHeight);
+	previousDisp.resize(processingFrameWidth * processingFrameHeight);
+	priorDisp.resize(processingFrameWidth * processingFrameHeight);
+	hasPrevious = false;
+	ResetStats();
 }
 
 void CStateStereo::CleanUp()
 {
+	StopPipeline();
 	if (sgmStereo != NULL)
 	{
 		sgmStereo->free();
 	}
 }
 
-void CStateStereo::ProcessFrameAirSim(int frameCounter, float& dtime, const std::vector<uint8_t>& left_image, const std::vector<uint8_t>& right_image)
+bool CStateStereo::ConvertFrame(const std::vector<uint8_t>& left_image, const std::vector<uint8_t>& right_image,
+	unsigned char* iL, unsigned char* iR)
 {
-	unsigned char *iL, *iR;
-
-	// sgm stereo
 	if (processingFrameWidth != inputFrameWidth || processingFrameHeight != inputFrameHeight)
 	{
 		printf("[ERROR]: Frame resolution = (%d x %d) is not equal to initialization ...\n", processingFrameWidth, processingFrameHeight);
 	}
 
 	int nP = processingFrameWidth * processingFrameHeight;
-	iL = new unsigned char[nP];
-	iR = new unsigned char[nP];
+	int channels = (int)left_image.size() / nP;
+	if (channels < 3 || left_image.size() != right_image.size() || left_image.size() < (size_t)channels * nP)
+	{
+		printf("[ERROR]: expected RGB or RGBA images of %d x %d\n", processingFrameWidth, processingFrameHeight);
+		return false;
+	}
 
-    int channels = (int)left_image.size()/nP;
+	const SGMKernels& kernels = getSGMKernels();
+	kernels.toGray(left_image.data(), channels, nP, iL);
+	kernels.toGray(right_image.data(), channels, nP, iR);
+	return true;
+}
 
-	for (int i = 0; i < nP; i++)
+// Moves disparities (in the convention of SGMStereo, minDisparity - disparity) of the previous left image
+// to the current one: pixels are lifted to 3D with their depth, transformed by motion and projected again.
+// Pixels coming closer cover up to 3x3 pixels so that moving forward does not leave cracks. Where several
+// land on the same pixel the nearest one wins, pixels nothing lands on are FLT_MAX.
+static void warpDisparity(const float* src, int width, int height, float f, float B, int minDisparity, int maxDisparity,
+	const float* motion, float* dst)
+{
+	int pixels = width * height;
+	std::fill(dst, dst + pixels, FLT_MAX);
+	float cx = 0.5f * width;
+	float cy = 0.5f * height;
+	const float* m = motion;
+
+	for (int y = 0; y < height; y++)
 	{
-        {
-            int idx = channels*i;
-			iL[i] = (left_image[idx] + left_image[idx+1] + left_image[idx+2]) / 3;
-			iR[i] = (right_image[idx] + right_image[idx+1] + right_image[idx+2]) / 3;
+		for (int x = 0; x < width; x++)
+		{
+			float d = minDisparity - src[y * width + x];
+			if (src[y * width + x] >= FLT_MAX || d <= 0)
+				continue;
+
+			float Z = f * B / d;
+			float X = (x - cx) * Z / f;
+			float Y = (y - cy) * Z / f;
+			float X1 = m[0] * X + m[1] * Y + m[2] * Z + m[3];
+			float Y1 = m[4] * X + m[5] * Y + m[6] * Z + m[7];
+			float Z1 = m[8] * X + m[9] * Y + m[10] * Z + m[11];
+			if (Z1 <= 0)
+				continue;
+
+			float d1 = f * B / Z1;
+			if (d1 >= maxDisparity)
+				continue;
+			float value = minDisparity - d1;
+
+			int size = std::min((int)(Z / Z1 + 0.99f), 3);
+			int x1 = (int)floorf(f * X1 / Z1 + cx + 0.5f);
+			int y1 = (int)floorf(f * Y1 / Z1 + cy + 0.5f);
+			int xEnd = std::min(x1 + size, width);
+			int yEnd = std::min(y1 + size, height);
+			for (int v = std::max(y1, 0); v < yEnd; v++)
+			{
+				for (int u = std::max(x1, 0); u < xEnd; u++)
+				{
+					float& target = dst[v * width + u];
+					if (target >= FLT_MAX || value < target)
+						target = value;
+				}
+			}
 		}
 	}
+}
 
-    std::clock_t start;
-    start = std::clock();
+void CStateStereo::ProcessFrame(int frameCounter, float& dtime, const std::vector<uint8_t>& left_image, const std::vector<uint8_t>& right_image,
+	const float* motion)
+{
+	StereoFrame frame;
+	frame.frameId = frameCounter;
+	frame.submitted = std::chrono::steady_clock::now();
+	if (!ConvertFrame(left_image, right_image, grayL.data(), grayR.data()))
+		return;
 
-	sgmStereo->Run(iL, iR, dispMap, confMap);
-    float duration = ( std::clock() - start ) / (float) CLOCKS_PER_SEC;
-	dtime += duration;
+	// wall clock, cpu time of all OpenMP threads would overstate the frame time
+	frame.converted = std::chrono::steady_clock::now();
+	const float* prior = NULL;
+	if (motion != NULL && hasPrevious)
+	{
+		warpDisparity(previousDisp.data(), processingFrameWidth, processingFrameHeight, focalLength, baseline, minDisp, maxDisp,
+			motion, priorDisp.data());
+		prior = priorDisp.data();
+	}
+	sgmStereo->Run(grayL.data(), grayR.data(), dispMap, confMap, prior);
+	frame.matched = frame.done = std::chrono::steady_clock::now();
 
-	printf("Frame %06d:	%5.1f ms, Average fps: %lf\n", frameCounter, duration*1000, 1.0 / (dtime / double(frameCounter+1)));
+	dtime += std::chrono::duration<float>(frame.matched - frame.converted).count();
+	AddStats(frame);
+}
 
-	delete[] iL;
-	delete[] iR;
+void CStateStereo::ProcessFrameAirSim(int frameCounter, float& dtime, const std::vector<uint8_t>& left_image, const std::vector<uint8_t>& right_image)
+{
+	ProcessFrame(frameCounter, dtime, left_image, right_image, NULL);
+}
+
+void CStateStereo::SetCamera(float focalLength_, float baseline_)
+{
+	focalLength = focalLength_;
+	baseline = baseline_;
+	hasPrevious = false;
+}
+
+void CStateStereo::ProcessFrameTemporal(int frameCounter, float& dtime, const std::vector<uint8_t>& left_image, const std::vector<uint8_t>& right_image,
+	const float motion[12])
+{
+	// frames in a row taking their search range from the prior before a full search
+	const int maxPriorFrames = 10;
+	bool usePrior = focalLength > 0 && baseline > 0 && framesSincePrior < maxPriorFrames;
+
+	ProcessFrame(frameCounter, dtime, left_image, right_image, usePrior ? motion : NULL);
+
+	framesSincePrior = sgmStereo->getPriorUsed() ? framesSincePrior + 1 : 0;
+	std::copy(dispMap, dispMap + previousDisp.size(), previousDisp.begin());
+	hasPrevious = true;
+}
+
+void CStateStereo::ResetTemporal()
+{
+	hasPrevious = false;
+	framesSincePrior = 0;
+}
 
+void CStateStereo::StartPipeline(std::function<void(StereoFrame&)> postProcess_, int poolSize)
+{
+	StopPipeline();
+
+	int nP = processingFrameWidth * processingFrameHeight;
+	if ((int)framePool.size() != poolSize)
+		framePool = std::vector<StereoFrame>(poolSize);
+
+	freeFrames.Reset();
+	matchFrames.Reset();
+	postFrames.Reset();
+	doneFrames.Reset();
+	for (StereoFrame& frame : framePool)
+	{
+		frame.grayL.resize(nP);
+		frame.grayR.resize(nP);
+		frame.dispMap.resize(nP);
+		frame.confMap.resize(nP);
+		freeFrames.Push(&frame);
+	}
+
+	ResetStats();
+	postProcess = postProcess_;
+	pipelineRunning = true;
+	matchThread = std::thread(&CStateStereo::MatchLoop, this);
+	postThread = std::thread(&CStateStereo::PostLoop, this);
+}
+
+bool CStateStereo::SubmitFrame(int frameId, const std::vector<uint8_t>& left_image, const std::vector<uint8_t>& right_image)
+{
+	if (!pipelineRunning)
+		return false;
+
+	StereoFrame* frame = freeFrames.Pop();
+	if (frame == NULL)
+		return false;
+
+	frame->frameId = frameId;
+	frame->submitted = std::chrono::steady_clock::now();
+	if (!ConvertFrame(left_image, right_image, frame->grayL.data(), frame->grayR.data()))
+	{
+		freeFrames.Push(frame);
+		return false;
+	}
+	frame->converted = std::chrono::steady_clock::now();
+	matchFrames.Push(frame);
+	return true;
+}
+
+void CStateStereo::MatchLoop()
+{
+	while (StereoFrame* frame = matchFrames.Pop())
+	{
+		sgmStereo->Run(frame->grayL.data(), frame->grayR.data(), frame->dispMap.data(), frame->confMap.data());
+		frame->matched = std::chrono::steady_clock::now();
+		postFrames.Push(frame);
+	}
+	postFrames.Close();
+}
+
+void CStateStereo::PostLoop()
+{
+	while (StereoFrame* frame = postFrames.Pop())
+	{
+		if (postProcess)
+			postProcess(*frame);
+		frame->done = std::chrono::steady_clock::now();
+		AddStats(*frame);
+		doneFrames.Push(frame);
+	}
+	doneFrames.Close();
+}
+
+StereoFrame* CStateStereo::ReceiveFrame()
+{
+	return doneFrames.Pop();
+}
+
+void CStateStereo::ReleaseFrame(StereoFrame* frame)
+{
+	if (frame != NULL)
+		freeFrames.Push(frame);
+}
+
+void CStateStereo::StopPipeline()
+{
+	if (!pipelineRunning)
+		return;
+
+	// wakes a SubmitFrame waiting for the pool, the match queue closing lets the threads finish in turn
+	freeFrames.Close();
+	matchFrames.Close();
+	matchThread.join();
+	postThread.join();
+	pipelineRunning = false;
+}
+
+void CStateStereo::ResetStats()
+{
+	std::lock_guard<std::mutex> lock(statsMutex);
+	stats = StereoPipelineStats();
+	totalLatency = totalConvert = totalMatch = totalPost = 0;
+}
+
+void CStateStereo::AddStats(const StereoFrame& frame)
+{
+	typedef std::chrono::duration<double, std::milli> Ms;
+
+	std::lock_guard<std::mutex> lock(statsMutex);
+	if (stats.frames == 0)
+		firstSubmitted = frame.submitted;
+	stats.frames++;
+
+	stats.lastLatency = Ms(frame.done - frame.submitted).count();
+	stats.maxLatency = std::max(stats.maxLatency, stats.lastLatency);
+	totalLatency += stats.lastLatency;
+	totalConvert += Ms(frame.converted - frame.submitted).count();
+	totalMatch += Ms(frame.matched - frame.converted).count();
+	totalPost += Ms(frame.done - frame.matched).count();
+
+	stats.meanLatency = totalLatency / stats.frames;
+	stats.meanConvert = totalConvert / stats.frames;
+	stats.meanMatch = totalMatch / stats.frames;
+	stats.meanPost = totalPost / stats.frames;
+	double elapsed = Ms(frame.done - firstSubmitted).count();
+	stats.fps = elapsed > 0 ? 1000.0 * stats.frames / elapsed : 0;
+}
+
+StereoPipelineStats CStateStereo::GetStats()
+{
+	std::lock_guard<std::mutex> lock(statsMutex);
+	return stats;
 }
 
 
@@ -115,10 +396,10 @@ float CStateStereo::GetLeftDisparity(float x, float y)
 {
 	int ix = (int)(x * processingFrameWidth + 0.5f); 
 	int iy = (int)(y * processingFrameHeight + 0.5f);
-	ix = __max(ix, 0);
-	ix = __min(ix, processingFrameWidth - 1);
-	iy = __max(iy, 0);
-	iy = __min(iy, processingFrameHeight - 1);
+	ix = std::max(ix, 0);
+	ix = std::min(ix, processingFrameWidth - 1);
+	iy = std::max(iy, 0);
+	iy = std::min(iy, processingFrameHeight - 1);
 	int off = iy*processingFrameWidth + ix;
 	float d = dispMap[off];
 	unsigned char c = confMap[off];
@@ -8,6 +8,55 @@
 #include "../sgmstereo/sgmstereo.h"
 #include "SGMOptions.h"
 #include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <chrono>
+
+// one stereo pair moving through the pipeline, buffers are allocated once by StartPipeline
+struct StereoFrame
+{
+	typedef std::chrono::steady_clock::time_point TimePoint;
+
+	int							frameId;
+	std::vector<unsigned char>	grayL, grayR;
+	std::vector<float>			dispMap;
+	std::vector<unsigned char>	confMap;
+
+	TimePoint					submitted, converted, matched, done;
+};
+
+// throughput and latency of the frames done so far, times in ms
+struct StereoPipelineStats
+{
+	int							frames = 0;
+	double						fps = 0;			// frames done per second of wall clock since the first was submitted
+	double						lastLatency = 0;	// from SubmitFrame until post-processing is done
+	double						meanLatency = 0;
+	double						maxLatency = 0;
+	double						meanConvert = 0;
+	double						meanMatch = 0;
+	double						meanPost = 0;
+};
+
+// blocking FIFO of frames between two pipeline stages
+class StereoFrameQueue
+{
+private:
+	std::deque<StereoFrame*>	frames;
+	std::mutex					mutex;
+	std::condition_variable		available;
+	bool						closed = false;
+
+public:
+	void						Reset();
+	void						Push(StereoFrame* frame);
+	// waits for a frame, NULL once the queue is closed and empty
+	StereoFrame*				Pop();
+	void						Close();
+};
 
 class CStateStereo
 {
@@ -21,19 +70,77 @@ private:
 	int							confThreshold;
 
 	SGMStereo *					sgmStereo;
-    
+
+	// gray images of ProcessFrameAirSim
+	std::vector<unsigned char>	grayL, grayR;
+
+	// temporal mode: disparities of the previous frame and those moved to the current one
+	float						focalLength, baseline;
+	std::vector<float>			previousDisp, priorDisp;
+	bool						hasPrevious;
+	int							framesSincePrior;
+
+	// pipeline: SubmitFrame converts on the caller's thread, matchThread runs SGM, postThread runs the
+	// post-processing callback, frames are handed on through the queues in the order they were submitted
+	std::vector<StereoFrame>	framePool;
+	StereoFrameQueue			freeFrames, matchFrames, postFrames, doneFrames;
+	std::thread					matchThread, postThread;
+	std::function<void(StereoFrame&)> postProcess;
+	bool						pipelineRunning;
+
+	std::mutex					statsMutex;
+	StereoPipelineStats			stats;
+	StereoFrame::TimePoint		firstSubmitted;
+	double						totalLatency, totalConvert, totalMatch, totalPost;
+
+	void						ProcessFrame(int frameCounter, float& dtime, const std::vector<uint8_t>& left_image, const std::vector<uint8_t>& right_image,
+									const float* motion);
+	bool						ConvertFrame(const std::vector<uint8_t>& left_image, const std::vector<uint8_t>& right_image,
+									unsigned char* iL, unsigned char* iR);
+	void						MatchLoop();
+	void						PostLoop();
+	void						ResetStats();
+	void						AddStats(const StereoFrame& frame);
+
 public:
-	
+
 	int							processingFrameWidth, processingFrameHeight;
-	
+
 	CStateStereo();
 	~CStateStereo();
 	void						Initialize(SGMOptions& params, int m = 144, int n = 256);
     void						CleanUp();
+	// synchronous, results are in dispMap and confMap. Not to be mixed with the pipeline.
     void                        ProcessFrameAirSim(int frameCounter, float& dtime, const std::vector<uint8_t>& left_image, const std::vector<uint8_t>& right_image);
 	float						GetLeftDisparity(float x, float y);
 
+	// Temporal mode: the disparities of the previous frame, moved by the camera motion since then, narrow the
+	// disparity search of the next one instead of the coarser pyramid levels (needs SGMOptions::pyramidLevels > 0).
+	// Pixels are projected with focal length and principal point at the image center, both in pixels.
+	void						SetCamera(float focalLength, float baseline);
+	// motion is the 3x4 row major transform [R | t] from the previous to the current left camera frame (x right,
+	// y down, z forward, t in units of the baseline). Frames where too few pixels have a prior, and every few
+	// frames so that errors do not carry on forever, search the full range through the coarser levels.
+	void						ProcessFrameTemporal(int frameCounter, float& dtime, const std::vector<uint8_t>& left_image, const std::vector<uint8_t>& right_image,
+									const float motion[12]);
+	// starts the next frame without prior, e.g. after a jump of the camera
+	void						ResetTemporal();
+
+	// Pipelined processing: frame N + 1 is converted while frame N is matched and frame N - 1 post-processed.
+	// postProcess, if given, runs on its own thread for each frame after matching.
+	void						StartPipeline(std::function<void(StereoFrame&)> postProcess = nullptr, int poolSize = 3);
+	// converts the images to gray and queues them for matching, waits while all frames of the pool are in use.
+	// False if the pipeline is not running or the images do not match the initialized resolution.
+	bool						SubmitFrame(int frameId, const std::vector<uint8_t>& left_image, const std::vector<uint8_t>& right_image);
+	// next frame in submission order, waits for it to be done. NULL once the pipeline is stopped and drained.
+	StereoFrame*				ReceiveFrame();
+	// gives a received frame back to the pool
+	void						ReleaseFrame(StereoFrame* frame);
+	// finishes the submitted frames and stops the threads, done frames can still be received
+	void						StopPipeline();
+	StereoPipelineStats			GetStats();
+
 	float*						dispMap;
 	unsigned char*				confMap;
 
-};
\ No newline at end of file
+};
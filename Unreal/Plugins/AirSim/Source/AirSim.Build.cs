@@ -127,6 +127,8 @@ public class AirSim : ModuleRules
 			// needed when packaging
 			PublicAdditionalLibraries.Add("stdc++");
 			PublicAdditionalLibraries.Add("supc++");
+			// shm_open for shared memory image transport
+			PublicAdditionalLibraries.Add("rt");
 		}
     }
 
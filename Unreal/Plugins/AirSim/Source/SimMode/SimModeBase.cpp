@@ -13,6 +13,7 @@
 #include "common/AirSimSettings.hpp"
 #include "common/ScalableClock.hpp"
 #include "common/SteppableClock.hpp"
+#include "common/common_utils/ThreadWaiter.hpp"
 #include "SimJoyStick/SimJoyStick.h"
 #include "common/EarthCelestial.hpp"
 #include "sensors/lidar/LidarSimple.hpp"
@@ -65,6 +66,7 @@ void ASimModeBase::BeginPlay()
 
     world_sim_api_.reset(new WorldSimApi(this));
     api_provider_.reset(new msr::airlib::ApiProvider(world_sim_api_.get()));
+    setupThreadWaiter();
     setupPhysicsLoopPeriod();
 
     setupClockSpeed();
@@ -258,6 +260,17 @@ void ASimModeBase::setupPhysicsLoopPeriod()
 {
 }
 
+void ASimModeBase::setupThreadWaiter()
+{
+    //must be done before physics loop and clocks are created as they pick up default config
+    const auto& waiter_setting = getSettings().thread_waiter_setting;
+
+    common_utils::ThreadWaiter::Config config;
+    config.strategy = common_utils::ThreadWaiter::toStrategy(waiter_setting.strategy);
+    config.spin_threshold_nanos = static_cast<uint64_t>(waiter_setting.spin_threshold_us) * 1000;
+    common_utils::ThreadWaiter::getSetDefaultConfig(&config);
+}
+
 void ASimModeBase::Tick(float DeltaSeconds)
 {
     if (isRecording())
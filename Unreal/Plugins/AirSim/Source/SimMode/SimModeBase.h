@@ -154,6 +154,7 @@ private:
     void advanceTimeOfDay();
     void setSunRotation(FRotator rotation);
     void setupPhysicsLoopPeriod();
+    void setupThreadWaiter();
     void showClockStats();
     void drawLidarDebugPoints();
 };
@@ -19,6 +19,10 @@ void ASimModeWorldBase::initializeForPlay()
     physics_engine_ = physics_engine.get();
     physics_world_.reset(new msr::airlib::PhysicsWorld(std::move(physics_engine),
         vehicles, getPhysicsLoopPeriod()));
+
+    const auto& parallel_update_setting = getSettings().parallel_update_setting;
+    if (parallel_update_setting.enabled)
+        physics_world_->enableParallelUpdate(parallel_update_setting.thread_count, parallel_update_setting.deterministic);
 }
 
 void ASimModeWorldBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
@@ -57,7 +61,8 @@ std::unique_ptr<ASimModeWorldBase::PhysicsEngineBase> ASimModeWorldBase::createP
     else if (physics_engine_name == "FastPhysicsEngine") {
         msr::airlib::Settings fast_phys_settings;
         if (msr::airlib::Settings::singleton().getChild("FastPhysicsEngine", fast_phys_settings)) {
-            physics_engine.reset(new msr::airlib::FastPhysicsEngine(fast_phys_settings.getBool("EnableGroundLock", true)));
+            physics_engine.reset(new msr::airlib::FastPhysicsEngine(fast_phys_settings.getBool("EnableGroundLock", true),
+                fast_phys_settings.getBool("EnableBatchIntegration", false)));
         }
         else {
             physics_engine.reset(new msr::airlib::FastPhysicsEngine());
@@ -52,6 +52,12 @@ void AirsimROSWrapper::initialize_airsim()
         airsim_client_images_.confirmConnection();
         airsim_client_lidar_.confirmConnection();
 
+        // images and point clouds go through shared memory if AirSim runs on this host, otherwise RPC is used as before
+        if (airsim_client_images_.enableSharedMemory())
+            std::cout << "Using shared memory for images" << std::endl;
+        if (airsim_client_lidar_.enableSharedMemory())
+            std::cout << "Using shared memory for lidar" << std::endl;
+
         for (const auto& vehicle_name : vehicle_names_)
         {
             airsim_client_.enableApiControl(true, vehicle_name); // todo expose as rosservice?
@@ -722,13 +728,43 @@ void AirsimROSWrapper::drone_state_timer_cb(const ros::TimerEvent& event)
 
         // todo this is global origin
         origin_geo_point_pub_.publish(origin_geo_point_msg_);
-        // iterate over drones
-        for (auto& multirotor_ros: multirotor_ros_vec_)
+
+        // get estimated state of all drones and their imus in one round trip
+        std::vector<msr::airlib::VehicleStateQuery::Request> state_request;
+        std::map<std::string, size_t> state_index;
+        for (const auto& multirotor_ros: multirotor_ros_vec_)
+        {
+            state_index[multirotor_ros.vehicle_name] = state_request.size();
+            state_request.emplace_back(multirotor_ros.vehicle_name);
+            state_request.back().estimated_state = true;
+        }
+        for (const auto& vehicle_imu_pair: vehicle_imu_map_)
+        {
+            auto it = state_index.find(vehicle_imu_pair.first);
+            if (it == state_index.end())
+            {
+                it = state_index.emplace(vehicle_imu_pair.first, state_request.size()).first;
+                state_request.emplace_back(vehicle_imu_pair.first);
+            }
+            state_request[it->second].imu_names.push_back(vehicle_imu_pair.second);
+        }
+
+        std::vector<msr::airlib::VehicleStateQuery::Response> vehicle_states;
+        if (state_request.size() > 0)
         {
-            // get drone state from airsim
             std::unique_lock<std::recursive_mutex> lck(drone_control_mutex_);
-            multirotor_ros.curr_drone_state = airsim_client_.getMultirotorState(multirotor_ros.vehicle_name);
+            vehicle_states = airsim_client_.simGetVehicleStates(state_request);
             lck.unlock();
+        }
+
+        // iterate over drones
+        for (auto& multirotor_ros: multirotor_ros_vec_)
+        {
+            // only the parts of drone state that are published here are updated
+            const auto& vehicle_state = vehicle_states[state_index.at(multirotor_ros.vehicle_name)];
+            multirotor_ros.curr_drone_state.kinematics_estimated = vehicle_state.kinematics_estimated;
+            multirotor_ros.curr_drone_state.gps_location = vehicle_state.gps_location;
+            multirotor_ros.curr_drone_state.timestamp = vehicle_state.time_stamp;
             ros::Time curr_ros_time = ros::Time::now();
 
             // convert airsim drone state to ROS msgs
@@ -764,10 +800,8 @@ void AirsimROSWrapper::drone_state_timer_cb(const ros::TimerEvent& event)
             int ctr = 0;
             for (const auto& vehicle_imu_pair: vehicle_imu_map_)
             {
-                std::unique_lock<std::recursive_mutex> lck(drone_control_mutex_);
-                auto imu_data = airsim_client_.getImuData(vehicle_imu_pair.second, vehicle_imu_pair.first);
-                lck.unlock();
-                sensor_msgs::Imu imu_msg = get_imu_msg_from_airsim(imu_data);
+                const auto& vehicle_state = vehicle_states[state_index.at(vehicle_imu_pair.first)];
+                sensor_msgs::Imu imu_msg = get_imu_msg_from_airsim(vehicle_state.imu_data.at(vehicle_imu_pair.second));
                 imu_msg.header.frame_id = vehicle_imu_pair.first;
                 imu_msg.header.stamp = ros::Time::now();
                 imu_pub_vec_[ctr].publish(imu_msg);